@@ -33,6 +33,11 @@ render =
     show_fps = 1;
 }
 
+physics =
+{
+    threads = 0;
+}
+
 controls =
 {
     mouse_sensitivity_x = 0.50;
@@ -18,6 +18,7 @@ extern "C" {
 #include "../core/vmath.h"
 #include "../core/gl_text.h"
 #include "../core/console.h"
+#include "../core/profiler.h"
 #include "../script/script.h"
 #include "../render/camera.h"
 #include "../vt/vt_level.h"
@@ -686,17 +687,17 @@ void AudioSource::LinkEmitter()
 }
 
 
-void Audio_CoreInit()
+void Audio_CoreInit(const char *device_name)
 {
     ALCint paramList[] = {
         ALC_STEREO_SOURCES,  TR_AUDIO_STREAM_NUMSOURCES,
         ALC_MONO_SOURCES,   (TR_AUDIO_MAX_CHANNELS - TR_AUDIO_STREAM_NUMSOURCES),
         ALC_FREQUENCY,       44100, 0};
 
-    al_device = alcOpenDevice(NULL);
+    al_device = alcOpenDevice(device_name);
     if (!al_device)
     {
-        Sys_DebugLog(SYS_LOG_FILENAME, "InitAL: No AL audio devices!");
+        Sys_DebugLog(SYS_LOG_FILENAME, "InitAL: No AL audio devices! (%s)", device_name ? device_name : "default");
         return;
     }
 
@@ -1977,6 +1978,7 @@ void Audio_UpdateListenerByEntity(struct entity_s *ent)
 
 void Audio_Update(float time)
 {
+    PROF_ZONE("Audio_Update");
     Audio_UpdateSources();
     Audio_UpdateStreams(time);
     Audio_UpdateListenerByCamera(&engine_camera, time);
@@ -17,6 +17,11 @@
 
 #define TR_AUDIO_MAX_CHANNELS 32
 
+// OpenAL Soft output device, that mixes sound without playing it.
+// Used by headless runs to keep audio update cost in benchmarks.
+
+#define AUDIO_NULL_DEVICE_NAME "No Output"
+
 // NUMSOURCES tells the engine how many sources we should reserve for
 // in-game music and BGMs, considering crossfades. By default, it's 6,
 // as it's more than enough for typical TR audio setup (one BGM track
@@ -155,7 +160,7 @@ extern struct audio_settings_s audio_settings;
 
 void Audio_InitGlobals();
 
-void Audio_CoreInit();
+void Audio_CoreInit(const char *device_name = NULL);
 void Audio_CoreDeinit();
 void Audio_Init(uint32_t num_Sources = TR_AUDIO_MAX_CHANNELS);
 void Audio_GenSamples(class VT_Level *tr);
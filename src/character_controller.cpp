@@ -7,6 +7,7 @@
 #include "core/console.h"
 #include "core/polygon.h"
 #include "core/obb.h"
+#include "core/profiler.h"
 #include "render/render.h"
 #include "script/script.h"
 #include "physics/ragdoll.h"
@@ -176,6 +177,7 @@ void Character_Delete(struct entity_s *ent)
 void Character_Update(struct entity_s *ent)
 {
     const uint16_t mask = ENTITY_STATE_ENABLED | ENTITY_STATE_ACTIVE;
+    PROF_ZONE("Character_Update");
     if(mask == (ent->state_flags & mask))
     {
         bool is_player = (World_GetPlayer() == ent);
@@ -511,12 +513,22 @@ void Character_UpdateCurrentHeight(struct entity_s *ent)
  */
 void Character_GetHeightInfo(float pos[3], struct height_info_s *fc, float v_offset)
 {
-    float from[3], to[3];
+    height_probe_t probe;
     room_p r = (fc->self) ? (fc->self->room) : (NULL);
     room_sector_p rs;
 
-    fc->floor_hit.hit = 0x00;
-    fc->ceiling_hit.hit = 0x00;
+    /*
+     * GET HEIGHTS
+     */
+    vec3_copy(probe.pos, pos);
+    probe.depth = 8192.0f;
+    probe.height = 4096.0f;
+    probe.cont = fc->self;
+    probe.filter = COLLISION_FILTER_HEIGHT_TEST;
+    Physics_HeightProbes(&probe, 1);
+    fc->floor_hit = probe.floor_hit;
+    fc->ceiling_hit = probe.ceiling_hit;
+
     fc->water = 0x00;
     fc->quicksand = 0x00;
     fc->transition_level = 32512.0;
@@ -585,19 +597,6 @@ void Character_GetHeightInfo(float pos[3], struct height_info_s *fc, float v_off
             }
         }
     }
-
-    /*
-     * GET HEIGHTS
-     */
-    vec3_copy(from, pos);
-    to[0] = from[0];
-    to[1] = from[1];
-    to[2] = from[2] - 8192.0f;
-
-    Physics_RayTestFiltered(&fc->floor_hit, from ,to, fc->self, COLLISION_FILTER_HEIGHT_TEST);
-
-    to[2] = from[2] + 4096.0f;
-    Physics_RayTestFiltered(&fc->ceiling_hit, from ,to, fc->self, COLLISION_FILTER_HEIGHT_TEST);
 }
 
 /**
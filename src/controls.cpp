@@ -1,4 +1,6 @@
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_platform.h>
@@ -30,6 +32,32 @@ extern "C" {
 struct engine_control_state_s           control_states = {0};
 struct control_settings_s               control_settings = {0};
 
+/*
+ * Input record file: header, then one fixed size record per game frame.
+ * All values are stored in little endian byte order.
+ */
+#define CONTROLS_RECORD_MAGIC           (0x5249544F)    // "OTIR"
+#define CONTROLS_RECORD_VERSION         (1)
+
+#define CONTROLS_RECORD_FLAG_LOOK       (0x01)
+#define CONTROLS_RECORD_FLAG_FREE_LOOK  (0x02)
+#define CONTROLS_RECORD_FLAG_MOUSE_LOOK (0x04)
+#define CONTROLS_RECORD_FLAG_NOCLIP     (0x08)
+
+typedef struct controls_record_frame_s
+{
+    float       time;
+    uint64_t    actions;                           // bit per ACTIONS entry
+    uint8_t     flags;
+    float       look_axis[2];
+    float       joy_look[2];
+    float       joy_move[2];
+}controls_record_frame_t, *controls_record_frame_p;
+
+static FILE    *controls_record_file = NULL;
+static int      controls_replay = 0;
+static uint32_t controls_record_frames = 0;
+
 
 void Controls_Key(int32_t button, int state, int memu_mode)
 {
@@ -1351,3 +1379,192 @@ void Controls_KeyToStr(char buff[128], int key)
             break;
     }
 }
+
+
+/*
+ * INPUT RECORDING AND REPLAY
+ */
+static void Controls_WriteUInt32(uint32_t value)
+{
+    uint32_t le = SDL_SwapLE32(value);
+    fwrite(&le, sizeof(le), 1, controls_record_file);
+}
+
+static void Controls_WriteFloat(float value)
+{
+    uint32_t v;
+    memcpy(&v, &value, sizeof(v));
+    Controls_WriteUInt32(v);
+}
+
+static int Controls_ReadUInt32(uint32_t *value)
+{
+    uint32_t le;
+    if(fread(&le, sizeof(le), 1, controls_record_file) != 1)
+    {
+        return 0;
+    }
+    *value = SDL_SwapLE32(le);
+    return 1;
+}
+
+static int Controls_ReadFloat(float *value)
+{
+    uint32_t v;
+    if(!Controls_ReadUInt32(&v))
+    {
+        return 0;
+    }
+    memcpy(value, &v, sizeof(v));
+    return 1;
+}
+
+int Controls_StartRecord(const char *file_name, uint32_t seed)
+{
+    Controls_StopRecordReplay();
+    controls_record_file = fopen(file_name, "wb");
+    if(!controls_record_file)
+    {
+        Sys_DebugLog(SYS_LOG_FILENAME, "Error: can not create input record file \"%s\"", file_name);
+        return 0;
+    }
+
+    Controls_WriteUInt32(CONTROLS_RECORD_MAGIC);
+    Controls_WriteUInt32(CONTROLS_RECORD_VERSION);
+    Controls_WriteUInt32(seed);
+    srand(seed);
+    return 1;
+}
+
+int Controls_StartReplay(const char *file_name)
+{
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    uint32_t seed = 0;
+
+    Controls_StopRecordReplay();
+    controls_record_file = fopen(file_name, "rb");
+    if(!controls_record_file)
+    {
+        Sys_DebugLog(SYS_LOG_FILENAME, "Error: can not open input record file \"%s\"", file_name);
+        return 0;
+    }
+
+    if(!Controls_ReadUInt32(&magic) || !Controls_ReadUInt32(&version) || !Controls_ReadUInt32(&seed) ||
+       (magic != CONTROLS_RECORD_MAGIC) || (version != CONTROLS_RECORD_VERSION))
+    {
+        Sys_DebugLog(SYS_LOG_FILENAME, "Error: \"%s\" is not an input record file or has wrong version", file_name);
+        fclose(controls_record_file);
+        controls_record_file = NULL;
+        return 0;
+    }
+
+    controls_replay = 1;
+    srand(seed);
+    return 1;
+}
+
+void Controls_StopRecordReplay()
+{
+    if(controls_record_file)
+    {
+        fclose(controls_record_file);
+        controls_record_file = NULL;
+        Sys_DebugLog(SYS_LOG_FILENAME, "Input %s stopped after %d frames", controls_replay ? "replay" : "record", controls_record_frames);
+    }
+    controls_replay = 0;
+    controls_record_frames = 0;
+}
+
+int Controls_IsRecording()
+{
+    return controls_record_file && !controls_replay;
+}
+
+int Controls_IsReplaying()
+{
+    return controls_record_file && controls_replay;
+}
+
+/**
+ * Stores current input state; call it right before Game_Frame(time).
+ */
+void Controls_RecordFrame(float time)
+{
+    if(controls_record_file && !controls_replay)
+    {
+        uint64_t actions = 0;
+        uint8_t flags = 0;
+
+        for(int i = 0; i < ACT_LASTINDEX; i++)
+        {
+            if(control_states.actions[i].state)
+            {
+                actions |= ((uint64_t)1) << i;
+            }
+        }
+        flags |= (control_states.look) ? (CONTROLS_RECORD_FLAG_LOOK) : (0x00);
+        flags |= (control_states.free_look) ? (CONTROLS_RECORD_FLAG_FREE_LOOK) : (0x00);
+        flags |= (control_states.mouse_look) ? (CONTROLS_RECORD_FLAG_MOUSE_LOOK) : (0x00);
+        flags |= (control_states.noclip) ? (CONTROLS_RECORD_FLAG_NOCLIP) : (0x00);
+
+        Controls_WriteFloat(time);
+        Controls_WriteUInt32((uint32_t)actions);
+        Controls_WriteUInt32((uint32_t)(actions >> 32));
+        fwrite(&flags, sizeof(flags), 1, controls_record_file);
+        Controls_WriteFloat(control_states.look_axis_x);
+        Controls_WriteFloat(control_states.look_axis_y);
+        Controls_WriteFloat(control_settings.joy_look_x);
+        Controls_WriteFloat(control_settings.joy_look_y);
+        Controls_WriteFloat(control_settings.joy_move_x);
+        Controls_WriteFloat(control_settings.joy_move_y);
+        controls_record_frames++;
+    }
+}
+
+/**
+ * Replaces event polling: loads next recorded input state and frame time.
+ * Returns 0 at the end of the record.
+ */
+int Controls_ReplayFrame(float *time)
+{
+    controls_record_frame_t frame;
+    uint32_t lo, hi;
+
+    if(!controls_record_file || !controls_replay)
+    {
+        return 0;
+    }
+
+    if(!Controls_ReadFloat(&frame.time) || !Controls_ReadUInt32(&lo) || !Controls_ReadUInt32(&hi) ||
+       (fread(&frame.flags, sizeof(frame.flags), 1, controls_record_file) != 1) ||
+       !Controls_ReadFloat(frame.look_axis + 0) || !Controls_ReadFloat(frame.look_axis + 1) ||
+       !Controls_ReadFloat(frame.joy_look + 0) || !Controls_ReadFloat(frame.joy_look + 1) ||
+       !Controls_ReadFloat(frame.joy_move + 0) || !Controls_ReadFloat(frame.joy_move + 1))
+    {
+        Controls_StopRecordReplay();
+        return 0;
+    }
+    frame.actions = ((uint64_t)hi << 32) | lo;
+
+    for(int i = 0; i < ACT_LASTINDEX; i++)
+    {
+        control_states.actions[i].prev_state = control_states.actions[i].state;
+        control_states.actions[i].state = (frame.actions >> i) & 0x01;
+    }
+    control_states.last_key = 0;
+    control_states.look = (frame.flags & CONTROLS_RECORD_FLAG_LOOK) ? (1) : (0);
+    control_states.free_look = (frame.flags & CONTROLS_RECORD_FLAG_FREE_LOOK) ? (1) : (0);
+    control_states.mouse_look = (frame.flags & CONTROLS_RECORD_FLAG_MOUSE_LOOK) ? (1) : (0);
+    control_states.noclip = (frame.flags & CONTROLS_RECORD_FLAG_NOCLIP) ? (1) : (0);
+    control_states.look_axis_x = frame.look_axis[0];
+    control_states.look_axis_y = frame.look_axis[1];
+    control_settings.joy_look_x = frame.joy_look[0];
+    control_settings.joy_look_y = frame.joy_look[1];
+    control_settings.joy_move_x = frame.joy_move[0];
+    control_settings.joy_move_y = frame.joy_move[1];
+    *time = frame.time;
+    controls_record_frames++;
+
+    return 1;
+}
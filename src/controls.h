@@ -154,4 +154,14 @@ void Controls_JoyAxis(int axis, Sint16 value);
 void Controls_JoyHat(int value, int menu_mode);
 void Controls_InitGlobals();
 
+// Input recording and replay: one record per game frame with action states,
+// look / move axes and frame time, so a session can be played back exactly.
+int  Controls_StartRecord(const char *file_name, uint32_t seed);
+int  Controls_StartReplay(const char *file_name);
+void Controls_StopRecordReplay();
+int  Controls_IsRecording();
+int  Controls_IsReplaying();
+void Controls_RecordFrame(float time);
+int  Controls_ReplayFrame(float *time);
+
 #endif /* CONTROLS_H */
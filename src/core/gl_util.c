@@ -216,6 +216,8 @@ PFNGLGETATTRIBLOCATIONARBPROC           qglGetAttribLocationARB = NULL;
 PFNGLENABLEVERTEXATTRIBARRAYARBPROC     qglEnableVertexAttribArrayARB = NULL;
 PFNGLENABLEVERTEXATTRIBARRAYARBPROC     qglDisableVertexAttribArrayARB = NULL;
 PFNGLVERTEXATTRIBPOINTERARBPROC         qglVertexAttribPointerARB = NULL;
+PFNGLVERTEXATTRIB1FARBPROC              qglVertexAttrib1fARB = NULL;
+PFNGLVERTEXATTRIB2FARBPROC              qglVertexAttrib2fARB = NULL;
 
 PFNGLACTIVETEXTUREARBPROC               qglActiveTextureARB = NULL;
 PFNGLCLIENTACTIVETEXTUREARBPROC         qglClientActiveTextureARB = NULL;
@@ -271,6 +273,9 @@ PFNGLISVERTEXARRAYPROC                  qglIsVertexArray = NULL;
 
 PFNGLGENERATEMIPMAPEXTPROC              qglGenerateMipmap = NULL;
 
+PFNGLDRAWELEMENTSINSTANCEDARBPROC       qglDrawElementsInstancedARB = NULL;
+PFNGLVERTEXATTRIBDIVISORARBPROC         qglVertexAttribDivisorARB = NULL;
+
 static char *engine_gl_ext_str = NULL;
 static GLuint whiteTexture = 0;
 
@@ -575,11 +580,206 @@ void InitGLExtFuncs()
         qglDisableVertexAttribArrayARB = (PFNGLDISABLEVERTEXATTRIBARRAYARBPROC)SDL_GL_GetProcAddress("glDisableVertexAttribArrayARB");
 
         qglVertexAttribPointerARB = (PFNGLVERTEXATTRIBPOINTERARBPROC)SDL_GL_GetProcAddress("glVertexAttribPointerARB");
+        qglVertexAttrib1fARB = (PFNGLVERTEXATTRIB1FARBPROC)SDL_GL_GetProcAddress("glVertexAttrib1fARB");
+        qglVertexAttrib2fARB = (PFNGLVERTEXATTRIB2FARBPROC)SDL_GL_GetProcAddress("glVertexAttrib2fARB");
     }
     else
     {
         Sys_Error("Shaders not supported");
     }
+
+    /// Instancing is optional: without it renderer draws instances one by one
+    if(IsGLExtensionSupported("GL_ARB_draw_instanced") && IsGLExtensionSupported("GL_ARB_instanced_arrays"))
+    {
+        qglDrawElementsInstancedARB = (PFNGLDRAWELEMENTSINSTANCEDARBPROC)SDL_GL_GetProcAddress("glDrawElementsInstancedARB");
+        qglVertexAttribDivisorARB = (PFNGLVERTEXATTRIBDIVISORARBPROC)SDL_GL_GetProcAddress("glVertexAttribDivisorARB");
+    }
+}
+
+/*
+ * Null GL driver: typed no-op entry points for the functions the engine uses
+ * outside of gl_util.c, so level loading and game logic can run without a GL
+ * context (headless benchmarks, CI). Object names are handed out sequentially.
+ */
+static GLuint null_gl_names = 0;
+
+static void APIENTRY nglVoidEnum(GLenum a) { }
+static void APIENTRY nglVoidBits(GLbitfield a) { }
+static void APIENTRY nglVoidVoid(void) { }
+static void APIENTRY nglVoidEnumEnum(GLenum a, GLenum b) { }
+static void APIENTRY nglVoidEnumUint(GLenum a, GLuint b) { }
+static void APIENTRY nglVoidFloat(GLfloat a) { }
+static void APIENTRY nglVoidFloat2(GLfloat a, GLfloat b) { }
+static void APIENTRY nglClearColor(GLclampf r, GLclampf g, GLclampf b, GLclampf a) { }
+static void APIENTRY nglAlphaFunc(GLenum func, GLclampf ref) { }
+static void APIENTRY nglDepthMask(GLboolean flag) { }
+static void APIENTRY nglPointer(GLint size, GLenum type, GLsizei stride, const GLvoid *ptr) { }
+static void APIENTRY nglNormalPointer(GLenum type, GLsizei stride, const GLvoid *ptr) { }
+static void APIENTRY nglDrawArrays(GLenum mode, GLint first, GLsizei count) { }
+static void APIENTRY nglDrawElements(GLenum mode, GLsizei count, GLenum type, const GLvoid *indices) { }
+static void APIENTRY nglPixelStorei(GLenum pname, GLint param) { }
+static void APIENTRY nglViewport(GLint x, GLint y, GLsizei width, GLsizei height) { }
+static void APIENTRY nglStencilFunc(GLenum func, GLint ref, GLuint mask) { }
+static void APIENTRY nglStencilOp(GLenum fail, GLenum zfail, GLenum zpass) { }
+static void APIENTRY nglTexParameteri(GLenum target, GLenum pname, GLint param) { }
+static void APIENTRY nglTexParameterf(GLenum target, GLenum pname, GLfloat param) { }
+static void APIENTRY nglTexImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const GLvoid *pixels) { }
+static void APIENTRY nglBufferData(GLenum target, GLsizeiptrARB size, const void *data, GLenum usage) { }
+static void APIENTRY nglDeleteNames(GLsizei n, const GLuint *names) { }
+static void APIENTRY nglHandle(GLhandleARB obj) { }
+static void APIENTRY nglHandle2(GLhandleARB a, GLhandleARB b) { }
+static void APIENTRY nglUniform1f(GLint location, GLfloat v0) { }
+static void APIENTRY nglUniform4f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3) { }
+static void APIENTRY nglUniform1i(GLint location, GLint v0) { }
+static void APIENTRY nglUniformfv(GLint location, GLsizei count, const GLfloat *value) { }
+static void APIENTRY nglUniformMatrixfv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value) { }
+
+static void APIENTRY nglGenNames(GLsizei n, GLuint *names)
+{
+    for(GLsizei i = 0; i < n; ++i)
+    {
+        names[i] = ++null_gl_names;
+    }
+}
+
+static GLboolean APIENTRY nglIsName(GLuint name)
+{
+    return (name != 0) ? (GL_TRUE) : (GL_FALSE);
+}
+
+static void APIENTRY nglGetIntegerv(GLenum pname, GLint *params)
+{
+    switch(pname)
+    {
+        case GL_MAX_TEXTURE_SIZE:
+            params[0] = 4096;
+            break;
+
+        case GL_VIEWPORT:
+            params[0] = params[1] = 0;
+            params[2] = screen_info.w;
+            params[3] = screen_info.h;
+            break;
+
+        default:
+            params[0] = 0;
+            break;
+    };
+}
+
+static void APIENTRY nglGetFloatv(GLenum pname, GLfloat *params)
+{
+    params[0] = 1.0f;
+}
+
+static void APIENTRY nglReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, GLvoid *pixels)
+{
+    memset(pixels, 0, 4 * width * height);
+}
+
+static void* APIENTRY nglMapBuffer(GLenum target, GLenum access)
+{
+    return NULL;
+}
+
+static GLboolean APIENTRY nglUnmapBuffer(GLenum target)
+{
+    return GL_TRUE;
+}
+
+static GLhandleARB APIENTRY nglCreateProgramObject(void)
+{
+    return ++null_gl_names;
+}
+
+static GLhandleARB APIENTRY nglCreateShaderObject(GLenum type)
+{
+    return ++null_gl_names;
+}
+
+static GLint APIENTRY nglGetUniformLocation(GLhandleARB program, const GLcharARB *name)
+{
+    return -1;
+}
+
+static GLenum APIENTRY nglGetError(void)
+{
+    return GL_NO_ERROR;
+}
+
+/**
+ * Install the null GL driver instead of InitGLExtFuncs(). No window or context is required.
+ */
+void InitGLNullFuncs()
+{
+    null_gl_names = 0;
+    whiteTexture = 0;
+
+    qglClear = nglVoidBits;
+    qglClearColor = nglClearColor;
+    qglAlphaFunc = nglAlphaFunc;
+    qglBlendFunc = nglVoidEnumEnum;
+    qglFrontFace = nglVoidEnum;
+    qglPointSize = nglVoidFloat;
+    qglLineWidth = nglVoidFloat;
+    qglPolygonMode = nglVoidEnumEnum;
+    qglEnable = nglVoidEnum;
+    qglDisable = nglVoidEnum;
+    qglEnableClientState = nglVoidEnum;
+    qglDisableClientState = nglVoidEnum;
+    qglGetError = nglGetError;
+    qglGetFloatv = nglGetFloatv;
+    qglGetIntegerv = nglGetIntegerv;
+    qglPushAttrib = nglVoidBits;
+    qglPopAttrib = nglVoidVoid;
+    qglPushClientAttrib = nglVoidBits;
+    qglPopClientAttrib = nglVoidVoid;
+    qglDepthFunc = nglVoidEnum;
+    qglDepthMask = nglDepthMask;
+    qglViewport = nglViewport;
+    qglPixelZoom = nglVoidFloat2;
+    qglPixelStorei = nglPixelStorei;
+    qglReadPixels = nglReadPixels;
+    qglStencilFunc = nglStencilFunc;
+    qglStencilOp = nglStencilOp;
+    qglTexParameterf = nglTexParameterf;
+    qglTexParameteri = nglTexParameteri;
+    qglTexImage2D = nglTexImage2D;
+    qglGenTextures = nglGenNames;
+    qglDeleteTextures = nglDeleteNames;
+    qglBindTexture = nglVoidEnumUint;
+    qglIsTexture = nglIsName;
+    qglGenerateMipmap = nglVoidEnum;
+    qglVertexPointer = nglPointer;
+    qglNormalPointer = nglNormalPointer;
+    qglColorPointer = nglPointer;
+    qglTexCoordPointer = nglPointer;
+    qglDrawArrays = nglDrawArrays;
+    qglDrawElements = nglDrawElements;
+
+    qglBindBufferARB = nglVoidEnumUint;
+    qglDeleteBuffersARB = nglDeleteNames;
+    qglGenBuffersARB = nglGenNames;
+    qglIsBufferARB = nglIsName;
+    qglBufferDataARB = nglBufferData;
+    qglMapBufferARB = nglMapBuffer;
+    qglUnmapBufferARB = nglUnmapBuffer;
+
+    qglDeleteObjectARB = nglHandle;
+    qglCreateShaderObjectARB = nglCreateShaderObject;
+    qglCreateProgramObjectARB = nglCreateProgramObject;
+    qglAttachObjectARB = nglHandle2;
+    qglLinkProgramARB = nglHandle;
+    qglUseProgramObjectARB = nglHandle;
+    qglGetUniformLocationARB = nglGetUniformLocation;
+    qglUniform1fARB = nglUniform1f;
+    qglUniform4fARB = nglUniform4f;
+    qglUniform1iARB = nglUniform1i;
+    qglUniform1fvARB = nglUniformfv;
+    qglUniform2fvARB = nglUniformfv;
+    qglUniform3fvARB = nglUniformfv;
+    qglUniform4fvARB = nglUniformfv;
+    qglUniformMatrix4fvARB = nglUniformMatrixfv;
 }
 
 /**
@@ -371,6 +371,8 @@ extern PFNGLGETATTRIBLOCATIONARBPROC qglGetAttribLocationARB;
 extern PFNGLENABLEVERTEXATTRIBARRAYARBPROC qglEnableVertexAttribArrayARB;
 extern PFNGLENABLEVERTEXATTRIBARRAYARBPROC qglDisableVertexAttribArrayARB;
 extern PFNGLVERTEXATTRIBPOINTERARBPROC qglVertexAttribPointerARB;
+extern PFNGLVERTEXATTRIB1FARBPROC qglVertexAttrib1fARB;
+extern PFNGLVERTEXATTRIB2FARBPROC qglVertexAttrib2fARB;
 
 /*multitexture EXT*/
 extern PFNGLACTIVETEXTUREARBPROC qglActiveTextureARB;
@@ -428,7 +430,11 @@ extern PFNGLISVERTEXARRAYPROC qglIsVertexArray;
 
 extern PFNGLGENERATEMIPMAPPROC qglGenerateMipmap;
 
+extern PFNGLDRAWELEMENTSINSTANCEDARBPROC qglDrawElementsInstancedARB;    // NULL if instancing is not supported
+extern PFNGLVERTEXATTRIBDIVISORARBPROC qglVertexAttribDivisorARB;
+
 void InitGLExtFuncs();
+void InitGLNullFuncs();
 int IsGLExtensionSupported(const char *ext);
 
 int checkOpenGLError();
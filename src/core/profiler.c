@@ -0,0 +1,182 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "system.h"
+#include "profiler.h"
+
+
+typedef struct prof_event_s
+{
+    const char     *name;
+    int64_t         begin;
+    int64_t         end;
+}prof_event_t, *prof_event_p;
+
+typedef struct prof_frame_s
+{
+    uint64_t        first_event;
+    int64_t         begin;
+}prof_frame_t, *prof_frame_p;
+
+static struct
+{
+    prof_event_p    events;
+    uint64_t        events_count;
+    prof_frame_t    frames[PROF_MAX_FRAMES];
+    uint64_t        frames_count;
+    uint64_t        stack[PROF_MAX_DEPTH];
+    uint32_t        depth;
+    int             pending_enabled;
+} profiler = {0};
+
+int prof_enabled = 0;
+
+
+void Prof_Init()
+{
+    if(!profiler.events)
+    {
+        profiler.events = (prof_event_p)calloc(PROF_MAX_EVENTS, sizeof(prof_event_t));
+    }
+    profiler.events_count = 0;
+    profiler.frames_count = 0;
+    profiler.depth = 0;
+}
+
+
+void Prof_Destroy()
+{
+    prof_enabled = 0;
+    profiler.pending_enabled = 0;
+    free(profiler.events);
+    profiler.events = NULL;
+}
+
+/**
+ * Takes effect on the next Prof_FrameBegin() call, so zones opened in the
+ * current frame are closed consistently.
+ */
+void Prof_SetEnabled(int enabled)
+{
+    profiler.pending_enabled = enabled && profiler.events;
+}
+
+
+void Prof_FrameBegin()
+{
+    prof_frame_p frame;
+
+    if(prof_enabled != profiler.pending_enabled)
+    {
+        prof_enabled = profiler.pending_enabled;
+        profiler.events_count = 0;
+        profiler.frames_count = 0;
+    }
+    profiler.depth = 0;
+
+    if(prof_enabled)
+    {
+        frame = profiler.frames + (profiler.frames_count % PROF_MAX_FRAMES);
+        frame->first_event = profiler.events_count;
+        frame->begin = Sys_MicroSecTime(0);
+        profiler.frames_count++;
+    }
+}
+
+
+void Prof_ZoneBegin(const char *name)
+{
+    if(prof_enabled)
+    {
+        uint64_t index = profiler.events_count++;
+        prof_event_p ev = profiler.events + (index % PROF_MAX_EVENTS);
+
+        ev->name = name;
+        ev->end = 0;
+        if(profiler.depth < PROF_MAX_DEPTH)
+        {
+            profiler.stack[profiler.depth] = index;
+        }
+        profiler.depth++;
+        ev->begin = Sys_MicroSecTime(0);
+    }
+}
+
+
+void Prof_ZoneEnd()
+{
+    if(prof_enabled && (profiler.depth > 0))
+    {
+        int64_t t = Sys_MicroSecTime(0);
+        profiler.depth--;
+        if(profiler.depth < PROF_MAX_DEPTH)
+        {
+            uint64_t index = profiler.stack[profiler.depth];
+            if(profiler.events_count - index <= PROF_MAX_EVENTS)
+            {
+                profiler.events[index % PROF_MAX_EVENTS].end = t;
+            }
+        }
+    }
+}
+
+/**
+ * Writes stored frames in Chrome trace event format (chrome://tracing,
+ * https://ui.perfetto.dev); each frame is a top level "frame" zone.
+ */
+int Prof_DumpChromeTrace(const char *file_name)
+{
+    FILE *f;
+    uint64_t first_frame, first_event;
+    int64_t now = Sys_MicroSecTime(0);
+    int64_t time_base;
+    int need_comma = 0;
+
+    if(!profiler.events || !profiler.frames_count)
+    {
+        return 0;
+    }
+
+    first_frame = (profiler.frames_count > PROF_MAX_FRAMES) ? (profiler.frames_count - PROF_MAX_FRAMES) : (0);
+    while((first_frame < profiler.frames_count) &&
+          (profiler.events_count - profiler.frames[first_frame % PROF_MAX_FRAMES].first_event > PROF_MAX_EVENTS))
+    {
+        first_frame++;
+    }
+    if(first_frame >= profiler.frames_count)
+    {
+        return 0;
+    }
+
+    f = fopen(file_name, "wb");
+    if(!f)
+    {
+        return 0;
+    }
+
+    first_event = profiler.frames[first_frame % PROF_MAX_FRAMES].first_event;
+    time_base = profiler.frames[first_frame % PROF_MAX_FRAMES].begin;
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for(uint64_t i = first_frame; i < profiler.frames_count; ++i)
+    {
+        prof_frame_p frame = profiler.frames + (i % PROF_MAX_FRAMES);
+        int64_t end = (i + 1 < profiler.frames_count) ? (profiler.frames[(i + 1) % PROF_MAX_FRAMES].begin) : (now);
+        fprintf(f, "%s{\"name\":\"frame\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":%lld,\"dur\":%lld,\"args\":{\"frame\":%llu}}",
+                need_comma ? ",\n" : "", (long long)(frame->begin - time_base), (long long)(end - frame->begin), (unsigned long long)i);
+        need_comma = 1;
+    }
+    for(uint64_t i = first_event; i < profiler.events_count; ++i)
+    {
+        prof_event_p ev = profiler.events + (i % PROF_MAX_EVENTS);
+        if(ev->end >= ev->begin)
+        {
+            fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":%lld,\"dur\":%lld}",
+                    ev->name, (long long)(ev->begin - time_base), (long long)(ev->end - ev->begin));
+        }
+    }
+    fprintf(f, "\n]}\n");
+    fclose(f);
+
+    return (int)(profiler.frames_count - first_frame);
+}
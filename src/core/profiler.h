@@ -0,0 +1,71 @@
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * Lightweight hot path profiler: named zones with begin / end time are stored
+ * in a ring buffer that keeps up to PROF_MAX_FRAMES last frames.
+ * Only main thread zones are supported.
+ * Zone names must be static strings: only the pointer is stored.
+ */
+#define PROF_MAX_FRAMES             (256)
+#define PROF_MAX_EVENTS             (262144)
+#define PROF_MAX_DEPTH              (32)
+
+extern int prof_enabled;
+
+void Prof_Init();
+void Prof_Destroy();
+void Prof_SetEnabled(int enabled);
+void Prof_FrameBegin();
+void Prof_ZoneBegin(const char *name);
+void Prof_ZoneEnd();
+int  Prof_DumpChromeTrace(const char *file_name);
+
+/*
+ * For C code: PROF_ZONE_BEGIN / PROF_ZONE_END pairs must be balanced in
+ * every exit path of the function.
+ */
+#define PROF_ZONE_BEGIN(name) do { if(prof_enabled) { Prof_ZoneBegin(name); } } while(0)
+#define PROF_ZONE_END() do { if(prof_enabled) { Prof_ZoneEnd(); } } while(0)
+
+#ifdef	__cplusplus
+}
+
+/*
+ * For C++ code: PROF_ZONE(name) closes zone at the end of the scope.
+ */
+class CProfZone
+{
+public:
+    CProfZone(const char *name) : m_active(prof_enabled)
+    {
+        if(m_active)
+        {
+            Prof_ZoneBegin(name);
+        }
+    }
+    ~CProfZone()
+    {
+        if(m_active)
+        {
+            Prof_ZoneEnd();
+        }
+    }
+
+private:
+    int m_active;
+};
+
+#define PROF_ZONE_CONCAT2(a, b) a##b
+#define PROF_ZONE_CONCAT(a, b) PROF_ZONE_CONCAT2(a, b)
+#define PROF_ZONE(name) CProfZone PROF_ZONE_CONCAT(prof_zone_, __LINE__)(name)
+#endif
+
+#endif
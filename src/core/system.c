@@ -12,6 +12,13 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#endif
+
 #include <lua.h>
 #include <lualib.h>
 #include <lauxlib.h>
@@ -259,6 +266,42 @@ SYS TIME
 ===============================================================================
 */
 
+/**
+ * Bytes currently allocated by malloc, 0 if platform gives no such info.
+ */
+size_t Sys_GetHeapUsed()
+{
+#if defined(__GLIBC__) && ((__GLIBC__ > 2) || ((__GLIBC__ == 2) && (__GLIBC_MINOR__ >= 33)))
+    struct mallinfo2 mi = mallinfo2();
+    return mi.uordblks + mi.hblkhd;
+#elif defined(__GLIBC__)
+    struct mallinfo mi = mallinfo();
+    return (size_t)(unsigned int)mi.uordblks + (size_t)(unsigned int)mi.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * Peak resident memory size of the process in bytes, 0 if unknown.
+ */
+size_t Sys_GetPeakMemUsed()
+{
+#if !defined(_WIN32)
+    struct rusage ru;
+    if(0 == getrusage(RUSAGE_SELF, &ru))
+    {
+#if defined(__APPLE__)
+        return ru.ru_maxrss;                                                    // bytes
+#else
+        return (size_t)ru.ru_maxrss * 1024;                                     // kilobytes
+#endif
+    }
+#endif
+    return 0;
+}
+
+
 int64_t Sys_MicroSecTime(int64_t sec_offset)
 {
     int64_t ret = 0;
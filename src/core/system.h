@@ -20,6 +20,7 @@ enum debug_view_state_e
     room_objects,
     ai_boxes,
     bsp_info,
+    collision_info,
     model_view,
     debug_states_count
 };
@@ -62,6 +63,8 @@ file_info_p Sys_ListDir(const char *path, const char *wild);
 void Sys_ListDirFree(file_info_p list);
 
 int64_t Sys_MicroSecTime(int64_t sec_offset);
+size_t  Sys_GetHeapUsed();
+size_t  Sys_GetPeakMemUsed();
 void Sys_Strtime(char *buf, size_t buf_size);
 
 void Sys_Init(void);
@@ -0,0 +1,135 @@
+
+#include <math.h>
+#include <stdint.h>
+
+#include "vmath_simd.h"
+
+/*
+ * Slerp of 4 quaternions pairs with polynomial approximation of sin ratios
+ * (D. Eberly, "A Fast and Accurate Algorithm for Computing SLERP"), so no
+ * acos / sin calls are needed. Matches vec4_slerp(): the shortest arc is
+ * taken and result is normalized.
+ */
+void vec4_slerp_soa4(v4f_t ret[4], const v4f_t q1[4], const v4f_t q2[4], v4f_t t)
+{
+    static const float mu = 1.90110745351730037f;
+    static const float u[8] =
+    {
+        1.0f / (1.0f * 3.0f), 1.0f / (2.0f * 5.0f), 1.0f / (3.0f * 7.0f), 1.0f / (4.0f * 9.0f),
+        1.0f / (5.0f * 11.0f), 1.0f / (6.0f * 13.0f), 1.0f / (7.0f * 15.0f), mu / (8.0f * 17.0f)
+    };
+    static const float v[8] =
+    {
+        1.0f / 3.0f, 2.0f / 5.0f, 3.0f / 7.0f, 4.0f / 9.0f,
+        5.0f / 11.0f, 6.0f / 13.0f, 7.0f / 15.0f, mu * 8.0f / 17.0f
+    };
+    v4f_t one = v4f_set1(1.0f);
+    v4f_t cos_fi, sign, xm1, d, sqr_t, sqr_d, ct, cd, norm;
+
+    cos_fi = v4f_mul(q1[0], q2[0]);
+    cos_fi = v4f_madd(q1[1], q2[1], cos_fi);
+    cos_fi = v4f_madd(q1[2], q2[2], cos_fi);
+    cos_fi = v4f_madd(q1[3], q2[3], cos_fi);
+    sign = v4f_sign(cos_fi);
+    xm1 = v4f_sub(v4f_mul(cos_fi, sign), one);
+    d = v4f_sub(one, t);
+    sqr_t = v4f_mul(t, t);
+    sqr_d = v4f_mul(d, d);
+
+    ct = one;
+    cd = one;
+    for(int i = 7; i >= 0; --i)
+    {
+        v4f_t ui = v4f_set1(u[i]);
+        v4f_t vi = v4f_set1(v[i]);
+        v4f_t bt = v4f_mul(v4f_sub(v4f_mul(ui, sqr_t), vi), xm1);
+        v4f_t bd = v4f_mul(v4f_sub(v4f_mul(ui, sqr_d), vi), xm1);
+        ct = v4f_madd(bt, ct, one);
+        cd = v4f_madd(bd, cd, one);
+    }
+    ct = v4f_mul(v4f_mul(ct, t), sign);
+    cd = v4f_mul(cd, d);
+
+    for(int i = 0; i < 4; ++i)
+    {
+        ret[i] = v4f_madd(cd, q1[i], v4f_mul(ct, q2[i]));
+    }
+
+    norm = v4f_mul(ret[0], ret[0]);
+    norm = v4f_madd(ret[1], ret[1], norm);
+    norm = v4f_madd(ret[2], ret[2], norm);
+    norm = v4f_madd(ret[3], ret[3], norm);
+    norm = v4f_rsqrt(norm);
+    for(int i = 0; i < 4; ++i)
+    {
+        ret[i] = v4f_mul(ret[i], norm);
+    }
+}
+
+
+static inline void Mat4_set_column_soa4(float *mat[4], int column, v4f_t x, v4f_t y, v4f_t z)
+{
+    v4f_t col[4] = {x, y, z, v4f_set1(0.0f)};
+
+    v4f_transpose(col);
+    v4f_store(mat[0] + 4 * column, col[0]);
+    v4f_store(mat[1] + 4 * column, col[1]);
+    v4f_store(mat[2] + 4 * column, col[2]);
+    v4f_store(mat[3] + 4 * column, col[3]);
+}
+
+/*
+ * Same as Mat4_set_qrotation() for 4 matrices: rotation part is written,
+ * translation part (12 - 15) is left untouched.
+ */
+void Mat4_set_qrotation_soa4(float *mat[4], const v4f_t q[4])
+{
+    v4f_t one = v4f_set1(1.0f);
+    v4f_t two = v4f_set1(2.0f);
+    v4f_t xx = v4f_mul(q[0], q[0]);
+    v4f_t yy = v4f_mul(q[1], q[1]);
+    v4f_t zz = v4f_mul(q[2], q[2]);
+    v4f_t xy = v4f_mul(q[0], q[1]);
+    v4f_t xz = v4f_mul(q[0], q[2]);
+    v4f_t yz = v4f_mul(q[1], q[2]);
+    v4f_t wx = v4f_mul(q[3], q[0]);
+    v4f_t wy = v4f_mul(q[3], q[1]);
+    v4f_t wz = v4f_mul(q[3], q[2]);
+
+    Mat4_set_column_soa4(mat, 0, v4f_sub(one, v4f_mul(two, v4f_add(yy, zz))),
+                                 v4f_mul(two, v4f_add(xy, wz)),
+                                 v4f_mul(two, v4f_sub(xz, wy)));
+    Mat4_set_column_soa4(mat, 1, v4f_mul(two, v4f_sub(xy, wz)),
+                                 v4f_sub(one, v4f_mul(two, v4f_add(xx, zz))),
+                                 v4f_mul(two, v4f_add(yz, wx)));
+    Mat4_set_column_soa4(mat, 2, v4f_mul(two, v4f_add(xz, wy)),
+                                 v4f_mul(two, v4f_sub(yz, wx)),
+                                 v4f_sub(one, v4f_mul(two, v4f_add(xx, yy))));
+}
+
+
+/*
+ * Mat4_Mat4_mul() with columns of src1 in registers; result may alias sources.
+ */
+void Mat4_Mat4_mul_simd(float result[16], const float src1[16], const float src2[16])
+{
+    v4f_t c0 = v4f_load(src1 + 0);
+    v4f_t c1 = v4f_load(src1 + 4);
+    v4f_t c2 = v4f_load(src1 + 8);
+    v4f_t c3 = v4f_load(src1 + 12);
+    v4f_t r[4];
+
+    for(int j = 0; j < 4; ++j)
+    {
+        const float *s = src2 + 4 * j;
+        r[j] = v4f_mul(c0, v4f_set1(s[0]));
+        r[j] = v4f_madd(c1, v4f_set1(s[1]), r[j]);
+        r[j] = v4f_madd(c2, v4f_set1(s[2]), r[j]);
+        r[j] = v4f_madd(c3, v4f_set1(s[3]), r[j]);
+    }
+
+    v4f_store(result + 0, r[0]);
+    v4f_store(result + 4, r[1]);
+    v4f_store(result + 8, r[2]);
+    v4f_store(result + 12, r[3]);
+}
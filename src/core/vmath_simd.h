@@ -0,0 +1,213 @@
+
+#ifndef VMATH_SIMD_H
+#define VMATH_SIMD_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include <math.h>
+#include <stdint.h>
+
+/*
+ * 4-wide float vector: SSE2 or NEON register, plain struct for the scalar
+ * fallback (or if VMATH_NO_SIMD is defined). Batched kernels work on
+ * structure of arrays data: q[0] holds x components of 4 quaternions,
+ * q[1] - y components, etc.
+ */
+#if !defined(VMATH_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)))
+#define VMATH_SIMD_SSE2     (1)
+#define VMATH_SIMD_NAME     "SSE2"
+#include <emmintrin.h>
+typedef __m128 v4f_t;
+#elif !defined(VMATH_NO_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define VMATH_SIMD_NEON     (1)
+#define VMATH_SIMD_NAME     "NEON"
+#include <arm_neon.h>
+typedef float32x4_t v4f_t;
+#else
+#define VMATH_SIMD_NAME     "scalar"
+typedef struct v4f_s
+{
+    float f[4];
+}v4f_t;
+#endif
+
+
+static inline v4f_t v4f_load(const float *p)
+{
+#if defined(VMATH_SIMD_SSE2)
+    return _mm_loadu_ps(p);
+#elif defined(VMATH_SIMD_NEON)
+    return vld1q_f32(p);
+#else
+    v4f_t r = {{p[0], p[1], p[2], p[3]}};
+    return r;
+#endif
+}
+
+static inline void v4f_store(float *p, v4f_t v)
+{
+#if defined(VMATH_SIMD_SSE2)
+    _mm_storeu_ps(p, v);
+#elif defined(VMATH_SIMD_NEON)
+    vst1q_f32(p, v);
+#else
+    p[0] = v.f[0];
+    p[1] = v.f[1];
+    p[2] = v.f[2];
+    p[3] = v.f[3];
+#endif
+}
+
+static inline v4f_t v4f_set1(float x)
+{
+#if defined(VMATH_SIMD_SSE2)
+    return _mm_set1_ps(x);
+#elif defined(VMATH_SIMD_NEON)
+    return vdupq_n_f32(x);
+#else
+    v4f_t r = {{x, x, x, x}};
+    return r;
+#endif
+}
+
+static inline v4f_t v4f_add(v4f_t a, v4f_t b)
+{
+#if defined(VMATH_SIMD_SSE2)
+    return _mm_add_ps(a, b);
+#elif defined(VMATH_SIMD_NEON)
+    return vaddq_f32(a, b);
+#else
+    v4f_t r = {{a.f[0] + b.f[0], a.f[1] + b.f[1], a.f[2] + b.f[2], a.f[3] + b.f[3]}};
+    return r;
+#endif
+}
+
+static inline v4f_t v4f_sub(v4f_t a, v4f_t b)
+{
+#if defined(VMATH_SIMD_SSE2)
+    return _mm_sub_ps(a, b);
+#elif defined(VMATH_SIMD_NEON)
+    return vsubq_f32(a, b);
+#else
+    v4f_t r = {{a.f[0] - b.f[0], a.f[1] - b.f[1], a.f[2] - b.f[2], a.f[3] - b.f[3]}};
+    return r;
+#endif
+}
+
+static inline v4f_t v4f_mul(v4f_t a, v4f_t b)
+{
+#if defined(VMATH_SIMD_SSE2)
+    return _mm_mul_ps(a, b);
+#elif defined(VMATH_SIMD_NEON)
+    return vmulq_f32(a, b);
+#else
+    v4f_t r = {{a.f[0] * b.f[0], a.f[1] * b.f[1], a.f[2] * b.f[2], a.f[3] * b.f[3]}};
+    return r;
+#endif
+}
+
+// a * b + c
+static inline v4f_t v4f_madd(v4f_t a, v4f_t b, v4f_t c)
+{
+#if defined(VMATH_SIMD_NEON)
+    return vmlaq_f32(c, a, b);
+#else
+    return v4f_add(v4f_mul(a, b), c);
+#endif
+}
+
+static inline v4f_t v4f_abs(v4f_t a)
+{
+#if defined(VMATH_SIMD_SSE2)
+    return _mm_andnot_ps(_mm_set1_ps(-0.0f), a);
+#elif defined(VMATH_SIMD_NEON)
+    return vabsq_f32(a);
+#else
+    v4f_t r = {{fabsf(a.f[0]), fabsf(a.f[1]), fabsf(a.f[2]), fabsf(a.f[3])}};
+    return r;
+#endif
+}
+
+// non zero if any component is negative
+static inline int v4f_any_lt_zero(v4f_t a)
+{
+#if defined(VMATH_SIMD_SSE2)
+    return _mm_movemask_ps(_mm_cmplt_ps(a, _mm_setzero_ps()));
+#elif defined(VMATH_SIMD_NEON)
+    uint32x4_t m = vcltq_f32(a, vdupq_n_f32(0.0f));
+    uint32x2_t t = vorr_u32(vget_low_u32(m), vget_high_u32(m));
+    return (vget_lane_u32(t, 0) | vget_lane_u32(t, 1)) != 0;
+#else
+    return (a.f[0] < 0.0f) || (a.f[1] < 0.0f) || (a.f[2] < 0.0f) || (a.f[3] < 0.0f);
+#endif
+}
+
+// -1.0 for negative components, 1.0 for others
+static inline v4f_t v4f_sign(v4f_t a)
+{
+#if defined(VMATH_SIMD_SSE2)
+    __m128 mask = _mm_cmplt_ps(a, _mm_setzero_ps());
+    return _mm_or_ps(_mm_and_ps(mask, _mm_set1_ps(-1.0f)), _mm_andnot_ps(mask, _mm_set1_ps(1.0f)));
+#elif defined(VMATH_SIMD_NEON)
+    return vbslq_f32(vcltq_f32(a, vdupq_n_f32(0.0f)), vdupq_n_f32(-1.0f), vdupq_n_f32(1.0f));
+#else
+    v4f_t r = {{(a.f[0] < 0.0f) ? (-1.0f) : (1.0f), (a.f[1] < 0.0f) ? (-1.0f) : (1.0f),
+                (a.f[2] < 0.0f) ? (-1.0f) : (1.0f), (a.f[3] < 0.0f) ? (-1.0f) : (1.0f)}};
+    return r;
+#endif
+}
+
+// 1 / sqrt(a), full precision
+static inline v4f_t v4f_rsqrt(v4f_t a)
+{
+#if defined(VMATH_SIMD_SSE2)
+    return _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(a));
+#elif defined(VMATH_SIMD_NEON) && defined(__aarch64__)
+    return vdivq_f32(vdupq_n_f32(1.0f), vsqrtq_f32(a));
+#elif defined(VMATH_SIMD_NEON)
+    float32x4_t r = vrsqrteq_f32(a);
+    r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(a, r), r));
+    r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(a, r), r));
+    return r;
+#else
+    v4f_t r = {{1.0f / sqrtf(a.f[0]), 1.0f / sqrtf(a.f[1]), 1.0f / sqrtf(a.f[2]), 1.0f / sqrtf(a.f[3])}};
+    return r;
+#endif
+}
+
+// rows to columns: r[i] component j becomes r[j] component i
+static inline void v4f_transpose(v4f_t r[4])
+{
+#if defined(VMATH_SIMD_SSE2)
+    _MM_TRANSPOSE4_PS(r[0], r[1], r[2], r[3]);
+#elif defined(VMATH_SIMD_NEON)
+    float32x4x2_t t01 = vtrnq_f32(r[0], r[1]);
+    float32x4x2_t t23 = vtrnq_f32(r[2], r[3]);
+    r[0] = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+    r[1] = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+    r[2] = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+    r[3] = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+#else
+    for(int i = 0; i < 4; ++i)
+    {
+        for(int j = i + 1; j < 4; ++j)
+        {
+            float t = r[i].f[j];
+            r[i].f[j] = r[j].f[i];
+            r[j].f[i] = t;
+        }
+    }
+#endif
+}
+
+void vec4_slerp_soa4(v4f_t ret[4], const v4f_t q1[4], const v4f_t q2[4], v4f_t t);
+void Mat4_set_qrotation_soa4(float *mat[4], const v4f_t q[4]);
+void Mat4_Mat4_mul_simd(float result[16], const float src1[16], const float src2[16]);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif
@@ -19,9 +19,15 @@ extern "C" {
 #include "core/gl_font.h"
 #include "core/console.h"
 #include "core/vmath.h"
+#include "core/vmath_simd.h"
 #include "core/polygon.h"
+#include "core/obb.h"
 #include "core/gl_text.h"
+#include "core/profiler.h"
 #include "render/camera.h"
+#include "render/bsp_tree.h"
+#include "render/frustum.h"
+#include "render/render_queue.h"
 #include "render/render.h"
 #include "render/shader_manager.h"
 #include "script/script.h"
@@ -61,6 +67,17 @@ static char                     base_path[1024] = {0};
 static volatile int             engine_done   = 0;
 static int                      g_menu_mode = 0x00;
 static int                      engine_set_zero_time = 0;
+static int                      engine_headless = 0;
+static char                    *engine_bench_level = NULL;
+static int                      engine_bench_frames = 0;
+static float                    engine_bench_load_time = 0.0f;
+static int                      engine_bench_loads = 0;
+static int                      engine_bench_draw_views = 0;
+static int                      engine_bench_ragdolls = 0;
+static int                      engine_bench_probes = 0;
+static int                      engine_check_physics = 0;
+static int                      engine_check_bsp = 0;
+static char                    *engine_replay_name = NULL;
 float                           time_scale = 1.0f;
 float                           engine_frame_time = 0.0;
 
@@ -83,6 +100,15 @@ void Engine_InitDefaultGlobals();
 
 void Engine_Display(float time);
 void Engine_PollSDLEvents();
+void Engine_HeadlessLoop();
+void Engine_LoadBenchmark(const char *level, int loads);
+void Engine_DrawBenchmark(const char *level, int views);
+void Engine_RagdollBenchmark(const char *level, int count);
+void Engine_ProbeBenchmark(const char *level, int passes);
+int  Engine_PhysicsCheck(const char *level, const char *replay, int seconds);
+void Bench_Animations(int passes);
+void Bench_Culling(int passes);
+int  Bench_BSP(int count, int headless);
 void Engine_Resize(int nominalW, int nominalH, int pixelsW, int pixelsH);
 
 void ClearTestModel();
@@ -96,6 +122,8 @@ void Engine_Start(int argc, char **argv)
 {
     char *config_name = NULL;
     char *autoexec_name = NULL;
+    char *record_name = NULL;
+    char *replay_name = NULL;
 
     Engine_InitDefaultGlobals();
 
@@ -142,12 +170,107 @@ void Engine_Start(int argc, char **argv)
             }
             ++i;
         }
+        else if(0 == strncmp(argv[i], "-headless", 9))
+        {
+            engine_headless = 1;
+        }
+        else if(0 == strncmp(argv[i], "-bench_load", 11))
+        {
+            if(i + 1 < argc)
+            {
+                engine_bench_loads = atoi(argv[i + 1]);
+            }
+            ++i;
+        }
+        else if(0 == strncmp(argv[i], "-check_bsp", 10))
+        {
+            if(i + 1 < argc)
+            {
+                engine_check_bsp = atoi(argv[i + 1]);
+            }
+            ++i;
+        }
+        else if(0 == strncmp(argv[i], "-check_physics", 14))
+        {
+            if(i + 1 < argc)
+            {
+                engine_check_physics = atoi(argv[i + 1]);
+            }
+            ++i;
+        }
+        else if(0 == strncmp(argv[i], "-bench_ragdolls", 15))
+        {
+            if(i + 1 < argc)
+            {
+                engine_bench_ragdolls = atoi(argv[i + 1]);
+            }
+            ++i;
+        }
+        else if(0 == strncmp(argv[i], "-bench_probes", 13))
+        {
+            if(i + 1 < argc)
+            {
+                engine_bench_probes = atoi(argv[i + 1]);
+            }
+            ++i;
+        }
+        else if(0 == strncmp(argv[i], "-bench_draw", 11))
+        {
+            if(i + 1 < argc)
+            {
+                engine_bench_draw_views = atoi(argv[i + 1]);
+            }
+            ++i;
+        }
+        else if(0 == strncmp(argv[i], "-bench", 6))
+        {
+            if(i + 1 < argc)
+            {
+                engine_bench_level = argv[i + 1];
+            }
+            ++i;
+        }
+        else if(0 == strncmp(argv[i], "-frames", 7))
+        {
+            if(i + 1 < argc)
+            {
+                engine_bench_frames = atoi(argv[i + 1]);
+            }
+            ++i;
+        }
+        else if(0 == strncmp(argv[i], "-record", 7))
+        {
+            if(i + 1 < argc)
+            {
+                record_name = argv[i + 1];
+            }
+            ++i;
+        }
+        else if(0 == strncmp(argv[i], "-replay", 7))
+        {
+            if((i + 1 < argc) && (Sys_FileFound(argv[i + 1], 0)))
+            {
+                replay_name = argv[i + 1];
+            }
+            ++i;
+        }
         else
         {
             puts("usage:");
             puts("-config \"path_to_config_file\"");
             puts("-autoexec \"path_to_autoexec_file\"");
             puts("-base_path \"path_to_base_folder_location (contains data, resource, save and script folders)\"");
+            puts("-headless - run game logic without window, OpenGL context and sound output");
+            puts("-bench \"path_to_level\" - load level (relative to base path) and print frame time statistics on exit");
+            puts("-bench_load N - load -bench level or all levels from tests folder N times and print load stage times");
+            puts("-bench_draw N - render -bench level or all levels from tests folder from N directions in every room and print render queue state changes");
+            puts("-bench_ragdolls N - spawn N ragdolls in -bench level or all levels from tests folder and print physics step time per solver threads count");
+            puts("-bench_probes N - run -bench level headless (with -replay input), record player height probes and play them back N times per probe mode");
+            puts("-check_bsp N - flood transparency BSP tree with N, 2N and 4N random triangles and fail if polygons are dropped");
+            puts("-check_physics N - run -bench level headless (with -replay input) for N seconds at 30, 60 and 144 Hz and compare entities and ragdolls trajectories");
+            puts("-frames N - stop headless run after N frames");
+            puts("-record \"path_to_file\" - record per frame input and frame time");
+            puts("-replay \"path_to_file\" - play recorded input back instead of polling events");
             exit(0);
         }
     }
@@ -157,13 +280,22 @@ void Engine_Start(int argc, char **argv)
 
     Engine_LoadConfig(config_name ? config_name : "config.lua");
 
-    // Init generic SDL interfaces.
-    Engine_InitSDLSubsystems();
-    Engine_InitSDLVideo();
+    if(engine_headless)
+    {
+        // No window, no GL context: all GL calls go to the null driver.
+        SDL_Init(SDL_INIT_EVENTS);
+        InitGLNullFuncs();
+    }
+    else
+    {
+        // Init generic SDL interfaces.
+        Engine_InitSDLSubsystems();
+        Engine_InitSDLVideo();
 
-    // Additional OpenGL initialization.
-    Engine_InitGL();
-    renderer.DoShaders();
+        // Additional OpenGL initialization.
+        Engine_InitGL();
+        renderer.DoShaders();
+    }
 
     // Secondary (deferred) initialization.
     Engine_Init_Post();
@@ -177,13 +309,47 @@ void Engine_Start(int argc, char **argv)
     // Clearing up memory for initial level loading.
     World_Prepare();
 
-    // Setting up mouse.
-    SDL_SetRelativeMouseMode(SDL_TRUE);
-    SDL_WarpMouseInWindow(sdl_window, screen_info.w / 2, screen_info.h / 2);
-    SDL_ShowCursor(0);
-    Audio_CoreInit();
+    if(engine_headless)
+    {
+        Audio_CoreInit(AUDIO_NULL_DEVICE_NAME);
+    }
+    else
+    {
+        // Setting up mouse.
+        SDL_SetRelativeMouseMode(SDL_TRUE);
+        SDL_WarpMouseInWindow(sdl_window, screen_info.w / 2, screen_info.h / 2);
+        SDL_ShowCursor(0);
+        Audio_CoreInit();
+    }
 
     luaL_dofile(engine_lua, autoexec_name ? autoexec_name : "autoexec.lua");
+
+    if(engine_bench_level && (engine_bench_loads <= 0) && (engine_bench_draw_views <= 0) && (engine_bench_ragdolls <= 0) && (engine_check_physics <= 0))
+    {
+        int64_t t = Sys_MicroSecTime(0);
+        if(!Engine_LoadMap(engine_bench_level))
+        {
+            Sys_DebugLog(SYS_LOG_FILENAME, "Error: can not load benchmark level \"%s\"", engine_bench_level);
+            Engine_Shutdown(EXIT_FAILURE);
+        }
+        engine_bench_load_time = (Sys_MicroSecTime(0) - t) / 1000.0f;
+    }
+
+    // Input record / replay starts with the first game frame, so the session
+    // is reproducible if the same level (-bench) and scripts are used.
+    // The physics check restarts the replay for every run itself.
+    engine_replay_name = replay_name;
+    if(replay_name)
+    {
+        if(engine_check_physics <= 0)
+        {
+            Controls_StartReplay(replay_name);
+        }
+    }
+    else if(record_name)
+    {
+        Controls_StartRecord(record_name, (uint32_t)time(NULL));
+    }
 }
 
 
@@ -196,6 +362,7 @@ void Engine_Shutdown(int val)
     strncat(path, "config.lua", path_base_len - strlen(path));
     Script_ExportConfig(path);
 
+    Controls_StopRecordReplay();
     stream_codec_stop(&engine_video, 0);
     StreamTrack_Stop(Audio_GetStreamExternal());
 
@@ -217,13 +384,20 @@ void Engine_Shutdown(int val)
     Con_Destroy();
     GLText_Destroy();
     glf_destroy();
+    Prof_Destroy();
     Sys_Destroy();
 
     /* no more renderings */
-    SDL_GL_DeleteContext(sdl_gl_context);
-    sdl_gl_context = 0;
-    SDL_DestroyWindow(sdl_window);
-    sdl_window = NULL;
+    if(sdl_gl_context)
+    {
+        SDL_GL_DeleteContext(sdl_gl_context);
+        sdl_gl_context = 0;
+    }
+    if(sdl_window)
+    {
+        SDL_DestroyWindow(sdl_window);
+        sdl_window = NULL;
+    }
 
     if(sdl_joystick)
     {
@@ -279,6 +453,7 @@ void Engine_Init_Pre()
     stream_codec_init(&engine_video);
 
     Sys_Init();
+    Prof_Init();
     glf_init();
     GLText_Init();
     Con_Init();
@@ -494,6 +669,8 @@ void Engine_LoadConfig(const char *filename)
             Script_ParseRender(lua, &renderer.settings);
             Script_ParseAudio(lua, &audio_settings);
             Script_ParseControls(lua, &control_settings);
+            Script_ParsePhysics(lua, &physics_settings);
+            Physics_SetThreadsCount(physics_settings.threads);
 
             if(0 < Script_ParseConsole(lua, &cp))
             {
@@ -513,6 +690,7 @@ void Engine_Display(float time)
 {
     if(!engine_done)
     {
+        PROF_ZONE("Engine_Display");
         qglClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);//| GL_ACCUM_BUFFER_BIT);
 
         Cam_Apply(&engine_camera);
@@ -560,7 +738,10 @@ void Engine_Display(float time)
 
 void Engine_GLSwapWindow()
 {
-    SDL_GL_SwapWindow(sdl_window);
+    if(sdl_window)
+    {
+        SDL_GL_SwapWindow(sdl_window);
+    }
 }
 
 
@@ -807,6 +988,54 @@ void Engine_MainLoop()
     int cycles = 0;
     char fps_str[32] = "0.0";
 
+    if(engine_bench_loads > 0)
+    {
+        Engine_LoadBenchmark(engine_bench_level, engine_bench_loads);
+        return;
+    }
+
+    if(engine_bench_draw_views > 0)
+    {
+        Engine_DrawBenchmark(engine_bench_level, engine_bench_draw_views);
+        return;
+    }
+
+    if(engine_bench_ragdolls > 0)
+    {
+        Engine_RagdollBenchmark(engine_bench_level, engine_bench_ragdolls);
+        return;
+    }
+
+    if(engine_bench_probes > 0)
+    {
+        Engine_ProbeBenchmark(engine_bench_level, engine_bench_probes);
+        return;
+    }
+
+    if(engine_check_bsp > 0)
+    {
+        if(!Bench_BSP(engine_check_bsp, 1))
+        {
+            Engine_Shutdown(EXIT_FAILURE);
+        }
+        return;
+    }
+
+    if(engine_check_physics > 0)
+    {
+        if(!Engine_PhysicsCheck(engine_bench_level, engine_replay_name, engine_check_physics))
+        {
+            Engine_Shutdown(EXIT_FAILURE);
+        }
+        return;
+    }
+
+    if(engine_headless)
+    {
+        Engine_HeadlessLoop();
+        return;
+    }
+
     while(!engine_done)
     {
         newtime = Sys_MicroSecTime(sec_base_offset);
@@ -840,7 +1069,15 @@ void Engine_MainLoop()
         }
 
         Sys_ResetTempMem();
-        Engine_PollSDLEvents();
+        Prof_FrameBegin();
+        if(Controls_IsReplaying())
+        {
+            g_menu_mode = 0x00;
+        }
+        else
+        {
+            Engine_PollSDLEvents();
+        }
 
         if (renderer.settings.show_fps)
         {
@@ -864,6 +1101,17 @@ void Engine_MainLoop()
         {
             if(!g_menu_mode && (screen_info.debug_view_state != debug_view_state_e::model_view))
             {
+                if(Controls_IsReplaying())
+                {
+                    // records are written only next to Game_Frame, so read them back only here
+                    if(!Controls_ReplayFrame(&time))
+                    {
+                        Engine_SetDone();
+                        break;
+                    }
+                    engine_frame_time = time;
+                }
+                Controls_RecordFrame(time);
                 Game_Frame(time);
                 Gameflow_ProcessCommands();
             }
@@ -905,6 +1153,139 @@ void Engine_MainLoop()
 }
 
 
+/*
+ * HEADLESS RUN AND BENCHMARK
+ */
+
+enum bench_stat_e
+{
+    BENCH_STAT_FRAME = 0,
+    BENCH_STAT_GAME,
+    BENCH_STAT_ENTITIES,
+    BENCH_STAT_PHYSICS,
+    BENCH_STAT_GAMEFLOW,
+    BENCH_STAT_AUDIO,
+    BENCH_STAT_LASTINDEX
+};
+
+static const char *bench_stat_names[BENCH_STAT_LASTINDEX] =
+{
+    "frame",
+    "Game_Frame",
+    "  entities",
+    "  physics",
+    "gameflow",
+    "Audio_Update"
+};
+
+static int Bench_CmpFloat(const void *a, const void *b)
+{
+    float fa = *((const float*)a);
+    float fb = *((const float*)b);
+    return (fa < fb) ? (-1) : ((fa > fb) ? (1) : (0));
+}
+
+static float Bench_Percentile(const float *sorted, uint32_t count, float p)
+{
+    uint32_t i = (uint32_t)(p * (float)(count - 1) + 0.5f);
+    return sorted[(i < count) ? (i) : (count - 1)];
+}
+
+static void Bench_PrintStats(float *samples[BENCH_STAT_LASTINDEX], uint32_t count, float load_time)
+{
+    printf("\nbenchmark: level = \"%s\", frames = %d, load = %.1f ms\n",
+           engine_bench_level ? engine_bench_level : "", count, load_time);
+    printf("%-14s %9s %9s %9s %9s %9s %9s\n", "subsystem, ms", "mean", "p50", "p90", "p99", "min", "max");
+    for(int s = 0; s < BENCH_STAT_LASTINDEX; ++s)
+    {
+        float *v = samples[s];
+        double sum = 0.0;
+        for(uint32_t i = 0; i < count; ++i)
+        {
+            sum += v[i];
+        }
+        qsort(v, count, sizeof(float), Bench_CmpFloat);
+        printf("%-14s %9.3f %9.3f %9.3f %9.3f %9.3f %9.3f\n", bench_stat_names[s], sum / count,
+               Bench_Percentile(v, count, 0.50f), Bench_Percentile(v, count, 0.90f), Bench_Percentile(v, count, 0.99f),
+               v[0], v[count - 1]);
+    }
+    fflush(stdout);
+}
+
+/*
+ * Game logic main loop without window and renderer: fixed time step (or the
+ * recorded one in -replay mode), null GL and null audio device. If -bench is
+ * set, per-subsystem frame time percentiles are printed on exit.
+ */
+void Engine_HeadlessLoop()
+{
+    float time = GAME_LOGIC_REFRESH_INTERVAL;
+    float *samples[BENCH_STAT_LASTINDEX] = {NULL};
+    uint32_t samples_size = 0;
+    uint32_t frame = 0;
+
+    if(engine_bench_level)
+    {
+        samples_size = (engine_bench_frames > 0) ? (engine_bench_frames) : (1024);
+        for(int s = 0; s < BENCH_STAT_LASTINDEX; ++s)
+        {
+            samples[s] = (float*)malloc(samples_size * sizeof(float));
+        }
+    }
+
+    while(!engine_done && ((engine_bench_frames <= 0) || (frame < (uint32_t)engine_bench_frames)))
+    {
+        int64_t t0, t1, t2, t3;
+        if(Controls_IsReplaying() && !Controls_ReplayFrame(&time))
+        {
+            break;
+        }
+        engine_frame_time = time;
+        Sys_ResetTempMem();
+        Prof_FrameBegin();
+
+        t0 = Sys_MicroSecTime(0);
+        Game_Frame(time);
+        t1 = Sys_MicroSecTime(0);
+        Gameflow_ProcessCommands();
+        t2 = Sys_MicroSecTime(0);
+        Audio_Update(time);
+        t3 = Sys_MicroSecTime(0);
+
+        if(samples_size)
+        {
+            if(frame >= samples_size)
+            {
+                samples_size *= 2;
+                for(int s = 0; s < BENCH_STAT_LASTINDEX; ++s)
+                {
+                    samples[s] = (float*)realloc(samples[s], samples_size * sizeof(float));
+                }
+            }
+            samples[BENCH_STAT_FRAME][frame] = (t3 - t0) / 1000.0f;
+            samples[BENCH_STAT_GAME][frame] = (t1 - t0) / 1000.0f;
+            samples[BENCH_STAT_ENTITIES][frame] = game_frame_timing.entities / 1000.0f;
+            samples[BENCH_STAT_PHYSICS][frame] = game_frame_timing.physics / 1000.0f;
+            samples[BENCH_STAT_GAMEFLOW][frame] = (t2 - t1) / 1000.0f;
+            samples[BENCH_STAT_AUDIO][frame] = (t3 - t2) / 1000.0f;
+        }
+        ++frame;
+    }
+
+    if(samples_size)
+    {
+        if(frame > 0)
+        {
+            Bench_PrintStats(samples, frame, engine_bench_load_time);
+        }
+        for(int s = 0; s < BENCH_STAT_LASTINDEX; ++s)
+        {
+            free(samples[s]);
+        }
+    }
+}
+
+
 /*
  * MISC ENGINE FUNCTIONALITY
  */
@@ -1171,9 +1552,14 @@ extern "C" int Engine_ExecCmd(char *ch)
             Con_AddLine("exit - close program\0", FONTSTYLE_CONSOLE_NOTIFY);
             Con_AddLine("cls - clean console\0", FONTSTYLE_CONSOLE_NOTIFY);
             Con_AddLine("show_fps - switch show fps flag\0", FONTSTYLE_CONSOLE_NOTIFY);
+            Con_AddLine("prof - switch hot path profiler, prof_dump(\"file_name\") - save last frames as chrome trace\0", FONTSTYLE_CONSOLE_NOTIFY);
+            Con_AddLine("bench_anim(passes) - time animation evaluation of all level models\0", FONTSTYLE_CONSOLE_NOTIFY);
+            Con_AddLine("bench_cull(passes) - time frustum tests of all level bounding volumes\0", FONTSTYLE_CONSOLE_NOTIFY);
+            Con_AddLine("bench_bsp(polygons) - flood transparency BSP tree and check that no polygons are dropped\0", FONTSTYLE_CONSOLE_NOTIFY);
             Con_AddLine("cvars - lua's table of cvar's, to see them type: show_table(cvars)\0", FONTSTYLE_CONSOLE_NOTIFY);
             Con_AddLine("free_look - switch camera mode\0", FONTSTYLE_CONSOLE_NOTIFY);
             Con_AddLine("r_crosshair - switch crosshair visibility\0", FONTSTYLE_CONSOLE_NOTIFY);
+            Con_AddLine("r_gpu_skinning - switch skeletal models skinning by shader, check_skinning - compare CPU and shader skinning of player\0", FONTSTYLE_CONSOLE_NOTIFY);
             Con_AddLine("cam_distance - camera distance to actor\0", FONTSTYLE_CONSOLE_NOTIFY);
             Con_AddLine("r_wireframe, r_portals, r_frustums, r_room_boxes, r_boxes, r_normals, r_skip_room, r_flyby, r_cinematics, r_triggers, r_ai_boxes, r_cameras - render modes, r_path - show character path\0", FONTSTYLE_CONSOLE_NOTIFY);
             Con_AddLine("playsound(id) - play specified sound\0", FONTSTYLE_CONSOLE_NOTIFY);
@@ -1221,6 +1607,64 @@ extern "C" int Engine_ExecCmd(char *ch)
             renderer.settings.show_fps = !renderer.settings.show_fps;
             return 1;
         }
+        else if(!strcmp(token, "prof"))
+        {
+            Prof_SetEnabled(!prof_enabled);
+            Con_Printf("profiler = %d", !prof_enabled);
+            return 1;
+        }
+        else if(!strcmp(token, "bench_anim"))
+        {
+            int passes = 10;
+            ch = SC_ParseToken(ch, token, sizeof(token));
+            if(NULL != ch)
+            {
+                passes = atoi(token);
+            }
+            Bench_Animations((passes > 0) ? (passes) : (1));
+            return 1;
+        }
+        else if(!strcmp(token, "bench_cull"))
+        {
+            int passes = 10;
+            ch = SC_ParseToken(ch, token, sizeof(token));
+            if(NULL != ch)
+            {
+                passes = atoi(token);
+            }
+            Bench_Culling((passes > 0) ? (passes) : (1));
+            return 1;
+        }
+        else if(!strcmp(token, "bench_bsp"))
+        {
+            int count = 4096;
+            ch = SC_ParseToken(ch, token, sizeof(token));
+            if(NULL != ch)
+            {
+                count = atoi(token);
+            }
+            Bench_BSP((count > 0) ? (count) : (1), 0);
+            return 1;
+        }
+        else if(!strcmp(token, "prof_dump"))
+        {
+            const char *file_name = "prof_trace.json";
+            ch = SC_ParseToken(ch, token, sizeof(token));
+            if(NULL != ch)
+            {
+                file_name = token;
+            }
+            int frames = Prof_DumpChromeTrace(file_name);
+            if(frames > 0)
+            {
+                Con_Printf("%d frames saved to \"%s\"", frames, file_name);
+            }
+            else
+            {
+                Con_Warning("no profiler data saved, type \"prof\" to start profiling");
+            }
+            return 1;
+        }
         else if(!strcmp(token, "r_wireframe"))
         {
             renderer.r_flags ^= R_DRAW_WIRE;
@@ -1316,6 +1760,23 @@ extern "C" int Engine_ExecCmd(char *ch)
             screen_info.crosshair = !screen_info.crosshair;
             return 1;
         }
+        else if(!strcmp(token, "r_gpu_skinning"))
+        {
+            renderer.settings.gpu_skinning = !renderer.settings.gpu_skinning;
+            Con_Printf("gpu_skinning = %d", renderer.settings.gpu_skinning);
+            return 1;
+        }
+        else if(!strcmp(token, "check_skinning"))
+        {
+            entity_p player = World_GetPlayer();
+            if(player && player->bf)
+            {
+                float position_error, normal_error;
+                renderer.GetSkinningError(player->bf, &position_error, &normal_error);
+                Con_Printf("skinning error: position = %f, normal = %f", position_error, normal_error);
+            }
+            return 1;
+        }
         else if(!strcmp(token, "room_info"))
         {
             room_p r = engine_camera.current_room;
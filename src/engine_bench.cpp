@@ -0,0 +1,1050 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "core/system.h"
+#include "core/gl_text.h"
+#include "core/console.h"
+#include "core/vmath.h"
+#include "core/vmath_simd.h"
+#include "core/polygon.h"
+#include "core/obb.h"
+#include "render/camera.h"
+#include "render/bsp_tree.h"
+#include "render/frustum.h"
+#include "render/render_queue.h"
+#include "render/render.h"
+#include "physics/physics.h"
+#include "physics/ragdoll.h"
+#include "vt/vt_level.h"
+#include "mesh.h"
+#include "skeletal_model.h"
+#include "entity.h"
+#include "room.h"
+#include "world.h"
+#include "game.h"
+#include "gameflow.h"
+#include "engine.h"
+#include "controls.h"
+
+
+/*
+ * LEVEL BENCHMARKS AND CHECKS (see -bench_* arguments and bench_* commands)
+ */
+
+void Engine_HeadlessLoop();
+
+
+static void Bench_LoadLevel(const char *name, int loads)
+{
+    int64_t sum[WORLD_LOAD_STAGES_COUNT] = {0};
+    int64_t min[WORLD_LOAD_STAGES_COUNT] = {0};
+    int64_t max[WORLD_LOAD_STAGES_COUNT] = {0};
+    int64_t total_sum = 0, total_min = 0, total_max = 0;
+    size_t peak[WORLD_LOAD_STAGES_COUNT] = {0};
+    size_t total_peak = 0;
+    const world_load_stage_t *stages = World_GetLoadStages();
+
+    for(int n = 0; n < loads; ++n)
+    {
+        int64_t total = 0;
+        Sys_ResetTempMem();
+        if(!Engine_LoadMap(name))
+        {
+            printf("load benchmark: can not load \"%s\"\n", name);
+            return;
+        }
+        for(int i = 0; i < WORLD_LOAD_STAGES_COUNT; ++i)
+        {
+            int64_t t = stages[i].time;
+            sum[i] += t;
+            min[i] = (n == 0 || t < min[i]) ? (t) : (min[i]);
+            max[i] = (n == 0 || t > max[i]) ? (t) : (max[i]);
+            peak[i] = (stages[i].heap_peak > peak[i]) ? (stages[i].heap_peak) : (peak[i]);
+            total_peak = (peak[i] > total_peak) ? (peak[i]) : (total_peak);
+            total += t;
+        }
+        total_sum += total;
+        total_min = (n == 0 || total < total_min) ? (total) : (total_min);
+        total_max = (n == 0 || total > total_max) ? (total) : (total_max);
+    }
+
+    printf("\nload benchmark: level = \"%s\", loads = %d\n", name, loads);
+    printf("%-24s %9s %9s %9s %9s %9s\n", "stage, ms", "mean", "min", "max", "heap, MB", "heap peak");
+    for(int i = 0; i < WORLD_LOAD_STAGES_COUNT; ++i)
+    {
+        printf("%-24s %9.2f %9.2f %9.2f %9.2f %9.2f\n", stages[i].name, sum[i] / (1000.0f * loads),
+               min[i] / 1000.0f, max[i] / 1000.0f, stages[i].heap_used / 1048576.0f, peak[i] / 1048576.0f);
+    }
+    printf("%-24s %9.2f %9.2f %9.2f   heap peak %.2f MB, process RSS peak %.2f MB\n", "total", total_sum / (1000.0f * loads),
+           total_min / 1000.0f, total_max / 1000.0f, total_peak / 1048576.0f, Sys_GetPeakMemUsed() / 1048576.0f);
+    fflush(stdout);
+}
+
+/*
+ * Animation evaluation benchmark: every frame of every animation of all
+ * level skeletal models is evaluated by batched and reference
+ * SSBoneFrame_Update() implementations; prints time per bone and the biggest
+ * difference between their bone matrices.
+ */
+void Bench_Animations(int passes)
+{
+    skeletal_model_p models = NULL;
+    uint32_t models_count = 0;
+    uint64_t bones = 0;
+    int64_t time_batched = 0, time_reference = 0;
+    float max_diff = 0.0f;
+
+    World_GetSkeletalModelsInfo(&models, &models_count);
+    for(uint32_t i = 0; i < models_count; ++i)
+    {
+        skeletal_model_p model = models + i;
+        ss_bone_frame_t bf, bf_ref;
+
+        if(!model->mesh_count || !model->animation_count)
+        {
+            continue;
+        }
+        SSBoneFrame_CreateFromModel(&bf, model);
+        SSBoneFrame_CreateFromModel(&bf_ref, model);
+        for(int pass = 0; pass < passes; ++pass)
+        {
+            for(uint16_t a = 0; a < model->animation_count; ++a)
+            {
+                animation_frame_p anim = model->animations + a;
+                int64_t t0, t1, t2;
+                for(uint16_t f = 0; f < anim->frames_count; ++f)
+                {
+                    bf.animations.prev_animation = bf_ref.animations.prev_animation = a;
+                    bf.animations.current_animation = bf_ref.animations.current_animation = a;
+                    bf.animations.prev_frame = bf_ref.animations.prev_frame = f;
+                    bf.animations.current_frame = bf_ref.animations.current_frame = (f + 1 < anim->frames_count) ? (f + 1) : (0);
+                    bf.animations.lerp = bf_ref.animations.lerp = 0.5f;
+                    t0 = Sys_MicroSecTime(0);
+                    SSBoneFrame_Update(&bf, 0.0f);
+                    t1 = Sys_MicroSecTime(0);
+                    SSBoneFrame_UpdateReference(&bf_ref, 0.0f);
+                    t2 = Sys_MicroSecTime(0);
+                    time_batched += t1 - t0;
+                    time_reference += t2 - t1;
+                    bones += model->mesh_count;
+                    for(uint16_t k = 0; (pass == 0) && (k < model->mesh_count); ++k)
+                    {
+                        for(int j = 0; j < 16; ++j)
+                        {
+                            float d = fabs(bf.bone_tags[k].current_transform[j] - bf_ref.bone_tags[k].current_transform[j]);
+                            max_diff = (d > max_diff) ? (d) : (max_diff);
+                        }
+                    }
+                }
+            }
+        }
+        SSBoneFrame_Clear(&bf);
+        SSBoneFrame_Clear(&bf_ref);
+    }
+
+    if(bones)
+    {
+        Con_Printf("bench_anim (%s): models = %d, bones = %llu", VMATH_SIMD_NAME, (int)models_count, (unsigned long long)bones);
+        Con_Printf("batched = %.2f ms (%.1f ns/bone), reference = %.2f ms (%.1f ns/bone), max diff = %g",
+                   time_batched / 1000.0f, 1000.0f * time_batched / bones,
+                   time_reference / 1000.0f, 1000.0f * time_reference / bones, max_diff);
+    }
+    else
+    {
+        Con_Warning("no animated models loaded");
+    }
+}
+
+struct bench_obb_list_s
+{
+    obb_p      *obbs;                                                           // NULL: count only
+    uint32_t    count;
+};
+
+static int Bench_CollectEntityOBB(struct entity_s *ent, void *data)
+{
+    struct bench_obb_list_s *list = (struct bench_obb_list_s*)data;
+    if(ent->obb)
+    {
+        if(list->obbs)
+        {
+            list->obbs[list->count] = ent->obb;
+        }
+        list->count++;
+    }
+    return 0;
+}
+
+/*
+ * Culling benchmark: rooms boxes, static meshes and entities volumes of the
+ * loaded level are tested against the camera and all current portal
+ * frustums by planes and by reference (polygon) tests. Planes tests are
+ * conservative, so only volumes culled by them but visible by the reference
+ * tests are reported as errors.
+ */
+void Bench_Culling(int passes)
+{
+    room_p rooms = NULL;
+    uint32_t rooms_count = 0;
+    uint32_t obb_count = 0, frustums_count = 1;
+    uint64_t tests = 0, visible = 0, visible_ref = 0, errors = 0;
+    int64_t time_planes = 0, time_reference = 0;
+    frustum_p *frustums;
+    obb_p *obbs;
+    struct bench_obb_list_s entities = {NULL, 0};
+
+    World_GetRoomInfo(&rooms, &rooms_count);
+    if(!rooms_count)
+    {
+        Con_Warning("no level loaded");
+        return;
+    }
+
+    for(uint32_t i = 0; i < rooms_count; ++i)
+    {
+        obb_count += rooms[i].content->static_mesh_count;
+        for(frustum_p f = rooms[i].frustum; f; f = f->next)
+        {
+            frustums_count++;
+        }
+    }
+    // entities outside of rooms lists (spawned ones) are counted too
+    World_IterateAllEntities(Bench_CollectEntityOBB, &entities);
+    obb_count += entities.count;
+
+    frustums = (frustum_p*)malloc(frustums_count * sizeof(frustum_p));
+    obbs = (obb_p*)malloc((obb_count + 1) * sizeof(obb_p));
+    frustums_count = 0;
+    frustums[frustums_count++] = engine_camera.frustum;
+    for(uint32_t i = 0; i < rooms_count; ++i)
+    {
+        for(frustum_p f = rooms[i].frustum; f; f = f->next)
+        {
+            frustums[frustums_count++] = f;
+        }
+    }
+    entities.obbs = obbs;
+    entities.count = 0;
+    World_IterateAllEntities(Bench_CollectEntityOBB, &entities);
+    obb_count = entities.count;
+    for(uint32_t i = 0; i < rooms_count; ++i)
+    {
+        for(uint32_t j = 0; j < rooms[i].content->static_mesh_count; ++j)
+        {
+            obbs[obb_count++] = rooms[i].content->static_mesh[j].obb;
+        }
+    }
+
+    for(int pass = 0; pass < passes; ++pass)
+    {
+        for(uint32_t fi = 0; fi < frustums_count; ++fi)
+        {
+            frustum_p f = frustums[fi];
+            uint32_t vis = 0, vis_ref = 0;
+            int64_t t0, t1, t2;
+
+            t0 = Sys_MicroSecTime(0);
+            for(uint32_t i = 0; i < rooms_count; ++i)
+            {
+                vis += Frustum_IsAABBVisible(rooms[i].bb_min, rooms[i].bb_max, f);
+            }
+            for(uint32_t i = 0; i < obb_count; ++i)
+            {
+                vis += Frustum_IsOBBVisible(obbs[i], f);
+            }
+            t1 = Sys_MicroSecTime(0);
+            for(uint32_t i = 0; i < rooms_count; ++i)
+            {
+                vis_ref += Frustum_IsAABBVisibleReference(rooms[i].bb_min, rooms[i].bb_max, f);
+            }
+            for(uint32_t i = 0; i < obb_count; ++i)
+            {
+                vis_ref += Frustum_IsOBBVisibleReference(obbs[i], f);
+            }
+            t2 = Sys_MicroSecTime(0);
+
+            time_planes += t1 - t0;
+            time_reference += t2 - t1;
+            tests += rooms_count + obb_count;
+            visible += vis;
+            visible_ref += vis_ref;
+            for(uint32_t i = 0; (pass == 0) && (i < rooms_count + obb_count); ++i)
+            {
+                bool ref = (i < rooms_count) ? Frustum_IsAABBVisibleReference(rooms[i].bb_min, rooms[i].bb_max, f) :
+                                               Frustum_IsOBBVisibleReference(obbs[i - rooms_count], f);
+                bool res = (i < rooms_count) ? Frustum_IsAABBVisible(rooms[i].bb_min, rooms[i].bb_max, f) :
+                                               Frustum_IsOBBVisible(obbs[i - rooms_count], f);
+                errors += (ref && !res) ? (1) : (0);
+            }
+        }
+    }
+    free(frustums);
+    free(obbs);
+
+    Con_Printf("bench_cull (%s): frustums = %d, volumes = %d, tests = %llu", VMATH_SIMD_NAME,
+               (int)frustums_count, (int)(rooms_count + obb_count), (unsigned long long)tests);
+    Con_Printf("planes = %.2f ms (%.1f ns/test), reference = %.2f ms (%.1f ns/test)",
+               time_planes / 1000.0f, 1000.0f * time_planes / tests,
+               time_reference / 1000.0f, 1000.0f * time_reference / tests);
+    Con_Printf("visible: planes = %llu, reference = %llu, wrongly culled = %llu",
+               (unsigned long long)visible, (unsigned long long)visible_ref, (unsigned long long)errors);
+}
+
+
+static void Bench_CountBSP(bsp_node_p node, uint32_t vertex_count, uint32_t *polygons, uint32_t *vertices, uint32_t *bad_indexes)
+{
+    for(int side = 0; side < 2; ++side)
+    {
+        for(bsp_polygon_p p = (side) ? (node->polygons_back) : (node->polygons_front); p; p = p->next)
+        {
+            (*polygons)++;
+            (*vertices) += p->vertex_count;
+            for(uint16_t i = 0; i < p->vertex_count; ++i)
+            {
+                (*bad_indexes) += (p->indexes[i] >= vertex_count) ? (1) : (0);
+            }
+        }
+    }
+    if(node->front)
+    {
+        Bench_CountBSP(node->front, vertex_count, polygons, vertices, bad_indexes);
+    }
+    if(node->back)
+    {
+        Bench_CountBSP(node->back, vertex_count, polygons, vertices, bad_indexes);
+    }
+}
+
+/*
+ * Local LCG: the test polygons do not depend on (and do not reseed) the game
+ * random sequence.
+ */
+static uint32_t Bench_Random(uint32_t *seed)
+{
+    *seed = *seed * 1664525u + 1013904223u;
+    return *seed >> 8;
+}
+
+static void Bench_Report(int headless, const char *fmt, ...)
+{
+    va_list argptr;
+    char buf[1024];
+
+    va_start(argptr, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, argptr);
+    buf[sizeof(buf) - 1] = 0;
+    va_end(argptr);
+    if(headless)
+    {
+        puts(buf);
+    }
+    else
+    {
+        Con_AddLine(buf, FONTSTYLE_CONSOLE_NOTIFY);
+    }
+}
+
+/*
+ * Floods a small CDynamicBSP with random triangles (count, 2 * count and
+ * 4 * count in the next frames) and checks that every input polygon and
+ * every split part is in the tree; returns 0 if polygons were dropped.
+ * Results go to stdout in headless mode (-check_bsp), else to the console.
+ */
+int Bench_BSP(int count, int headless)
+{
+    const int frames = 3;
+    float transform[16];
+    polygon_p polygons = Polygon_CreateArray(4 * count);
+    CDynamicBSP *bsp = new CDynamicBSP(8192);
+    uint32_t seed = count;
+    bool ok = true;
+
+    Mat4_E(transform);
+    for(int i = 0; i < 4 * count; ++i)
+    {
+        polygon_p p = polygons + i;
+        float center[3];
+        center[0] = (float)(Bench_Random(&seed) % 16384) - 8192.0f;
+        center[1] = (float)(Bench_Random(&seed) % 16384) - 8192.0f;
+        center[2] = (float)(Bench_Random(&seed) % 16384) - 8192.0f;
+        Polygon_Resize(p, 3);
+        for(int v = 0; v < 3; ++v)
+        {
+            p->vertices[v].position[0] = center[0] + (float)(Bench_Random(&seed) % 2048) - 1024.0f;
+            p->vertices[v].position[1] = center[1] + (float)(Bench_Random(&seed) % 2048) - 1024.0f;
+            p->vertices[v].position[2] = center[2] + (float)(Bench_Random(&seed) % 2048) - 1024.0f;
+            vec4_set_one(p->vertices[v].color);
+            p->vertices[v].tex_coord[0] = p->vertices[v].tex_coord[1] = 0.0f;
+        }
+        Polygon_FindNormale(p);
+        vec3_copy(p->vertices[0].normal, p->plane);
+        vec3_copy(p->vertices[1].normal, p->plane);
+        vec3_copy(p->vertices[2].normal, p->plane);
+        p->next = (i + 1 < 4 * count) ? (p + 1) : (NULL);
+    }
+
+    for(int frame = 0, n = count; frame < frames; ++frame, n *= 2)
+    {
+        uint32_t in_tree = 0, vertices = 0, bad_indexes = 0;
+        uint32_t expected;
+        int64_t t;
+
+        bsp->Reset(NULL);
+        polygons[n - 1].next = NULL;
+        t = Sys_MicroSecTime(0);
+        bsp->AddNewPolygonList(polygons, transform, NULL);
+        t = Sys_MicroSecTime(0) - t;
+        polygons[n - 1].next = (n < 4 * count) ? (polygons + n) : (NULL);
+
+        Bench_CountBSP(bsp->m_root, bsp->GetActiveVertexCount(), &in_tree, &vertices, &bad_indexes);
+        expected = bsp->GetInputPolygonsCount() + bsp->GetSplitsCount();
+        ok = ok && (bsp->GetInputPolygonsCount() == (uint32_t)n) && (in_tree == expected) &&
+             (bsp->GetAddedPolygonsCount() == expected) && (vertices == bsp->GetActiveVertexCount()) && (bad_indexes == 0);
+        Bench_Report(headless, "bench_bsp: input = %d, splits = %d, nodes = %d, in tree = %d / %d, time = %.2f ms, bytes = %d / %d",
+                   (int)bsp->GetInputPolygonsCount(), (int)bsp->GetSplitsCount(), (int)bsp->GetNodesCount(),
+                   (int)in_tree, (int)expected, t / 1000.0f, (int)bsp->GetUsedBytes(), (int)bsp->GetAllocatedBytes());
+    }
+    Bench_Report(headless, "bench_bsp: %s", (ok) ? ("all polygons are in the tree") : ("FAILED, polygons were dropped"));
+    fflush(stdout);
+
+    delete bsp;
+    for(int i = 0; i < 4 * count; ++i)
+    {
+        Polygon_Clear(polygons + i);
+    }
+    free(polygons);
+
+    return (ok) ? (1) : (0);
+}
+
+/*
+ * Places camera in the center of every room, looks around by "views" yaw
+ * steps and counts GL state changes of the opaque render queue submitted in
+ * portals traversal order, in sorted order and in sorted order with
+ * instanced static meshes. Queue is filled without GL calls, so it works in
+ * headless mode too.
+ */
+static void Bench_DrawLevel(const char *name, int views)
+{
+    const char *order_names[3] = {"traversal", "sorted", "instanced"};
+    render_queue_stats_t stats[3];
+    render_queue_stats_t sum[3];
+    room_p rooms = NULL;
+    uint32_t rooms_count = 0;
+    uint32_t frames = 0;
+
+    Sys_ResetTempMem();
+    if(!Engine_LoadMap(name))
+    {
+        printf("draw benchmark: can not load \"%s\"\n", name);
+        return;
+    }
+
+    memset(sum, 0, sizeof(sum));
+    World_GetRoomInfo(&rooms, &rooms_count);
+    for(uint32_t i = 0; i < rooms_count; ++i)
+    {
+        room_p room = rooms + i;
+        if(room != room->real_room)
+        {
+            continue;
+        }
+        for(int v = 0; v < views; ++v)
+        {
+            float angles[3] = {2.0f * (float)M_PI * v / views, 0.0f, 0.0f};
+            engine_camera.transform.M4x4[12 + 0] = 0.5f * (room->bb_min[0] + room->bb_max[0]);
+            engine_camera.transform.M4x4[12 + 1] = 0.5f * (room->bb_min[1] + room->bb_max[1]);
+            engine_camera.transform.M4x4[12 + 2] = 0.5f * (room->bb_min[2] + room->bb_max[2]);
+            engine_camera.current_room = room;
+            Cam_SetRotation(&engine_camera, angles);
+            Cam_Apply(&engine_camera);
+            Cam_RecalcClipPlanes(&engine_camera);
+            renderer.GenWorldList(&engine_camera);
+            renderer.GetRenderQueueStats(stats + 0, stats + 1, stats + 2);
+            for(int j = 0; j < 3; ++j)
+            {
+                sum[j].draw_calls += stats[j].draw_calls;
+                sum[j].shader_changes += stats[j].shader_changes;
+                sum[j].texture_changes += stats[j].texture_changes;
+                sum[j].vbo_changes += stats[j].vbo_changes;
+                sum[j].instance_changes += stats[j].instance_changes;
+            }
+            frames++;
+        }
+    }
+
+    if(frames)
+    {
+        printf("%s: %u views, per view:\n", name, frames);
+        printf("    %-10s %10s %10s %10s %10s %10s\n", "order", "draws", "shaders", "textures", "vbos", "instances");
+        for(int j = 0; j < 3; ++j)
+        {
+            printf("    %-10s %10.1f %10.1f %10.1f %10.1f %10.1f\n", order_names[j],
+                   (float)sum[j].draw_calls / frames, (float)sum[j].shader_changes / frames,
+                   (float)sum[j].texture_changes / frames, (float)sum[j].vbo_changes / frames,
+                   (float)sum[j].instance_changes / frames);
+        }
+    }
+}
+
+static void Bench_SpawnPlayerCopies(entity_p player, uint32_t *ids, int count)
+{
+    for(int i = 0; i < count; ++i)
+    {
+        float pos[3], ang[3] = {0.0f, 0.0f, 0.0f};
+        vec3_copy(pos, player->transform.M4x4 + 12);
+        pos[0] += 256.0f * (i % 4 - 2);
+        pos[1] += 256.0f * ((i / 4) % 4 - 2);
+        pos[2] += 512.0f * (i / 16 + 1);
+        ang[0] = 37.0f * i;
+        ids[i] = World_SpawnEntity(player->bf->animations.model->id, player->self->room->id, pos, ang, -1);
+    }
+}
+
+/*
+ * (Re)creates ragdolls of the spawned copies from their current pose.
+ */
+static void Bench_CreateRagdolls(const uint32_t *ids, int count, struct rd_setup_s *setup)
+{
+    for(int i = 0; i < count; ++i)
+    {
+        entity_p ent = World_GetEntityByID(ids[i]);
+        if(ent)
+        {
+            ent->type_flags &= ~ENTITY_TYPE_DYNAMIC;
+            Entity_UpdateRigidBody(ent, 1);
+            if(Ragdoll_Create(ent->physics, ent->bf, setup))
+            {
+                ent->type_flags |= ENTITY_TYPE_DYNAMIC;
+            }
+        }
+    }
+}
+
+static void Bench_DeleteRagdolls(const uint32_t *ids, int count)
+{
+    for(int i = 0; i < count; ++i)
+    {
+        entity_p ent = World_GetEntityByID(ids[i]);
+        if(ent)
+        {
+            Ragdoll_Delete(ent->physics);
+            World_DeleteEntity(ids[i]);
+        }
+    }
+}
+
+/*
+ * Spawns copies of the player model near the player, turns them into ragdolls
+ * and times physics steps for every solver threads count (powers of two up to
+ * the scheduler limit); ragdolls are rebuilt from the spawn pose before every
+ * run, so all runs simulate the same scene.
+ */
+static void Bench_RagdollsLevel(const char *name, int count)
+{
+    const int steps = 240;
+    entity_p player;
+    struct rd_setup_s *setup;
+    uint32_t *ids;
+    int threads_saved = Physics_GetThreadsCount();
+
+    Sys_ResetTempMem();
+    if(!Engine_LoadMap(name))
+    {
+        printf("ragdoll benchmark: can not load \"%s\"\n", name);
+        return;
+    }
+
+    player = World_GetPlayer();
+    setup = (player && player->self->room) ? (Ragdoll_AutoCreateSetup(player->bf->animations.model, 0, 0)) : (NULL);
+    if(!setup)
+    {
+        printf("ragdoll benchmark: no player model ragdoll in \"%s\"\n", name);
+        return;
+    }
+
+    ids = (uint32_t*)malloc(count * sizeof(uint32_t));
+    Bench_SpawnPlayerCopies(player, ids, count);
+
+    printf("\nragdoll benchmark: level = \"%s\", ragdolls = %d, steps = %d\n", name, count, steps);
+    printf("%-8s %9s %9s\n", "threads", "mean, ms", "max, ms");
+    for(int threads = 1; threads <= Physics_GetMaxThreadsCount(); threads *= 2)
+    {
+        int64_t sum = 0, max = 0;
+        Physics_SetThreadsCount(threads);
+        Bench_CreateRagdolls(ids, count, setup);
+        for(int s = 0; s < steps; ++s)
+        {
+            int64_t t = Sys_MicroSecTime(0);
+            Physics_StepSimulation(PHYSICS_FIXED_TIME_STEP);
+            t = Sys_MicroSecTime(0) - t;
+            sum += t;
+            max = (t > max) ? (t) : (max);
+        }
+        printf("%-8d %9.3f %9.3f\n", threads, sum / (1000.0f * steps), max / 1000.0f);
+    }
+    fflush(stdout);
+
+    Bench_DeleteRagdolls(ids, count);
+    free(ids);
+    Ragdoll_DeleteSetup(setup);
+    Physics_SetThreadsCount(threads_saved);
+}
+
+/*
+ * Physics check: the same session is run at several frame rates and sampled
+ * positions of all entities (every half a second of game time) and of ragdoll
+ * bodies (every PHYSICS_CHECK_SAMPLE_STEPS fixed steps) are compared with the
+ * 60 Hz run. Replayed input is applied by time: a frame gets the last record
+ * which starts before its end, so low rates may merge short presses.
+ */
+#define PHYSICS_CHECK_SAMPLE_STEPS          (30)
+#define PHYSICS_CHECK_RAGDOLLS              (8)
+#define PHYSICS_CHECK_RATES_COUNT           (3)
+#define PHYSICS_CHECK_REFERENCE_RATE        (1)
+/*
+ * Ragdoll bodies are compared after equal fixed steps counts, so they must
+ * match up to float rounding. Game logic entities (Lara, AI, moving objects)
+ * still advance by the variable frame time, and the replay input lands on
+ * different frames at different rates, so they get a tolerance.
+ */
+#define PHYSICS_CHECK_ENTITY_TOLERANCE      (32.0f)                             // world units
+#define PHYSICS_CHECK_RAGDOLL_TOLERANCE     (0.01f)
+
+static const int physics_check_rates[PHYSICS_CHECK_RATES_COUNT] = {30, 60, 144};
+
+typedef struct physics_check_run_s
+{
+    uint32_t    entities_count;                                                 // positions per sample
+    uint32_t    bodies_count;
+    uint32_t    entity_samples;
+    uint32_t    body_samples;
+    uint32_t    entities_used;                                                  // positions of all samples
+    uint32_t    bodies_used;
+    uint32_t    entities_size;                                                  // allocated positions
+    uint32_t    bodies_size;
+    int         changed;                                                        // objects set is changed between samples
+    float      *entities;
+    float      *bodies;
+}physics_check_run_t, *physics_check_run_p;
+
+static void Bench_AddCheckPosition(float **buf, uint32_t *size, uint32_t index, const float pos[3])
+{
+    if(index >= *size)
+    {
+        *size = (*size) ? (*size * 2) : (1024);
+        *buf = (float*)realloc(*buf, *size * 3 * sizeof(float));
+    }
+    vec3_copy(*buf + 3 * index, pos);
+}
+
+/*
+ * Dynamic entities transforms are taken before the physics step of the frame,
+ * so they are checked by ragdoll bodies samples only.
+ */
+static int Bench_CollectEntityPosition(struct entity_s *ent, void *data)
+{
+    physics_check_run_p run = (physics_check_run_p)data;
+    if(!(ent->type_flags & ENTITY_TYPE_DYNAMIC))
+    {
+        Bench_AddCheckPosition(&run->entities, &run->entities_size, run->entities_used++, ent->transform.M4x4 + 12);
+    }
+    return 0;
+}
+
+static void Bench_SampleEntities(physics_check_run_p run)
+{
+    uint32_t first = run->entities_used;
+    World_IterateAllEntities(Bench_CollectEntityPosition, run);
+    if((run->entity_samples > 0) && (run->entities_used - first != run->entities_count))
+    {
+        run->changed = 1;
+    }
+    run->entities_count = run->entities_used - first;
+    run->entity_samples++;
+}
+
+static void Bench_SampleRagdolls(physics_check_run_p run, const uint32_t *ids, int count)
+{
+    uint32_t first = run->bodies_used;
+    for(int i = 0; i < count; ++i)
+    {
+        entity_p ent = World_GetEntityByID(ids[i]);
+        if(ent && (ent->type_flags & ENTITY_TYPE_DYNAMIC))
+        {
+            for(uint16_t j = 0; j < ent->bf->bone_tag_count; ++j)
+            {
+                float tr[16];
+                Physics_GetBodyWorldTransform(ent->physics, tr, j);
+                Bench_AddCheckPosition(&run->bodies, &run->bodies_size, run->bodies_used++, tr + 12);
+            }
+        }
+    }
+    if((run->body_samples > 0) && (run->bodies_used - first != run->bodies_count))
+    {
+        run->changed = 1;
+    }
+    run->bodies_count = run->bodies_used - first;
+    run->body_samples++;
+}
+
+static int Bench_PhysicsCheckRun(const char *level, const char *replay, int rate, int seconds, physics_check_run_p run)
+{
+    const float frame_time = 1.0f / (float)rate;
+    const uint32_t samples = (uint32_t)(seconds / (PHYSICS_CHECK_SAMPLE_STEPS * PHYSICS_FIXED_TIME_STEP) + 0.5f);
+    const uint32_t sample_frames = (uint32_t)(rate * PHYSICS_CHECK_SAMPLE_STEPS * PHYSICS_FIXED_TIME_STEP + 0.5f);
+    const uint32_t max_frames = (samples + 1) * sample_frames;
+    uint32_t ids[PHYSICS_CHECK_RAGDOLLS];
+    struct rd_setup_s *setup;
+    entity_p player;
+    uint32_t steps;
+    float replay_time = 0.0f;
+
+    Sys_ResetTempMem();
+    if(!Engine_LoadMap(level))
+    {
+        printf("physics check: can not load \"%s\"\n", level);
+        return 0;
+    }
+
+    player = World_GetPlayer();
+    setup = (player && player->self->room) ? (Ragdoll_AutoCreateSetup(player->bf->animations.model, 0, 0)) : (NULL);
+    if(!setup)
+    {
+        printf("physics check: no player model ragdoll in \"%s\"\n", level);
+        return 0;
+    }
+    Bench_SpawnPlayerCopies(player, ids, PHYSICS_CHECK_RAGDOLLS);
+    Bench_CreateRagdolls(ids, PHYSICS_CHECK_RAGDOLLS, setup);
+
+    if(!replay || !Controls_StartReplay(replay))
+    {
+        srand(1);                                                               // the same random sequence in every run
+    }
+
+    steps = Physics_GetStepsCount();
+    for(uint32_t frame = 1; (frame <= max_frames) && ((run->entity_samples < samples) || (run->body_samples < samples)); ++frame)
+    {
+        while(Controls_IsReplaying() && (replay_time < frame * frame_time))
+        {
+            float t;
+            if(!Controls_ReplayFrame(&t))
+            {
+                break;
+            }
+            replay_time += t;
+        }
+        engine_frame_time = frame_time;
+        Sys_ResetTempMem();
+        Game_Frame(frame_time);
+        Gameflow_ProcessCommands();
+
+        if((frame % sample_frames == 0) && (run->entity_samples < samples))
+        {
+            Bench_SampleEntities(run);
+        }
+        if((Physics_GetStepsCount() - steps == (run->body_samples + 1) * PHYSICS_CHECK_SAMPLE_STEPS) && (run->body_samples < samples))
+        {
+            Bench_SampleRagdolls(run, ids, PHYSICS_CHECK_RAGDOLLS);
+        }
+    }
+    Controls_StopRecordReplay();
+
+    Bench_DeleteRagdolls(ids, PHYSICS_CHECK_RAGDOLLS);
+    Ragdoll_DeleteSetup(setup);
+    return (run->entity_samples == samples) && (run->body_samples == samples);
+}
+
+static float Bench_MaxCheckDistance(const float *a, const float *b, uint32_t count)
+{
+    float max = 0.0f;
+    for(uint32_t i = 0; i < count; ++i)
+    {
+        float d = vec3_dist(a + 3 * i, b + 3 * i);
+        max = (d > max) ? (d) : (max);
+    }
+    return max;
+}
+
+/*
+ * Returns 0 if a run fails or any trajectory differs from the reference rate
+ * run by more than the tolerance.
+ */
+int Engine_PhysicsCheck(const char *level, const char *replay, int seconds)
+{
+    physics_check_run_t runs[PHYSICS_CHECK_RATES_COUNT];
+    physics_check_run_p ref = runs + PHYSICS_CHECK_REFERENCE_RATE;
+    int finished = 1;
+    int ret;
+
+    if(!level)
+    {
+        printf("physics check: -bench level is required\n");
+        return 0;
+    }
+
+    memset(runs, 0, sizeof(runs));
+    for(int r = 0; r < PHYSICS_CHECK_RATES_COUNT; ++r)
+    {
+        if(!Bench_PhysicsCheckRun(level, replay, physics_check_rates[r], seconds, runs + r))
+        {
+            printf("physics check: %d Hz run is not finished\n", physics_check_rates[r]);
+            finished = 0;
+        }
+    }
+
+    printf("\nphysics check: level = \"%s\", replay = \"%s\", seconds = %d, ragdolls = %d\n",
+           level, (replay) ? (replay) : (""), seconds, PHYSICS_CHECK_RAGDOLLS);
+    printf("%-8s %14s %14s %8s\n", "rate, Hz", "entities, max", "ragdolls, max", "result");
+    ret = finished;
+    for(int r = 0; finished && (r < PHYSICS_CHECK_RATES_COUNT); ++r)
+    {
+        physics_check_run_p run = runs + r;
+        int ok = !run->changed && !ref->changed &&
+                 (run->entities_used == ref->entities_used) && (run->bodies_used == ref->bodies_used);
+        float de = 0.0f, db = 0.0f;
+        if(ok)
+        {
+            de = Bench_MaxCheckDistance(run->entities, ref->entities, run->entities_used);
+            db = Bench_MaxCheckDistance(run->bodies, ref->bodies, run->bodies_used);
+            ok = (de <= PHYSICS_CHECK_ENTITY_TOLERANCE) && (db <= PHYSICS_CHECK_RAGDOLL_TOLERANCE);
+        }
+        printf("%-8d %14.3f %14.3f %8s\n", physics_check_rates[r], de, db, (ok) ? ("ok") : ("FAILED"));
+        ret = ret && ok;
+    }
+    fflush(stdout);
+
+    for(int r = 0; r < PHYSICS_CHECK_RATES_COUNT; ++r)
+    {
+        free(runs[r].entities);
+        free(runs[r].bodies);
+    }
+    return ret;
+}
+
+enum bench_probes_mode_e
+{
+    BENCH_PROBES_RAYS = 0,
+    BENCH_PROBES_SINGLE,
+    BENCH_PROBES_BATCHED,
+    BENCH_PROBES_CACHED,
+    BENCH_PROBES_LASTINDEX
+};
+
+static const char *bench_probes_mode_names[BENCH_PROBES_LASTINDEX] =
+{
+    "rays", "single", "batched", "cached"
+};
+
+/*
+ * Plays recorded probes back frame by frame: two filtered ray tests per
+ * probe, probes one by one, all probes of a frame in one batch, or probes one
+ * by one with the cache (as Character_GetHeightInfo() does).
+ */
+static void Bench_ReplayProbes(height_probe_p probes, const uint32_t *frames, uint32_t count, int mode)
+{
+    uint32_t first = 0;
+    while(first < count)
+    {
+        uint32_t last = first + 1;
+        for(; (last < count) && (frames[last] == frames[first]); ++last);
+
+        Physics_ResetCollisionPool();
+        if(mode == BENCH_PROBES_BATCHED)
+        {
+            Physics_HeightProbes(probes + first, last - first);
+        }
+        else
+        {
+            for(height_probe_p p = probes + first; p < probes + last; ++p)
+            {
+                if(mode == BENCH_PROBES_RAYS)
+                {
+                    float to[3];
+                    vec3_copy(to, p->pos);
+                    to[2] -= p->depth;
+                    Physics_RayTestFiltered(&p->floor_hit, p->pos, to, p->cont, p->filter);
+                    to[2] = p->pos[2] + p->height;
+                    Physics_RayTestFiltered(&p->ceiling_hit, p->pos, to, p->cont, p->filter);
+                }
+                else
+                {
+                    Physics_HeightProbes(p, 1);
+                }
+            }
+        }
+        first = last;
+    }
+}
+
+/*
+ * Player probes recorder, set as the physics height probes hook.
+ */
+static struct engine_container_s *bench_probes_cont = NULL;
+static height_probe_p   bench_probes_record = NULL;
+static uint32_t        *bench_probes_frames = NULL;
+static uint32_t         bench_probes_count = 0;
+static uint32_t         bench_probes_size = 0;
+
+static void Bench_RecordProbes(struct height_probe_s *probes, uint32_t count, uint32_t frame)
+{
+    for(height_probe_p p = probes; p < probes + count; ++p)
+    {
+        if(p->cont == bench_probes_cont)
+        {
+            if(bench_probes_count >= bench_probes_size)
+            {
+                bench_probes_size = (bench_probes_size) ? (bench_probes_size * 2) : (1024);
+                bench_probes_record = (height_probe_p)realloc(bench_probes_record, bench_probes_size * sizeof(height_probe_t));
+                bench_probes_frames = (uint32_t*)realloc(bench_probes_frames, bench_probes_size * sizeof(uint32_t));
+            }
+            bench_probes_record[bench_probes_count] = *p;
+            bench_probes_frames[bench_probes_count++] = frame;
+        }
+    }
+}
+
+static int Bench_IsSameHit(struct collision_result_s *a, struct collision_result_s *b)
+{
+    return (a->hit == b->hit) && (!a->hit || ((a->obj == b->obj) && (a->fraction == b->fraction)));
+}
+
+/*
+ * Calls level benchmark for -bench level, or for every level found in the
+ * "tests" folder.
+ */
+static void Bench_ForEachLevel(const char *level, void (*bench)(const char *name, int param), int param)
+{
+    if(level)
+    {
+        bench(level, param);
+        return;
+    }
+
+    char tests_path[MAX_ENGINE_PATH];
+    const char *base_path = Engine_GetBasePath();
+    size_t base_len = strlen(base_path);
+    snprintf(tests_path, sizeof(tests_path), "%stests", base_path);
+    file_info_p dirs = Sys_ListDir(tests_path, NULL);
+    for(file_info_p d = dirs; d; d = d->next)
+    {
+        file_info_p files = (d->is_dir) ? (Sys_ListDir(d->full_name, NULL)) : (NULL);
+        for(file_info_p f = files; f; f = f->next)
+        {
+            if(!f->is_dir && (VT_Level::get_PC_level_version(f->full_name) != TR_UNKNOWN))
+            {
+                bench(f->full_name + base_len, param);
+            }
+        }
+        Sys_ListDirFree(files);
+    }
+    Sys_ListDirFree(dirs);
+}
+
+/*
+ * Loads -bench level, or every level found in the "tests" folder, several
+ * times and prints per stage World_Open() timings and heap peaks.
+ */
+void Engine_LoadBenchmark(const char *level, int loads)
+{
+    World_SetLoadHeapSampling(1);
+    Bench_ForEachLevel(level, Bench_LoadLevel, loads);
+    World_SetLoadHeapSampling(0);
+}
+
+void Engine_DrawBenchmark(const char *level, int views)
+{
+    Bench_ForEachLevel(level, Bench_DrawLevel, views);
+}
+
+void Engine_RagdollBenchmark(const char *level, int count)
+{
+    Bench_ForEachLevel(level, Bench_RagdollsLevel, count);
+}
+
+/*
+ * Records the player height probes of the headless run (-bench level, input
+ * from -replay file if set), then plays the stream back in every probe mode
+ * and prints timings and results which differ from the plain ray tests.
+ */
+void Engine_ProbeBenchmark(const char *level, int passes)
+{
+    entity_p player = World_GetPlayer();
+    height_probe_p recorded, probes, reference;
+    uint32_t *frames;
+    uint32_t count;
+
+    if(!player)
+    {
+        printf("probe benchmark: no player, -bench level is required\n");
+        return;
+    }
+
+    bench_probes_cont = player->self;
+    bench_probes_count = 0;
+    Physics_SetHeightProbesHook(Bench_RecordProbes);
+    Engine_HeadlessLoop();
+    Physics_SetHeightProbesHook(NULL);
+    recorded = bench_probes_record;
+    frames = bench_probes_frames;
+    count = bench_probes_count;
+    if(count == 0)
+    {
+        printf("probe benchmark: no probes recorded\n");
+        return;
+    }
+
+    probes = (height_probe_p)malloc(count * sizeof(height_probe_t));
+    reference = (height_probe_p)malloc(count * sizeof(height_probe_t));
+    printf("\nprobe benchmark: level = \"%s\", probes = %u, frames = %u, passes = %d\n",
+           (level) ? (level) : (""), count, frames[count - 1] - frames[0] + 1, passes);
+    printf("%-8s %9s %9s %9s %9s %9s %9s\n", "mode", "total, ms", "ns/probe", "hits", "bp tests", "ray tests", "diffs");
+    for(int mode = 0; mode < BENCH_PROBES_LASTINDEX; ++mode)
+    {
+        height_probe_stats_t stats;
+        uint32_t diffs = 0;
+        int64_t t = 0;
+
+        Physics_SetHeightProbesCache(mode == BENCH_PROBES_CACHED);
+        Physics_ResetHeightProbeStats();
+        for(int pass = 0; pass < passes; ++pass)
+        {
+            int64_t t0;
+            memcpy(probes, recorded, count * sizeof(height_probe_t));
+            t0 = Sys_MicroSecTime(0);
+            Bench_ReplayProbes(probes, frames, count, mode);
+            t += Sys_MicroSecTime(0) - t0;
+        }
+        Physics_GetHeightProbeStats(&stats);
+
+        if(mode == BENCH_PROBES_RAYS)
+        {
+            memcpy(reference, probes, count * sizeof(height_probe_t));
+        }
+        for(uint32_t i = 0; i < count; ++i)
+        {
+            if(!Bench_IsSameHit(&probes[i].floor_hit, &reference[i].floor_hit) ||
+               !Bench_IsSameHit(&probes[i].ceiling_hit, &reference[i].ceiling_hit))
+            {
+                diffs++;
+            }
+        }
+        printf("%-8s %9.3f %9.1f %9u %9u %9u %9u\n", bench_probes_mode_names[mode], t / 1000.0f,
+               1000.0f * t / ((float)count * passes), stats.cache_hits / passes, stats.broadphase_tests / passes,
+               stats.ray_tests / passes, diffs);
+    }
+    fflush(stdout);
+
+    Physics_SetHeightProbesCache(1);
+    free(reference);
+    free(probes);
+    free(bench_probes_record);
+    free(bench_probes_frames);
+    bench_probes_record = NULL;
+    bench_probes_frames = NULL;
+    bench_probes_count = 0;
+    bench_probes_size = 0;
+}
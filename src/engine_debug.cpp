@@ -510,6 +510,21 @@ void ShowDebugInfo()
             {
                 GLText_OutTextXY(30.0f, y += dy, "input polygons = %07d", renderer.dynamicBSP->GetInputPolygonsCount());
                 GLText_OutTextXY(30.0f, y += dy, "added polygons = %07d", renderer.dynamicBSP->GetAddedPolygonsCount());
+                GLText_OutTextXY(30.0f, y += dy, "splits = %07d", renderer.dynamicBSP->GetSplitsCount());
+                GLText_OutTextXY(30.0f, y += dy, "nodes = %07d", renderer.dynamicBSP->GetNodesCount());
+                GLText_OutTextXY(30.0f, y += dy, "bytes used = %07d / %07d", renderer.dynamicBSP->GetUsedBytes(), renderer.dynamicBSP->GetAllocatedBytes());
+            }
+            break;
+
+        case debug_view_state_e::collision_info:
+            {
+                collision_pool_stats_t stats;
+                Physics_GetCollisionPoolStats(&stats);
+                GLText_OutTextXY(30.0f, y += dy, "VIEW: Ghost collision queries (last frame)");
+                GLText_OutTextXY(30.0f, y += dy, "queries = %07d", stats.queries);
+                GLText_OutTextXY(30.0f, y += dy, "cache hits = %07d, dispatch skips = %07d", stats.cache_hits, stats.dispatch_skips);
+                GLText_OutTextXY(30.0f, y += dy, "nodes used = %07d / %07d", stats.nodes_used, stats.nodes_allocated);
+                GLText_OutTextXY(30.0f, y += dy, "heap allocations = %07d", stats.heap_allocations);
             }
             break;
 
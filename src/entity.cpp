@@ -10,6 +10,7 @@ extern "C" {
 #include "core/console.h"
 #include "core/vmath.h"
 #include "core/obb.h"
+#include "core/profiler.h"
 #include "render/camera.h"
 #include "render/render.h"
 #include "script/script.h"
@@ -267,6 +268,28 @@ void Entity_UpdateTransform(entity_p entity)
 }
 
 
+/*
+ * Model matrix for drawing. Dynamic entities are moved by the interpolation
+ * offset of their root body (see Physics_GetBodyRenderTransform); the
+ * simulated ent->transform and bone transforms are not changed.
+ */
+void Entity_GetRenderTransform(struct entity_s *ent, float tr[16])
+{
+    if((ent->type_flags & ENTITY_TYPE_DYNAMIC) && ent->physics)
+    {
+        float simulated[16], interpolated[16], local[16];
+        Physics_GetBodyWorldTransform(ent->physics, simulated, 0);
+        Physics_GetBodyRenderTransform(ent->physics, interpolated, 0);
+        Mat4_inv_Mat4_affine_mul(local, simulated, ent->transform.M4x4);
+        Mat4_Mat4_mul(tr, interpolated, local);
+    }
+    else
+    {
+        Mat4_Copy(tr, ent->transform.M4x4);
+    }
+}
+
+
 void Entity_UpdateRigidBody(struct entity_s *ent, int force)
 {
     if(ent->type_flags & ENTITY_TYPE_DYNAMIC)
@@ -1153,6 +1176,7 @@ void Entity_MoveToSink(entity_p entity, struct static_camera_sink_s *sink)
 
 void Entity_Frame(entity_p entity, float time)
 {
+    PROF_ZONE("Entity_Frame");
     if(entity && !(entity->type_flags & ENTITY_TYPE_DYNAMIC) && (entity->state_flags & ENTITY_STATE_ACTIVE)  && (entity->state_flags & ENTITY_STATE_ENABLED))
     {
         ss_animation_p ss_anim = &entity->bf->animations;
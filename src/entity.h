@@ -193,6 +193,7 @@ int  Entity_Deactivate(struct entity_s *entity_object, struct entity_s *entity_a
 
 int  Entity_GetSubstanceState(entity_p entity);
 
+void Entity_GetRenderTransform(struct entity_s *ent, float tr[16]);
 void Entity_UpdateRigidBody(struct entity_s *ent, int force);
 void Entity_GhostUpdate(struct entity_s *ent);
 
@@ -13,6 +13,7 @@ extern "C" {
 #include "core/vmath.h"
 #include "core/polygon.h"
 #include "core/obb.h"
+#include "core/profiler.h"
 #include "render/camera.h"
 #include "render/frustum.h"
 #include "render/render.h"
@@ -35,6 +36,7 @@ extern "C" {
 #include "mesh.h"
 
 extern lua_State *engine_lua;
+game_frame_timing_t game_frame_timing = {0};
 
 int Game_ProcessMenu(entity_p player);
 int Save_Entity(entity_p ent, void *data);
@@ -631,6 +633,14 @@ int Game_ProcessMenu(entity_p player)
 void Game_Frame(float time)
 {
     entity_p player = World_GetPlayer();
+    int64_t frame_start = Sys_MicroSecTime(0);
+    int64_t t;
+    PROF_ZONE("Game_Frame");
+
+    game_frame_timing.total = 0;
+    game_frame_timing.entities = 0;
+    game_frame_timing.physics = 0;
+    Physics_ResetCollisionPool();
 
     if(Game_ProcessMenu(player))
     {
@@ -761,9 +771,19 @@ void Game_Frame(float time)
         }
     }
 
-    World_IterateAllEntities(Game_UpdateEntity, NULL);
+    t = Sys_MicroSecTime(0);
+    {
+        PROF_ZONE("World_IterateAllEntities");
+        World_IterateAllEntities(Game_UpdateEntity, NULL);
+    }
+    game_frame_timing.entities = Sys_MicroSecTime(0) - t;
+
+    t = Sys_MicroSecTime(0);
     Physics_StepSimulation(time);
+    game_frame_timing.physics = Sys_MicroSecTime(0) - t;
+
     renderer.UpdateAnimTextures();
+    game_frame_timing.total = Sys_MicroSecTime(0) - frame_start;
 }
 
 
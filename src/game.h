@@ -13,6 +13,16 @@
 struct camera_s;
 struct entity_s;
 
+// Time spent in the last Game_Frame() call, in microseconds.
+typedef struct game_frame_timing_s
+{
+    int64_t     total;
+    int64_t     entities;
+    int64_t     physics;
+}game_frame_timing_t, *game_frame_timing_p;
+
+extern struct game_frame_timing_s game_frame_timing;
+
 void Game_InitGlobals();
 void Game_RegisterLuaFunctions(struct lua_State *lua);
 int Game_Load(const char* name);
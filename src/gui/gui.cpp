@@ -462,6 +462,11 @@ void Gui_DrawBars()
 
 void Gui_DrawLoadScreen(int value)
 {
+    if(!renderer.shaderManager)
+    {
+        return;     // headless run, no shaders to draw with
+    }
+
     qglClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     qglPushAttrib(GL_ENABLE_BIT | GL_PIXEL_MODE_BIT | GL_COLOR_BUFFER_BIT);
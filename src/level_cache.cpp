@@ -0,0 +1,721 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <zlib.h>
+
+#include "core/system.h"
+#include "core/gl_util.h"
+#include "core/polygon.h"
+#include "mesh.h"
+#include "room.h"
+#include "trigger.h"
+#include "level_cache.h"
+
+
+#define LEVEL_CACHE_MAGIC           (0x43544C4F)                                // "OLTC"
+#define LEVEL_CACHE_PATH_MAX        (1024)
+#define LEVEL_CACHE_NONE_INDEX      (0xFFFFFFFF)
+
+enum level_cache_record_e
+{
+    LEVEL_CACHE_RECORD_MESH = 1,
+    LEVEL_CACHE_RECORD_ROOM_MESH,
+    LEVEL_CACHE_RECORD_ROOM_SECTORS
+};
+
+enum level_cache_state_e
+{
+    LEVEL_CACHE_NONE = 0,
+    LEVEL_CACHE_LOAD,                                                           // records are taken from the file
+    LEVEL_CACHE_SAVE,                                                           // records are collected to be written
+    LEVEL_CACHE_BROKEN                                                          // nothing is used or written
+};
+
+enum polygon_list_e
+{
+    POLYGON_LIST_NONE = 0,
+    POLYGON_LIST_TRANSPARENCY,
+    POLYGON_LIST_ANIMATED
+};
+
+typedef struct level_cache_header_s
+{
+    uint32_t    magic;
+    uint32_t    version;
+    uint32_t    layout;                                                         // sizes of stored structures
+    uint32_t    level_size;
+    uint32_t    level_crc;
+    int32_t     game_version;
+    int32_t     texture_border;
+    uint32_t    atlas_page_width;                                               // texture coordinates depend on it
+    uint32_t    atlas_pages_count;
+    uint32_t    data_size;
+    uint32_t    data_crc;
+}level_cache_header_t, *level_cache_header_p;
+
+static struct
+{
+    int                     state;
+    char                    path[LEVEL_CACHE_PATH_MAX];
+    level_cache_header_t    header;
+    const uint32_t         *pages;                                              // atlas pages GL names of the current load
+    uint32_t                pages_count;
+    uint8_t                *data;
+    size_t                  size;
+    size_t                  pos;
+    size_t                  capacity;
+} level_cache = {0};
+
+
+static uint32_t LevelCache_Layout()
+{
+    return (uint32_t)(sizeof(vertex_t) | (sizeof(GLuint) << 16));
+}
+
+
+static int LevelCache_HashLevel(const char *level_path, uint32_t *size, uint32_t *crc)
+{
+    FILE *f = fopen(level_path, "rb");
+    if(f)
+    {
+        uint8_t *buf = (uint8_t*)malloc(65536);
+        uLong c = crc32(0L, Z_NULL, 0);
+        size_t total = 0;
+        size_t n;
+        while((n = fread(buf, 1, 65536, f)) > 0)
+        {
+            c = crc32(c, buf, (uInt)n);
+            total += n;
+        }
+        free(buf);
+        fclose(f);
+        *size = (uint32_t)total;
+        *crc = (uint32_t)c;
+        return 1;
+    }
+    return 0;
+}
+
+
+static void LevelCache_Put(const void *src, size_t size)
+{
+    if(level_cache.state == LEVEL_CACHE_SAVE)
+    {
+        if(level_cache.size + size > level_cache.capacity)
+        {
+            size_t capacity = (level_cache.capacity) ? (level_cache.capacity) : (1024 * 1024);
+            while(level_cache.size + size > capacity)
+            {
+                capacity *= 2;
+            }
+            level_cache.data = (uint8_t*)realloc(level_cache.data, capacity);
+            level_cache.capacity = capacity;
+        }
+        memcpy(level_cache.data + level_cache.size, src, size);
+        level_cache.size += size;
+    }
+}
+
+
+static void LevelCache_PutU32(uint32_t value)
+{
+    LevelCache_Put(&value, sizeof(value));
+}
+
+
+static int LevelCache_Get(void *dst, size_t size)
+{
+    if((level_cache.state == LEVEL_CACHE_LOAD) && (level_cache.size - level_cache.pos >= size))
+    {
+        memcpy(dst, level_cache.data + level_cache.pos, size);
+        level_cache.pos += size;
+        return 1;
+    }
+    return 0;
+}
+
+
+static uint32_t LevelCache_GetU32()
+{
+    uint32_t value = 0;
+    LevelCache_Get(&value, sizeof(value));
+    return value;
+}
+
+/*
+ * Reads array length and checks that the array of such elements fits the rest
+ * of data, so broken counts never reach allocations.
+ */
+static int LevelCache_GetCount(uint32_t *count, size_t element_size)
+{
+    return LevelCache_Get(count, sizeof(*count)) &&
+           ((uint64_t)(*count) * element_size <= (uint64_t)(level_cache.size - level_cache.pos));
+}
+
+/*
+ * Stops using the cache on records mismatch; generation goes on as usual,
+ * the file is rebuilt on the next level load.
+ */
+static void LevelCache_Drop(const char *reason)
+{
+    Sys_DebugLog(SYS_LOG_FILENAME, "level cache \"%s\" is dropped: %s", level_cache.path, reason);
+    free(level_cache.data);
+    level_cache.data = NULL;
+    level_cache.size = 0;
+    level_cache.pos = 0;
+    level_cache.capacity = 0;
+    level_cache.state = LEVEL_CACHE_BROKEN;
+    remove(level_cache.path);
+}
+
+
+static int LevelCache_BeginRecord(uint32_t type, uint32_t id)
+{
+    if(level_cache.state == LEVEL_CACHE_LOAD)
+    {
+        if((LevelCache_GetU32() == type) && (LevelCache_GetU32() == id))
+        {
+            return 1;
+        }
+        LevelCache_Drop("unexpected record");
+    }
+    return 0;
+}
+
+
+void LevelCache_Open(const char *level_path, int game_version, int texture_border)
+{
+    level_cache_header_p h = &level_cache.header;
+    FILE *f;
+
+    LevelCache_Close();
+    if(strlen(level_path) + sizeof(LEVEL_CACHE_FILE_EXT) > LEVEL_CACHE_PATH_MAX)
+    {
+        return;
+    }
+    strcpy(level_cache.path, level_path);
+    strcat(level_cache.path, LEVEL_CACHE_FILE_EXT);
+
+    h->magic = LEVEL_CACHE_MAGIC;
+    h->version = LEVEL_CACHE_VERSION;
+    h->layout = LevelCache_Layout();
+    h->game_version = game_version;
+    h->texture_border = texture_border;
+    h->atlas_page_width = 0;
+    h->atlas_pages_count = 0;
+    h->data_size = 0;
+    h->data_crc = 0;
+    if(!LevelCache_HashLevel(level_path, &h->level_size, &h->level_crc))
+    {
+        return;
+    }
+
+    level_cache.state = LEVEL_CACHE_SAVE;
+    f = fopen(level_cache.path, "rb");
+    if(f)
+    {
+        level_cache_header_t fh;
+        if((fread(&fh, sizeof(fh), 1, f) == 1) && (fh.magic == h->magic) && (fh.version == h->version) &&
+           (fh.layout == h->layout) && (fh.level_size == h->level_size) && (fh.level_crc == h->level_crc) &&
+           (fh.game_version == h->game_version) && (fh.texture_border == h->texture_border))
+        {
+            h->atlas_page_width = fh.atlas_page_width;                          // checked by LevelCache_SetAtlas()
+            h->atlas_pages_count = fh.atlas_pages_count;
+            level_cache.data = (uint8_t*)malloc(fh.data_size);
+            if(level_cache.data && (fread(level_cache.data, 1, fh.data_size, f) == fh.data_size) &&
+               ((uint32_t)crc32(crc32(0L, Z_NULL, 0), level_cache.data, fh.data_size) == fh.data_crc))
+            {
+                level_cache.size = fh.data_size;
+                level_cache.capacity = fh.data_size;
+                level_cache.pos = 0;
+                level_cache.state = LEVEL_CACHE_LOAD;
+            }
+            else
+            {
+                free(level_cache.data);
+                level_cache.data = NULL;
+            }
+        }
+        fclose(f);
+    }
+}
+
+/*
+ * Writes collected records, if the cache was built during this load.
+ */
+void LevelCache_Close()
+{
+    if((level_cache.state == LEVEL_CACHE_SAVE) && (level_cache.size > 0))
+    {
+        char tmp_path[LEVEL_CACHE_PATH_MAX + 4];
+        FILE *f;
+
+        level_cache.header.data_size = (uint32_t)level_cache.size;
+        level_cache.header.data_crc = (uint32_t)crc32(crc32(0L, Z_NULL, 0), level_cache.data, (uInt)level_cache.size);
+        snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", level_cache.path);
+        f = fopen(tmp_path, "wb");
+        if(f)
+        {
+            int ok = (fwrite(&level_cache.header, sizeof(level_cache_header_t), 1, f) == 1) &&
+                     (fwrite(level_cache.data, 1, level_cache.size, f) == level_cache.size);
+            ok = (fclose(f) == 0) && ok;
+            remove(level_cache.path);
+            if(!ok || (rename(tmp_path, level_cache.path) != 0))
+            {
+                remove(tmp_path);
+                Sys_DebugLog(SYS_LOG_FILENAME, "level cache \"%s\" can not be written", level_cache.path);
+            }
+        }
+        else
+        {
+            Sys_DebugLog(SYS_LOG_FILENAME, "level cache \"%s\" can not be created", level_cache.path);
+        }
+    }
+
+    free(level_cache.data);
+    level_cache.data = NULL;
+    level_cache.size = 0;
+    level_cache.pos = 0;
+    level_cache.capacity = 0;
+    level_cache.pages = NULL;
+    level_cache.pages_count = 0;
+    level_cache.state = LEVEL_CACHE_NONE;
+}
+
+
+int LevelCache_IsLoaded()
+{
+    return level_cache.state == LEVEL_CACHE_LOAD;
+}
+
+/*
+ * Atlas layout is known only after textures generation: cached texture
+ * coordinates are valid for the same page width and pages count only, so
+ * other layout (e.g. smaller GL_MAX_TEXTURE_SIZE) makes the cache rebuilt.
+ * Polygons and faces store page indexes, mapped to GL names of these pages.
+ */
+void LevelCache_SetAtlas(const uint32_t *pages, uint32_t pages_count, uint32_t page_width)
+{
+    level_cache_header_p h = &level_cache.header;
+
+    level_cache.pages = pages;
+    level_cache.pages_count = pages_count;
+    if((level_cache.state == LEVEL_CACHE_LOAD) &&
+       ((h->atlas_page_width != page_width) || (h->atlas_pages_count != pages_count)))
+    {
+        Sys_DebugLog(SYS_LOG_FILENAME, "level cache \"%s\" is rebuilt: atlas layout %ux%u differs from %ux%u",
+                     level_cache.path, page_width, pages_count, h->atlas_page_width, h->atlas_pages_count);
+        free(level_cache.data);
+        level_cache.data = NULL;
+        level_cache.size = 0;
+        level_cache.pos = 0;
+        level_cache.capacity = 0;
+        level_cache.state = LEVEL_CACHE_SAVE;
+    }
+    h->atlas_page_width = page_width;
+    h->atlas_pages_count = pages_count;
+}
+
+
+static void LevelCache_PutTexture(GLuint texture)
+{
+    uint32_t page = LEVEL_CACHE_NONE_INDEX;
+    for(uint32_t i = 0; i < level_cache.pages_count; ++i)
+    {
+        if(level_cache.pages[i] == texture)
+        {
+            page = i;
+            break;
+        }
+    }
+    LevelCache_PutU32(page);
+}
+
+
+static int LevelCache_GetTexture(GLuint *texture)
+{
+    uint32_t page = LEVEL_CACHE_NONE_INDEX;
+    if(LevelCache_Get(&page, sizeof(page)) && ((page == LEVEL_CACHE_NONE_INDEX) || (page < level_cache.pages_count)))
+    {
+        *texture = (page == LEVEL_CACHE_NONE_INDEX) ? (0) : (level_cache.pages[page]);
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * MESHES: polygons, welded vertices and faces are stored as generated by
+ * TR_Gen*Mesh() + BaseMesh_GenFaces(); animated faces and VBOs are rebuilt.
+ */
+static void LevelCache_PutMesh(struct base_mesh_s *mesh)
+{
+    polygon_p p = mesh->polygons;
+    uint8_t *lists = (uint8_t*)calloc(mesh->polygons_count + 1, sizeof(uint8_t));
+
+    LevelCache_Put(mesh->centre, sizeof(mesh->centre));
+    LevelCache_Put(mesh->bb_min, sizeof(mesh->bb_min));
+    LevelCache_Put(mesh->bb_max, sizeof(mesh->bb_max));
+    LevelCache_Put(&mesh->radius, sizeof(mesh->radius));
+
+    for(polygon_p lp = mesh->transparency_polygons; lp; lp = lp->next)
+    {
+        lists[lp - mesh->polygons] = POLYGON_LIST_TRANSPARENCY;
+    }
+    for(polygon_p lp = mesh->animated_polygons; lp; lp = lp->next)
+    {
+        lists[lp - mesh->polygons] = POLYGON_LIST_ANIMATED;
+    }
+
+    LevelCache_PutU32(mesh->polygons_count);
+    for(uint32_t i = 0; i < mesh->polygons_count; i++, p++)
+    {
+        uint16_t flags[5] = {p->vertex_count, p->anim_id, p->frame_offset, (uint16_t)(p->transparency | (p->double_side << 8)), lists[i]};
+        LevelCache_Put(flags, sizeof(flags));
+        LevelCache_PutTexture(p->texture_index);
+        LevelCache_Put(p->plane, sizeof(p->plane));
+        LevelCache_Put(p->vertices, p->vertex_count * sizeof(vertex_t));
+    }
+    free(lists);
+
+    LevelCache_PutU32(mesh->vertex_count);
+    LevelCache_Put(mesh->vertices, mesh->vertex_count * sizeof(vertex_t));
+
+    LevelCache_PutU32(mesh->faces_count);
+    for(uint32_t i = 0; i < mesh->faces_count; i++)
+    {
+        LevelCache_PutTexture(mesh->faces[i].texture_index);
+        LevelCache_PutU32(mesh->faces[i].elements_count);
+        LevelCache_Put(mesh->faces[i].elements, mesh->faces[i].elements_count * sizeof(GLuint));
+    }
+}
+
+
+static int LevelCache_GetMesh(struct base_mesh_s *mesh)
+{
+    polygon_p p;
+    uint32_t count = 0;
+    int ret = 1;
+
+    ret = ret && LevelCache_Get(mesh->centre, sizeof(mesh->centre));
+    ret = ret && LevelCache_Get(mesh->bb_min, sizeof(mesh->bb_min));
+    ret = ret && LevelCache_Get(mesh->bb_max, sizeof(mesh->bb_max));
+    ret = ret && LevelCache_Get(&mesh->radius, sizeof(mesh->radius));
+    ret = ret && LevelCache_GetCount(&count, sizeof(uint16_t[5]));
+
+    mesh->polygons_count = (ret) ? (count) : (0);
+    p = mesh->polygons = Polygon_CreateArray(mesh->polygons_count);
+    mesh->transparency_polygons = NULL;
+    mesh->animated_polygons = NULL;
+    for(uint32_t i = 0; ret && (i < mesh->polygons_count); i++, p++)
+    {
+        uint16_t flags[5];
+        ret = ret && LevelCache_Get(flags, sizeof(flags));
+        ret = ret && LevelCache_GetTexture(&p->texture_index);
+        ret = ret && LevelCache_Get(p->plane, sizeof(p->plane));
+        if(!ret)
+        {
+            break;
+        }
+        Polygon_Resize(p, flags[0]);
+        ret = LevelCache_Get(p->vertices, p->vertex_count * sizeof(vertex_t));
+        p->anim_id = flags[1];
+        p->frame_offset = flags[2];
+        p->transparency = flags[3] & 0xFF;
+        p->double_side = flags[3] >> 8;
+        // same order as BaseMesh_GenFaces() makes: every polygon goes to the list head
+        if(flags[4] == POLYGON_LIST_TRANSPARENCY)
+        {
+            p->next = mesh->transparency_polygons;
+            mesh->transparency_polygons = p;
+        }
+        else if(flags[4] == POLYGON_LIST_ANIMATED)
+        {
+            p->next = mesh->animated_polygons;
+            mesh->animated_polygons = p;
+        }
+    }
+
+    ret = ret && LevelCache_GetCount(&count, sizeof(vertex_t));
+    mesh->vertex_count = (ret) ? (count) : (0);
+    mesh->vertices = (vertex_p)malloc(mesh->vertex_count * sizeof(vertex_t));
+    ret = ret && LevelCache_Get(mesh->vertices, mesh->vertex_count * sizeof(vertex_t));
+
+    ret = ret && LevelCache_GetCount(&count, sizeof(uint32_t) + sizeof(uint32_t));
+    mesh->faces_count = (ret) ? (count) : (0);
+    mesh->faces = (mesh_face_p)calloc(mesh->faces_count, sizeof(mesh_face_t));
+    for(uint32_t i = 0; ret && (i < mesh->faces_count); i++)
+    {
+        ret = ret && LevelCache_GetTexture(&mesh->faces[i].texture_index);
+        ret = ret && LevelCache_GetCount(&count, sizeof(GLuint));
+        if(ret)
+        {
+            mesh->faces[i].elements_count = count;
+            mesh->faces[i].elements = (GLuint*)malloc(count * sizeof(GLuint));
+            ret = LevelCache_Get(mesh->faces[i].elements, count * sizeof(GLuint));
+        }
+    }
+
+    if(!ret)
+    {
+        BaseMesh_Clear(mesh);
+        LevelCache_Drop("unexpected end of data");
+        return 0;
+    }
+
+    BaseMesh_GenAnimatedFaces(mesh);
+    BaseMesh_GenVBO(mesh);
+
+    return 1;
+}
+
+
+int LevelCache_LoadMesh(struct base_mesh_s *mesh, uint32_t id)
+{
+    if(LevelCache_BeginRecord(LEVEL_CACHE_RECORD_MESH, id))
+    {
+        mesh->id = id;
+        return LevelCache_GetMesh(mesh);
+    }
+    return 0;
+}
+
+
+void LevelCache_SaveMesh(struct base_mesh_s *mesh)
+{
+    if(level_cache.state == LEVEL_CACHE_SAVE)
+    {
+        LevelCache_PutU32(LEVEL_CACHE_RECORD_MESH);
+        LevelCache_PutU32(mesh->id);
+        LevelCache_PutMesh(mesh);
+    }
+}
+
+/*
+ * Room may have no mesh at all; it is stored as well.
+ */
+int LevelCache_LoadRoomMesh(struct base_mesh_s **mesh, uint32_t id)
+{
+    if(LevelCache_BeginRecord(LEVEL_CACHE_RECORD_ROOM_MESH, id))
+    {
+        *mesh = NULL;
+        if(LevelCache_GetU32())
+        {
+            *mesh = (base_mesh_p)calloc(1, sizeof(base_mesh_t));
+            (*mesh)->id = id;
+            if(!LevelCache_GetMesh(*mesh))
+            {
+                free(*mesh);
+                *mesh = NULL;
+                return 0;
+            }
+        }
+        return 1;
+    }
+    return 0;
+}
+
+
+void LevelCache_SaveRoomMesh(struct base_mesh_s *mesh, uint32_t id)
+{
+    if(level_cache.state == LEVEL_CACHE_SAVE)
+    {
+        LevelCache_PutU32(LEVEL_CACHE_RECORD_ROOM_MESH);
+        LevelCache_PutU32(id);
+        LevelCache_PutU32(mesh != NULL);
+        if(mesh)
+        {
+            LevelCache_PutMesh(mesh);
+        }
+    }
+}
+
+/*
+ * SECTORS: state after Res_Sector_TranslateFloorData() and
+ * Res_RoomSectorsCalculate() of the room. Fields set by World_GenRoom() are
+ * not stored; rooms are stored as indexes, triggers with their commands.
+ */
+static void LevelCache_PutRoomIndex(struct room_s *rooms, struct room_s *room)
+{
+    LevelCache_PutU32((room) ? ((uint32_t)(room - rooms)) : (LEVEL_CACHE_NONE_INDEX));
+}
+
+
+static int LevelCache_GetRoomIndex(struct room_s *rooms, uint32_t rooms_count, struct room_s **room)
+{
+    uint32_t index = LEVEL_CACHE_NONE_INDEX;
+    if(LevelCache_Get(&index, sizeof(index)) && ((index == LEVEL_CACHE_NONE_INDEX) || (index < rooms_count)))
+    {
+        *room = (index == LEVEL_CACHE_NONE_INDEX) ? (NULL) : (rooms + index);
+        return 1;
+    }
+    return 0;
+}
+
+
+static void LevelCache_FreeTrigger(struct trigger_header_s *trigger)
+{
+    if(trigger)
+    {
+        while(trigger->commands)
+        {
+            trigger_command_p next = trigger->commands->next;
+            free(trigger->commands);
+            trigger->commands = next;
+        }
+        free(trigger);
+    }
+}
+
+
+static void LevelCache_PutTrigger(struct trigger_header_s *trigger)
+{
+    LevelCache_PutU32(trigger != NULL);
+    if(trigger)
+    {
+        uint16_t header[5] = {trigger->function_value, trigger->sub_function, trigger->once, trigger->timer, trigger->mask};
+        uint32_t count = 0;
+        LevelCache_Put(header, sizeof(header));
+        for(trigger_command_p cmd = trigger->commands; cmd; cmd = cmd->next)
+        {
+            count++;
+        }
+        LevelCache_PutU32(count);
+        for(trigger_command_p cmd = trigger->commands; cmd; cmd = cmd->next)
+        {
+            uint16_t data[4] = {cmd->function, cmd->operands, (uint16_t)(cmd->camera.index | (cmd->camera.timer << 8)), (uint16_t)(cmd->camera.move | (cmd->once << 8))};
+            LevelCache_Put(data, sizeof(data));
+        }
+    }
+}
+
+
+static int LevelCache_GetTrigger(struct trigger_header_s **trigger)
+{
+    uint16_t header[5];
+    uint32_t present = 0;
+    uint32_t count = 0;
+    trigger_command_p *last;
+
+    *trigger = NULL;
+    if(!LevelCache_Get(&present, sizeof(present)))
+    {
+        return 0;
+    }
+    if(!present)
+    {
+        return 1;
+    }
+    if(!LevelCache_Get(header, sizeof(header)) || !LevelCache_GetCount(&count, sizeof(uint16_t[4])))
+    {
+        return 0;
+    }
+
+    *trigger = (trigger_header_p)malloc(sizeof(trigger_header_t));
+    (*trigger)->function_value = header[0];
+    (*trigger)->sub_function = header[1];
+    (*trigger)->once = header[2];
+    (*trigger)->timer = header[3];
+    (*trigger)->mask = header[4];
+    (*trigger)->commands = NULL;
+    last = &(*trigger)->commands;
+    for(uint32_t i = 0; i < count; ++i)
+    {
+        uint16_t data[4];
+        LevelCache_Get(data, sizeof(data));                                     // fits, see LevelCache_GetCount()
+        *last = (trigger_command_p)calloc(1, sizeof(trigger_command_t));
+        (*last)->function = data[0];
+        (*last)->operands = data[1];
+        (*last)->camera.index = data[2] & 0xFF;
+        (*last)->camera.timer = data[2] >> 8;
+        (*last)->camera.move = data[3] & 0xFF;
+        (*last)->once = data[3] >> 8;
+        last = &(*last)->next;
+    }
+    return 1;
+}
+
+/*
+ * Sectors are read into a copy, so a broken record leaves the room as
+ * World_GenRoom() made it and floordata is translated as usual.
+ */
+int LevelCache_LoadRoomSectors(struct room_s *rooms, uint32_t rooms_count, uint32_t room_index)
+{
+    room_p room = rooms + room_index;
+    room_sector_p sectors;
+    uint32_t count = 0;
+    int ret;
+
+    if(!LevelCache_BeginRecord(LEVEL_CACHE_RECORD_ROOM_SECTORS, room_index))
+    {
+        return 0;
+    }
+
+    ret = LevelCache_Get(&count, sizeof(count)) && (count == room->sectors_count);
+    sectors = (room_sector_p)malloc(room->sectors_count * sizeof(room_sector_t));
+    memcpy(sectors, room->content->sectors, room->sectors_count * sizeof(room_sector_t));
+    for(uint32_t i = 0; i < room->sectors_count; ++i)
+    {
+        room_sector_p rs = sectors + i;
+        uint8_t configs[4] = {0};
+        rs->trigger = NULL;
+        ret = ret && LevelCache_Get(&rs->flags, sizeof(rs->flags));
+        ret = ret && LevelCache_GetRoomIndex(rooms, rooms_count, &rs->portal_to_room);
+        ret = ret && LevelCache_GetRoomIndex(rooms, rooms_count, &rs->room_below);
+        ret = ret && LevelCache_GetRoomIndex(rooms, rooms_count, &rs->room_above);
+        ret = ret && LevelCache_Get(rs->floor_corners, sizeof(rs->floor_corners));
+        ret = ret && LevelCache_Get(rs->ceiling_corners, sizeof(rs->ceiling_corners));
+        ret = ret && LevelCache_Get(configs, sizeof(configs));
+        ret = ret && LevelCache_GetTrigger(&rs->trigger);
+        rs->floor_diagonal_type = configs[0];
+        rs->floor_penetration_config = configs[1];
+        rs->ceiling_diagonal_type = configs[2];
+        rs->ceiling_penetration_config = configs[3];
+    }
+
+    if(!ret)
+    {
+        for(uint32_t i = 0; i < room->sectors_count; ++i)
+        {
+            LevelCache_FreeTrigger(sectors[i].trigger);
+        }
+        free(sectors);
+        LevelCache_Drop("unexpected end of data");
+        return 0;
+    }
+
+    for(uint32_t i = 0; i < room->sectors_count; ++i)
+    {
+        LevelCache_FreeTrigger(room->content->sectors[i].trigger);
+    }
+    memcpy(room->content->sectors, sectors, room->sectors_count * sizeof(room_sector_t));
+    free(sectors);
+
+    return 1;
+}
+
+
+void LevelCache_SaveRoomSectors(struct room_s *rooms, uint32_t room_index)
+{
+    if(level_cache.state == LEVEL_CACHE_SAVE)
+    {
+        room_p room = rooms + room_index;
+        LevelCache_PutU32(LEVEL_CACHE_RECORD_ROOM_SECTORS);
+        LevelCache_PutU32(room_index);
+        LevelCache_PutU32(room->sectors_count);
+        for(uint32_t i = 0; i < room->sectors_count; ++i)
+        {
+            room_sector_p rs = room->content->sectors + i;
+            uint8_t configs[4] = {rs->floor_diagonal_type, rs->floor_penetration_config, rs->ceiling_diagonal_type, rs->ceiling_penetration_config};
+            LevelCache_Put(&rs->flags, sizeof(rs->flags));
+            LevelCache_PutRoomIndex(rooms, rs->portal_to_room);
+            LevelCache_PutRoomIndex(rooms, rs->room_below);
+            LevelCache_PutRoomIndex(rooms, rs->room_above);
+            LevelCache_Put(rs->floor_corners, sizeof(rs->floor_corners));
+            LevelCache_Put(rs->ceiling_corners, sizeof(rs->ceiling_corners));
+            LevelCache_Put(configs, sizeof(configs));
+            LevelCache_PutTrigger(rs->trigger);
+        }
+    }
+}
@@ -0,0 +1,37 @@
+
+#ifndef LEVEL_CACHE_H
+#define LEVEL_CACHE_H
+
+#include <stdint.h>
+
+/*
+ * Pre-baked level data cache. Products of level generation that depend only
+ * on the level file and a few settings (static and room meshes with their
+ * faces, translated room sectors) are stored in a file next to the level, so
+ * later loads of the same level skip their generation.
+ * Cache is keyed by level file size + CRC, game version, texture border,
+ * texture atlas layout and LEVEL_CACHE_VERSION, that must be increased with
+ * any change of generators.
+ *
+ * Records are read back in the order they were written; any mismatch drops
+ * the cache and the level is generated (and cached) as usual.
+ */
+#define LEVEL_CACHE_VERSION         (3)
+#define LEVEL_CACHE_FILE_EXT        ".otcache"
+
+struct base_mesh_s;
+struct room_s;
+
+void LevelCache_Open(const char *level_path, int game_version, int texture_border);
+void LevelCache_Close();
+int  LevelCache_IsLoaded();
+void LevelCache_SetAtlas(const uint32_t *pages, uint32_t pages_count, uint32_t page_width);
+
+int  LevelCache_LoadMesh(struct base_mesh_s *mesh, uint32_t id);
+void LevelCache_SaveMesh(struct base_mesh_s *mesh);
+int  LevelCache_LoadRoomMesh(struct base_mesh_s **mesh, uint32_t id);
+void LevelCache_SaveRoomMesh(struct base_mesh_s *mesh, uint32_t id);
+int  LevelCache_LoadRoomSectors(struct room_s *rooms, uint32_t rooms_count, uint32_t room_index);
+void LevelCache_SaveRoomSectors(struct room_s *rooms, uint32_t room_index);
+
+#endif
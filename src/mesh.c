@@ -7,12 +7,32 @@
 #include "mesh.h"
 
 
-void BaseMesh_GenVBO(struct base_mesh_s *mesh);
-void BaseMesh_AddPolygonToFaces(base_mesh_p mesh, struct polygon_s *p);
+/*
+ * Vertex weld table for BaseMesh_GenFaces() and BaseMesh_AddVertex(): open
+ * addressing hash of vertex indices keyed by position, texture coordinates
+ * and colour.
+ */
+typedef struct vertex_weld_s
+{
+    uint32_t   *slots;                                                          // vertex index + 1, 0 = empty slot
+    uint32_t    slots_mask;
+    uint32_t    vertex_capacity;
+}vertex_weld_t, *vertex_weld_p;
+
+void BaseMesh_AddPolygonToFaces(base_mesh_p mesh, vertex_weld_p weld, struct polygon_s *p);
 void BaseMesh_AddAnimatedPolygonToFaces(base_mesh_p mesh, uint32_t *vertex_index, struct polygon_s *p);
 
+static void BaseMesh_WeldDestroy(base_mesh_p mesh, vertex_weld_p weld);
+
 void BaseMesh_Clear(base_mesh_p mesh)
 {
+    if(mesh->vertex_weld)
+    {
+        BaseMesh_WeldDestroy(mesh, mesh->vertex_weld);
+        free(mesh->vertex_weld);
+        mesh->vertex_weld = NULL;
+    }
+
     if(qglIsBufferARB(mesh->vbo_vertex_array))
     {
         qglDeleteBuffersARB(1, &mesh->vbo_vertex_array);
@@ -169,10 +189,23 @@ void BaseMesh_GenVBO(struct base_mesh_s *mesh)
         qglBufferDataARB(GL_ARRAY_BUFFER, mesh->animated_vertex_count * sizeof(vertex_t), mesh->animated_vertices, GL_STATIC_DRAW);
         free(mesh->animated_vertices);
         mesh->animated_vertices = NULL;
-        // Prepare empty buffer for tex coords
+        // Animated texture frame (sequence, frame offset) of every vertex, in
+        // animated vertices order; vertex shaders look the frame up by it.
+        // Without lookup support renderer refills the buffer by tex coords.
+        GLfloat *frames = (GLfloat*)malloc(mesh->animated_vertex_count * sizeof(GLfloat [2]));
+        GLfloat *f = frames;
+        for(polygon_p p = mesh->animated_polygons; p != NULL; p = p->next)
+        {
+            for(uint16_t i = 0; i < p->vertex_count; i++, f += 2)
+            {
+                f[0] = (GLfloat)(p->anim_id - 1);
+                f[1] = (GLfloat)p->frame_offset;
+            }
+        }
         qglGenBuffersARB(1, &mesh->vbo_animated_texcoord_array);
         qglBindBufferARB(GL_ARRAY_BUFFER, mesh->vbo_animated_texcoord_array);
-        qglBufferDataARB(GL_ARRAY_BUFFER, mesh->animated_vertex_count * sizeof(GLfloat [2]), 0, GL_STREAM_DRAW);
+        qglBufferDataARB(GL_ARRAY_BUFFER, mesh->animated_vertex_count * sizeof(GLfloat [2]), frames, GL_STATIC_DRAW);
+        free(frames);
     }
     qglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
     qglBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
@@ -182,24 +215,140 @@ void BaseMesh_GenVBO(struct base_mesh_s *mesh)
 /*
  * FACES FUNCTIONS
  */
-uint32_t BaseMesh_AddVertex(base_mesh_p mesh, struct vertex_s *vertex)
+static inline int BaseMesh_IsVertexEqual(vertex_p v1, vertex_p v2)
+{
+    return v1->position[0] == v2->position[0] && v1->position[1] == v2->position[1] && v1->position[2] == v2->position[2] &&
+           v1->tex_coord[0] == v2->tex_coord[0] && v1->tex_coord[1] == v2->tex_coord[1] &&
+           v1->color[0] == v2->color[0] && v1->color[1] == v2->color[1] && v1->color[2] == v2->color[2] && v1->color[3] == v2->color[3];
+}
+
+
+static inline uint32_t BaseMesh_HashFloat(uint32_t h, float f)
+{
+    union
+    {
+        float       f;
+        uint32_t    u;
+    } key;
+
+    key.f = (f == 0.0f) ? (0.0f) : (f);                                         // -0.0 == 0.0, so must have the same hash
+    h ^= key.u;
+    h *= 0x01000193;
+    return h ^ (h >> 15);
+}
+
+
+static uint32_t BaseMesh_HashVertex(vertex_p v)
+{
+    uint32_t h = 0x811C9DC5;
+    h = BaseMesh_HashFloat(h, v->position[0]);
+    h = BaseMesh_HashFloat(h, v->position[1]);
+    h = BaseMesh_HashFloat(h, v->position[2]);
+    h = BaseMesh_HashFloat(h, v->tex_coord[0]);
+    h = BaseMesh_HashFloat(h, v->tex_coord[1]);
+    h = BaseMesh_HashFloat(h, v->color[0]);
+    h = BaseMesh_HashFloat(h, v->color[1]);
+    h = BaseMesh_HashFloat(h, v->color[2]);
+    h = BaseMesh_HashFloat(h, v->color[3]);
+    return h;
+}
+
+/*
+ * Table holds up to max_vertices vertices at load factor <= 0.5; vertices
+ * array is reserved for the same count, so no reallocs happen while welding.
+ * Vertices already stored in mesh are inserted first, lookups return the
+ * lowest equal index, so results are the same as with linear search.
+ */
+static void BaseMesh_WeldInit(base_mesh_p mesh, vertex_weld_p weld, uint32_t max_vertices)
+{
+    uint32_t slots_count = 16;
+
+    while(slots_count < 2 * max_vertices)
+    {
+        slots_count <<= 1;
+    }
+    weld->slots = (uint32_t*)calloc(slots_count, sizeof(uint32_t));
+    weld->slots_mask = slots_count - 1;
+    weld->vertex_capacity = max_vertices;
+    if(max_vertices > mesh->vertex_count)
+    {
+        mesh->vertices = (vertex_p)realloc(mesh->vertices, max_vertices * sizeof(vertex_t));
+    }
+
+    for(uint32_t i = 0; i < mesh->vertex_count; i++)
+    {
+        vertex_p v = mesh->vertices + i;
+        uint32_t slot = BaseMesh_HashVertex(v) & weld->slots_mask;
+        for(; weld->slots[slot]; slot = (slot + 1) & weld->slots_mask)
+        {
+            if(BaseMesh_IsVertexEqual(mesh->vertices + weld->slots[slot] - 1, v))
+            {
+                break;
+            }
+        }
+        if(!weld->slots[slot])
+        {
+            weld->slots[slot] = i + 1;
+        }
+    }
+}
+
+
+static void BaseMesh_WeldDestroy(base_mesh_p mesh, vertex_weld_p weld)
+{
+    free(weld->slots);
+    weld->slots = NULL;
+    weld->slots_mask = 0;
+    weld->vertex_capacity = 0;
+
+    if(mesh->vertex_count > 0)
+    {
+        mesh->vertices = (vertex_p)realloc(mesh->vertices, mesh->vertex_count * sizeof(vertex_t));
+    }
+    else if(mesh->vertices)
+    {
+        free(mesh->vertices);
+        mesh->vertices = NULL;
+    }
+}
+
+
+/*
+ * Table is full: rehashed for twice more vertices, the vertices array grows
+ * with it, so adding n vertices costs O(n) amortized.
+ */
+static void BaseMesh_WeldGrow(base_mesh_p mesh, vertex_weld_p weld)
 {
-    vertex_p v = mesh->vertices;
-    uint32_t vertex_index = 0;
+    uint32_t capacity = (weld->vertex_capacity) ? (2 * weld->vertex_capacity) : (16);
+    free(weld->slots);
+    BaseMesh_WeldInit(mesh, weld, capacity);
+}
+
 
-    for(vertex_index = 0; vertex_index < mesh->vertex_count; vertex_index++, v++)
+static uint32_t BaseMesh_AddVertexInternal(base_mesh_p mesh, vertex_weld_p weld, vertex_p vertex)
+{
+    vertex_p v;
+    uint32_t vertex_index;
+    uint32_t slot;
+
+    for(slot = BaseMesh_HashVertex(vertex) & weld->slots_mask; weld->slots[slot]; slot = (slot + 1) & weld->slots_mask)
     {
-        if(v->position[0] == vertex->position[0] && v->position[1] == vertex->position[1] && v->position[2] == vertex->position[2] &&
-           v->tex_coord[0] == vertex->tex_coord[0] && v->tex_coord[1] == vertex->tex_coord[1] &&
-           v->color[0] == vertex->color[0] && v->color[1] == vertex->color[1] && v->color[2] == vertex->color[2] && v->color[3] == vertex->color[3])
+        vertex_index = weld->slots[slot] - 1;
+        if(BaseMesh_IsVertexEqual(mesh->vertices + vertex_index, vertex))
         {
             return vertex_index;
         }
     }
 
+    if(mesh->vertex_count >= weld->vertex_capacity)
+    {
+        BaseMesh_WeldGrow(mesh, weld);
+        for(slot = BaseMesh_HashVertex(vertex) & weld->slots_mask; weld->slots[slot]; slot = (slot + 1) & weld->slots_mask);
+    }
+
     vertex_index = mesh->vertex_count;
     mesh->vertex_count++;
-    mesh->vertices = (vertex_p)realloc(mesh->vertices, mesh->vertex_count * sizeof(vertex_t));
+    weld->slots[slot] = vertex_index + 1;
 
     v = mesh->vertices + vertex_index;
     vec3_copy(v->position, vertex->position);
@@ -212,6 +361,22 @@ uint32_t BaseMesh_AddVertex(base_mesh_p mesh, struct vertex_s *vertex)
 }
 
 
+/**
+ * Adds vertex if there is no equal one in mesh; the lookup table is kept in
+ * mesh until BaseMesh_GenFaces() or BaseMesh_Clear(), vertices array may
+ * have spare capacity until then.
+ */
+uint32_t BaseMesh_AddVertex(base_mesh_p mesh, struct vertex_s *vertex)
+{
+    if(!mesh->vertex_weld)
+    {
+        mesh->vertex_weld = (vertex_weld_p)malloc(sizeof(vertex_weld_t));
+        BaseMesh_WeldInit(mesh, mesh->vertex_weld, 2 * mesh->vertex_count);
+    }
+    return BaseMesh_AddVertexInternal(mesh, mesh->vertex_weld, vertex);
+}
+
+
 uint32_t BaseMesh_FindVertexIndex(base_mesh_p mesh, float v[3])
 {
     vertex_p mv = mesh->vertices;
@@ -227,7 +392,7 @@ uint32_t BaseMesh_FindVertexIndex(base_mesh_p mesh, float v[3])
 }
 
 
-void BaseMesh_AddPolygonToFaces(base_mesh_p mesh, struct polygon_s *p)
+void BaseMesh_AddPolygonToFaces(base_mesh_p mesh, vertex_weld_p weld, struct polygon_s *p)
 {
     mesh_face_p current_face = NULL;
     uint32_t add_elements_count = (p->vertex_count - 2) * 3;
@@ -262,12 +427,12 @@ void BaseMesh_AddPolygonToFaces(base_mesh_p mesh, struct polygon_s *p)
     current_face->elements_count += add_elements_count;
 
     // Render the face as a triangle array
-    uint32_t startElement = BaseMesh_AddVertex(mesh, p->vertices);
-    uint32_t previousElement = BaseMesh_AddVertex(mesh, p->vertices + 1);
+    uint32_t startElement = BaseMesh_AddVertexInternal(mesh, weld, p->vertices);
+    uint32_t previousElement = BaseMesh_AddVertexInternal(mesh, weld, p->vertices + 1);
 
     for(uint16_t j = 2; j < p->vertex_count; j++)
     {
-        uint32_t thisElement = BaseMesh_AddVertex(mesh, p->vertices + j);
+        uint32_t thisElement = BaseMesh_AddVertexInternal(mesh, weld, p->vertices + j);
 
         *current_index++ = startElement;
         *current_index++ = previousElement;
@@ -353,6 +518,8 @@ void BaseMesh_AddAnimatedPolygonToFaces(base_mesh_p mesh, uint32_t *vertex_index
 void BaseMesh_GenFaces(base_mesh_p mesh)
 {
     polygon_p p = mesh->polygons;
+    vertex_weld_t weld;
+    uint32_t max_vertices = mesh->vertex_count;
     
     mesh->faces_count = 0;
     mesh->faces = NULL;
@@ -364,12 +531,25 @@ void BaseMesh_GenFaces(base_mesh_p mesh)
     
     mesh->animated_polygons = NULL;
     mesh->transparency_polygons = NULL;
-    
+
+    if(mesh->vertex_weld)
+    {
+        BaseMesh_WeldDestroy(mesh, mesh->vertex_weld);
+        free(mesh->vertex_weld);
+        mesh->vertex_weld = NULL;
+    }
+
+    for(uint32_t i = 0; i < mesh->polygons_count; i++)
+    {
+        max_vertices += mesh->polygons[i].vertex_count;
+    }
+    BaseMesh_WeldInit(mesh, &weld, max_vertices);
+
     for(uint32_t i = 0; i < mesh->polygons_count; i++, p++)
     {
         if((p->transparency < 2) && (p->anim_id == 0) && !Polygon_IsBroken(p))
         {
-            BaseMesh_AddPolygonToFaces(mesh, p);
+            BaseMesh_AddPolygonToFaces(mesh, &weld, p);
         }
         else if(p->transparency >= 2)
         {
@@ -382,7 +562,23 @@ void BaseMesh_GenFaces(base_mesh_p mesh)
             mesh->animated_polygons = p;
         }
     }
-    
+    BaseMesh_WeldDestroy(mesh, &weld);
+
+    BaseMesh_GenAnimatedFaces(mesh);
+    BaseMesh_GenVBO(mesh);
+}
+
+/*
+ * Builds animated faces and vertices from animated_polygons list;
+ * animated vertices are not shared, so it is a plain linear pass.
+ */
+void BaseMesh_GenAnimatedFaces(base_mesh_p mesh)
+{
+    mesh->animated_faces_count = 0;
+    mesh->animated_faces = NULL;
+    mesh->animated_vertices = NULL;
+    mesh->animated_vertex_count = 0;
+
     if(mesh->animated_polygons)
     {
         for (polygon_p p = mesh->animated_polygons; p != 0; p = p->next)
@@ -397,6 +593,4 @@ void BaseMesh_GenFaces(base_mesh_p mesh)
             BaseMesh_AddAnimatedPolygonToFaces(mesh, &vertex_index, p);
         }
     }
-    
-    BaseMesh_GenVBO(mesh);
 }
@@ -45,6 +45,7 @@ typedef struct base_mesh_s
     uint32_t                animated_vertex_count;
     struct vertex_s        *vertices;
     struct vertex_s        *animated_vertices;
+    struct vertex_weld_s   *vertex_weld;                                        // lookup of BaseMesh_AddVertex() vertices, NULL when not building
 
     float                   centre[3];                                          // geometry centre of mesh
     float                   bb_min[3];                                          // AABB bounding volume
@@ -53,7 +54,7 @@ typedef struct base_mesh_s
 
     GLuint                  vbo_vertex_array;
     GLuint                  vbo_animated_vertex_array;
-    GLuint                  vbo_animated_texcoord_array;
+    GLuint                  vbo_animated_texcoord_array;                        // anim texture frames (or tex coords without shader lookup)
 }base_mesh_t, *base_mesh_p;
 
 
@@ -111,6 +112,8 @@ void BaseMesh_FindBB(base_mesh_p mesh);
 uint32_t BaseMesh_AddVertex(base_mesh_p mesh, struct vertex_s *vertex);
 uint32_t BaseMesh_FindVertexIndex(base_mesh_p mesh, float v[3]);
 void     BaseMesh_GenFaces(base_mesh_p mesh);
+void     BaseMesh_GenAnimatedFaces(base_mesh_p mesh);
+void     BaseMesh_GenVBO(base_mesh_p mesh);
 
 
 #ifdef	__cplusplus
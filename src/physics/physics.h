@@ -11,10 +11,14 @@
 #include <stdint.h>
 
 
-#define DEFAULT_COLLSION_NODE_POOL_SIZE    (128)
+#define DEFAULT_COLLSION_NODE_POOL_SIZE    (128)                               // nodes in collision results pool block
 // non zero value prevents to "smooth" normales calculations near edges, 
 // that is wrong for slide state checking.
 #define COLLISION_MARGIN_DEFAULT           (0.0f)
+// dynamics world is integrated by fixed steps only, frame time is accumulated;
+// time over the substeps limit is dropped (slow frames / hitches).
+#define PHYSICS_FIXED_TIME_STEP            (1.0f / 60.0f)
+#define PHYSICS_MAX_SUB_STEPS              (4)
 
 
 typedef struct collision_node_s
@@ -29,6 +33,20 @@ typedef struct collision_node_s
 }collision_node_t, *collision_node_p;
 
 
+/*
+ * Ghost collision queries counters; see Physics_ResetCollisionPool().
+ */
+typedef struct collision_pool_stats_s
+{
+    uint32_t                    queries;
+    uint32_t                    cache_hits;                                     // results of the ghost are returned as is
+    uint32_t                    dispatch_skips;                                 // contacts are refiltered without pair cache update
+    uint32_t                    nodes_used;
+    uint32_t                    nodes_allocated;                                // pool capacity
+    uint32_t                    heap_allocations;                               // pool blocks allocations
+}collision_pool_stats_t, *collision_pool_stats_p;
+
+
 typedef struct collision_result_s
 {
     struct engine_container_s  *obj;
@@ -40,6 +58,42 @@ typedef struct collision_result_s
 }collision_result_t, *collision_result_p;
 
 
+/*
+ * Vertical height probe: nearest floor hit down to pos - depth and ceiling
+ * hit up to pos + height, see Physics_HeightProbes().
+ */
+typedef struct height_probe_s
+{
+    float                       pos[3];
+    float                       depth;
+    float                       height;
+    struct engine_container_s  *cont;                                           // ignored object, its room is a part of the key
+    int16_t                     filter;
+    int16_t                     cached;                                         // out: results are taken from the probes cache
+    struct collision_result_s   floor_hit;
+    struct collision_result_s   ceiling_hit;
+}height_probe_t, *height_probe_p;
+
+
+typedef struct height_probe_stats_s
+{
+    uint32_t                    probes;
+    uint32_t                    cache_hits;                                     // results are taken from the probes cache
+    uint32_t                    broadphase_tests;                               // one per batch with cache misses
+    uint32_t                    ray_tests;                                      // narrow phase tests of broadphase candidates
+}height_probe_stats_t, *height_probe_stats_p;
+
+typedef void (*height_probes_hook_t)(struct height_probe_s *probes, uint32_t count, uint32_t frame);
+
+
+typedef struct physics_settings_s
+{
+    int32_t     threads;                                                        // solver threads of OPENTOMB_BULLET_MT build, 0 - all cores
+}physics_settings_t, *physics_settings_p;
+
+extern struct physics_settings_s physics_settings;
+
+
 typedef struct ghost_shape_s
 {
     uint32_t    shape_id;
@@ -57,8 +111,14 @@ struct physics_object_s;
 void Physics_Init();
 void Physics_Destroy();
 void Physics_StepSimulation(float time);
+uint32_t Physics_GetStepsCount();
 void Physics_DebugDrawWorld();
 void Physics_CleanUpObjects();
+void Physics_ResetCollisionPool();
+void Physics_GetCollisionPoolStats(struct collision_pool_stats_s *stats);
+void Physics_SetThreadsCount(int threads);
+int  Physics_GetThreadsCount();
+int  Physics_GetMaxThreadsCount();
 
 struct physics_data_s *Physics_CreatePhysicsData(struct engine_container_s *cont);
 void Physics_DeletePhysicsData(struct physics_data_s *physics);
@@ -68,6 +128,11 @@ void Physics_SetGravity(float g[3]);
 
 int  Physics_RayTest(struct collision_result_s *result, float from[3], float to[3], struct engine_container_s *cont, int16_t filter);
 int  Physics_RayTestFiltered(struct collision_result_s *result, float from[3], float to[3], struct engine_container_s *cont, int16_t filter);
+void Physics_HeightProbes(struct height_probe_s *probes, uint32_t count);
+void Physics_SetHeightProbesCache(int enabled);
+void Physics_GetHeightProbeStats(struct height_probe_stats_s *stats);
+void Physics_ResetHeightProbeStats();
+void Physics_SetHeightProbesHook(height_probes_hook_t hook);
 int  Physics_SphereTest(struct collision_result_s *result, float from[3], float to[3], float R, struct engine_container_s *cont, int16_t filter);
 
 /* Physics object manipulation functions */
@@ -76,6 +141,7 @@ int  Physics_IsGhostsInited(struct physics_data_s *physics);
 int  Physics_GetBodiesCount(struct physics_data_s *physics);
 void Physics_GetBodyWorldTransform(struct physics_data_s *physics, float tr[16], uint16_t index);
 void Physics_SetBodyWorldTransform(struct physics_data_s *physics, float tr[16], uint16_t index);
+void Physics_GetBodyRenderTransform(struct physics_data_s *physics, float tr[16], uint16_t index);
 void Physics_GetGhostWorldTransform(struct physics_data_s *physics, float tr[16], uint16_t index);
 void Physics_SetGhostWorldTransform(struct physics_data_s *physics, float tr[16], uint16_t index);
 ghost_shape_p Physics_GetGhostShapeInfo(struct physics_data_s *physics, uint16_t index);
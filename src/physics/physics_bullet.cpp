@@ -11,6 +11,12 @@
 #include <BulletCollision/CollisionDispatch/btGhostObject.h>
 #include <BulletCollision/BroadphaseCollision/btCollisionAlgorithm.h>
 #include <BulletCollision/NarrowPhaseCollision/btRaycastCallback.h>
+#ifdef OPENTOMB_BULLET_MT
+#include <LinearMath/btThreads.h>
+#include <BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h>
+#include <BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h>
+#include <BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h>
+#endif
 
 #include "../core/gl_util.h"
 #include "../core/gl_font.h"
@@ -18,6 +24,7 @@
 #include "../core/console.h"
 #include "../core/vmath.h"
 #include "../core/obb.h"
+#include "../core/profiler.h"
 #include "../render/render.h"
 #include "../script/script.h"
 #include "../engine.h"
@@ -245,6 +252,17 @@ struct kinematic_info_s
     bool        has_collisions;
 };
 
+/*
+ * Ghost query result is valid while collision epoch is not changed; contacts
+ * manifolds of the ghost are valid for the epoch with any filter.
+ */
+struct ghost_collision_cache_s
+{
+    uint32_t                            epoch;
+    int16_t                             filter;
+    struct collision_node_s            *result;
+};
+
 typedef struct physics_data_s
 {
     // kinematic
@@ -255,7 +273,7 @@ typedef struct physics_data_s
     struct ghost_shape_s               *ghosts_info;
     btPairCachingGhostObject          **ghost_objects;          // like Bullet character controller for penetration resolving.
     btManifoldArray                    *manifoldArray;          // keep track of the contact manifolds
-    struct collision_node_s            *collision_track;
+    struct ghost_collision_cache_s     *ghost_cache;            // last query of every ghost
     uint16_t                            objects_count;          // Ragdoll joints
     uint16_t                            bt_joint_count;         // Ragdoll joints
     btTypedConstraint                 **bt_joints;              // Ragdoll joints
@@ -321,9 +339,91 @@ btGhostPairCallback                     *bt_engine_ghostPairCallback = NULL;
 btBroadphaseInterface                   *bt_engine_overlappingPairCache = NULL;
 btSequentialImpulseConstraintSolver     *bt_engine_solver = NULL;
 btDiscreteDynamicsWorld                 *bt_engine_dynamicsWorld = NULL;
+struct physics_settings_s                physics_settings = { 0 };
+#ifdef OPENTOMB_BULLET_MT
+btITaskScheduler                        *bt_engine_taskScheduler = NULL;
+btConstraintSolverPoolMt                *bt_engine_solverPool = NULL;
+#endif
 
 CBulletDebugDrawer                       bt_debug_drawer;
 
+/*
+ * Ghost collision results of a frame: nodes are taken from blocks reused every
+ * frame, so queries do not touch heap after warm up, and result lists stay
+ * valid up to Physics_ResetCollisionPool() call.
+ */
+typedef struct collision_pool_block_s
+{
+    struct collision_pool_block_s      *next;
+    collision_node_t                    nodes[DEFAULT_COLLSION_NODE_POOL_SIZE];
+}collision_pool_block_t, *collision_pool_block_p;
+
+static collision_pool_block_p            bt_engine_collision_blocks = NULL;
+static collision_pool_block_p            bt_engine_collision_block = NULL;      // current block
+static uint32_t                          bt_engine_collision_block_used = 0;
+static uint32_t                          bt_engine_collision_epoch = 1;         // changed with any collision world change
+static collision_pool_stats_t            bt_engine_collision_stats = { 0 };
+static collision_pool_stats_t            bt_engine_collision_stats_last = { 0 };
+
+/*
+ * Height probes results are kept until the collision world is changed (at
+ * least once per frame); probes of the same position, ignored object and its
+ * room are answered from the cache.
+ */
+#define BT_HEIGHT_PROBE_CACHE_SIZE              (256)                           // power of two
+
+typedef struct height_probe_cache_s
+{
+    uint32_t                            epoch;
+    struct room_s                      *room;
+    struct room_sector_s               *sector;
+    struct height_probe_s               probe;
+}height_probe_cache_t, *height_probe_cache_p;
+
+class bt_engine_AabbCandidatesCallback : public btBroadphaseAabbCallback
+{
+public:
+    virtual bool process(const btBroadphaseProxy* proxy) override
+    {
+        m_objects.push_back((btCollisionObject*)proxy->m_clientObject);
+        return true;
+    }
+
+    btAlignedObjectArray<btCollisionObject*> m_objects;
+};
+
+static height_probe_cache_t              bt_engine_height_probe_cache[BT_HEIGHT_PROBE_CACHE_SIZE];
+static int                               bt_engine_height_probe_cache_enabled = 1;
+static height_probe_stats_t              bt_engine_height_probe_stats = { 0 };
+static bt_engine_AabbCandidatesCallback  bt_engine_height_probe_candidates;
+static height_probes_hook_t              bt_engine_height_probes_hook = NULL;
+static uint32_t                          bt_engine_collision_frame = 0;
+static uint32_t                          bt_engine_steps_count = 0;
+
+static void BT_CollisionWorldChanged()
+{
+    bt_engine_collision_epoch = (bt_engine_collision_epoch + 1 != 0) ? (bt_engine_collision_epoch + 1) : (1);
+}
+
+static collision_node_p BT_AllocCollisionNode()
+{
+    if(!bt_engine_collision_block || (bt_engine_collision_block_used >= DEFAULT_COLLSION_NODE_POOL_SIZE))
+    {
+        collision_pool_block_p *next = (bt_engine_collision_block) ? (&bt_engine_collision_block->next) : (&bt_engine_collision_blocks);
+        if(*next == NULL)
+        {
+            *next = (collision_pool_block_p)malloc(sizeof(collision_pool_block_t));
+            (*next)->next = NULL;
+            bt_engine_collision_stats.nodes_allocated += DEFAULT_COLLSION_NODE_POOL_SIZE;
+            bt_engine_collision_stats.heap_allocations++;
+        }
+        bt_engine_collision_block = *next;
+        bt_engine_collision_block_used = 0;
+    }
+    bt_engine_collision_stats.nodes_used++;
+    return bt_engine_collision_block->nodes + bt_engine_collision_block_used++;
+}
+
 /* bullet collision model calculation */
 btCollisionShape* BT_CSfromBBox(btScalar *bb_min, btScalar *bb_max);
 btCollisionShape* BT_CSfromMesh(struct base_mesh_s *mesh, bool useCompression, bool buildBvh, bool is_static = true);
@@ -349,18 +449,32 @@ void Physics_Init()
     ///collision configuration contains default setup for memory, collision setup. Advanced users can create their own configuration.
     bt_engine_collisionConfiguration = new btDefaultCollisionConfiguration();
 
-    ///use the default collision dispatcher. For parallel processing you can use a diffent dispatcher (see Extras/BulletMultiThreaded)
-    bt_engine_dispatcher = new btCollisionDispatcher(bt_engine_collisionConfiguration);
-
     ///btDbvtBroadphase is a good general purpose broadphase. You can also try out btAxis3Sweep.
     bt_engine_overlappingPairCache = new btDbvtBroadphase();
     bt_engine_ghostPairCallback = new btGhostPairCallback();
     bt_engine_overlappingPairCache->getOverlappingPairCache()->setInternalGhostPairCallback(bt_engine_ghostPairCallback);
 
+#ifdef OPENTOMB_BULLET_MT
+    ///islands are solved by the task scheduler threads, one pooled solver per thread;
+    ///threads count is set from config by Physics_SetThreadsCount().
+    bt_engine_taskScheduler = btCreateDefaultTaskScheduler();
+    if(bt_engine_taskScheduler)
+    {
+        btSetTaskScheduler(bt_engine_taskScheduler);
+    }
+    bt_engine_dispatcher = new btCollisionDispatcherMt(bt_engine_collisionConfiguration, 40);
+    bt_engine_solverPool = new btConstraintSolverPoolMt(Physics_GetMaxThreadsCount());
+    bt_engine_solver = new btSequentialImpulseConstraintSolverMt();
+    bt_engine_dynamicsWorld = new btDiscreteDynamicsWorldMt(bt_engine_dispatcher, bt_engine_overlappingPairCache, bt_engine_solverPool, bt_engine_solver, bt_engine_collisionConfiguration);
+#else
+    ///use the default collision dispatcher. For parallel processing you can use a diffent dispatcher (see Extras/BulletMultiThreaded)
+    bt_engine_dispatcher = new btCollisionDispatcher(bt_engine_collisionConfiguration);
+
     ///the default constraint solver. For parallel processing you can use a different solver (see Extras/BulletMultiThreaded)
     bt_engine_solver = new btSequentialImpulseConstraintSolver;
 
     bt_engine_dynamicsWorld = new btDiscreteDynamicsWorld(bt_engine_dispatcher, bt_engine_overlappingPairCache, bt_engine_solver, bt_engine_collisionConfiguration);
+#endif
     bt_engine_dynamicsWorld->getPairCache()->setOverlapFilterCallback(&bt_engine_overlap_filter_callback);
     bt_engine_dynamicsWorld->setGravity(btVector3(0, 0, -4500.0));
 
@@ -376,6 +490,10 @@ void Physics_Destroy()
 
     //delete solver
     delete bt_engine_solver;
+#ifdef OPENTOMB_BULLET_MT
+    delete bt_engine_solverPool;
+    bt_engine_solverPool = NULL;
+#endif
 
     //delete broadphase
     delete bt_engine_overlappingPairCache;
@@ -386,13 +504,110 @@ void Physics_Destroy()
     delete bt_engine_collisionConfiguration;
 
     delete bt_engine_ghostPairCallback;
+
+    while(bt_engine_collision_blocks)
+    {
+        collision_pool_block_p next = bt_engine_collision_blocks->next;
+        free(bt_engine_collision_blocks);
+        bt_engine_collision_blocks = next;
+    }
+    bt_engine_collision_block = NULL;
+    bt_engine_collision_block_used = 0;
+
+    bt_engine_height_probes_hook = NULL;
+    bt_engine_height_probe_candidates.m_objects.clear();
+
+#ifdef OPENTOMB_BULLET_MT
+    if(bt_engine_taskScheduler)
+    {
+        btSetTaskScheduler(btGetSequentialTaskScheduler());
+        delete bt_engine_taskScheduler;
+        bt_engine_taskScheduler = NULL;
+    }
+#endif
+}
+
+
+/*
+ * Solver threads of the multithreaded build; 0 or more than available means
+ * all scheduler threads. Single threaded build ignores it.
+ */
+void Physics_SetThreadsCount(int threads)
+{
+#ifdef OPENTOMB_BULLET_MT
+    if(bt_engine_taskScheduler)
+    {
+        int max_threads = bt_engine_taskScheduler->getMaxNumThreads();
+        bt_engine_taskScheduler->setNumThreads(((threads > 0) && (threads < max_threads)) ? (threads) : (max_threads));
+    }
+#endif
+}
+
+int Physics_GetThreadsCount()
+{
+#ifdef OPENTOMB_BULLET_MT
+    return (bt_engine_taskScheduler) ? (bt_engine_taskScheduler->getNumThreads()) : (1);
+#else
+    return 1;
+#endif
+}
+
+int Physics_GetMaxThreadsCount()
+{
+#ifdef OPENTOMB_BULLET_MT
+    return (bt_engine_taskScheduler) ? (bt_engine_taskScheduler->getMaxNumThreads()) : (1);
+#else
+    return 1;
+#endif
 }
 
 
+/*
+ * Bullet accumulates frame time and integrates only whole fixed steps, so the
+ * simulation does not depend on the host frame rate; motion states of dynamic
+ * bodies get transforms interpolated between the last two steps (see
+ * Physics_GetBodyRenderTransform).
+ */
 void Physics_StepSimulation(float time)
 {
-    time = (time < 0.1f) ? (time) : (0.0f);
-    bt_engine_dynamicsWorld->stepSimulation(time, 0);
+    PROF_ZONE("Physics_StepSimulation");
+    BT_CollisionWorldChanged();
+    int steps = bt_engine_dynamicsWorld->stepSimulation(time, PHYSICS_MAX_SUB_STEPS, PHYSICS_FIXED_TIME_STEP);
+    bt_engine_steps_count += (steps < PHYSICS_MAX_SUB_STEPS) ? (steps) : (PHYSICS_MAX_SUB_STEPS); // Bullet returns unclamped count
+}
+
+/*
+ * Fixed steps simulated since start; frames of different rates reach the same
+ * simulation state at the same steps count.
+ */
+uint32_t Physics_GetStepsCount()
+{
+    return bt_engine_steps_count;
+}
+
+/*
+ * Called once per frame: all previous ghost query results are dropped and the
+ * pool is reused from the start.
+ */
+void Physics_ResetCollisionPool()
+{
+    uint32_t nodes_allocated = bt_engine_collision_stats.nodes_allocated;
+    bt_engine_collision_stats_last = bt_engine_collision_stats;
+    memset(&bt_engine_collision_stats, 0, sizeof(bt_engine_collision_stats));
+    bt_engine_collision_stats.nodes_allocated = nodes_allocated;
+    bt_engine_collision_block = NULL;
+    bt_engine_collision_block_used = 0;
+    bt_engine_collision_frame++;
+    BT_CollisionWorldChanged();
+}
+
+/*
+ * Counters of the last finished frame.
+ */
+void Physics_GetCollisionPoolStats(struct collision_pool_stats_s *stats)
+{
+    *stats = bt_engine_collision_stats_last;
+    stats->nodes_allocated = bt_engine_collision_stats.nodes_allocated;
 }
 
 void Physics_DebugDrawWorld()
@@ -402,6 +617,7 @@ void Physics_DebugDrawWorld()
 
 void Physics_CleanUpObjects()
 {
+    BT_CollisionWorldChanged();
     if(bt_engine_dynamicsWorld != NULL)
     {
         int num_obj = bt_engine_dynamicsWorld->getNumCollisionObjects();
@@ -450,7 +666,7 @@ struct physics_data_s *Physics_CreatePhysicsData(struct engine_container_s *cont
     ret->manifoldArray = NULL;
     ret->ghosts_info = NULL;
     ret->ghost_objects = NULL;
-    ret->collision_track = NULL;
+    ret->ghost_cache = NULL;
     ret->collision_group = btBroadphaseProxy::KinematicFilter;
     ret->collision_mask = btBroadphaseProxy::AllFilter;
     ret->cont = cont;
@@ -463,13 +679,9 @@ void Physics_DeletePhysicsData(struct physics_data_s *physics)
 {
     if(physics)
     {
-        for(collision_node_p cn = physics->collision_track; cn;)
-        {
-            collision_node_p next = cn->next_bucket;
-            free(cn);
-            cn = next;
-        }
-        physics->collision_track = NULL;
+        BT_CollisionWorldChanged();
+        free(physics->ghost_cache);
+        physics->ghost_cache = NULL;
 
         if(physics->bt_info)
         {
@@ -617,6 +829,182 @@ int  Physics_RayTestFiltered(struct collision_result_s *result, float from[3], f
 }
 
 
+static uint32_t BT_HeightProbeHash(struct height_probe_s *probe)
+{
+    uint32_t room_id = (probe->cont && probe->cont->room) ? (probe->cont->room->id) : (0xFFFF);
+    uint32_t h = (uint32_t)((int32_t)probe->pos[0]) * 73856093;
+    h ^= (uint32_t)((int32_t)probe->pos[1]) * 19349663;
+    h ^= (uint32_t)((int32_t)probe->pos[2]) * 83492791;
+    h ^= room_id * 2654435761u;
+    return (h ^ (h >> 16)) & (BT_HEIGHT_PROBE_CACHE_SIZE - 1);
+}
+
+
+static height_probe_cache_p BT_FindHeightProbe(struct height_probe_s *probe)
+{
+    height_probe_cache_p entry = bt_engine_height_probe_cache + BT_HeightProbeHash(probe);
+    struct room_s *room = (probe->cont) ? (probe->cont->room) : (NULL);
+    struct room_sector_s *sector = (probe->cont) ? (probe->cont->sector) : (NULL);
+
+    if(bt_engine_height_probe_cache_enabled &&
+       (entry->epoch == bt_engine_collision_epoch) && (entry->room == room) && (entry->sector == sector) &&
+       (entry->probe.cont == probe->cont) && (entry->probe.filter == probe->filter) &&
+       (entry->probe.pos[0] == probe->pos[0]) && (entry->probe.pos[1] == probe->pos[1]) && (entry->probe.pos[2] == probe->pos[2]) &&
+       (entry->probe.depth == probe->depth) && (entry->probe.height == probe->height))
+    {
+        return entry;
+    }
+    return NULL;
+}
+
+/*
+ * Vertical ray against the candidates of the batch: same filtering and
+ * result as Physics_RayTestFiltered(), but without own broadphase traversal.
+ */
+static void BT_HeightProbeRay(struct height_probe_s *probe, float to_z, struct collision_result_s *result)
+{
+    float to[3] = {probe->pos[0], probe->pos[1], to_z};
+    bt_engine_ClosestRayResultCallback cb(probe->cont, probe->pos, to, probe->filter);
+    btVector3 vFrom(probe->pos[0], probe->pos[1], probe->pos[2]), vTo(to[0], to[1], to[2]);
+    btTransform tFrom, tTo;
+    btScalar z_min = (vFrom[2] < vTo[2]) ? (vFrom[2]) : (vTo[2]);
+    btScalar z_max = (vFrom[2] < vTo[2]) ? (vTo[2]) : (vFrom[2]);
+    btAlignedObjectArray<btCollisionObject*> &objects = bt_engine_height_probe_candidates.m_objects;
+
+    cb.m_flags |= btTriangleRaycastCallback::kF_FilterBackfaces;
+    cb.m_flags |= btTriangleRaycastCallback::kF_KeepUnflippedNormal;
+    tFrom.setIdentity();
+    tFrom.setOrigin(vFrom);
+    tTo.setIdentity();
+    tTo.setOrigin(vTo);
+
+    for(int i = 0; (i < objects.size()) && (cb.m_closestHitFraction > 0.0f); ++i)
+    {
+        btCollisionObject *obj = objects[i];
+        btBroadphaseProxy *proxy = obj->getBroadphaseHandle();
+        if(proxy && cb.needsCollision(proxy) &&
+           (vFrom[0] >= proxy->m_aabbMin[0]) && (vFrom[0] <= proxy->m_aabbMax[0]) &&
+           (vFrom[1] >= proxy->m_aabbMin[1]) && (vFrom[1] <= proxy->m_aabbMax[1]) &&
+           (z_max >= proxy->m_aabbMin[2]) && (z_min <= proxy->m_aabbMax[2]))
+        {
+            bt_engine_height_probe_stats.ray_tests++;
+            btCollisionWorld::rayTestSingle(tFrom, tTo, obj, obj->getCollisionShape(), obj->getWorldTransform(), cb);
+        }
+    }
+
+    result->hit = 0x00;
+    result->obj = NULL;
+    result->fraction = 1.0f;
+    if(cb.hasHit())
+    {
+        result->obj      = (struct engine_container_s *)cb.m_collisionObject->getUserPointer();
+        result->hit      = 0x01;
+        result->bone_num = cb.m_collisionObject->getUserIndex();
+        vec3_copy(result->normale, cb.m_hitNormalWorld.m_floats);
+        vFrom.setInterpolate3(vFrom, vTo, cb.m_closestHitFraction);
+        vec3_copy(result->point, vFrom.m_floats);
+        result->fraction = cb.m_closestHitFraction;
+    }
+}
+
+/*
+ * Probes are answered from the cache if possible; the rest of the batch is
+ * tested against objects found by one broadphase query of their common box.
+ * Cache hits are resolved in the first pass: storing the misses may evict
+ * entries of the same batch, and their columns are not in the query box.
+ */
+void Physics_HeightProbes(struct height_probe_s *probes, uint32_t count)
+{
+    btVector3 aabb_min, aabb_max;
+    uint32_t misses = 0;
+
+    if(bt_engine_height_probes_hook)
+    {
+        bt_engine_height_probes_hook(probes, count, bt_engine_collision_frame);
+    }
+
+    for(height_probe_p p = probes; p < probes + count; ++p)
+    {
+        height_probe_cache_p entry = BT_FindHeightProbe(p);
+        bt_engine_height_probe_stats.probes++;
+        p->cached = (entry) ? (0x01) : (0x00);
+        if(entry)
+        {
+            p->floor_hit = entry->probe.floor_hit;
+            p->ceiling_hit = entry->probe.ceiling_hit;
+            bt_engine_height_probe_stats.cache_hits++;
+        }
+        else
+        {
+            btVector3 p_min(p->pos[0], p->pos[1], p->pos[2] - p->depth);
+            btVector3 p_max(p->pos[0], p->pos[1], p->pos[2] + p->height);
+            if(misses++ == 0)
+            {
+                aabb_min = p_min;
+                aabb_max = p_max;
+            }
+            else
+            {
+                aabb_min.setMin(p_min);
+                aabb_max.setMax(p_max);
+            }
+        }
+    }
+
+    if(misses > 0)
+    {
+        bt_engine_height_probe_candidates.m_objects.resize(0);
+        bt_engine_dynamicsWorld->getBroadphase()->aabbTest(aabb_min, aabb_max, bt_engine_height_probe_candidates);
+        bt_engine_height_probe_stats.broadphase_tests++;
+    }
+
+    for(height_probe_p p = probes; p < probes + count; ++p)
+    {
+        height_probe_cache_p entry;
+        if(p->cached)
+        {
+            continue;
+        }
+
+        BT_HeightProbeRay(p, p->pos[2] - p->depth, &p->floor_hit);
+        BT_HeightProbeRay(p, p->pos[2] + p->height, &p->ceiling_hit);
+
+        entry = bt_engine_height_probe_cache + BT_HeightProbeHash(p);
+        entry->epoch = bt_engine_collision_epoch;
+        entry->room = (p->cont) ? (p->cont->room) : (NULL);
+        entry->sector = (p->cont) ? (p->cont->sector) : (NULL);
+        entry->probe = *p;
+    }
+}
+
+
+void Physics_SetHeightProbesCache(int enabled)
+{
+    bt_engine_height_probe_cache_enabled = enabled;
+}
+
+
+void Physics_GetHeightProbeStats(struct height_probe_stats_s *stats)
+{
+    *stats = bt_engine_height_probe_stats;
+}
+
+
+void Physics_ResetHeightProbeStats()
+{
+    memset(&bt_engine_height_probe_stats, 0, sizeof(bt_engine_height_probe_stats));
+}
+
+/*
+ * The hook sees every batch before it is answered, with the number of
+ * Physics_ResetCollisionPool() calls (frames) so far; NULL removes it.
+ */
+void Physics_SetHeightProbesHook(height_probes_hook_t hook)
+{
+    bt_engine_height_probes_hook = hook;
+}
+
+
 int  Physics_SphereTest(struct collision_result_s *result, float from[3], float to[3], float R, struct engine_container_s *cont, int16_t filter)
 {
     bt_engine_ClosestConvexResultCallback cb(cont, from, to, filter);
@@ -681,11 +1069,53 @@ void Physics_GetBodyWorldTransform(struct physics_data_s *physics, float tr[16],
 }
 
 
+/*
+ * Moved body is placed without interpolation from its previous position.
+ */
 void Physics_SetBodyWorldTransform(struct physics_data_s *physics, float tr[16], uint16_t index)
+{
+    btRigidBody *body = physics->bt_body[index];
+    if(body)
+    {
+        btTransform t;
+        t.setFromOpenGLMatrix(tr);
+        if(!(t == body->getWorldTransform()))
+        {
+            BT_CollisionWorldChanged();
+        }
+        body->getWorldTransform() = t;
+        body->setInterpolationWorldTransform(body->getWorldTransform());
+        if(body->getMotionState())
+        {
+            body->getMotionState()->setWorldTransform(body->getWorldTransform());
+        }
+    }
+}
+
+
+static void BT_GetRenderTransform(btRigidBody *body, float tr[16])
+{
+    if(body->getMotionState() && !body->isStaticOrKinematicObject())
+    {
+        btTransform t;
+        body->getMotionState()->getWorldTransform(t);
+        t.getOpenGLMatrix(tr);
+    }
+    else
+    {
+        body->getWorldTransform().getOpenGLMatrix(tr);
+    }
+}
+
+/*
+ * Transform for drawing: dynamic bodies are interpolated between the last two
+ * fixed steps, others are returned as is.
+ */
+void Physics_GetBodyRenderTransform(struct physics_data_s *physics, float tr[16], uint16_t index)
 {
     if(physics->bt_body[index])
     {
-        physics->bt_body[index]->getWorldTransform().setFromOpenGLMatrix(tr);
+        BT_GetRenderTransform(physics->bt_body[index], tr);
     }
 }
 
@@ -710,9 +1140,15 @@ void Physics_SetGhostWorldTransform(struct physics_data_s *physics, float tr[16]
     if(physics->ghost_objects && physics->ghost_objects[index])
     {
         btVector3 origin;
+        btTransform t;
         Mat4_vec3_mul_macro(origin.m_floats, tr, physics->ghosts_info[index].offset);
-        physics->ghost_objects[index]->getWorldTransform().setFromOpenGLMatrix(tr);
-        physics->ghost_objects[index]->getWorldTransform().setOrigin(origin);
+        t.setFromOpenGLMatrix(tr);
+        t.setOrigin(origin);
+        if(!(t == physics->ghost_objects[index]->getWorldTransform()))
+        {
+            physics->ghost_objects[index]->getWorldTransform() = t;
+            BT_CollisionWorldChanged();
+        }
     }
 }
 
@@ -725,6 +1161,9 @@ ghost_shape_p Physics_GetGhostShapeInfo(struct physics_data_s *physics, uint16_t
 
 /**
  * It is from bullet_character_controller
+ * Result nodes are taken from the frame pool; repeated query of the ghost
+ * returns the same list, if collision world is not changed since the previous
+ * one.
  */
 collision_node_p Physics_GetGhostCurrentCollision(struct physics_data_s *physics, uint16_t index, int16_t filter)
 {
@@ -736,18 +1175,45 @@ collision_node_p Physics_GetGhostCurrentCollision(struct physics_data_s *physics
     // Do this by calling the broadphase's setAabb with the moved AABB, this will update the broadphase
     // paircache and the ghostobject's internal paircache at the same time.    /BW
 
-    collision_node_p *cn = &(physics->collision_track);
-    collision_node_p *cnb = &(physics->collision_track);
+    collision_node_p ret = NULL;
+    collision_node_p *cn = &ret;
     btPairCachingGhostObject *ghost = physics->ghost_objects[index];
+    struct ghost_collision_cache_s *cache;
+
+    if(!physics->ghost_cache)
+    {
+        physics->ghost_cache = (struct ghost_collision_cache_s*)calloc(physics->objects_count, sizeof(struct ghost_collision_cache_s));
+    }
+    cache = physics->ghost_cache + index;
+    bt_engine_collision_stats.queries++;
+    if(cache->epoch == bt_engine_collision_epoch)
+    {
+        if(cache->filter == filter)
+        {
+            bt_engine_collision_stats.cache_hits++;
+            return cache->result;
+        }
+        bt_engine_collision_stats.dispatch_skips++;
+    }
+
     if(ghost && ghost->getBroadphaseHandle())
     {
         int num_pairs, manifolds_size;
         btBroadphasePairArray &pairArray = ghost->getOverlappingPairCache()->getOverlappingPairArray();
-        btVector3 aabb_min, aabb_max;
 
-        ghost->getCollisionShape()->getAabb(ghost->getWorldTransform(), aabb_min, aabb_max);
-        bt_engine_dynamicsWorld->getBroadphase()->setAabb(ghost->getBroadphaseHandle(), aabb_min, aabb_max, bt_engine_dynamicsWorld->getDispatcher());
-        bt_engine_dynamicsWorld->getDispatcher()->dispatchAllCollisionPairs(ghost->getOverlappingPairCache(), bt_engine_dynamicsWorld->getDispatchInfo(), bt_engine_dynamicsWorld->getDispatcher());
+        if(cache->epoch != bt_engine_collision_epoch)
+        {
+            btBroadphaseProxy *proxy = ghost->getBroadphaseHandle();
+            btVector3 aabb_min, aabb_max;
+            ghost->getCollisionShape()->getAabb(ghost->getWorldTransform(), aabb_min, aabb_max);
+            if((aabb_min != proxy->m_aabbMin) || (aabb_max != proxy->m_aabbMax))
+            {
+                // pairs of other ghosts may be changed too
+                bt_engine_dynamicsWorld->getBroadphase()->setAabb(proxy, aabb_min, aabb_max, bt_engine_dynamicsWorld->getDispatcher());
+                BT_CollisionWorldChanged();
+            }
+            bt_engine_dynamicsWorld->getDispatcher()->dispatchAllCollisionPairs(ghost->getOverlappingPairCache(), bt_engine_dynamicsWorld->getDispatchInfo(), bt_engine_dynamicsWorld->getDispatcher());
+        }
 
         num_pairs = pairArray.size();
         for(int i = 0; i < num_pairs; i++)
@@ -782,28 +1248,22 @@ collision_node_p Physics_GetGhostCurrentCollision(struct physics_data_s *physics
 
                             if(dist < 0.0)
                             {
-                                if(*cn == NULL)
-                                {
-                                    *cn = *cnb = (collision_node_p)calloc(4, sizeof(collision_node_t));
-                                    for(int bi = 0; bi < 4 - 1; ++bi)
-                                    {
-                                        (*cnb)[bi].next = *cnb + bi + 1;
-                                    }
-                                    cnb = &((*cnb)->next_bucket);
-                                }
-
-                                (*cn)->obj = cont;
-                                (*cn)->part_from = obj->getUserIndex();
-                                (*cn)->part_self = i;
-                                (*cn)->penetration[0] = pt.m_normalWorldOnB[0];
-                                (*cn)->penetration[1] = pt.m_normalWorldOnB[1];
-                                (*cn)->penetration[2] = pt.m_normalWorldOnB[2];
-                                (*cn)->penetration[3] = dist * directionSign;
-                                (*cn)->point[0] = pt.m_positionWorldOnA[0];
-                                (*cn)->point[1] = pt.m_positionWorldOnA[1];
-                                (*cn)->point[2] = pt.m_positionWorldOnA[2];
-
-                                cn = &((*cn)->next);
+                                collision_node_p node = BT_AllocCollisionNode();
+                                node->obj = cont;
+                                node->part_from = obj->getUserIndex();
+                                node->part_self = i;
+                                node->penetration[0] = pt.m_normalWorldOnB[0];
+                                node->penetration[1] = pt.m_normalWorldOnB[1];
+                                node->penetration[2] = pt.m_normalWorldOnB[2];
+                                node->penetration[3] = dist * directionSign;
+                                node->point[0] = pt.m_positionWorldOnA[0];
+                                node->point[1] = pt.m_positionWorldOnA[1];
+                                node->point[2] = pt.m_positionWorldOnA[2];
+                                node->next = NULL;
+                                node->next_bucket = NULL;
+
+                                *cn = node;
+                                cn = &(node->next);
                             }
                         }
                     }
@@ -813,12 +1273,11 @@ collision_node_p Physics_GetGhostCurrentCollision(struct physics_data_s *physics
         physics->manifoldArray->clear();
     }
 
-    if(*cn)
-    {
-        (*cn)->obj = NULL;
-    }
+    cache->epoch = bt_engine_collision_epoch;
+    cache->filter = filter;
+    cache->result = ret;
 
-    return physics->collision_track;
+    return ret;
 }
 
 
@@ -1198,6 +1657,7 @@ btCollisionShape *BT_CSfromHeightmap(struct room_sector_s *heightmap, uint32_t s
 
 void Physics_GenRigidBody(struct physics_data_s *physics, struct ss_bone_frame_s *bf)
 {
+    BT_CollisionWorldChanged();
     btVector3 localInertia(0, 0, 0);
     btTransform startTransform;
     btCollisionShape *cshape = NULL;
@@ -1313,6 +1773,7 @@ void Physics_GenRigidBody(struct physics_data_s *physics, struct ss_bone_frame_s
 
 void Physics_DeleteRigidBody(struct physics_data_s *physics)
 {
+    BT_CollisionWorldChanged();
     if(physics->bt_body)
     {
         for(int i = 0; i < physics->objects_count; i++)
@@ -1348,6 +1809,9 @@ void Physics_DeleteRigidBody(struct physics_data_s *physics)
  */
 void Physics_CreateGhosts(struct physics_data_s *physics, struct ss_bone_frame_s *bf, struct ghost_shape_s *shape_info)
 {
+    BT_CollisionWorldChanged();
+    free(physics->ghost_cache);
+    physics->ghost_cache = NULL;
     if(physics->objects_count > 0)
     {
         btTransform tr;
@@ -1462,6 +1926,7 @@ void Physics_CreateGhosts(struct physics_data_s *physics, struct ss_bone_frame_s
 
 void Physics_SetGhostCollisionShape(struct physics_data_s *physics, struct ss_bone_frame_s *bf, uint16_t index, struct ghost_shape_s *shape_info)
 {
+    BT_CollisionWorldChanged();
     if(physics->ghost_objects && (index < physics->objects_count) && physics->ghost_objects[index])
     {
         btCollisionShape *new_shape = NULL;
@@ -1515,6 +1980,7 @@ void Physics_SetGhostCollisionShape(struct physics_data_s *physics, struct ss_bo
 
 void Physics_GenStaticMeshRigidBody(struct static_mesh_s *smesh)
 {
+    BT_CollisionWorldChanged();
     btCollisionShape *cshape = NULL;
 
     if(smesh->self->collision_group == COLLISION_NONE)
@@ -1565,6 +2031,7 @@ void Physics_GenStaticMeshRigidBody(struct static_mesh_s *smesh)
 
 struct physics_object_s* Physics_GenRoomRigidBody(struct room_s *room, struct room_sector_s *heightmap, uint32_t sectors_count, struct sector_tween_s *tweens, int num_tweens)
 {
+    BT_CollisionWorldChanged();
     btCollisionShape *cshape = BT_CSfromHeightmap(heightmap, sectors_count, tweens, num_tweens, true, true);
     struct physics_object_s *ret = NULL;
 
@@ -1599,6 +2066,7 @@ void Physics_SetOwnerObject(struct physics_object_s *obj, struct engine_containe
 
 void Physics_DeleteObject(struct physics_object_s *obj)
 {
+    BT_CollisionWorldChanged();
     if(obj)
     {
         obj->bt_body->setUserPointer(NULL);
@@ -1622,6 +2090,7 @@ void Physics_DeleteObject(struct physics_object_s *obj)
 
 void Physics_EnableObject(struct physics_object_s *obj)
 {
+    BT_CollisionWorldChanged();
     if(obj->bt_body && !obj->bt_body->isInWorld())
     {
         bt_engine_dynamicsWorld->addRigidBody(obj->bt_body, btBroadphaseProxy::StaticFilter, btBroadphaseProxy::AllFilter);
@@ -1631,6 +2100,7 @@ void Physics_EnableObject(struct physics_object_s *obj)
 
 void Physics_DisableObject(struct physics_object_s *obj)
 {
+    BT_CollisionWorldChanged();
     if(obj->bt_body && obj->bt_body->isInWorld())
     {
         bt_engine_dynamicsWorld->removeRigidBody(obj->bt_body);
@@ -1645,6 +2115,7 @@ void Physics_DisableObject(struct physics_object_s *obj)
  */
 void Physics_EnableCollision(struct physics_data_s *physics)
 {
+    BT_CollisionWorldChanged();
     if(physics->bt_body)
     {
         for(uint32_t i = 0; i < physics->objects_count; i++)
@@ -1667,6 +2138,7 @@ void Physics_EnableCollision(struct physics_data_s *physics)
 
 void Physics_DisableCollision(struct physics_data_s *physics)
 {
+    BT_CollisionWorldChanged();
     if(physics->bt_body != NULL)
     {
         for(uint32_t i = 0; i < physics->objects_count; i++)
@@ -1689,6 +2161,7 @@ void Physics_DisableCollision(struct physics_data_s *physics)
 
 void Physics_SetBoneCollision(struct physics_data_s *physics, int bone_index, int collision)
 {
+    BT_CollisionWorldChanged();
     if(physics->bt_body && (bone_index >= 0) && (bone_index < physics->objects_count))
     {
         btRigidBody *b = physics->bt_body[bone_index];
@@ -1704,6 +2177,7 @@ void Physics_SetBoneCollision(struct physics_data_s *physics, int bone_index, in
 
 void Physics_SetCollisionGroupAndMask(struct physics_data_s *physics, int16_t group, int16_t mask)
 {
+    BT_CollisionWorldChanged();
     if(physics->bt_body != NULL)
     {
         physics->collision_group = (group & (COLLISION_GROUP_STATIC_OBLECT | COLLISION_GROUP_STATIC_ROOM)) ? (btBroadphaseProxy::StaticFilter) : 0x0000;
@@ -1733,6 +2207,7 @@ void Physics_SetCollisionGroupAndMask(struct physics_data_s *physics, int16_t gr
 
 void Physics_SetCollisionScale(struct physics_data_s *physics, float scaling[3])
 {
+    BT_CollisionWorldChanged();
     for(int i = 0; i < physics->objects_count; i++)
     {
         bt_engine_dynamicsWorld->removeRigidBody(physics->bt_body[i]);
@@ -1746,6 +2221,7 @@ void Physics_SetCollisionScale(struct physics_data_s *physics, float scaling[3])
 
 void Physics_SetBodyMass(struct physics_data_s *physics, float mass, uint16_t index)
 {
+    BT_CollisionWorldChanged();
     btVector3 inertia (0.0, 0.0, 0.0);
     bt_engine_dynamicsWorld->removeRigidBody(physics->bt_body[index]);
 
@@ -1811,6 +2287,7 @@ typedef struct hair_s
 
 struct hair_s *Hair_Create(struct hair_setup_s *setup, struct physics_data_s *physics)
 {
+    BT_CollisionWorldChanged();
     // No setup or parent to link to - bypass function.
 
     if(!physics || !setup || (setup->link_body >= physics->objects_count) ||
@@ -1995,6 +2472,7 @@ struct hair_s *Hair_Create(struct hair_setup_s *setup, struct physics_data_s *ph
 
 void Hair_Delete(struct hair_s *hair)
 {
+    BT_CollisionWorldChanged();
     if(hair)
     {
         for(int i = 0; i < hair->element_count; i++)
@@ -2055,7 +2533,7 @@ int Hair_GetElementsCount(struct hair_s *hair)
 
 void Hair_GetElementInfo(struct hair_s *hair, int element, struct base_mesh_s **mesh, float tr[16])
 {
-    hair->elements[element].body->getWorldTransform().getOpenGLMatrix(tr);
+    BT_GetRenderTransform(hair->elements[element].body, tr);
     *mesh = hair->elements[element].mesh;
 }
 
@@ -2066,6 +2544,7 @@ void Hair_GetElementInfo(struct hair_s *hair, int element, struct base_mesh_s **
 
 bool Ragdoll_Create(struct physics_data_s *physics, struct ss_bone_frame_s *bf, struct rd_setup_s *setup)
 {
+    BT_CollisionWorldChanged();
     // No entity, setup or body count overflow - bypass function.
 
     if(!physics || !setup || (setup->body_count > physics->objects_count))
@@ -2127,6 +2606,7 @@ bool Ragdoll_Create(struct physics_data_s *physics, struct ss_bone_frame_s *bf,
         bt_engine_dynamicsWorld->addRigidBody(physics->bt_body[i], btBroadphaseProxy::CharacterFilter, btBroadphaseProxy::CharacterFilter | btBroadphaseProxy::StaticFilter | btBroadphaseProxy::KinematicFilter);
         physics->bt_body[i]->activate();
         physics->bt_body[i]->setLinearVelocity(btVector3(0.0, 0.0, 0.0));
+        physics->bt_body[i]->setAngularVelocity(btVector3(0.0, 0.0, 0.0));
     }
 
     // Setup constraints.
@@ -2209,6 +2689,7 @@ bool Ragdoll_Create(struct physics_data_s *physics, struct ss_bone_frame_s *bf,
 
 bool Ragdoll_Delete(struct physics_data_s *physics)
 {
+    BT_CollisionWorldChanged();
     if(physics->bt_joint_count == 0)
     {
         return false;
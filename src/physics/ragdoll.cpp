@@ -277,9 +277,9 @@ struct rd_setup_s *Ragdoll_AutoCreateSetup(struct skeletal_model_s *model, uint1
     struct rd_setup_s *setup = NULL;
     if(model && (anim < model->animation_count) && (frame < model->animations[anim].frames_count))
     {
-        bone_frame_p bf = model->animations[anim].frames + frame;
+        animation_frame_p af = model->animations + anim;
         rd_joint_setup_p js;
-        float tr[16], t;
+        float tr[16], q[4], t;
         setup = (rd_setup_p)malloc(sizeof(rd_setup_t));
 
         setup->body_count  = model->mesh_count;
@@ -309,20 +309,21 @@ struct rd_setup_s *Ragdoll_AutoCreateSetup(struct skeletal_model_s *model, uint1
         {
             if(model->mesh_tree[i].parent != i)
             {
-                bone_tag_p b_tag = bf->bone_tags + i;
+                const float *offset = af->bone_offsets + 3 * i;
+                Anim_GetBoneRotation(af, frame, i, q);
                 part = (model->mesh_tree[i].body_part) ? (model->mesh_tree[i].body_part) : (part);
                 js->body_index = i;
                 js->body1_offset[0] = 0.0f;
                 js->body1_offset[1] = 0.0f;
                 js->body1_offset[2] = 0.0f;
-                js->body2_offset[0] = b_tag->offset[0];
-                js->body2_offset[1] = b_tag->offset[1];
-                js->body2_offset[2] = b_tag->offset[2];
+                js->body2_offset[0] = offset[0];
+                js->body2_offset[1] = offset[1];
+                js->body2_offset[2] = offset[2];
                 js->body1_angle[0] = 0.0f;
                 js->body1_angle[1] = 0.0f;
                 js->body1_angle[2] = 0.0f;
                 Mat4_E_macro(tr);
-                Mat4_RotateRByQuaternion(tr, b_tag->qrotate);
+                Mat4_RotateRByQuaternion(tr, q);
                 Mat4_GetAnglesZXY(js->body2_angle, tr);
                 SWAPT(js->body2_angle[1], js->body2_angle[2], t);
                 
@@ -493,6 +493,11 @@ unsigned long bordered_texture_atlas::getNumAtlasPages() const
     return number_result_pages;
 }
 
+unsigned long bordered_texture_atlas::getPageWidth() const
+{
+    return result_page_width;
+}
+
 void bordered_texture_atlas::createTextures(GLuint *textureNames)
 {
     GLubyte *data = (GLubyte *) malloc(4 * result_page_width * result_page_width);
@@ -166,6 +166,11 @@ public:
      * layout if none has happened so far.
      */
     unsigned long getNumAtlasPages() const;
+
+    /*!
+     * Returns width (and maximal height) of texture atlas pages.
+     */
+    unsigned long getPageWidth() const;
     
     /*!
      * Returns height of specified file object texture.
@@ -8,53 +8,166 @@
 #include "../core/gl_util.h"
 #include "../core/vmath.h"
 #include "../core/polygon.h"
+#include "../core/profiler.h"
 #include "bsp_tree.h"
 #include "frustum.h"
 
-#define NEED_REALLOC_TREE_BUFF        (1)
-#define NEED_REALLOC_VERTEX_BUFF      (2)
-#define NEED_REALLOC_TEMP_BUFF        (3)
+#define BSP_MEM_ALIGN                 (sizeof(void*))
+#define BSP_MIN_BLOCK_SIZE            (8192)
+
+
+void CDynamicBSP::MemChainInit(struct bsp_mem_chain_s *chain, uint32_t block_size)
+{
+    chain->block_size = (block_size < BSP_MIN_BLOCK_SIZE) ? (BSP_MIN_BLOCK_SIZE) : (block_size);
+    chain->first = (bsp_mem_block_p)malloc(sizeof(bsp_mem_block_t));
+    chain->first->next = NULL;
+    chain->first->size = chain->block_size;
+    chain->first->used = 0;
+    chain->first->data = (uint8_t*)malloc(chain->block_size);
+    chain->current = chain->first;
+    chain->used = 0;
+    chain->peak = 0;
+    chain->high_water = 0;
+}
+
+
+void CDynamicBSP::MemChainFree(struct bsp_mem_chain_s *chain)
+{
+    while(chain->first)
+    {
+        bsp_mem_block_p next = chain->first->next;
+        free(chain->first->data);
+        free(chain->first);
+        chain->first = next;
+    }
+    chain->current = NULL;
+    chain->used = 0;
+}
+
+
+void CDynamicBSP::MemChainRewind(struct bsp_mem_chain_s *chain)
+{
+    chain->peak = (chain->used > chain->peak) ? (chain->used) : (chain->peak);
+    chain->current = chain->first;
+    chain->first->used = 0;
+    chain->used = 0;
+}
+
+/*
+ * Rewinds the chain and makes it one block if the last frames did not fit
+ * in the first one (or used much less than it).
+ */
+void CDynamicBSP::MemChainReset(struct bsp_mem_chain_s *chain)
+{
+    uint32_t peak;
+    MemChainRewind(chain);
+    peak = chain->peak;
+    chain->peak = 0;
+    chain->high_water -= chain->high_water / 16;                                // decay, so rare peaks do not hold memory forever
+    chain->high_water = (peak > chain->high_water) ? (peak) : (chain->high_water);
+
+    if((chain->first->next != NULL) || (chain->first->size / 4 > chain->high_water + chain->block_size))
+    {
+        uint32_t size = chain->high_water + chain->high_water / 4;
+        size = (size < chain->block_size) ? (chain->block_size) : (size);
+        MemChainFree(chain);
+        chain->first = (bsp_mem_block_p)malloc(sizeof(bsp_mem_block_t));
+        chain->first->next = NULL;
+        chain->first->size = size;
+        chain->first->used = 0;
+        chain->first->data = (uint8_t*)malloc(size);
+        chain->current = chain->first;
+    }
+}
+
+
+void *CDynamicBSP::MemChainAlloc(struct bsp_mem_chain_s *chain, uint32_t size)
+{
+    bsp_mem_block_p block = chain->current;
+    void *ret;
+
+    size = (size + BSP_MEM_ALIGN - 1) & ~(BSP_MEM_ALIGN - 1);
+    if(block->used + size > block->size)
+    {
+        chain->used += block->size - block->used;                               // tail of the block is lost
+        if((block->next == NULL) || (block->next->size < size))
+        {
+            bsp_mem_block_p new_block = (bsp_mem_block_p)malloc(sizeof(bsp_mem_block_t));
+            new_block->size = (size > chain->block_size) ? (size) : (chain->block_size);
+            new_block->data = (uint8_t*)malloc(new_block->size);
+            new_block->next = block->next;
+            block->next = new_block;
+        }
+        block = block->next;
+        block->used = 0;
+        chain->current = block;
+    }
+
+    ret = block->data + block->used;
+    block->used += size;
+    chain->used += size;
+    return ret;
+}
+
+
+uint32_t CDynamicBSP::MemChainAllocated(struct bsp_mem_chain_s *chain)
+{
+    uint32_t ret = 0;
+    for(bsp_mem_block_p block = chain->first; block; block = block->next)
+    {
+        ret += block->size;
+    }
+    return ret;
+}
+
 
 struct bsp_node_s *CDynamicBSP::CreateBSPNode()
 {
-    bsp_node_p ret = (bsp_node_p)(m_tree_buffer + m_tree_allocated);
-    m_tree_allocated += sizeof(bsp_node_t);
+    bsp_node_p ret = (bsp_node_p)MemChainAlloc(&m_tree_mem, sizeof(bsp_node_t));
+    m_nodes++;
     ret->front = NULL;
     ret->back = NULL;
     ret->polygons_front = NULL;
     ret->polygons_back = NULL;
+    ret->frame = 0;
+    ret->dynamic_front = NULL;
+    ret->dynamic_back = NULL;
     return ret;
 }
 
 
 struct polygon_s *CDynamicBSP::CreatePolygon(uint16_t vertex_count)
 {
-    polygon_p ret = (polygon_p)(m_temp_buffer + m_temp_allocated);
-    m_temp_allocated += sizeof(polygon_t);
+    polygon_p ret = (polygon_p)MemChainAlloc(&m_temp_mem, sizeof(polygon_t));
     ret->next = NULL;
     ret->vertex_count = vertex_count;
-    ret->vertices = (vertex_p)(m_temp_buffer + m_temp_allocated);
-    m_temp_allocated += vertex_count * sizeof(vertex_t);
+    ret->vertices = (vertex_p)MemChainAlloc(&m_temp_mem, vertex_count * sizeof(vertex_t));
     return ret;
 }
 
 
 void CDynamicBSP::AddBSPPolygon(struct bsp_node_s *leaf, struct polygon_s *p)
 {
-    if(m_realloc_state || (m_vertex_allocated + p->vertex_count >= m_vertex_buffer_size))
+    if(m_vertex_allocated + p->vertex_count >= m_vertex_buffer_size)
     {
-        m_realloc_state = NEED_REALLOC_VERTEX_BUFF;
-        return;
+        // polygons refer vertices by indexes, so the array may be moved
+        while(m_vertex_allocated + p->vertex_count >= m_vertex_buffer_size)
+        {
+            m_vertex_buffer_size *= 2;
+        }
+        m_vertex_buffer = (vertex_p)realloc(m_vertex_buffer, m_vertex_buffer_size * sizeof(vertex_t));
     }
 
-    bsp_polygon_p bp = (bsp_polygon_p)(m_tree_buffer + m_tree_allocated);
-    m_tree_allocated  += sizeof(bsp_polygon_t);
+    bsp_polygon_p bp = (bsp_polygon_p)MemChainAlloc(&m_tree_mem, sizeof(bsp_polygon_t));
     bp->texture_index  = p->texture_index;
     bp->transparency   = p->transparency;
     bp->vertex_count   = p->vertex_count;
+    bp->anim_id        = p->anim_id;
+    bp->frame_offset   = p->frame_offset;
+    bp->tex_coords     = NULL;
+    bp->next_animated  = NULL;
 
-    bp->indexes        = (GLuint*)(m_tree_buffer + m_tree_allocated);
-    m_tree_allocated  += p->vertex_count * sizeof(GLint);
+    bp->indexes        = (GLuint*)MemChainAlloc(&m_tree_mem, p->vertex_count * sizeof(GLuint));
 
     //vertex_p v = m_vertex_buffer + m_vertex_allocated;
     //vertex_p pv = p->vertices;
@@ -65,6 +178,18 @@ void CDynamicBSP::AddBSPPolygon(struct bsp_node_s *leaf, struct polygon_s *p)
         //*v  = *pv;
     }
 
+    if(m_is_static && (p->anim_id > 0))
+    {
+        bp->tex_coords = (GLfloat*)MemChainAlloc(&m_tree_mem, p->vertex_count * sizeof(GLfloat [2]));
+        for(uint16_t i = 0; i < p->vertex_count; i++)
+        {
+            bp->tex_coords[2 * i + 0] = p->vertices[i].tex_coord[0];
+            bp->tex_coords[2 * i + 1] = p->vertices[i].tex_coord[1];
+        }
+        bp->next_animated = m_animated_polygons;
+        m_animated_polygons = bp;
+    }
+
     if(vec3_dot(p->plane, leaf->plane) > 0.9)
     {
         bp->next = leaf->polygons_front;
@@ -81,23 +206,6 @@ void CDynamicBSP::AddBSPPolygon(struct bsp_node_s *leaf, struct polygon_s *p)
 
 void CDynamicBSP::AddPolygon(struct bsp_node_s *root, struct polygon_s *p)
 {
-    if(m_realloc_state)
-    {
-        return;
-    }
-
-    if(m_tree_allocated + 1024 > m_tree_buffer_size)
-    {
-        m_realloc_state = NEED_REALLOC_TREE_BUFF;
-        return;
-    }
-
-    if(m_temp_allocated + 1024 > m_temp_buffer_size)
-    {
-        m_realloc_state = NEED_REALLOC_TEMP_BUFF;
-        return;
-    }
-
     if(root->polygons_front == NULL)
     {
         // we though root->front == NULL and root->back == NULL
@@ -157,6 +265,7 @@ void CDynamicBSP::AddPolygon(struct bsp_node_s *root, struct polygon_s *p)
         back = this->CreatePolygon(p->vertex_count + 2);
         back->vertex_count = 0;
         Polygon_Split(p, root->plane, front, back);
+        m_splits++;
 
         if(root->front == NULL)
         {
@@ -172,17 +281,111 @@ void CDynamicBSP::AddPolygon(struct bsp_node_s *root, struct polygon_s *p)
 }
 
 
-CDynamicBSP::CDynamicBSP(uint32_t size)
+struct bsp_node_s *CDynamicBSP::GetDynamicSubtree(struct bsp_node_s *node, bool front)
 {
-    size = (size < 8192)?(8192):(size);
+    bsp_node_p *subtree;
+    if(node->frame != m_frame)
+    {
+        node->frame = m_frame;
+        node->dynamic_front = NULL;
+        node->dynamic_back = NULL;
+    }
+    subtree = (front) ? (&node->dynamic_front) : (&node->dynamic_back);
+    if(*subtree == NULL)
+    {
+        *subtree = this->CreateBSPNode();
+    }
+    return *subtree;
+}
 
-    m_temp_buffer = (uint8_t*)malloc(size);
-    m_temp_buffer_size = size;
-    m_temp_allocated = 0;
+/*
+ * Goes down the static tree by its planes; polygon (or its parts) is added to
+ * the dynamic subtree of the first missing static child. Polygons in the
+ * static node plane go to the front side.
+ */
+void CDynamicBSP::AddPolygonToTree(struct bsp_node_s *node, struct polygon_s *p)
+{
+    if(node->polygons_front == NULL)                        // empty static tree
+    {
+        this->AddPolygon(this->GetDynamicSubtree(node, true), p);
+        return;
+    }
 
-    m_tree_buffer = (uint8_t*)malloc(size);
-    m_tree_buffer_size = size;
-    m_tree_allocated = 0;
+    uint16_t positive = 0;
+    uint16_t negative = 0;
+    float dist;
+    vertex_p v = p->vertices;
+    for(uint16_t i = 0; i < p->vertex_count; i++, v++)
+    {
+        dist = vec3_plane_dist(node->plane, v->position);
+        if (dist > SPLIT_EPSILON)
+        {
+            positive++;
+        }
+        else if (dist < -SPLIT_EPSILON)
+        {
+            negative++;
+        }
+    }
+
+    if(negative == 0)                                       // SPLIT_FRONT or SPLIT_IN_PLANE
+    {
+        if(node->front != NULL)
+        {
+            this->AddPolygonToTree(node->front, p);
+        }
+        else
+        {
+            this->AddPolygon(this->GetDynamicSubtree(node, true), p);
+        }
+    }
+    else if(positive == 0)                                  // SPLIT_BACK
+    {
+        if(node->back != NULL)
+        {
+            this->AddPolygonToTree(node->back, p);
+        }
+        else
+        {
+            this->AddPolygon(this->GetDynamicSubtree(node, false), p);
+        }
+    }
+    else                                                    // SPLIT_IN_BOTH
+    {
+        polygon_p front, back;
+        front = this->CreatePolygon(p->vertex_count + 2);
+        front->vertex_count = 0;
+        back = this->CreatePolygon(p->vertex_count + 2);
+        back->vertex_count = 0;
+        Polygon_Split(p, node->plane, front, back);
+        m_splits++;
+
+        if(node->front != NULL)
+        {
+            this->AddPolygonToTree(node->front, front);
+        }
+        else
+        {
+            this->AddPolygon(this->GetDynamicSubtree(node, true), front);
+        }
+        if(node->back != NULL)
+        {
+            this->AddPolygonToTree(node->back, back);
+        }
+        else
+        {
+            this->AddPolygon(this->GetDynamicSubtree(node, false), back);
+        }
+    }
+}
+
+
+CDynamicBSP::CDynamicBSP(uint32_t size, bool is_static)
+{
+    size = (size < BSP_MIN_BLOCK_SIZE)?(BSP_MIN_BLOCK_SIZE):(size);
+
+    MemChainInit(&m_temp_mem, size / 4);
+    MemChainInit(&m_tree_mem, size);
 
     size /= 64;
     m_vertex_buffer = (vertex_p)malloc(size * sizeof(vertex_t));
@@ -191,10 +394,14 @@ CDynamicBSP::CDynamicBSP(uint32_t size)
 
     m_input_polygons = 0;
     m_added_polygons = 0;
+    m_splits = 0;
+    m_nodes = 0;
 
     m_vbo = 0;
     m_anim_seq = NULL;
-    m_realloc_state = 0;
+    m_is_static = is_static;
+    m_frame = 1;
+    m_animated_polygons = NULL;
     m_root = this->CreateBSPNode();
 }
 
@@ -207,19 +414,8 @@ CDynamicBSP::~CDynamicBSP()
         m_vbo = 0;
     }
 
-    if(m_tree_buffer)
-    {
-        free(m_tree_buffer);
-        m_tree_buffer = NULL;
-    }
-    m_tree_buffer_size = 0;
-
-    if(m_temp_buffer)
-    {
-        free(m_temp_buffer);
-        m_temp_buffer = NULL;
-    }
-    m_temp_buffer_size = 0;
+    MemChainFree(&m_tree_mem);
+    MemChainFree(&m_temp_mem);
 
     if(m_vertex_buffer)
     {
@@ -228,76 +424,93 @@ CDynamicBSP::~CDynamicBSP()
     }
     m_vertex_buffer_size = 0;
 
-    m_realloc_state = 0;
     m_anim_seq = NULL;
     m_root = NULL;
 }
 
 
-void CDynamicBSP::AddNewPolygonList(struct polygon_s *p, float transform[16], struct frustum_s *f)
+/*
+ * Makes transformed copy of the polygon in the temp buffer; returns NULL if
+ * it is out of all frustums.
+ */
+struct polygon_s *CDynamicBSP::PreparePolygon(struct polygon_s *p, float transform[16], struct frustum_s *f)
 {
-    for( ; p && (!m_realloc_state); p = p->next)
+    MemChainRewind(&m_temp_mem);
+    polygon_p np = this->CreatePolygon(p->vertex_count);
+    bool visible = (f == NULL);
+    vertex_p src_v, dst_v;
+
+    np->anim_id = p->anim_id;
+    np->frame_offset = p->frame_offset;
+    np->double_side  = p->double_side;
+
+    np->transparency = p->transparency;
+
+    Mat4_vec3_rot_macro(np->plane, transform, p->plane);
+    for(uint16_t i = 0; i < p->vertex_count; i++)
     {
-        m_temp_allocated = 0;
-        polygon_p np = this->CreatePolygon(p->vertex_count);
-        bool visible = (f == NULL);
-        vertex_p src_v, dst_v;
+        src_v = p->vertices + i;
+        dst_v = np->vertices + i;
+        Mat4_vec3_mul_macro(dst_v->position, transform, src_v->position);
+    }
+    np->plane[3] = -vec3_dot(np->plane, np->vertices[0].position);
 
-        np->anim_id = p->anim_id;
-        np->frame_offset = p->frame_offset;
-        np->double_side  = p->double_side;
+    for(frustum_p ff = f; (!visible) && ff; ff = ff->next)
+    {
+        if(Frustum_IsPolyVisible(np, ff, false))
+        {
+            visible = true;
+            break;
+        }
+    }
+
+    if(!visible)
+    {
+        return NULL;
+    }
 
-        np->transparency = p->transparency;
+    if((p->anim_id > 0) && !m_is_static)
+    {
+        anim_seq_p seq = m_anim_seq + p->anim_id - 1;
+        uint16_t frame = (seq->current_frame + p->frame_offset) % seq->frames_count;
+        tex_frame_p tf = seq->frames + frame;
+        np->texture_index = tf->texture_index;
 
-        Mat4_vec3_rot_macro(np->plane, transform, p->plane);
         for(uint16_t i = 0; i < p->vertex_count; i++)
         {
             src_v = p->vertices + i;
             dst_v = np->vertices + i;
-            Mat4_vec3_mul_macro(dst_v->position, transform, src_v->position);
+            Mat4_vec3_rot_macro(dst_v->normal, transform, src_v->normal);
+            vec4_copy(dst_v->color, src_v->color);
+            ApplyAnimTextureTransformation(dst_v->tex_coord, src_v->tex_coord, tf);
         }
-        np->plane[3] = -vec3_dot(np->plane, np->vertices[0].position);
-
-        for(frustum_p ff = f; (!visible) && ff; ff = ff->next)
+    }
+    else
+    {
+        np->texture_index = p->texture_index;
+        for(uint16_t i = 0; i < p->vertex_count; i++)
         {
-            if(Frustum_IsPolyVisible(np, ff, false))
-            {
-                visible = true;
-                break;
-            }
+            src_v = p->vertices + i;
+            dst_v = np->vertices + i;
+            Mat4_vec3_rot_macro(dst_v->normal, transform, src_v->normal);
+            vec4_copy(dst_v->color, src_v->color);
+            dst_v->tex_coord[0] = src_v->tex_coord[0];
+            dst_v->tex_coord[1] = src_v->tex_coord[1];
         }
+    }
+
+    return np;
+}
 
-        if(visible)
+
+void CDynamicBSP::AddNewPolygonList(struct polygon_s *p, float transform[16], struct frustum_s *f)
+{
+    PROF_ZONE("CDynamicBSP::AddNewPolygonList");
+    for( ; p; p = p->next)
+    {
+        polygon_p np = this->PreparePolygon(p, transform, f);
+        if(np)
         {
-            if(p->anim_id > 0)
-            {
-                anim_seq_p seq = m_anim_seq + p->anim_id - 1;
-                uint16_t frame = (seq->current_frame + p->frame_offset) % seq->frames_count;
-                tex_frame_p tf = seq->frames + frame;
-                np->texture_index = tf->texture_index;
-
-                for(uint16_t i = 0; i < p->vertex_count; i++)
-                {
-                    src_v = p->vertices + i;
-                    dst_v = np->vertices + i;
-                    Mat4_vec3_rot_macro(dst_v->normal, transform, src_v->normal);
-                    vec4_copy(dst_v->color, src_v->color);
-                    ApplyAnimTextureTransformation(dst_v->tex_coord, src_v->tex_coord, tf);
-                }
-            }
-            else
-            {
-                np->texture_index = p->texture_index;
-                for(uint16_t i = 0; i < p->vertex_count; i++)
-                {
-                    src_v = p->vertices + i;
-                    dst_v = np->vertices + i;
-                    Mat4_vec3_rot_macro(dst_v->normal, transform, src_v->normal);
-                    vec4_copy(dst_v->color, src_v->color);
-                    dst_v->tex_coord[0] = src_v->tex_coord[0];
-                    dst_v->tex_coord[1] = src_v->tex_coord[1];
-                }
-            }
             m_input_polygons++;
             this->AddPolygon(m_root, np);
         }
@@ -305,61 +518,71 @@ void CDynamicBSP::AddNewPolygonList(struct polygon_s *p, float transform[16], st
 }
 
 
-void CDynamicBSP::Reset(struct anim_seq_s *seq)
+void CDynamicBSP::AddNewPolygonListToTree(struct polygon_s *p, float transform[16], struct frustum_s *f, struct bsp_node_s *tree)
 {
-    if(m_vbo == 0)
+    PROF_ZONE("CDynamicBSP::AddNewPolygonListToTree");
+    for( ; p; p = p->next)
     {
-        qglGenBuffersARB(1, &m_vbo);
+        polygon_p np = this->PreparePolygon(p, transform, f);
+        if(np)
+        {
+            m_input_polygons++;
+            this->AddPolygonToTree(tree, np);
+        }
     }
+}
 
-    switch(m_realloc_state)
+
+/*
+ * Static tree: applies current frames of animated textures to the vertices
+ * of animated polygons; returns true if vertex array was changed.
+ */
+bool CDynamicBSP::UpdateAnimTextures()
+{
+    for(bsp_polygon_p bp = m_animated_polygons; bp; bp = bp->next_animated)
     {
-        case NEED_REALLOC_TREE_BUFF:
-            {
-                uint32_t new_buffer_size = m_tree_buffer_size * 1.5;
-                uint8_t *new_buffer = (uint8_t*)malloc(new_buffer_size * sizeof(uint8_t));
-                if(new_buffer != NULL)
-                {
-                    free(m_tree_buffer);
-                    m_tree_buffer = new_buffer;
-                    m_tree_buffer_size = new_buffer_size;
-                }
-            }
-            break;
+        anim_seq_p seq = m_anim_seq + bp->anim_id - 1;
+        uint16_t frame = (seq->current_frame + bp->frame_offset) % seq->frames_count;
+        tex_frame_p tf = seq->frames + frame;
+        bp->texture_index = tf->texture_index;
+        for(uint16_t i = 0; i < bp->vertex_count; i++)
+        {
+            ApplyAnimTextureTransformation(m_vertex_buffer[bp->indexes[i]].tex_coord, bp->tex_coords + 2 * i, tf);
+        }
+    }
 
-        case NEED_REALLOC_TEMP_BUFF:
-            {
-                uint32_t new_buffer_size = m_temp_buffer_size * 1.5;
-                uint8_t *new_buffer = (uint8_t*)malloc(new_buffer_size * sizeof(uint8_t));
-                if(new_buffer != NULL)
-                {
-                    free(m_temp_buffer);
-                    m_temp_buffer = new_buffer;
-                    m_temp_buffer_size = new_buffer_size;
-                }
-            }
-            break;
+    return m_animated_polygons != NULL;
+}
 
-        case NEED_REALLOC_VERTEX_BUFF:
-            {
-                uint32_t new_buffer_size = m_vertex_buffer_size * 1.5;
-                vertex_p new_buffer = (vertex_p)malloc(new_buffer_size * sizeof(vertex_t));
-                if(new_buffer != NULL)
-                {
-                    free(m_vertex_buffer);
-                    m_vertex_buffer = new_buffer;
-                    m_vertex_buffer_size = new_buffer_size;
-                }
-            }
-            break;
-    };
+
+void CDynamicBSP::Reset(struct anim_seq_s *seq)
+{
+    if(m_vbo == 0)
+    {
+        qglGenBuffersARB(1, &m_vbo);
+    }
+
+    MemChainReset(&m_tree_mem);
+    MemChainReset(&m_temp_mem);
 
     m_anim_seq = seq;
-    m_temp_allocated = 0;
-    m_tree_allocated = 0;
     m_vertex_allocated = 0;
-    m_realloc_state = 0;
     m_input_polygons = 0;
     m_added_polygons = 0;
+    m_splits = 0;
+    m_nodes = 0;
+    m_frame = (m_frame + 1) ? (m_frame + 1) : (1);
+    m_animated_polygons = NULL;
     m_root = this->CreateBSPNode();
 }
+
+uint32_t CDynamicBSP::GetUsedBytes()
+{
+    uint32_t temp = (m_temp_mem.used > m_temp_mem.peak) ? (m_temp_mem.used) : (m_temp_mem.peak);
+    return m_tree_mem.used + temp + m_vertex_allocated * sizeof(vertex_t);
+}
+
+uint32_t CDynamicBSP::GetAllocatedBytes()
+{
+    return MemChainAllocated(&m_tree_mem) + MemChainAllocated(&m_temp_mem) + m_vertex_buffer_size * sizeof(vertex_t);
+}
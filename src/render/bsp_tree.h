@@ -16,8 +16,12 @@ typedef struct bsp_polygon_s
     GLuint                 *indexes;                                            // vertices indexes
     uint16_t                texture_index;                                      // texture index
     uint16_t                transparency;                                       // transparency information
-    
+    uint16_t                anim_id;                                            // anim texture ID
+    uint16_t                frame_offset;                                       // anim texture frame offset
+    GLfloat                *tex_coords;                                         // source tex coords of animated polygon in static tree
+
     struct bsp_polygon_s   *next;                                               // polygon list (for BSP using)
+    struct bsp_polygon_s   *next_animated;                                      // animated polygons list of static tree
 } bsp_polygon_t, *bsp_polygon_p;
 
 
@@ -30,64 +34,132 @@ typedef struct bsp_node_s
     
     struct bsp_node_s      *front;
     struct bsp_node_s      *back;
+
+    uint32_t                frame;                                              // dynamic subtrees below are valid if equal to dynamic tree frame
+    struct bsp_node_s      *dynamic_front;                                      // dynamic subtrees in place of missing static children
+    struct bsp_node_s      *dynamic_back;
 } bsp_node_t, *bsp_node_p;
 
 
+/*
+ * Memory chain of blocks; allocations never move, so tree pointers stay
+ * valid while the chain grows. Rewind keeps blocks for the next use.
+ */
+typedef struct bsp_mem_block_s
+{
+    struct bsp_mem_block_s *next;
+    uint32_t                size;
+    uint32_t                used;
+    uint8_t                *data;
+} bsp_mem_block_t, *bsp_mem_block_p;
+
+typedef struct bsp_mem_chain_s
+{
+    struct bsp_mem_block_s *first;
+    struct bsp_mem_block_s *current;
+    uint32_t                block_size;                                         // size of new blocks
+    uint32_t                used;                                               // bytes in blocks before current + current used
+    uint32_t                peak;                                               // peak of used since last Reset
+    uint32_t                high_water;                                         // rolling peaks maximum
+} bsp_mem_chain_t, *bsp_mem_chain_p;
+
+
+/*
+ * Polygons BSP tree in chained buffers: nodes, polygons and split parts are
+ * never dropped, buffers grow inside of the frame and are sized on Reset()
+ * by the rolling high-water mark of previous frames. The dynamic (per frame)
+ * tree is rebuilt by Reset() every frame. A static tree is built once; its
+ * animated texture polygons keep source tex coords and are updated by
+ * UpdateAnimTextures(). Polygons of the dynamic tree may be attached to
+ * a static tree by AddNewPolygonListToTree(): they are classified by the
+ * static tree planes and go to dynamic subtrees in place of missing static
+ * children, so back to front traversal of the static tree draws both trees
+ * in right order.
+ */
 class CDynamicBSP
 {
-    uint8_t             *m_tree_buffer;
-    uint32_t             m_tree_buffer_size;
-    uint32_t             m_tree_allocated;
-    
-    uint8_t             *m_temp_buffer;
-    uint32_t             m_temp_buffer_size;
-    uint32_t             m_temp_allocated;
-    
-    struct vertex_s     *m_vertex_buffer;
+    struct bsp_mem_chain_s m_tree_mem;
+    struct bsp_mem_chain_s m_temp_mem;                                          // split polygons of the current input polygon
+
+    struct vertex_s     *m_vertex_buffer;                                       // addressed by indexes, so it may be reallocated
     uint32_t             m_vertex_buffer_size;
     uint32_t             m_vertex_allocated;
-    
-    uint32_t             m_realloc_state;
+
     struct anim_seq_s   *m_anim_seq;
-    
+    bool                 m_is_static;
+    uint32_t             m_frame;
+    struct bsp_polygon_s *m_animated_polygons;
+
     uint32_t             m_input_polygons;
     uint32_t             m_added_polygons;
-    
+    uint32_t             m_splits;
+    uint32_t             m_nodes;
+
     struct bsp_node_s     *CreateBSPNode();
     struct polygon_s      *CreatePolygon(uint16_t vertex_count);
     void AddBSPPolygon(struct bsp_node_s *leaf, struct polygon_s *p);
     void AddPolygon(struct bsp_node_s *root, struct polygon_s *p);
-    
+    void AddPolygonToTree(struct bsp_node_s *node, struct polygon_s *p);
+    struct bsp_node_s     *GetDynamicSubtree(struct bsp_node_s *node, bool front);
+    struct polygon_s      *PreparePolygon(struct polygon_s *p, float transform[16], struct frustum_s *f);
+
+    static void  MemChainInit(struct bsp_mem_chain_s *chain, uint32_t block_size);
+    static void  MemChainFree(struct bsp_mem_chain_s *chain);
+    static void  MemChainRewind(struct bsp_mem_chain_s *chain);
+    static void  MemChainReset(struct bsp_mem_chain_s *chain);
+    static void *MemChainAlloc(struct bsp_mem_chain_s *chain, uint32_t size);
+    static uint32_t MemChainAllocated(struct bsp_mem_chain_s *chain);
+
 public:
     struct bsp_node_s   *m_root;
     GLuint m_vbo;
-    
-    CDynamicBSP(uint32_t size);
+
+    CDynamicBSP(uint32_t size, bool is_static = false);
    ~CDynamicBSP();
-   
+
     void AddNewPolygonList(struct polygon_s *p, float transform[16], struct frustum_s *f);
+    void AddNewPolygonListToTree(struct polygon_s *p, float transform[16], struct frustum_s *f, struct bsp_node_s *tree);
+    bool UpdateAnimTextures();
     void Reset(struct anim_seq_s *seq);
-    
+
+    uint32_t GetFrame()
+    {
+        return m_frame;
+    }
+
     struct vertex_s *GetVertexArray()
     {
         return m_vertex_buffer;
     }
-    
+
     uint32_t GetActiveVertexCount()
     {
         return m_vertex_allocated;
     }
-    
+
     uint32_t GetInputPolygonsCount()
     {
         return m_input_polygons;
     }
-    
+
     uint32_t GetAddedPolygonsCount()
     {
         return m_added_polygons;
     }
+
+    uint32_t GetSplitsCount()
+    {
+        return m_splits;
+    }
+
+    uint32_t GetNodesCount()
+    {
+        return m_nodes;
+    }
+
+    uint32_t GetUsedBytes();                                                    // tree + peak of temp + vertices
+    uint32_t GetAllocatedBytes();
 };
 
 
-#endif
\ No newline at end of file
+#endif
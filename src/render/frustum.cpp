@@ -5,6 +5,7 @@
 
 #include "../core/system.h"
 #include "../core/vmath.h"
+#include "../core/vmath_simd.h"
 #include "../core/polygon.h"
 #include "../core/obb.h"
 #include "../room.h"
@@ -51,6 +52,26 @@ void CFrustumManager::Reset()
     }
 }
 
+/*
+ * Grows the buffer up front (by the room PVS estimation), so the first frames
+ * in big rooms do not lose frustums on reallocation.
+ */
+void CFrustumManager::Reserve(uint32_t buffer_size)
+{
+    if(buffer_size > m_buffer_size)
+    {
+        uint8_t *new_buffer = (uint8_t*)malloc(buffer_size * sizeof(uint8_t));
+        if(new_buffer != NULL)
+        {
+            free(m_buffer);
+            m_buffer = new_buffer;
+            m_buffer_size = buffer_size;
+            m_allocated = 0;
+            m_need_realloc = false;
+        }
+    }
+}
+
 frustum_p CFrustumManager::CreateFrustum()
 {
     if((!m_need_realloc) && (m_allocated + sizeof(frustum_t) < m_buffer_size))
@@ -462,6 +483,75 @@ bool Frustum_IsPolyVisible(struct polygon_s *p, struct frustum_s *frustum, bool
     return false;
 }
 
+/*
+ * Box vs 4 planes test: box is out if its most positive vertex (centre +
+ * projected extent) is behind any plane. Planes are in AoS order and are
+ * transposed to check all 4 at once; axes == NULL means AABB.
+ */
+static inline bool Frustum_IsBoxOutOf4Planes(const float planes[16], const float centre[3], const float *axes, const float extent[3])
+{
+    v4f_t p[4] = {v4f_load(planes), v4f_load(planes + 4), v4f_load(planes + 8), v4f_load(planes + 12)};
+    v4f_t dist, r;
+
+    v4f_transpose(p);
+    dist = v4f_madd(p[0], v4f_set1(centre[0]), p[3]);
+    dist = v4f_madd(p[1], v4f_set1(centre[1]), dist);
+    dist = v4f_madd(p[2], v4f_set1(centre[2]), dist);
+    if(axes == NULL)
+    {
+        r = v4f_mul(v4f_abs(p[0]), v4f_set1(extent[0]));
+        r = v4f_madd(v4f_abs(p[1]), v4f_set1(extent[1]), r);
+        r = v4f_madd(v4f_abs(p[2]), v4f_set1(extent[2]), r);
+    }
+    else
+    {
+        r = v4f_set1(0.0f);
+        for(int i = 0; i < 3; ++i, axes += 4)
+        {
+            v4f_t d = v4f_mul(p[0], v4f_set1(axes[0]));
+            d = v4f_madd(p[1], v4f_set1(axes[1]), d);
+            d = v4f_madd(p[2], v4f_set1(axes[2]), d);
+            r = v4f_madd(v4f_abs(d), v4f_set1(extent[i]), r);
+        }
+    }
+
+    return v4f_any_lt_zero(v4f_add(v4f_add(dist, r), v4f_set1(SPLIT_EPSILON)));
+}
+
+/*
+ * Box is visible if it is not completely behind any of frustum clip planes or
+ * the main frustum plane. It is conservative: boxes near the frustum edges
+ * may pass the test. axes are columns of the box transform (may be NULL).
+ */
+static bool Frustum_IsBoxVisible(struct frustum_s *frustum, const float centre[3], const float *axes, const float extent[3])
+{
+    float tail[16];
+    uint16_t i = 0, j = 0;
+
+    if(frustum->planes)
+    {
+        for(; i + 4 <= frustum->vertex_count; i += 4)
+        {
+            if(Frustum_IsBoxOutOf4Planes(frustum->planes + 4 * i, centre, axes, extent))
+            {
+                return false;
+            }
+        }
+        for(; i < frustum->vertex_count; ++i, ++j)
+        {
+            vec4_copy(tail + 4 * j, frustum->planes + 4 * i);
+        }
+    }
+    vec4_copy(tail + 4 * j, frustum->norm);
+    for(++j; j < 4; ++j)
+    {
+        tail[4 * j + 0] = tail[4 * j + 1] = tail[4 * j + 2] = 0.0f;             // plane that contains everything
+        tail[4 * j + 3] = 1.0f;
+    }
+
+    return !Frustum_IsBoxOutOf4Planes(tail, centre, axes, extent);
+}
+
 /**
  *
  * @param bbmin - aabb corner (x_min, y_min, z_min)
@@ -470,6 +560,30 @@ bool Frustum_IsPolyVisible(struct polygon_s *p, struct frustum_s *frustum, bool
  * @return 1 if aabb is in frustum.
  */
 bool Frustum_IsAABBVisible(float bbmin[3], float bbmax[3], struct frustum_s *frustum)
+{
+    float centre[3], extent[3];
+
+    centre[0] = 0.5f * (bbmax[0] + bbmin[0]);
+    centre[1] = 0.5f * (bbmax[1] + bbmin[1]);
+    centre[2] = 0.5f * (bbmax[2] + bbmin[2]);
+    extent[0] = 0.5f * (bbmax[0] - bbmin[0]);
+    extent[1] = 0.5f * (bbmax[1] - bbmin[1]);
+    extent[2] = 0.5f * (bbmax[2] - bbmin[2]);
+
+    return Frustum_IsBoxVisible(frustum, centre, NULL, extent);
+}
+
+
+bool Frustum_IsOBBVisible(struct obb_s *obb, struct frustum_s *frustum)
+{
+    return Frustum_IsBoxVisible(frustum, obb->centre, obb->transform, obb->extent);
+}
+
+/*
+ * Polygon based tests, used before the planes tests; kept as a reference
+ * for the culling benchmark.
+ */
+bool Frustum_IsAABBVisibleReference(float bbmin[3], float bbmax[3], struct frustum_s *frustum)
 {
     bool inside = true;
     polygon_t poly;
@@ -653,7 +767,7 @@ bool Frustum_IsAABBVisible(float bbmin[3], float bbmax[3], struct frustum_s *fru
 }
 
 
-bool Frustum_IsOBBVisible(struct obb_s *obb, struct frustum_s *frustum)
+bool Frustum_IsOBBVisibleReference(struct obb_s *obb, struct frustum_s *frustum)
 {
     bool inside = true;
     float t;
@@ -42,6 +42,11 @@ public:
    ~CFrustumManager();
     
     void Reset();
+    void Reserve(uint32_t buffer_size);
+    bool IsFull()
+    {
+        return m_need_realloc;
+    }
     frustum_p PortalFrustumIntersect(struct portal_s *portal, frustum_p emitter, struct camera_s *cam);
 
 private:
@@ -62,6 +67,8 @@ bool Frustum_IsPolyVisible(struct polygon_s *p, struct frustum_s *frustum, bool
 bool Frustum_IsAABBVisible(float bbmin[3], float bbmax[3], struct frustum_s *frustum);
 bool Frustum_IsOBBVisible(struct obb_s *obb, struct frustum_s *frustum);
 bool Frustum_IsOBBVisibleInFrustumList(struct obb_s *obb, struct frustum_s *frustum);
+bool Frustum_IsAABBVisibleReference(float bbmin[3], float bbmax[3], struct frustum_s *frustum);
+bool Frustum_IsOBBVisibleReference(struct obb_s *obb, struct frustum_s *frustum);
 
 
 portal_p Portal_Create(unsigned int vcount);
@@ -11,6 +11,7 @@
 #include "../core/vmath.h"
 #include "../core/polygon.h"
 #include "../core/obb.h"
+#include "../core/profiler.h"
 #include "../script/script.h"
 #include "../physics/physics.h"
 #include "../vt/tr_versions.h"
@@ -18,6 +19,8 @@
 #include "render.h"
 #include "bsp_tree.h"
 #include "frustum.h"
+#include "room_pvs.h"
+#include "render_queue.h"
 #include "shader_description.h"
 #include "shader_manager.h"
 #include "../room.h"
@@ -28,12 +31,57 @@
 #include "../character_controller.h"
 #include "../engine.h"
 
+#define ROOM_BSP_SLOTS              (2)                                         // room contents (flip states) with kept trees
+#define ROOM_BSP_INITIAL_SIZE       (16 * 1024)
+
+/*
+ * Static transparency of room content (room mesh and static meshes) is built
+ * into the tree once; entities transparency is attached to it every frame.
+ * Slot 0 is the current content of the room.
+ */
+struct room_bsp_s
+{
+    struct room_content_s  *content[ROOM_BSP_SLOTS];
+    CDynamicBSP            *bsp[ROOM_BSP_SLOTS];                                // NULL if content has no transparency
+    bool                    need_upload[ROOM_BSP_SLOTS];
+    bsp_node_t              empty_root;                                         // static tree of content without transparency
+};
+
+/*
+ * Vertex stream of a skinned mesh for the skinned shader: position and weight
+ * of the parent bone per vertex. Vertices mapped to the parent mesh take the
+ * parent vertex position (in parent bone space) with weight 1, so they follow
+ * the parent bone exactly as in DrawSkinMesh.
+ */
+#define SKIN_STREAM_STRIDE          (4)                                         // floats per vertex
+
+struct sprite_item_s
+{
+    GLuint                  texture;
+    struct room_sprite_s   *sprite;
+    struct vertex_s        *vertices;                                           // color and tex coords of the room sprite
+};
+
+struct skin_buffer_s
+{
+    const uint32_t         *map;
+    struct base_mesh_s     *mesh;
+    struct base_mesh_s     *parent_mesh;
+    GLuint                  vbo;
+};
+
 CRender renderer;
 
 void CalculateWaterTint(GLfloat *tint, uint8_t fixed_colour);
 
 #define DEBUG_DRAWER_DEFAULT_BUFFER_SIZE        (128 * 1024)
 
+// rooms list and frustums are reused while the camera stays in the same room
+// and moves / rotates less than these limits
+#define VIS_CACHE_MAX_MOVE                      (4.0f)
+#define VIS_CACHE_MIN_COS                       (0.99995f)
+#define VIS_CACHE_MAX_FRAMES                    (8)
+
 /*
  * =============================================================================
  */
@@ -50,13 +98,34 @@ r_list_size(0),
 r_list_active_count(0),
 r_list(NULL),
 frustumManager(NULL),
+roomPVS(NULL),
+renderQueue(NULL),
+m_instances_vbo(0),
+m_pvs_row(NULL),
+m_rooms_bsp(NULL),
+m_bsp_vbo(0),
+m_anim_tex_table(0),
+m_anim_tex_data(NULL),
+m_anim_tex_lookup(false),
+m_sprite_items(NULL),
+m_sprite_items_size(0),
+m_sprite_vertices(NULL),
+m_sprites_vbo(0),
+m_skin_buffers(NULL),
+m_skin_buffers_count(0),
+m_skin_buffers_size(0),
 shaderManager(NULL),
 debugDrawer(NULL),
 dynamicBSP(NULL),
 r_flags(0x00)
 {
     this->InitSettings();
+    m_vis_cache.valid = false;
+    m_vis_cache.room = NULL;
+    m_vis_cache.reused_frames = 0;
     frustumManager = new CFrustumManager(32768);
+    roomPVS        = new CRoomPVS();
+    renderQueue    = new CRenderQueue();
     debugDrawer    = new CRenderDebugDrawer();
     dynamicBSP     = new CDynamicBSP(512 * 1024);
 }
@@ -64,6 +133,27 @@ r_flags(0x00)
 CRender::~CRender()
 {
     m_camera = NULL;
+    this->ClearRoomsBSP();
+    this->ClearSkinBuffers();
+
+    if(m_anim_tex_table != 0)
+    {
+        qglDeleteTextures(1, &m_anim_tex_table);
+        m_anim_tex_table = 0;
+    }
+    free(m_anim_tex_data);
+    m_anim_tex_data = NULL;
+
+    if(m_sprites_vbo != 0)
+    {
+        qglDeleteBuffersARB(1, &m_sprites_vbo);
+        m_sprites_vbo = 0;
+    }
+    free(m_sprite_items);
+    free(m_sprite_vertices);
+    m_sprite_items = NULL;
+    m_sprite_vertices = NULL;
+    m_sprite_items_size = 0;
 
     if(r_list)
     {
@@ -79,6 +169,24 @@ CRender::~CRender()
         frustumManager = NULL;
     }
 
+    if(roomPVS)
+    {
+        delete roomPVS;
+        roomPVS = NULL;
+    }
+
+    if(renderQueue)
+    {
+        delete renderQueue;
+        renderQueue = NULL;
+    }
+
+    if(m_instances_vbo != 0)
+    {
+        qglDeleteBuffersARB(1, &m_instances_vbo);
+        m_instances_vbo = 0;
+    }
+
     if(debugDrawer)
     {
         delete debugDrawer;
@@ -114,6 +222,7 @@ void CRender::InitSettings()
     settings.fog_color[2] = 0.0f;
     settings.fog_start_depth = 10000.0f;
     settings.fog_end_depth = 16000.0f;
+    settings.gpu_skinning = true;
 }
 
 void CRender::DoShaders()
@@ -127,12 +236,19 @@ void CRender::DoShaders()
 void CRender::ResetWorld(struct room_s *rooms, uint32_t rooms_count, struct anim_seq_s *anim_sequences, uint32_t anim_sequences_count)
 {
     this->CleanList();
+    this->ClearRoomsBSP();                                                      // uses the old rooms count
     r_flags = 0x00;
 
     m_rooms = rooms;
     m_rooms_count = rooms_count;
     m_anim_sequences = anim_sequences;
     m_anim_sequences_count = anim_sequences_count;
+    this->InitAnimTexTable();
+    m_pvs_row = NULL;
+    m_vis_cache.valid = false;
+    roomPVS->Reset(rooms, rooms_count);
+    frustumManager->Reserve(roomPVS->GetFrustumBufferSize());
+    this->ClearSkinBuffers();
 
     if(m_rooms)
     {
@@ -156,9 +272,112 @@ void CRender::ResetWorld(struct room_s *rooms, uint32_t rooms_count, struct anim
         {
             m_rooms[i].is_in_r_list = 0;
         }
+
+        m_rooms_bsp = (struct room_bsp_s*)calloc(m_rooms_count, sizeof(struct room_bsp_s));
+        for(uint32_t i = 0; i < m_rooms_count; i++)
+        {
+            if(m_rooms + i == m_rooms[i].real_room)
+            {
+                this->GetRoomBSP(m_rooms + i);
+            }
+        }
+    }
+}
+
+
+void CRender::ClearRoomsBSP()
+{
+    if(m_rooms_bsp)
+    {
+        for(uint32_t i = 0; i < m_rooms_count; i++)
+        {
+            for(int j = 0; j < ROOM_BSP_SLOTS; j++)
+            {
+                delete m_rooms_bsp[i].bsp[j];
+            }
+        }
+        free(m_rooms_bsp);
+        m_rooms_bsp = NULL;
+    }
+}
+
+
+/**
+ * Builds static transparency tree of the current room content in world
+ * coordinates; returns NULL if there is no transparency polygons.
+ */
+CDynamicBSP *CRender::BuildRoomBSP(struct room_s *room)
+{
+    room_content_p content = room->content;
+    bool has_transparency = (content->mesh != NULL) && (content->mesh->transparency_polygons != NULL);
+    CDynamicBSP *bsp;
+
+    for(uint32_t i = 0; !has_transparency && (i < content->static_mesh_count); i++)
+    {
+        has_transparency = (content->static_mesh[i].mesh->transparency_polygons != NULL);
+    }
+    if(!has_transparency)
+    {
+        return NULL;
+    }
+
+    bsp = new CDynamicBSP(ROOM_BSP_INITIAL_SIZE, true);
+    bsp->Reset(m_anim_sequences);
+    if((content->mesh != NULL) && (content->mesh->transparency_polygons != NULL))
+    {
+        bsp->AddNewPolygonList(content->mesh->transparency_polygons, room->transform, NULL);
+    }
+    for(uint32_t i = 0; i < content->static_mesh_count; i++)
+    {
+        static_mesh_p sm = content->static_mesh + i;
+        if(sm->mesh->transparency_polygons != NULL)
+        {
+            bsp->AddNewPolygonList(sm->mesh->transparency_polygons, sm->transform, NULL);
+        }
+    }
+
+    return bsp;
+}
+
+
+/**
+ * Returns static transparency tree of the room current content (slot 0),
+ * tree of other content is kept for flip back.
+ */
+CDynamicBSP *CRender::GetRoomBSP(struct room_s *room)
+{
+    struct room_bsp_s *rb = m_rooms_bsp + (room - m_rooms);
+    if(rb->content[0] != room->content)
+    {
+        int slot = 1;
+        for(; (slot < ROOM_BSP_SLOTS) && (rb->content[slot] != room->content); slot++);
+        if(slot == ROOM_BSP_SLOTS)
+        {
+            slot = ROOM_BSP_SLOTS - 1;
+            delete rb->bsp[slot];
+            rb->bsp[slot] = this->BuildRoomBSP(room);
+            rb->content[slot] = room->content;
+            rb->need_upload[slot] = true;
+        }
+
+        struct room_content_s *content = rb->content[slot];
+        CDynamicBSP *bsp = rb->bsp[slot];
+        bool need_upload = rb->need_upload[slot];
+        for(; slot > 0; slot--)
+        {
+            rb->content[slot] = rb->content[slot - 1];
+            rb->bsp[slot] = rb->bsp[slot - 1];
+            rb->need_upload[slot] = rb->need_upload[slot - 1];
+        }
+        rb->content[0] = content;
+        rb->bsp[0] = bsp;
+        rb->need_upload[0] = need_upload;
     }
+
+    return rb->bsp[0];
 }
 
+
 // This function is used for updating global animated texture frame
 void CRender::UpdateAnimTextures()
 {
@@ -223,6 +442,71 @@ void CRender::UpdateAnimTextures()
             }
         }
     }
+    this->UpdateAnimTexTable();
+}
+
+/**
+ * Animated texture frames table: row per sequence, two texels per frame slot
+ * (texture matrix; move minus uvrotate). Slot x holds the frame that polygons
+ * with frame offset x show now, so vertex shaders index it by the static
+ * (sequence, frame offset) pair and no vertex data is touched per frame.
+ */
+void CRender::InitAnimTexTable()
+{
+    m_anim_tex_lookup = false;
+    if(!shaderManager || !shaderManager->hasAnimTexTable() || (m_anim_sequences_count == 0) || (m_anim_sequences_count > MAX_ANIM_TEX_SEQUENCES))
+    {
+        return;
+    }
+    for(uint32_t i = 0; i < m_anim_sequences_count; i++)
+    {
+        if(m_anim_sequences[i].frames_count > MAX_ANIM_TEX_FRAMES)
+        {
+            return;
+        }
+    }
+
+    if(m_anim_tex_table == 0)
+    {
+        m_anim_tex_data = (GLfloat*)malloc(MAX_ANIM_TEX_SEQUENCES * MAX_ANIM_TEX_FRAMES * 2 * sizeof(GLfloat [4]));
+        qglGenTextures(1, &m_anim_tex_table);
+        qglActiveTextureARB(GL_TEXTURE0_ARB + ANIM_TEX_TABLE_UNIT);
+        qglBindTexture(GL_TEXTURE_2D, m_anim_tex_table);
+        qglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        qglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        qglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        qglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        qglTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F_ARB, 2 * MAX_ANIM_TEX_FRAMES, MAX_ANIM_TEX_SEQUENCES, 0, GL_RGBA, GL_FLOAT, NULL);
+        qglActiveTextureARB(GL_TEXTURE0_ARB);
+    }
+    m_anim_tex_lookup = true;
+    this->UpdateAnimTexTable();
+}
+
+void CRender::UpdateAnimTexTable()
+{
+    if(m_anim_tex_lookup)
+    {
+        anim_seq_p seq = m_anim_sequences;
+        for(uint32_t i = 0; i < m_anim_sequences_count; i++, seq++)
+        {
+            GLfloat *texel = m_anim_tex_data + i * MAX_ANIM_TEX_FRAMES * 2 * 4;
+            for(uint16_t j = 0; j < seq->frames_count; j++, texel += 8)
+            {
+                tex_frame_p tf = seq->frames + (seq->current_frame + j) % seq->frames_count;
+                vec4_copy(texel, tf->mat);
+                texel[4] = tf->move[0];
+                texel[5] = tf->move[1] - tf->current_uvrotate;
+                texel[6] = 0.0f;
+                texel[7] = 0.0f;
+            }
+        }
+
+        qglActiveTextureARB(GL_TEXTURE0_ARB + ANIM_TEX_TABLE_UNIT);
+        qglBindTexture(GL_TEXTURE_2D, m_anim_tex_table);
+        qglTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 2 * MAX_ANIM_TEX_FRAMES, m_anim_sequences_count, GL_RGBA, GL_FLOAT, m_anim_tex_data);
+        qglActiveTextureARB(GL_TEXTURE0_ARB);
+    }
 }
 
 /**
@@ -230,20 +514,38 @@ void CRender::UpdateAnimTextures()
  */
 void CRender::GenWorldList(struct camera_s *cam)
 {
-    this->CleanList();
+    PROF_ZONE("CRender::GenWorldList");
     this->dynamicBSP->Reset(m_anim_sequences);
-    this->frustumManager->Reset();
     cam->frustum->next = NULL;
     m_camera = cam;
 
     if(m_rooms == NULL)
     {
+        this->CleanList();
+        this->frustumManager->Reset();
+        m_pvs_row = NULL;
+        m_vis_cache.valid = false;
         return;
     }
 
+    bool is_flipped = roomPVS->Update();                                        // flipmaps were changed
     room_p curr_room = World_FindRoomByPosCogerrence(cam->transform.M4x4 + 12, cam->current_room);     // find room that contains camera
     GLfloat *cam_pos = cam->transform.M4x4 + 12;
     cam->current_room = curr_room;                                              // set camera's cuttent room pointer
+    if(!is_flipped && this->IsVisCacheValid(cam))
+    {
+        m_vis_cache.reused_frames++;                                            // previous frame rooms list and frustums are still good
+        return;
+    }
+
+    this->CleanList();
+    this->frustumManager->Reset();
+    m_pvs_row = NULL;
+    if(is_flipped)
+    {
+        frustumManager->Reserve(roomPVS->GetFrustumBufferSize());
+    }
+
     if(curr_room != NULL)                                                       // camera located in some room
     {
         const float eps = 10.0f;
@@ -253,6 +555,7 @@ void CRender::GenWorldList(struct camera_s *cam)
         for(uint16_t i = 0; i < curr_room->content->portals_count; i++, p++)    // go through all start room portals
         {
             room_p dest_room = p->dest_room->real_room;
+            m_pvs_row = roomPVS->GetRoomRow(curr_room);
             frustum_p last_frus = this->frustumManager->PortalFrustumIntersect(p, cam->frustum, cam);
             if(last_frus)
             {
@@ -269,6 +572,8 @@ void CRender::GenWorldList(struct camera_s *cam)
                 dest_room->frustum = NULL;                                      // room with camera inside has no frustums!
                 if(this->AddRoom(dest_room))                                    // room with camera inside adds to the render list immediately
                 {
+                    m_pvs_row = roomPVS->GetRoomRow(dest_room);                 // camera is (almost) inside that room
+
                     for(uint16_t ii = 0; ii < dest_room->content->portals_count; ii++, np++)// go through all start room portals
                     {
                         room_p ndest_room = np->dest_room->real_room;
@@ -295,6 +600,52 @@ void CRender::GenWorldList(struct camera_s *cam)
             }
         }
     }
+
+    this->UpdateVisCache(cam);
+}
+
+/**
+ * Is the list generated on previous frames still valid for the camera:
+ * same room and flipmaps, small position and orientation change.
+ */
+bool CRender::IsVisCacheValid(struct camera_s *cam)
+{
+    return m_vis_cache.valid && (cam->current_room != NULL) &&
+           (m_vis_cache.room == cam->current_room) &&
+           (m_vis_cache.reused_frames < VIS_CACHE_MAX_FRAMES) &&
+           (m_vis_cache.dist_far == cam->dist_far) && (m_vis_cache.fov == cam->fov) &&
+           (vec3_dist_sq(m_vis_cache.pos, cam->transform.M4x4 + 12) < VIS_CACHE_MAX_MOVE * VIS_CACHE_MAX_MOVE) &&
+           (vec3_dot(m_vis_cache.up, cam->transform.M4x4 + 4) > VIS_CACHE_MIN_COS) &&
+           (vec3_dot(m_vis_cache.view, cam->transform.M4x4 + 8) > VIS_CACHE_MIN_COS);
+}
+
+void CRender::UpdateVisCache(struct camera_s *cam)
+{
+    m_vis_cache.valid = (cam->current_room != NULL) && !frustumManager->IsFull();   // lost frustums have to be regenerated
+    m_vis_cache.room = cam->current_room;
+    m_vis_cache.reused_frames = 0;
+    m_vis_cache.dist_far = cam->dist_far;
+    m_vis_cache.fov = cam->fov;
+    vec3_copy(m_vis_cache.pos, cam->transform.M4x4 + 12);
+    vec3_copy(m_vis_cache.up, cam->transform.M4x4 + 4);
+    vec3_copy(m_vis_cache.view, cam->transform.M4x4 + 8);
+}
+
+struct room_order_s
+{
+    float       dist;
+    uint32_t    index;
+};
+
+static int Room_CmpBackToFront(const void *a, const void *b)
+{
+    const struct room_order_s *ra = (const struct room_order_s*)a;
+    const struct room_order_s *rb = (const struct room_order_s*)b;
+    if(ra->dist != rb->dist)
+    {
+        return (ra->dist > rb->dist) ? (-1) : (1);
+    }
+    return (ra->index > rb->index) ? (-1) : ((ra->index < rb->index) ? (1) : (0));
 }
 
 /**
@@ -302,6 +653,7 @@ void CRender::GenWorldList(struct camera_s *cam)
  */
 void CRender::DrawList()
 {
+    PROF_ZONE("CRender::DrawList");
     if(m_camera)
     {
         if(r_flags & R_DRAW_WIRE)
@@ -342,41 +694,26 @@ void CRender::DrawList()
         /*
          * room rendering
          */
+        renderQueue->Reset();
         for(uint32_t i = 0; i < r_list_active_count; i++)
         {
             this->DrawRoom(r_list[i].room, m_camera->gl_view_mat, m_camera->gl_view_proj_mat);
         }
+        renderQueue->Sort();
+        this->DrawRenderQueue();
 
         qglDisable(GL_CULL_FACE);
-        for(uint32_t i = 0; i < r_list_active_count; i++)
-        {
-            this->DrawRoomSprites(r_list[i].room);
-        }
+        this->DrawSprites();
 
         /*
          * NOW render transparency polygons
          */
-        /*First generate BSP from base room mesh - it has good for start splitter polygons*/
-        for(uint32_t i = 0; i < r_list_active_count; i++)
-        {
-            room_p r = r_list[i].room;
-            if((r->content->mesh != NULL) && (r->content->mesh->transparency_polygons != NULL))
-            {
-                dynamicBSP->AddNewPolygonList(r->content->mesh->transparency_polygons, r->transform, m_camera->frustum);
-            }
-        }
-
+        /*Static transparency of rooms and static meshes is prebuilt, only entities polygons are added to room trees*/
         for(uint32_t i = 0; i < r_list_active_count; i++)
         {
             room_p r = r_list[i].room;
-            // Add transparency polygons from static meshes (if they exists)
-            for(uint16_t j = 0; j < r->content->static_mesh_count; j++)
-            {
-                if((r->content->static_mesh[j].mesh->transparency_polygons != NULL) && Frustum_IsOBBVisibleInFrustumList(r->content->static_mesh[j].obb, (r->frustum) ? (r->frustum) : (m_camera->frustum)))
-                {
-                    dynamicBSP->AddNewPolygonList(r->content->static_mesh[j].mesh->transparency_polygons, r->content->static_mesh[j].transform, m_camera->frustum);
-                }
-            }
+            CDynamicBSP *room_bsp = this->GetRoomBSP(r);
+            bsp_node_p tree = (room_bsp) ? (room_bsp->m_root) : (&m_rooms_bsp[r - m_rooms].empty_root);
 
             // Add transparency polygons from all entities (if they exists) // yes, entities may be animated and intersects with each others;
             for(engine_container_p cont = r->containers; cont; cont = cont->next)
@@ -386,13 +723,14 @@ void CRender::DrawList()
                     entity_p ent = (entity_p)cont->object;
                     if((ent->state_flags & ENTITY_STATE_VISIBLE) && ent->bf->animations.model && (ent->bf->animations.model->transparency_flags == MESH_HAS_TRANSPARENCY) && Frustum_IsOBBVisibleInFrustumList(ent->obb, (r->frustum) ? (r->frustum) : (m_camera->frustum)))
                     {
-                        float tr[16];
+                        float tr[16], ent_tr[16];
+                        Entity_GetRenderTransform(ent, ent_tr);
                         for(uint16_t j = 0; j < ent->bf->bone_tag_count; j++)
                         {
                             if(ent->bf->bone_tags[j].mesh_base->transparency_polygons != NULL)
                             {
-                                Mat4_Mat4_mul(tr, ent->transform.M4x4, ent->bf->bone_tags[j].current_transform);
-                                dynamicBSP->AddNewPolygonList(ent->bf->bone_tags[j].mesh_base->transparency_polygons, tr, m_camera->frustum);
+                                Mat4_Mat4_mul(tr, ent_tr, ent->bf->bone_tags[j].current_transform);
+                                dynamicBSP->AddNewPolygonListToTree(ent->bf->bone_tags[j].mesh_base->transparency_polygons, tr, m_camera->frustum, tree);
                             }
                         }
                     }
@@ -400,7 +738,7 @@ void CRender::DrawList()
             }
         }
 
-        if(dynamicBSP->m_root->polygons_front && (dynamicBSP->m_vbo != 0))
+        if(dynamicBSP->m_vbo != 0)
         {
             const unlit_tinted_shader_description *shader = shaderManager->getRoomShader(false, false);
             qglUseProgramObjectARB(shader->program);
@@ -411,14 +749,54 @@ void CRender::DrawList()
             qglDisable(GL_ALPHA_TEST);
             qglEnable(GL_BLEND);
             m_active_transparency = 0;
-            qglBindBufferARB(GL_ARRAY_BUFFER_ARB, dynamicBSP->m_vbo);
             qglBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
-            qglBufferDataARB(GL_ARRAY_BUFFER_ARB, dynamicBSP->GetActiveVertexCount() * sizeof(vertex_t), dynamicBSP->GetVertexArray(), GL_DYNAMIC_DRAW);
-            qglVertexPointer(3, GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, position));
-            qglColorPointer(4, GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, color));
-            qglNormalPointer(GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, normal));
-            qglTexCoordPointer(2, GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, tex_coord));
-            this->DrawBSPBackToFront(dynamicBSP->m_root);
+            if(dynamicBSP->GetActiveVertexCount() > 0)
+            {
+                qglBindBufferARB(GL_ARRAY_BUFFER_ARB, dynamicBSP->m_vbo);
+                qglBufferDataARB(GL_ARRAY_BUFFER_ARB, dynamicBSP->GetActiveVertexCount() * sizeof(vertex_t), dynamicBSP->GetVertexArray(), GL_DYNAMIC_DRAW);
+            }
+
+            // rooms trees back to front: portals order is not a depth order
+            // (side branches, several portals to one room), so visible rooms
+            // are sorted by camera distance to their centres, far first;
+            // distances are recalculated, r_list may come from the vis cache.
+            size_t order_size = r_list_active_count * sizeof(struct room_order_s);
+            struct room_order_s *order = (struct room_order_s*)Sys_GetTempMem(order_size);
+            for(uint32_t i = 0; i < r_list_active_count; i++)
+            {
+                room_p r = r_list[i].room;
+                float centre[3];
+                vec3_add(centre, r->bb_min, r->bb_max);
+                vec3_mul_scalar(centre, centre, 0.5f);
+                order[i].dist = vec3_dist_sq(m_camera->transform.M4x4 + 12, centre);
+                order[i].index = i;
+            }
+            qsort(order, r_list_active_count, sizeof(struct room_order_s), Room_CmpBackToFront);
+            for(uint32_t i = 0; i < r_list_active_count; i++)
+            {
+                room_p r = r_list[order[i].index].room;
+                struct room_bsp_s *rb = m_rooms_bsp + (r - m_rooms);
+                CDynamicBSP *room_bsp = rb->bsp[0];
+                if(room_bsp && room_bsp->m_vbo)
+                {
+                    m_bsp_vbo = room_bsp->m_vbo;
+                    qglBindBufferARB(GL_ARRAY_BUFFER_ARB, m_bsp_vbo);
+                    if(room_bsp->UpdateAnimTextures() || rb->need_upload[0])
+                    {
+                        qglBufferDataARB(GL_ARRAY_BUFFER_ARB, room_bsp->GetActiveVertexCount() * sizeof(vertex_t), room_bsp->GetVertexArray(), (rb->need_upload[0]) ? (GL_STATIC_DRAW) : (GL_DYNAMIC_DRAW));
+                        rb->need_upload[0] = false;
+                    }
+                    this->BindBSPVertices(m_bsp_vbo);
+                    this->DrawBSPBackToFront(room_bsp->m_root);
+                }
+                else if(rb->empty_root.frame == dynamicBSP->GetFrame())
+                {
+                    m_bsp_vbo = 0;
+                    this->DrawBSPBackToFront(&rb->empty_root);
+                }
+            }
+            Sys_ReturnTempMem(order_size);
+            m_bsp_vbo = 0;
             qglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
             qglDepthMask(GL_TRUE);
             qglDisable(GL_BLEND);
@@ -442,12 +820,12 @@ void CRender::DrawListDebugLines()
         if((r_flags & R_DRAW_NORMALS) && skybox)
         {
             GLfloat tr[16];
-            float *p;
+            float *p, q[4];
             Mat4_E_macro(tr);
-            p = skybox->animations->frames->bone_tags->offset;
+            p = skybox->animations->bone_offsets;
             vec3_add(tr + 12, m_camera->transform.M4x4 + 12, p);
-            p = skybox->animations->frames->bone_tags->qrotate;
-            Mat4_set_qrotation(tr, p);
+            Anim_GetBoneRotation(skybox->animations, 0, 0, q);
+            Mat4_set_qrotation(tr, q);
             debugDrawer->DrawMeshDebugLines(skybox->mesh_tree->mesh_base, tr, NULL, NULL);
         }
 
@@ -618,6 +996,29 @@ void CRender::DrawBSPPolygon(struct bsp_polygon_s *p)
     qglDrawElements(GL_TRIANGLE_FAN, p->vertex_count, GL_UNSIGNED_INT, p->indexes);
 }
 
+void CRender::BindBSPVertices(GLuint vbo)
+{
+    qglBindBufferARB(GL_ARRAY_BUFFER_ARB, vbo);
+    qglVertexPointer(3, GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, position));
+    qglColorPointer(4, GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, color));
+    qglNormalPointer(GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, normal));
+    qglTexCoordPointer(2, GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, tex_coord));
+}
+
+/**
+ * Draws per frame subtree attached to the static tree node; its polygons
+ * are in the dynamic tree vertex buffer.
+ */
+void CRender::DrawBSPDynamicSubtree(struct bsp_node_s *subtree)
+{
+    this->BindBSPVertices(dynamicBSP->m_vbo);
+    this->DrawBSPBackToFront(subtree);
+    if(m_bsp_vbo != 0)
+    {
+        this->BindBSPVertices(m_bsp_vbo);
+    }
+}
+
 void CRender::DrawBSPFrontToBack(struct bsp_node_s *root)
 {
     float d = vec3_plane_dist(root->plane, engine_camera.transform.M4x4 + 12);
@@ -669,6 +1070,9 @@ void CRender::DrawBSPFrontToBack(struct bsp_node_s *root)
 void CRender::DrawBSPBackToFront(struct bsp_node_s *root)
 {
     float d = vec3_plane_dist(root->plane, engine_camera.transform.M4x4 + 12);
+    bool has_dynamic = (root->frame == dynamicBSP->GetFrame());
+    bsp_node_p dynamic_front = (has_dynamic) ? (root->dynamic_front) : (NULL);
+    bsp_node_p dynamic_back = (has_dynamic) ? (root->dynamic_back) : (NULL);
 
     if(d >= 0)
     {
@@ -676,6 +1080,10 @@ void CRender::DrawBSPBackToFront(struct bsp_node_s *root)
         {
             this->DrawBSPBackToFront(root->back);
         }
+        else if(dynamic_back != NULL)
+        {
+            this->DrawBSPDynamicSubtree(dynamic_back);
+        }
 
         for(bsp_polygon_p p = root->polygons_back; p; p = p->next)
         {
@@ -690,6 +1098,10 @@ void CRender::DrawBSPBackToFront(struct bsp_node_s *root)
         {
             this->DrawBSPBackToFront(root->front);
         }
+        else if(dynamic_front != NULL)
+        {
+            this->DrawBSPDynamicSubtree(dynamic_front);
+        }
     }
     else
     {
@@ -697,6 +1109,10 @@ void CRender::DrawBSPBackToFront(struct bsp_node_s *root)
         {
             this->DrawBSPBackToFront(root->front);
         }
+        else if(dynamic_front != NULL)
+        {
+            this->DrawBSPDynamicSubtree(dynamic_front);
+        }
 
         for(bsp_polygon_p p = root->polygons_front; p; p = p->next)
         {
@@ -711,39 +1127,148 @@ void CRender::DrawBSPBackToFront(struct bsp_node_s *root)
         {
             this->DrawBSPBackToFront(root->back);
         }
+        else if(dynamic_back != NULL)
+        {
+            this->DrawBSPDynamicSubtree(dynamic_back);
+        }
     }
 }
 
-void CRender::DrawMesh(struct base_mesh_s *mesh, const float *overrideVertices, const float *overrideNormals)
+/**
+ * CPU skinning, the reference path: vertices mapped to the parent mesh are
+ * moved from the parent bone space to the bone space of the skinned mesh
+ * (transform is the local transform of the bone).
+ */
+static void SkinMesh_Transform(float *dst_v, float *dst_n, struct base_mesh_s *mesh, struct base_mesh_s *parent_mesh, const uint32_t *map, float transform[16])
 {
-    if(mesh->animated_vertex_count)
+    vertex_p v = mesh->vertices;
+    for(uint32_t i = 0; i < mesh->vertex_count; i++, v++, map++, dst_v += 3, dst_n += 3)
+    {
+        float *src_n = v->normal;
+        if(*map == 0xFFFFFFFF)
+        {
+            vec3_copy(dst_v, v->position);
+            vec3_copy(dst_n, src_n);
+        }
+        else
+        {
+            Mat4_vec3_mul_inv(dst_v, transform, parent_mesh->vertices[*map].position);
+            dst_n[0]  = transform[0] * src_n[0] + transform[1] * src_n[1] + transform[2]  * src_n[2];             // (M^-1 * src).x
+            dst_n[1]  = transform[4] * src_n[0] + transform[5] * src_n[1] + transform[6]  * src_n[2];             // (M^-1 * src).y
+            dst_n[2]  = transform[8] * src_n[0] + transform[9] * src_n[1] + transform[10] * src_n[2];             // (M^-1 * src).z
+        }
+    }
+}
+
+/**
+ * Fills skinned shader vertex stream of the skinned mesh (see skin_buffer_s).
+ */
+static void SkinMesh_FillStream(float *stream, struct base_mesh_s *mesh, struct base_mesh_s *parent_mesh, const uint32_t *map)
+{
+    vertex_p v = mesh->vertices;
+    for(uint32_t i = 0; i < mesh->vertex_count; i++, v++, map++, stream += SKIN_STREAM_STRIDE)
     {
-        // Respecify the tex coord buffer
-        qglBindBufferARB(GL_ARRAY_BUFFER, mesh->vbo_animated_texcoord_array);
-        // Tell OpenGL to discard the old values
-        qglBufferDataARB(GL_ARRAY_BUFFER, mesh->animated_vertex_count * sizeof(GLfloat [2]), 0, GL_STREAM_DRAW);
-        // Get writable data (to avoid copy)
-        GLfloat *data = (GLfloat *) qglMapBufferARB(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
+        if(*map == 0xFFFFFFFF)
+        {
+            vec3_copy(stream, v->position);
+            stream[3] = 0.0f;
+        }
+        else
+        {
+            vec3_copy(stream, parent_mesh->vertices[*map].position);
+            stream[3] = 1.0f;
+        }
+    }
+}
 
-        for(polygon_p p = mesh->animated_polygons; p; p = p->next)
+/**
+ * Software version of the skinned entity vertex shader: blends the bone and
+ * the parent bone matrices by the stream weight of every vertex.
+ */
+static void SkinMesh_TransformByPalette(float *dst_v, float *dst_n, struct base_mesh_s *mesh, const float *stream, const float bone[16], const float parent_bone[16])
+{
+    float m[16];
+    vertex_p v = mesh->vertices;
+    for(uint32_t i = 0; i < mesh->vertex_count; i++, v++, stream += SKIN_STREAM_STRIDE, dst_v += 3, dst_n += 3)
+    {
+        for(int j = 0; j < 16; j++)
         {
-            anim_seq_p seq = m_anim_sequences + p->anim_id - 1;
-            uint16_t frame = (seq->current_frame + p->frame_offset) % seq->frames_count;
-            tex_frame_p tf = seq->frames + frame;
-            for(uint16_t i = 0; i < p->vertex_count; i++, data += 2)
-            {
-                ApplyAnimTextureTransformation(data, p->vertices[i].tex_coord, tf);
-            }
+            m[j] = bone[j] * (1.0f - stream[3]) + parent_bone[j] * stream[3];
+        }
+        Mat4_vec3_mul(dst_v, m, stream);
+        Mat4_vec3_rot_macro(dst_n, m, v->normal);
+    }
+}
+
+/**
+ * Refills animated texture coordinates buffer of the mesh by current frames
+ * of its animated texture sequences.
+ */
+void CRender::UpdateAnimTexCoords(struct base_mesh_s *mesh)
+{
+    // Respecify the tex coord buffer
+    qglBindBufferARB(GL_ARRAY_BUFFER, mesh->vbo_animated_texcoord_array);
+    // Tell OpenGL to discard the old values
+    qglBufferDataARB(GL_ARRAY_BUFFER, mesh->animated_vertex_count * sizeof(GLfloat [2]), 0, GL_STREAM_DRAW);
+    // Get writable data (to avoid copy)
+    GLfloat *data = (GLfloat *) qglMapBufferARB(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
+
+    for(polygon_p p = mesh->animated_polygons; p; p = p->next)
+    {
+        anim_seq_p seq = m_anim_sequences + p->anim_id - 1;
+        uint16_t frame = (seq->current_frame + p->frame_offset) % seq->frames_count;
+        tex_frame_p tf = seq->frames + frame;
+        for(uint16_t i = 0; i < p->vertex_count; i++, data += 2)
+        {
+            ApplyAnimTextureTransformation(data, p->vertices[i].tex_coord, tf);
         }
-        qglUnmapBufferARB(GL_ARRAY_BUFFER);
+    }
+    qglUnmapBufferARB(GL_ARRAY_BUFFER);
+}
 
-        // Setup altered buffer
+/**
+ * Binds animated vertices of the mesh: with frames lookup the frame attribute
+ * array is enabled and vertex shaders transform original tex coords, else tex
+ * coords come from the buffer refilled by UpdateAnimTexCoords.
+ */
+void CRender::BindAnimatedVertices(struct base_mesh_s *mesh)
+{
+    qglBindBufferARB(GL_ARRAY_BUFFER, mesh->vbo_animated_texcoord_array);
+    if(m_anim_tex_lookup)
+    {
+        qglVertexAttribPointerARB(ANIM_TEX_FRAME_ATTRIB, 2, GL_FLOAT, GL_FALSE, sizeof(GLfloat [2]), 0);
+        qglEnableVertexAttribArrayARB(ANIM_TEX_FRAME_ATTRIB);
+        qglBindBufferARB(GL_ARRAY_BUFFER, mesh->vbo_animated_vertex_array);
+        qglTexCoordPointer(2, GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, tex_coord));
+    }
+    else
+    {
         qglTexCoordPointer(2, GL_FLOAT, sizeof(GLfloat [2]), 0);
-        // Setup static data
         qglBindBufferARB(GL_ARRAY_BUFFER, mesh->vbo_animated_vertex_array);
-        qglVertexPointer(3, GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, position));
-        qglColorPointer(4, GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, color));
-        qglNormalPointer(GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, normal));
+    }
+    qglVertexPointer(3, GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, position));
+    qglColorPointer(4, GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, color));
+    qglNormalPointer(GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, normal));
+}
+
+void CRender::UnbindAnimatedVertices()
+{
+    if(m_anim_tex_lookup)
+    {
+        qglDisableVertexAttribArrayARB(ANIM_TEX_FRAME_ATTRIB);
+        qglVertexAttrib2fARB(ANIM_TEX_FRAME_ATTRIB, -1.0f, 0.0f);               // not animated; undefined after array use
+    }
+}
+
+void CRender::DrawMeshAnimatedFaces(struct base_mesh_s *mesh)
+{
+    if(mesh->animated_vertex_count)
+    {
+        if(!m_anim_tex_lookup)
+        {
+            this->UpdateAnimTexCoords(mesh);
+        }
+        this->BindAnimatedVertices(mesh);
 
         mesh_face_p face = mesh->animated_faces;
         for(uint32_t face_index = 0; face_index < mesh->animated_faces_count; face_index++, face++)
@@ -755,7 +1280,13 @@ void CRender::DrawMesh(struct base_mesh_s *mesh, const float *overrideVertices,
             }
             qglDrawElements(GL_TRIANGLES, face->elements_count, GL_UNSIGNED_INT, face->elements);
         }
+        this->UnbindAnimatedVertices();
     }
+}
+
+void CRender::DrawMesh(struct base_mesh_s *mesh, const float *overrideVertices, const float *overrideNormals)
+{
+    this->DrawMeshAnimatedFaces(mesh);
 
     if(mesh->vertex_count == 0)
     {
@@ -795,39 +1326,61 @@ void CRender::DrawMesh(struct base_mesh_s *mesh, const float *overrideVertices,
 
 void CRender::DrawSkinMesh(struct base_mesh_s *mesh, struct base_mesh_s *parent_mesh, uint32_t *map, float transform[16])
 {
-    uint32_t i;
-    vertex_p v;
-    float *p_vertex, *src_v, *dst_v;
-    GLfloat *p_normale, *src_n, *dst_n;
     size_t buf_size = mesh->vertex_count * 3 * sizeof(GLfloat);
+    GLfloat *p_vertex  = (GLfloat*)Sys_GetTempMem(buf_size);
+    GLfloat *p_normale = (GLfloat*)Sys_GetTempMem(buf_size);
 
-    p_vertex  = (GLfloat*)Sys_GetTempMem(buf_size);
-    p_normale = (GLfloat*)Sys_GetTempMem(buf_size);
-    dst_v = p_vertex;
-    dst_n = p_normale;
-    v = mesh->vertices;
-    for(i = 0; i < mesh->vertex_count; i++, v++, map++)
+    SkinMesh_Transform(p_vertex, p_normale, mesh, parent_mesh, map, transform);
+    this->DrawMesh(mesh, p_vertex, p_normale);
+    Sys_ReturnTempMem(2 * buf_size);
+}
+
+void CRender::ClearSkinBuffers()
+{
+    for(uint32_t i = 0; i < m_skin_buffers_count; i++)
     {
-        src_v = v->position;
-        src_n = v->normal;
-        if(*map == 0xFFFFFFFF)
+        qglDeleteBuffersARB(1, &m_skin_buffers[i].vbo);
+    }
+    free(m_skin_buffers);
+    m_skin_buffers = NULL;
+    m_skin_buffers_count = 0;
+    m_skin_buffers_size = 0;
+}
+
+/**
+ * Returns skinned shader vertex stream of the skinned mesh; streams are built
+ * on the first use and kept until the world is changed.
+ */
+GLuint CRender::GetSkinBuffer(struct base_mesh_s *mesh, struct base_mesh_s *parent_mesh, uint32_t *map)
+{
+    struct skin_buffer_s *sb = m_skin_buffers;
+    for(uint32_t i = 0; i < m_skin_buffers_count; i++, sb++)
+    {
+        if((sb->map == map) && (sb->mesh == mesh) && (sb->parent_mesh == parent_mesh))
         {
-            vec3_copy(dst_v, src_v);
-            vec3_copy(dst_n, src_n);
+            return sb->vbo;
         }
-        else
-        {
-            Mat4_vec3_mul_inv(dst_v, transform, parent_mesh->vertices[*map].position);
-            dst_n[0]  = transform[0] * src_n[0] + transform[1] * src_n[1] + transform[2]  * src_n[2];             // (M^-1 * src).x
-            dst_n[1]  = transform[4] * src_n[0] + transform[5] * src_n[1] + transform[6]  * src_n[2];             // (M^-1 * src).y
-            dst_n[2]  = transform[8] * src_n[0] + transform[9] * src_n[1] + transform[10] * src_n[2];             // (M^-1 * src).z
-        }
-        dst_v += 3;
-        dst_n += 3;
     }
 
-    this->DrawMesh(mesh, p_vertex, p_normale);
-    Sys_ReturnTempMem(2 * buf_size);
+    if(m_skin_buffers_count >= m_skin_buffers_size)
+    {
+        m_skin_buffers_size = (m_skin_buffers_size) ? (m_skin_buffers_size * 2) : (16);
+        m_skin_buffers = (struct skin_buffer_s*)realloc(m_skin_buffers, m_skin_buffers_size * sizeof(struct skin_buffer_s));
+    }
+    sb = m_skin_buffers + m_skin_buffers_count++;
+    sb->map = map;
+    sb->mesh = mesh;
+    sb->parent_mesh = parent_mesh;
+
+    size_t buf_size = mesh->vertex_count * SKIN_STREAM_STRIDE * sizeof(GLfloat);
+    GLfloat *stream = (GLfloat*)Sys_GetTempMem(buf_size);
+    SkinMesh_FillStream(stream, mesh, parent_mesh, map);
+    qglGenBuffersARB(1, &sb->vbo);
+    qglBindBufferARB(GL_ARRAY_BUFFER_ARB, sb->vbo);
+    qglBufferDataARB(GL_ARRAY_BUFFER_ARB, buf_size, stream, GL_STATIC_DRAW);
+    Sys_ReturnTempMem(buf_size);
+
+    return sb->vbo;
 }
 
 void CRender::DrawSkyBox(const float modelViewProjectionMatrix[16])
@@ -836,13 +1389,13 @@ void CRender::DrawSkyBox(const float modelViewProjectionMatrix[16])
     if((r_flags & R_DRAW_SKYBOX) && (skybox = World_GetSkybox()))
     {
         float tr[16];
-        float *p;
+        float *p, q[4];
         qglDepthMask(GL_FALSE);
         tr[15] = 1.0;
-        p = skybox->animations->frames->bone_tags->offset;
+        p = skybox->animations->bone_offsets;
         vec3_add(tr + 12, m_camera->transform.M4x4 + 12, p);
-        p = skybox->animations->frames->bone_tags->qrotate;
-        Mat4_set_qrotation(tr, p);
+        Anim_GetBoneRotation(skybox->animations, 0, 0, q);
+        Mat4_set_qrotation(tr, q);
         float fullView[16];
         Mat4_Mat4_mul(fullView, modelViewProjectionMatrix, tr);
 
@@ -893,6 +1446,120 @@ void CRender::DrawSkeletalModel(const lit_shader_description *shader, struct ss_
     }
 }
 
+/**
+ * Skeletal model drawing by the skinned shader: model view matrices of all
+ * bones are uploaded once as a palette, meshes select their bones by constant
+ * bone index attribute; skinned meshes blend the bone and its parent by the
+ * per vertex weight of the skin stream.
+ */
+void CRender::DrawSkeletalModelSkinned(const struct skinned_shader_description *shader, struct ss_bone_frame_s *bframe, const float mvMatrix[16], const float projection[16])
+{
+    float palette[16 * MAX_SKINNED_BONES];
+    ss_bone_tag_p btag = bframe->bone_tags;
+
+    for(uint16_t i = 0; i < bframe->bone_tag_count; i++, btag++)
+    {
+        Mat4_Mat4_mul(palette + 16 * i, mvMatrix, btag->current_transform);
+    }
+    qglUniformMatrix4fvARB(shader->projection, 1, false, projection);
+    qglUniformMatrix4fvARB(shader->bone_matrices, bframe->bone_tag_count, false, palette);
+    qglVertexAttrib1fARB(shader->bone_weight, 0.0f);
+
+    btag = bframe->bone_tags;
+    for(uint16_t i = 0; i < bframe->bone_tag_count; i++, btag++)
+    {
+        if(!btag->is_hidden)
+        {
+            qglVertexAttrib2fARB(shader->bone_index, (GLfloat)i, (GLfloat)i);
+            this->DrawMesh((btag->mesh_replace) ? (btag->mesh_replace) : (btag->mesh_base), NULL, NULL);
+            if(btag->mesh_slot)
+            {
+                this->DrawMesh(btag->mesh_slot, NULL, NULL);
+            }
+            if(btag->mesh_skin && btag->parent && btag->mesh_skin->vbo_vertex_array)
+            {
+                base_mesh_p mesh = btag->mesh_skin;
+                GLuint skin_vbo = this->GetSkinBuffer(mesh, btag->parent->mesh_base, btag->skin_map);
+
+                qglVertexAttrib2fARB(shader->bone_index, (GLfloat)i, (GLfloat)(btag->parent - bframe->bone_tags));
+                this->DrawMeshAnimatedFaces(mesh);
+                if(mesh->vertex_count == 0)
+                {
+                    continue;
+                }
+
+                qglBindBufferARB(GL_ARRAY_BUFFER_ARB, mesh->vbo_vertex_array);
+                qglColorPointer(4, GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, color));
+                qglNormalPointer(GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, normal));
+                qglTexCoordPointer(2, GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, tex_coord));
+                qglBindBufferARB(GL_ARRAY_BUFFER_ARB, skin_vbo);
+                qglVertexPointer(3, GL_FLOAT, SKIN_STREAM_STRIDE * sizeof(GLfloat), (void*)0);
+                qglVertexAttribPointerARB(shader->bone_weight, 1, GL_FLOAT, GL_FALSE, SKIN_STREAM_STRIDE * sizeof(GLfloat), (void*)(3 * sizeof(GLfloat)));
+                qglEnableVertexAttribArrayARB(shader->bone_weight);
+
+                mesh_face_p face = mesh->faces;
+                for(uint32_t face_index = 0; face_index < mesh->faces_count; face_index++, face++)
+                {
+                    if(m_active_texture != face->texture_index)
+                    {
+                        m_active_texture = face->texture_index;
+                        qglBindTexture(GL_TEXTURE_2D, m_active_texture);
+                    }
+                    qglDrawElements(GL_TRIANGLES, face->elements_count, GL_UNSIGNED_INT, face->elements);
+                }
+
+                qglDisableVertexAttribArrayARB(shader->bone_weight);
+                qglVertexAttrib1fARB(shader->bone_weight, 0.0f);                // current value is undefined after array use
+            }
+        }
+    }
+}
+
+/**
+ * Compares skinned meshes of the model transformed by the CPU path and by the
+ * software version of the skinned shader, in model space; returns the largest
+ * position and normal differences.
+ */
+void CRender::GetSkinningError(struct ss_bone_frame_s *bframe, float *position_error, float *normal_error)
+{
+    ss_bone_tag_p btag = bframe->bone_tags;
+
+    *position_error = 0.0f;
+    *normal_error = 0.0f;
+    for(uint16_t i = 0; i < bframe->bone_tag_count; i++, btag++)
+    {
+        if(btag->mesh_skin && btag->parent && btag->skin_map)
+        {
+            base_mesh_p mesh = btag->mesh_skin;
+            size_t buf_size = mesh->vertex_count * 3 * sizeof(GLfloat);
+            size_t stream_size = mesh->vertex_count * SKIN_STREAM_STRIDE * sizeof(GLfloat);
+            GLfloat *cpu_v = (GLfloat*)Sys_GetTempMem(buf_size);
+            GLfloat *cpu_n = (GLfloat*)Sys_GetTempMem(buf_size);
+            GLfloat *gpu_v = (GLfloat*)Sys_GetTempMem(buf_size);
+            GLfloat *gpu_n = (GLfloat*)Sys_GetTempMem(buf_size);
+            GLfloat *stream = (GLfloat*)Sys_GetTempMem(stream_size);
+
+            SkinMesh_Transform(cpu_v, cpu_n, mesh, btag->parent->mesh_base, btag->skin_map, btag->local_transform);
+            SkinMesh_FillStream(stream, mesh, btag->parent->mesh_base, btag->skin_map);
+            SkinMesh_TransformByPalette(gpu_v, gpu_n, mesh, stream, btag->current_transform, btag->parent->current_transform);
+            for(uint32_t j = 0; j < mesh->vertex_count; j++)
+            {
+                float v[3], n[3];
+                Mat4_vec3_mul(v, btag->current_transform, cpu_v + 3 * j);
+                Mat4_vec3_rot_macro(n, btag->current_transform, cpu_n + 3 * j);
+                for(int k = 0; k < 3; k++)
+                {
+                    float dv = fabsf(v[k] - gpu_v[3 * j + k]);
+                    float dn = fabsf(n[k] - gpu_n[3 * j + k]);
+                    *position_error = (dv > *position_error) ? (dv) : (*position_error);
+                    *normal_error = (dn > *normal_error) ? (dn) : (*normal_error);
+                }
+            }
+            Sys_ReturnTempMem(4 * buf_size + stream_size);
+        }
+    }
+}
+
 void CRender::DrawEntity(struct entity_s *entity, const float modelViewMatrix[16], const float modelViewProjectionMatrix[16])
 {
     if(!(entity->state_flags & ENTITY_STATE_VISIBLE) || (entity->bf->animations.model->hide && !(r_flags & R_DRAW_NULLMESHES)))
@@ -900,33 +1567,42 @@ void CRender::DrawEntity(struct entity_s *entity, const float modelViewMatrix[16
         return;
     }
 
+    bool skinned = settings.gpu_skinning && (entity->bf->bone_tag_count <= MAX_SKINNED_BONES) &&
+                   (shaderManager->getEntitySkinnedShader(0) != NULL);
+
     // Calculate lighting
-    const lit_shader_description *shader = this->SetupEntityLight(entity, modelViewMatrix);
+    const lit_shader_description *shader = this->SetupEntityLight(entity, modelViewMatrix, skinned);
 
     if(entity->bf->animations.model && entity->bf->animations.model->animations)
     {
         float subModelView[16];
         float subModelViewProjection[16];
+        float renderTransform[16];
+        Entity_GetRenderTransform(entity, renderTransform);
         if(entity->bf->bone_tag_count == 1)
         {
-            float scaledTransform[16];
-            memcpy(scaledTransform, entity->transform.M4x4, sizeof(scaledTransform));
-            Mat4_Scale(scaledTransform, entity->transform.scaling[0], entity->transform.scaling[1], entity->transform.scaling[2]);
-            Mat4_Mat4_mul(subModelView, modelViewMatrix, scaledTransform);
-            Mat4_Mat4_mul(subModelViewProjection, modelViewProjectionMatrix, scaledTransform);
+            Mat4_Scale(renderTransform, entity->transform.scaling[0], entity->transform.scaling[1], entity->transform.scaling[2]);
+        }
+        Mat4_Mat4_mul(subModelView, modelViewMatrix, renderTransform);
+        Mat4_Mat4_mul(subModelViewProjection, modelViewProjectionMatrix, renderTransform);
+
+        if(skinned)
+        {
+            this->DrawSkeletalModelSkinned((const skinned_shader_description*)shader, entity->bf, subModelView, m_camera->gl_proj_mat);
         }
         else
         {
-            Mat4_Mat4_mul(subModelView, modelViewMatrix, entity->transform.M4x4);
-            Mat4_Mat4_mul(subModelViewProjection, modelViewProjectionMatrix, entity->transform.M4x4);
+            this->DrawSkeletalModel(shader, entity->bf, subModelView, subModelViewProjection);
         }
 
-        this->DrawSkeletalModel(shader, entity->bf, subModelView, subModelViewProjection);
-
         if(entity->character && entity->character->hair_count)
         {
             base_mesh_p mesh;
             float transform[16];
+            if(skinned)
+            {
+                qglVertexAttrib2fARB(((const skinned_shader_description*)shader)->bone_index, 0.0f, 0.0f);
+            }
             for(int h = 0; h < entity->character->hair_count; h++)
             {
                 int num_elements = Hair_GetElementsCount(entity->character->hairs[h]);
@@ -936,8 +1612,15 @@ void CRender::DrawEntity(struct entity_s *entity, const float modelViewMatrix[16
                     Mat4_Mat4_mul(subModelView, modelViewMatrix, transform);
                     Mat4_Mat4_mul(subModelViewProjection, modelViewProjectionMatrix, transform);
 
-                    qglUniformMatrix4fvARB(shader->model_view, 1, GL_FALSE, subModelView);
-                    qglUniformMatrix4fvARB(shader->model_view_projection, 1, GL_FALSE, subModelViewProjection);
+                    if(skinned)
+                    {
+                        qglUniformMatrix4fvARB(((const skinned_shader_description*)shader)->bone_matrices, 1, GL_FALSE, subModelView);
+                    }
+                    else
+                    {
+                        qglUniformMatrix4fvARB(shader->model_view, 1, GL_FALSE, subModelView);
+                        qglUniformMatrix4fvARB(shader->model_view_projection, 1, GL_FALSE, subModelViewProjection);
+                    }
                     this->DrawMesh(mesh, NULL, NULL);
                 }
             }
@@ -966,125 +1649,326 @@ void CRender::DrawEntity(struct entity_s *entity, const float modelViewMatrix[16
     }
 }
 
-void CRender::DrawRoom(struct room_s *room, const float modelViewMatrix[16], const float modelViewProjectionMatrix[16])
+/**
+ * Room is drawn with stencil if the rooms overlapped with it are visible.
+ */
+bool CRender::IsRoomNeedStencil(struct room_s *room)
 {
-    float transform[16];
-    engine_container_p cont;
-    entity_p ent;
-
-    const shader_description *lastShader = 0;
-
-    ////start test stencil test code
-    bool need_stencil = false;
     if(room->frustum != NULL)
     {
         for(uint16_t i = 0; i < room->content->overlapped_room_list_size; i++)
         {
             if(room->content->overlapped_room_list[i]->real_room->is_in_r_list)
             {
-                need_stencil = true;
-                break;
+                return true;
             }
         }
+    }
+    return false;
+}
+
+/**
+ * Adds room mesh (if with_mesh), visible static meshes of the room and static
+ * meshes of near rooms that intersect it to the render queue.
+ */
+void CRender::QueueRoom(struct room_s *room, const float modelViewProjectionMatrix[16], bool with_mesh)
+{
+    float transform[16];
+    GLfloat tint[4];
+    frustum_p frus = (room->frustum) ? (room->frustum) : (m_camera->frustum);
 
-        if(need_stencil)
+    if(with_mesh && !(r_flags & R_SKIP_ROOM) && room->content->mesh)
+    {
+        uint16_t shader = RENDER_QUEUE_SHADER_ROOM;
+        shader |= (room->content->light_mode == 1) ? (RENDER_QUEUE_SHADER_FLICKER) : (0);
+        shader |= (room->content->room_flags & TR_ROOM_FLAG_WATER) ? (RENDER_QUEUE_SHADER_WATER) : (0);
+        Mat4_Mat4_mul(transform, modelViewProjectionMatrix, room->transform);
+        CalculateWaterTint(tint, 1);
+        renderQueue->AddMesh(room->content->mesh, renderQueue->AddInstance(shader, transform, tint));
+    }
+
+    for(uint32_t i = 0; i < room->content->static_mesh_count; i++)
+    {
+        static_mesh_p sm = room->content->static_mesh + i;
+        if((!sm->hide || (r_flags & R_DRAW_DUMMY_STATICS)) && Frustum_IsOBBVisibleInFrustumList(sm->obb, frus))
         {
-            const int elem_size = (3 + 3 + 4 + 2) * sizeof(GLfloat);
-            const unlit_tinted_shader_description *shader = shaderManager->getRoomShader(false, false);
-            size_t buf_size;
+            Mat4_Mat4_mul(transform, modelViewProjectionMatrix, sm->transform);
+            vec4_copy(tint, sm->tint);
+            if(room->content->room_flags & TR_ROOM_FLAG_WATER)                  // If this static mesh is in a water room
+            {
+                CalculateWaterTint(tint, 0);
+            }
+            renderQueue->AddMesh(sm->mesh, renderQueue->AddInstance(RENDER_QUEUE_SHADER_STATIC, transform, tint));
+        }
+    }
 
-            qglUseProgramObjectARB(shader->program);
-            qglUniform1iARB(shader->sampler, 0);
-            qglUniformMatrix4fvARB(shader->model_view_projection, 1, false, engine_camera.gl_view_proj_mat);
-            qglUniform1fARB(shader->dist_fog, m_camera->dist_far);
-            qglEnable(GL_STENCIL_TEST);
-            qglClear(GL_STENCIL_BUFFER_BIT);
-            qglStencilFunc(GL_NEVER, 1, 0x00);
-            qglStencilOp(GL_REPLACE, GL_KEEP, GL_KEEP);
-            for(frustum_p f = room->frustum; f; f = f->next)
+    for(uint16_t ni = 0; ni < room->content->near_room_list_size; ni++)
+    {
+        room_p near_room = room->content->near_room_list[ni]->real_room;
+        if(!room->content->near_room_list[ni]->is_in_r_list)
+        {
+            for(uint32_t si = 0; si < near_room->content->static_mesh_count; si++)
             {
-                buf_size = f->vertex_count * elem_size;
-                GLfloat *v, *buf = (GLfloat*)Sys_GetTempMem(buf_size);
-                v=buf;
-                for(int16_t i = f->vertex_count - 1; i >= 0; i--)
+                static_mesh_p sm = near_room->content->static_mesh + si;
+                if(OBB_OBB_Test(sm->obb, room->obb, 0.0f) &&
+                   Frustum_IsOBBVisibleInFrustumList(sm->obb, frus) &&
+                   (!sm->hide || (r_flags & R_DRAW_DUMMY_STATICS)))
                 {
-                    vec3_copy(v, f->vertex + 3 * i);                    v+=3;
-                    vec3_copy_inv(v, engine_camera.transform.M4x4 + 8);   v+=3;
-                    vec4_set_one(v);                                    v+=4;
-                    v[0] = v[1] = 0.0;                                  v+=2;
+                    Mat4_Mat4_mul(transform, modelViewProjectionMatrix, sm->transform);
+                    vec4_copy(tint, sm->tint);
+                    if(near_room->content->room_flags & TR_ROOM_FLAG_WATER)     // If this static mesh is in a water near_room
+                    {
+                        CalculateWaterTint(tint, 0);
+                    }
+                    renderQueue->AddMesh(sm->mesh, renderQueue->AddInstance(RENDER_QUEUE_SHADER_STATIC, transform, tint));
                 }
+            }
+        }
+    }
+}
 
-                m_active_texture = 0;
-                BindWhiteTexture();
-                qglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
-                qglVertexPointer(3, GL_FLOAT, elem_size, buf+0);
-                qglNormalPointer(GL_FLOAT, elem_size, buf+3);
-                qglColorPointer(4, GL_FLOAT, elem_size, buf+3+3);
-                qglTexCoordPointer(2, GL_FLOAT, elem_size, buf+3+3+4);
-                qglDrawArrays(GL_TRIANGLE_FAN, 0, f->vertex_count);
+/**
+ * Submits queued opaque geometry; render queue has to be sorted.
+ * If GL supports instancing, all instances of a static mesh face are drawn
+ * by one call with transforms and tints taken from the instances stream.
+ */
+void CRender::DrawRenderQueue()
+{
+    const instanced_shader_description *instanced_shader = shaderManager->getStaticMeshInstancedShader();
+    const unlit_tinted_shader_description *shader = NULL;
+    render_item_p items = renderQueue->GetItems();
+    uint32_t items_count = renderQueue->GetItemsCount();
+    uint32_t instance = 0xFFFFFFFF;
+    uint32_t stream_offset = 0;
+    uint16_t shader_index = 0xFFFF;
+    GLuint vbo = 0;
+    bool animated_bound = false;
 
-                Sys_ReturnTempMem(buf_size);
+    for(uint32_t i = 0; !m_anim_tex_lookup && (i < renderQueue->GetAnimatedMeshesCount()); ++i)
+    {
+        this->UpdateAnimTexCoords(renderQueue->GetAnimatedMesh(i));
+    }
+
+    if(instanced_shader)
+    {
+        uint32_t stream_count = renderQueue->BuildInstancesStream(RENDER_QUEUE_SHADER_STATIC);
+        if(stream_count > 0)
+        {
+            if(m_instances_vbo == 0)
+            {
+                qglGenBuffersARB(1, &m_instances_vbo);
             }
-            qglStencilFunc(GL_EQUAL, 1, 0xFF);
+            qglBindBufferARB(GL_ARRAY_BUFFER_ARB, m_instances_vbo);
+            qglBufferDataARB(GL_ARRAY_BUFFER_ARB, stream_count * sizeof(render_instance_t), renderQueue->GetInstancesStream(), GL_STREAM_DRAW);
+        }
+        else
+        {
+            instanced_shader = NULL;
         }
     }
 
-    if(!(r_flags & R_SKIP_ROOM) && room->content->mesh)
+    for(uint32_t i = 0; i < items_count; ++i)
     {
-        float modelViewProjectionTransform[16];
-        Mat4_Mat4_mul(modelViewProjectionTransform, modelViewProjectionMatrix, room->transform);
-
-        const unlit_tinted_shader_description *shader = shaderManager->getRoomShader(room->content->light_mode == 1, room->content->room_flags & 1);
+        render_item_p item = items + i;
+        render_instance_p inst = renderQueue->GetInstance(item->instance);
+        base_mesh_p mesh = item->mesh;
+        GLuint item_vbo = (item->is_animated) ? (mesh->vbo_animated_vertex_array) : (mesh->vbo_vertex_array);
+        bool is_instanced = instanced_shader && (inst->shader == RENDER_QUEUE_SHADER_STATIC);
 
-        GLfloat tint[4];
-        CalculateWaterTint(tint, 1);
-        if (shader != lastShader)
+        if(inst->shader != shader_index)
         {
+            shader_index = inst->shader;
+            if(is_instanced)
+            {
+                shader = instanced_shader;
+            }
+            else if(shader_index == RENDER_QUEUE_SHADER_STATIC)
+            {
+                shader = shaderManager->getStaticMeshShader();
+            }
+            else
+            {
+                shader = shaderManager->getRoomShader(shader_index & RENDER_QUEUE_SHADER_FLICKER, shader_index & RENDER_QUEUE_SHADER_WATER);
+            }
             qglUseProgramObjectARB(shader->program);
+            qglUniform1iARB(shader->sampler, 0);
+            qglUniform1fARB(shader->current_tick, (GLfloat) SDL_GetTicks());
+            qglUniform1fARB(shader->dist_fog, m_camera->dist_far);
+            instance = 0xFFFFFFFF;
         }
 
-        lastShader = shader;
-        qglUniform4fvARB(shader->tint_mult, 1, tint);
-        qglUniform1fARB(shader->current_tick, (GLfloat) SDL_GetTicks());
-        qglUniform1iARB(shader->sampler, 0);
-        qglUniformMatrix4fvARB(shader->model_view_projection, 1, false, modelViewProjectionTransform);
-        qglUniform1fARB(shader->dist_fog, m_camera->dist_far);
-        this->DrawMesh(room->content->mesh, NULL, NULL);
+        if(!is_instanced && (item->instance != instance))
+        {
+            instance = item->instance;
+            qglUniformMatrix4fvARB(shader->model_view_projection, 1, false, inst->mvp);
+            qglUniform4fvARB(shader->tint_mult, 1, inst->tint);
+        }
+
+        if(item_vbo != vbo)
+        {
+            vbo = item_vbo;
+            if(animated_bound && !item->is_animated)
+            {
+                this->UnbindAnimatedVertices();
+            }
+            animated_bound = item->is_animated;
+            if(item->is_animated)
+            {
+                this->BindAnimatedVertices(mesh);
+            }
+            else
+            {
+                qglBindBufferARB(GL_ARRAY_BUFFER_ARB, mesh->vbo_vertex_array);
+                qglVertexPointer(3, GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, position));
+                qglColorPointer(4, GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, color));
+                qglNormalPointer(GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, normal));
+                qglTexCoordPointer(2, GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, tex_coord));
+            }
+        }
+
+        if(m_active_texture != item->face->texture_index)
+        {
+            m_active_texture = item->face->texture_index;
+            qglBindTexture(GL_TEXTURE_2D, m_active_texture);
+        }
+
+        if(is_instanced)
+        {
+            uint32_t run = renderQueue->GetRunLength(i);
+            const GLsizei stride = sizeof(render_instance_t);
+            size_t offset = stream_offset * sizeof(render_instance_t);
+
+            qglBindBufferARB(GL_ARRAY_BUFFER_ARB, m_instances_vbo);
+            for(int c = 0; c < 4; ++c)
+            {
+                qglEnableVertexAttribArrayARB(instanced_shader->instance_mvp + c);
+                qglVertexAttribPointerARB(instanced_shader->instance_mvp + c, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(render_instance_t, mvp) + c * sizeof(GLfloat [4])));
+                qglVertexAttribDivisorARB(instanced_shader->instance_mvp + c, 1);
+            }
+            qglEnableVertexAttribArrayARB(instanced_shader->instance_tint);
+            qglVertexAttribPointerARB(instanced_shader->instance_tint, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(render_instance_t, tint)));
+            qglVertexAttribDivisorARB(instanced_shader->instance_tint, 1);
+            qglBindBufferARB(GL_ARRAY_BUFFER_ARB, item_vbo);
+
+            qglDrawElementsInstancedARB(GL_TRIANGLES, item->face->elements_count, GL_UNSIGNED_INT, item->face->elements, run);
+            stream_offset += run;
+            i += run - 1;
+        }
+        else
+        {
+            qglDrawElements(GL_TRIANGLES, item->face->elements_count, GL_UNSIGNED_INT, item->face->elements);
+        }
     }
 
-    if(need_stencil)
+    if(animated_bound)
     {
-        qglDisable(GL_STENCIL_TEST);
+        this->UnbindAnimatedVertices();
     }
 
-    if (room->content->static_mesh_count > 0)
+    if(instanced_shader)
     {
-        const unlit_tinted_shader_description *shader = shaderManager->getStaticMeshShader();
-        qglUseProgramObjectARB(shader->program);
-        for(uint32_t i = 0; i < room->content->static_mesh_count; i++)
+        for(int c = 0; c < 4; ++c)
         {
-            if((!room->content->static_mesh[i].hide || (r_flags & R_DRAW_DUMMY_STATICS)) &&
-               Frustum_IsOBBVisibleInFrustumList(room->content->static_mesh[i].obb, (room->frustum) ? (room->frustum) : (m_camera->frustum)))
-            {
-                Mat4_Mat4_mul(transform, modelViewProjectionMatrix, room->content->static_mesh[i].transform);
-                qglUniformMatrix4fvARB(shader->model_view_projection, 1, false, transform);
-                qglUniform1fARB(shader->dist_fog, m_camera->dist_far);
-                base_mesh_s *mesh = room->content->static_mesh[i].mesh;
-                GLfloat tint[4];
+            qglVertexAttribDivisorARB(instanced_shader->instance_mvp + c, 0);
+            qglDisableVertexAttribArrayARB(instanced_shader->instance_mvp + c);
+        }
+        qglVertexAttribDivisorARB(instanced_shader->instance_tint, 0);
+        qglDisableVertexAttribArrayARB(instanced_shader->instance_tint);
+    }
+}
 
-                vec4_copy(tint, room->content->static_mesh[i].tint);
+/**
+ * Fills render queue for the current rooms list without GL calls and counts
+ * state changes of traversal, sorted and sorted instanced submission orders.
+ */
+void CRender::GetRenderQueueStats(struct render_queue_stats_s *traversal, struct render_queue_stats_s *sorted, struct render_queue_stats_s *instanced)
+{
+    renderQueue->Reset();
+    for(uint32_t i = 0; m_camera && (i < r_list_active_count); i++)
+    {
+        room_p room = r_list[i].room;
+        this->QueueRoom(room, m_camera->gl_view_proj_mat, !this->IsRoomNeedStencil(room));
+    }
+    renderQueue->GetStats(traversal);
+    renderQueue->Sort();
+    renderQueue->GetStats(sorted);
+    renderQueue->GetStats(instanced, RENDER_QUEUE_SHADER_STATIC);
+    renderQueue->Reset();
+}
 
-                //If this static mesh is in a water room
-                if(room->content->room_flags & TR_ROOM_FLAG_WATER)
-                {
-                    CalculateWaterTint(tint, 0);
-                }
-                qglUniform4fvARB(shader->tint_mult, 1, tint);
-                this->DrawMesh(mesh, NULL, NULL);
+/**
+ * Draws stencil masked room mesh and entities; room mesh without stencil and
+ * static meshes go to the render queue.
+ */
+void CRender::DrawRoom(struct room_s *room, const float modelViewMatrix[16], const float modelViewProjectionMatrix[16])
+{
+    engine_container_p cont;
+    entity_p ent;
+    bool need_stencil = this->IsRoomNeedStencil(room);
+
+    ////start test stencil test code
+    if(need_stencil)
+    {
+        const int elem_size = (3 + 3 + 4 + 2) * sizeof(GLfloat);
+        const unlit_tinted_shader_description *shader = shaderManager->getRoomShader(false, false);
+        size_t buf_size;
+
+        qglUseProgramObjectARB(shader->program);
+        qglUniform1iARB(shader->sampler, 0);
+        qglUniformMatrix4fvARB(shader->model_view_projection, 1, false, engine_camera.gl_view_proj_mat);
+        qglUniform1fARB(shader->dist_fog, m_camera->dist_far);
+        qglEnable(GL_STENCIL_TEST);
+        qglClear(GL_STENCIL_BUFFER_BIT);
+        qglStencilFunc(GL_NEVER, 1, 0x00);
+        qglStencilOp(GL_REPLACE, GL_KEEP, GL_KEEP);
+        for(frustum_p f = room->frustum; f; f = f->next)
+        {
+            buf_size = f->vertex_count * elem_size;
+            GLfloat *v, *buf = (GLfloat*)Sys_GetTempMem(buf_size);
+            v=buf;
+            for(int16_t i = f->vertex_count - 1; i >= 0; i--)
+            {
+                vec3_copy(v, f->vertex + 3 * i);                    v+=3;
+                vec3_copy_inv(v, engine_camera.transform.M4x4 + 8);   v+=3;
+                vec4_set_one(v);                                    v+=4;
+                v[0] = v[1] = 0.0;                                  v+=2;
             }
+
+            m_active_texture = 0;
+            BindWhiteTexture();
+            qglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+            qglVertexPointer(3, GL_FLOAT, elem_size, buf+0);
+            qglNormalPointer(GL_FLOAT, elem_size, buf+3);
+            qglColorPointer(4, GL_FLOAT, elem_size, buf+3+3);
+            qglTexCoordPointer(2, GL_FLOAT, elem_size, buf+3+3+4);
+            qglDrawArrays(GL_TRIANGLE_FAN, 0, f->vertex_count);
+
+            Sys_ReturnTempMem(buf_size);
+        }
+        qglStencilFunc(GL_EQUAL, 1, 0xFF);
+
+        if(!(r_flags & R_SKIP_ROOM) && room->content->mesh)
+        {
+            float modelViewProjectionTransform[16];
+            Mat4_Mat4_mul(modelViewProjectionTransform, modelViewProjectionMatrix, room->transform);
+
+            shader = shaderManager->getRoomShader(room->content->light_mode == 1, room->content->room_flags & 1);
+
+            GLfloat tint[4];
+            CalculateWaterTint(tint, 1);
+            qglUseProgramObjectARB(shader->program);
+            qglUniform4fvARB(shader->tint_mult, 1, tint);
+            qglUniform1fARB(shader->current_tick, (GLfloat) SDL_GetTicks());
+            qglUniform1iARB(shader->sampler, 0);
+            qglUniformMatrix4fvARB(shader->model_view_projection, 1, false, modelViewProjectionTransform);
+            qglUniform1fARB(shader->dist_fog, m_camera->dist_far);
+            this->DrawMesh(room->content->mesh, NULL, NULL);
         }
+        qglDisable(GL_STENCIL_TEST);
     }
 
+    this->QueueRoom(room, modelViewProjectionMatrix, !need_stencil);
+
     for(cont = room->containers; cont; cont = cont->next)
     {
         switch(cont->object_type)
@@ -1104,35 +1988,6 @@ void CRender::DrawRoom(struct room_s *room, const float modelViewMatrix[16], con
         room_p near_room = room->content->near_room_list[ni]->real_room;
         if(!room->content->near_room_list[ni]->is_in_r_list)
         {
-            if (near_room->content->static_mesh_count > 0)
-            {
-                const unlit_tinted_shader_description *shader = shaderManager->getStaticMeshShader();
-                for(uint32_t si = 0; si < near_room->content->static_mesh_count; si++)
-                {
-                    if(OBB_OBB_Test(near_room->content->static_mesh[si].obb, room->obb, 0.0f) &&
-                       Frustum_IsOBBVisibleInFrustumList(near_room->content->static_mesh[si].obb, (room->frustum) ? (room->frustum) : (m_camera->frustum)) &&
-                       (!near_room->content->static_mesh[si].hide || (r_flags & R_DRAW_DUMMY_STATICS)))
-                    {
-                        qglUseProgramObjectARB(shader->program);
-                        Mat4_Mat4_mul(transform, modelViewProjectionMatrix, near_room->content->static_mesh[si].transform);
-                        qglUniformMatrix4fvARB(shader->model_view_projection, 1, false, transform);
-                        qglUniform1fARB(shader->dist_fog, m_camera->dist_far);
-                        base_mesh_s *mesh = near_room->content->static_mesh[si].mesh;
-                        GLfloat tint[4];
-
-                        vec4_copy(tint, near_room->content->static_mesh[si].tint);
-
-                        //If this static mesh is in a water near_room
-                        if(near_room->content->room_flags & TR_ROOM_FLAG_WATER)
-                        {
-                            CalculateWaterTint(tint, 0);
-                        }
-                        qglUniform4fvARB(shader->tint_mult, 1, tint);
-                        this->DrawMesh(mesh, NULL, NULL);
-                    }
-                }
-            }
-
             for(cont = near_room->containers; cont; cont=cont->next)
             {
                 switch(cont->object_type)
@@ -1152,52 +2007,114 @@ void CRender::DrawRoom(struct room_s *room, const float modelViewMatrix[16], con
 }
 
 
-void CRender::DrawRoomSprites(struct room_s *room)
+static int Sprite_CmpItems(const void *a, const void *b)
 {
-    if (room->content->sprites_count > 0)
+    GLuint ta = ((const struct sprite_item_s*)a)->texture;
+    GLuint tb = ((const struct sprite_item_s*)b)->texture;
+    return (ta < tb) ? (-1) : ((ta > tb) ? (1) : (0));
+}
+
+/**
+ * Sprites of all visible rooms are written into one stream sorted by texture
+ * page, so every page is drawn by one call. Sprites are alpha tested, the
+ * order inside of a page does not matter.
+ */
+void CRender::DrawSprites()
+{
+    uint32_t count = 0;
+    for(uint32_t i = 0; i < r_list_active_count; i++)
     {
-        const unlit_tinted_shader_description *shader = shaderManager->getRoomShader(false, false);
-        GLfloat *view = m_camera->transform.M4x4 + 8;
+        count += r_list[i].room->content->sprites_count;
+    }
+    if(count == 0)
+    {
+        return;
+    }
 
-        qglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
-        qglUseProgramObjectARB(shader->program);
-        qglUniform1iARB(shader->sampler, 0);
-        qglUniformMatrix4fvARB(shader->model_view_projection, 1, false, m_camera->gl_view_proj_mat);
-        qglUniform1fARB(shader->dist_fog, m_camera->dist_far);
+    if(count > m_sprite_items_size)
+    {
+        m_sprite_items_size = count + count / 2;
+        m_sprite_items = (struct sprite_item_s*)realloc(m_sprite_items, m_sprite_items_size * sizeof(struct sprite_item_s));
+        m_sprite_vertices = (vertex_p)realloc(m_sprite_vertices, 4 * m_sprite_items_size * sizeof(vertex_t));
+    }
 
-        for(uint32_t i = 0; i < room->content->sprites_count; i++)
+    count = 0;
+    for(uint32_t i = 0; i < r_list_active_count; i++)
+    {
+        room_content_p content = r_list[i].room->content;
+        for(uint32_t j = 0; j < content->sprites_count; j++)
         {
-            room_sprite_p s = room->content->sprites + i;
-            vertex_p v = room->content->sprites_vertices + i * 4;
-            vec3_copy_inv(v[0].normal, view);
-            vec3_copy_inv(v[1].normal, view);
-            vec3_copy_inv(v[2].normal, view);
-            vec3_copy_inv(v[3].normal, view);
+            room_sprite_p s = content->sprites + j;
+            if(s->sprite)
+            {
+                m_sprite_items[count].texture = s->sprite->texture_index;
+                m_sprite_items[count].sprite = s;
+                m_sprite_items[count].vertices = content->sprites_vertices + j * 4;
+                count++;
+            }
+        }
+    }
+    qsort(m_sprite_items, count, sizeof(struct sprite_item_s), Sprite_CmpItems);
+
+    GLfloat *view = m_camera->transform.M4x4 + 8;
+    vertex_p v = m_sprite_vertices;
+    for(uint32_t i = 0; i < count; i++, v += 4)
+    {
+        room_sprite_p s = m_sprite_items[i].sprite;
+        memcpy(v, m_sprite_items[i].vertices, 4 * sizeof(vertex_t));
+        vec3_copy_inv(v[0].normal, view);
+        vec3_copy_inv(v[1].normal, view);
+        vec3_copy_inv(v[2].normal, view);
+        vec3_copy_inv(v[3].normal, view);
 
-            v[0].position[0] = s->pos[0] + s->sprite->right * m_cam_right[0];
-            v[0].position[1] = s->pos[1] + s->sprite->right * m_cam_right[1];
-            v[0].position[2] = s->pos[2] + s->sprite->right * m_cam_right[2] + s->sprite->top;
+        v[0].position[0] = s->pos[0] + s->sprite->right * m_cam_right[0];
+        v[0].position[1] = s->pos[1] + s->sprite->right * m_cam_right[1];
+        v[0].position[2] = s->pos[2] + s->sprite->right * m_cam_right[2] + s->sprite->top;
 
-            v[1].position[0] = s->pos[0] + s->sprite->left * m_cam_right[0];
-            v[1].position[1] = s->pos[1] + s->sprite->left * m_cam_right[1];
-            v[1].position[2] = s->pos[2] + s->sprite->left * m_cam_right[2] + s->sprite->top;
+        v[1].position[0] = s->pos[0] + s->sprite->left * m_cam_right[0];
+        v[1].position[1] = s->pos[1] + s->sprite->left * m_cam_right[1];
+        v[1].position[2] = s->pos[2] + s->sprite->left * m_cam_right[2] + s->sprite->top;
 
-            v[2].position[0] = s->pos[0] + s->sprite->left * m_cam_right[0];
-            v[2].position[1] = s->pos[1] + s->sprite->left * m_cam_right[1];
-            v[2].position[2] = s->pos[2] + s->sprite->left * m_cam_right[2] + s->sprite->bottom;
+        v[2].position[0] = s->pos[0] + s->sprite->left * m_cam_right[0];
+        v[2].position[1] = s->pos[1] + s->sprite->left * m_cam_right[1];
+        v[2].position[2] = s->pos[2] + s->sprite->left * m_cam_right[2] + s->sprite->bottom;
 
-            v[3].position[0] = s->pos[0] + s->sprite->right * m_cam_right[0];
-            v[3].position[1] = s->pos[1] + s->sprite->right * m_cam_right[1];
-            v[3].position[2] = s->pos[2] + s->sprite->right * m_cam_right[2] + s->sprite->bottom;
-        }
+        v[3].position[0] = s->pos[0] + s->sprite->right * m_cam_right[0];
+        v[3].position[1] = s->pos[1] + s->sprite->right * m_cam_right[1];
+        v[3].position[2] = s->pos[2] + s->sprite->right * m_cam_right[2] + s->sprite->bottom;
+    }
 
-        qglBindTexture(GL_TEXTURE_2D, room->content->sprites->sprite->texture_index);
-        qglVertexPointer(3, GL_FLOAT, sizeof(vertex_t), room->content->sprites_vertices->position);
-        qglColorPointer(4, GL_FLOAT, sizeof(vertex_t), room->content->sprites_vertices->color);
-        qglNormalPointer(GL_FLOAT, sizeof(vertex_t), room->content->sprites_vertices->normal);
-        qglTexCoordPointer(2, GL_FLOAT, sizeof(vertex_t), room->content->sprites_vertices->tex_coord);
-        qglDrawArrays(GL_QUADS, 0, 4 * room->content->sprites_count);
+    if(m_sprites_vbo == 0)
+    {
+        qglGenBuffersARB(1, &m_sprites_vbo);
     }
+    qglBindBufferARB(GL_ARRAY_BUFFER_ARB, m_sprites_vbo);
+    qglBufferDataARB(GL_ARRAY_BUFFER_ARB, 4 * count * sizeof(vertex_t), m_sprite_vertices, GL_STREAM_DRAW);
+
+    const unlit_tinted_shader_description *shader = shaderManager->getRoomShader(false, false);
+    qglUseProgramObjectARB(shader->program);
+    qglUniform1iARB(shader->sampler, 0);
+    qglUniformMatrix4fvARB(shader->model_view_projection, 1, false, m_camera->gl_view_proj_mat);
+    qglUniform1fARB(shader->dist_fog, m_camera->dist_far);
+
+    qglVertexPointer(3, GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, position));
+    qglColorPointer(4, GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, color));
+    qglNormalPointer(GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, normal));
+    qglTexCoordPointer(2, GL_FLOAT, sizeof(vertex_t), (void*)offsetof(vertex_t, tex_coord));
+
+    for(uint32_t first = 0; first < count;)
+    {
+        uint32_t last = first + 1;
+        for(; (last < count) && (m_sprite_items[last].texture == m_sprite_items[first].texture); last++);
+        if(m_active_texture != m_sprite_items[first].texture)
+        {
+            m_active_texture = m_sprite_items[first].texture;
+            qglBindTexture(GL_TEXTURE_2D, m_active_texture);
+        }
+        qglDrawArrays(GL_QUADS, 4 * first, 4 * (last - first));
+        first = last;
+    }
+    qglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
 }
 
 
@@ -1278,6 +2195,10 @@ int CRender::ProcessRoom(struct portal_s *portal, struct frustum_s *frus)
     {
         portal_p p = room->content->portals + i;
         room_p dest_room = p->dest_room->real_room;
+        if(!this->IsRoomInPVS(dest_room))
+        {
+            continue;                                                           // no sight line from camera room, skip frustums generation
+        }
         frustum_p gen_frus = frustumManager->PortalFrustumIntersect(p, frus, m_camera);  // backface portals are filtered here
         if(gen_frus)
         {
@@ -1290,11 +2211,16 @@ int CRender::ProcessRoom(struct portal_s *portal, struct frustum_s *frus)
     return ret;
 }
 
+bool CRender::IsRoomInPVS(struct room_s *room)
+{
+    return CRoomPVS::IsInRow(m_pvs_row, room - m_rooms);
+}
+
 /**
  * Sets up the light calculations for the given entity based on its current
  * room. Returns the used shader, which will have been made current already.
  */
-const lit_shader_description *CRender::SetupEntityLight(struct entity_s *entity, const float modelViewMatrix[16])
+const lit_shader_description *CRender::SetupEntityLight(struct entity_s *entity, const float modelViewMatrix[16], bool skinned)
 {
     // Calculate lighting
     const lit_shader_description *shader;
@@ -1399,7 +2325,7 @@ const lit_shader_description *CRender::SetupEntityLight(struct entity_s *entity,
             }
         }
 
-        shader = shaderManager->getEntityShader(current_light_number);
+        shader = (skinned) ? (shaderManager->getEntitySkinnedShader(current_light_number)) : (shaderManager->getEntityShader(current_light_number));
         qglUseProgramObjectARB(shader->program);
         qglUniform1fARB(shader->dist_fog, m_camera->dist_far);
         qglUniform4fvARB(shader->light_ambient, 1, ambient_component);
@@ -1410,7 +2336,7 @@ const lit_shader_description *CRender::SetupEntityLight(struct entity_s *entity,
     }
     else
     {
-        shader = shaderManager->getEntityShader(0);
+        shader = (skinned) ? (shaderManager->getEntitySkinnedShader(0)) : (shaderManager->getEntityShader(0));
         qglUseProgramObjectARB(shader->program);
         qglUniform1fARB(shader->dist_fog, m_camera->dist_far);
     }
@@ -41,6 +41,9 @@ struct sprite_s;
 struct base_mesh_s;
 struct obb_s;
 struct lit_shader_description;
+struct skinned_shader_description;
+struct ss_bone_frame_s;
+struct render_queue_stats_s;
 
 // Native TR blending modes.
 
@@ -82,6 +85,7 @@ typedef struct render_settings_s
     float     fog_start_depth;
     float     fog_end_depth;
     bool      show_fps;
+    bool      gpu_skinning;                                                     // draw skeletal models by skinned shader if it is available
 }render_settings_t, *render_settings_p;
 
 
@@ -149,6 +153,7 @@ class CRender
         void CleanList();
 
         void DrawBSPPolygon(struct bsp_polygon_s *p);
+        void DrawBSPDynamicSubtree(struct bsp_node_s *subtree);
         void DrawBSPFrontToBack(struct bsp_node_s *root);
         void DrawBSPBackToFront(struct bsp_node_s *root);
 
@@ -157,10 +162,13 @@ class CRender
         void DrawSkyBox(const float matrix[16]);
 
         void DrawSkeletalModel(const struct lit_shader_description *shader, struct ss_bone_frame_s *bframe, const float mvMatrix[16], const float mvpMatrix[16]);
+        void DrawSkeletalModelSkinned(const struct skinned_shader_description *shader, struct ss_bone_frame_s *bframe, const float mvMatrix[16], const float projection[16]);
+        void GetSkinningError(struct ss_bone_frame_s *bframe, float *position_error, float *normal_error);
         void DrawEntity(struct entity_s *entity, const float modelViewMatrix[16], const float modelViewProjectionMatrix[16]);
 
         void DrawRoom(struct room_s *room, const float matrix[16], const float modelViewProjectionMatrix[16]);
-        void DrawRoomSprites(struct room_s *room);
+        void DrawSprites();
+        void GetRenderQueueStats(struct render_queue_stats_s *traversal, struct render_queue_stats_s *sorted, struct render_queue_stats_s *instanced);
 
         struct gl_text_line_s *OutTextXYZ(GLfloat x, GLfloat y, GLfloat z, const char *fmt, ...);
 
@@ -172,10 +180,40 @@ class CRender
             float              dist;
         };
 
+        struct vis_cache_s
+        {
+            bool               valid;
+            struct room_s     *room;                                            // camera room
+            float              pos[3];                                          // camera state on list generation
+            float              up[3];
+            float              view[3];
+            float              dist_far;
+            float              fov;
+            uint32_t           reused_frames;
+        };
+
         void InitSettings();
         int  AddRoom(struct room_s *room);
         int  ProcessRoom(struct portal_s *portal, struct frustum_s *frus);
-        const lit_shader_description *SetupEntityLight(struct entity_s *entity, const float modelViewMatrix[16]);
+        bool IsRoomInPVS(struct room_s *room);
+        bool IsRoomNeedStencil(struct room_s *room);
+        void QueueRoom(struct room_s *room, const float modelViewProjectionMatrix[16], bool with_mesh);
+        void DrawRenderQueue();
+        void UpdateAnimTexCoords(struct base_mesh_s *mesh);
+        void InitAnimTexTable();
+        void UpdateAnimTexTable();
+        void BindAnimatedVertices(struct base_mesh_s *mesh);
+        void UnbindAnimatedVertices();
+        void DrawMeshAnimatedFaces(struct base_mesh_s *mesh);
+        GLuint GetSkinBuffer(struct base_mesh_s *mesh, struct base_mesh_s *parent_mesh, uint32_t *map);
+        void ClearSkinBuffers();
+        class CDynamicBSP *GetRoomBSP(struct room_s *room);
+        class CDynamicBSP *BuildRoomBSP(struct room_s *room);
+        void ClearRoomsBSP();
+        void BindBSPVertices(GLuint vbo);
+        bool IsVisCacheValid(struct camera_s *cam);
+        void UpdateVisCache(struct camera_s *cam);
+        const lit_shader_description *SetupEntityLight(struct entity_s *entity, const float modelViewMatrix[16], bool skinned);
 
         struct camera_s            *m_camera;
 
@@ -192,6 +230,23 @@ class CRender
         uint32_t                    r_list_active_count;
         struct render_list_s       *r_list;
         class CFrustumManager      *frustumManager;
+        class CRoomPVS             *roomPVS;
+        class CRenderQueue         *renderQueue;
+        GLuint                      m_instances_vbo;                            // per frame instances stream of static meshes
+        const uint8_t              *m_pvs_row;                                  // rooms set potentially visible from camera room
+        struct room_bsp_s          *m_rooms_bsp;                                // prebuilt static transparency trees of rooms
+        GLuint                      m_bsp_vbo;                                  // vertices of the static tree being drawn
+        GLuint                      m_anim_tex_table;                           // current frames of animated textures for vertex shaders
+        GLfloat                    *m_anim_tex_data;
+        bool                        m_anim_tex_lookup;                          // animated tex coords are computed by vertex shaders
+        struct sprite_item_s       *m_sprite_items;                             // visible sprites of the frame
+        uint32_t                    m_sprite_items_size;
+        struct vertex_s            *m_sprite_vertices;
+        GLuint                      m_sprites_vbo;                              // per frame sprites stream
+        struct skin_buffer_s       *m_skin_buffers;                             // skinned meshes vertex streams for skinned shader
+        uint32_t                    m_skin_buffers_count;
+        uint32_t                    m_skin_buffers_size;
+        struct vis_cache_s          m_vis_cache;
 
     public:
         struct render_settings_s    settings;
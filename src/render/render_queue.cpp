@@ -0,0 +1,237 @@
+
+#include <stdlib.h>
+#include <string.h>
+#include <SDL2/SDL_platform.h>
+#include <SDL2/SDL_opengl.h>
+
+#include "../core/vmath.h"
+#include "../mesh.h"
+#include "render_queue.h"
+
+
+#define RENDER_QUEUE_INITIAL_SIZE   (1024)
+#define RENDER_QUEUE_NAME_MASK      (0x000FFFFF)
+
+/*
+ * Items are ordered by the key state bits (shader, texture, vbo), then by
+ * face, then by instance: all instances of a face go in a row, so they may be
+ * drawn by one instanced call.
+ */
+static int RenderQueue_CmpItems(const void *a, const void *b)
+{
+    const render_item_s *ia = (const render_item_s*)a;
+    const render_item_s *ib = (const render_item_s*)b;
+    uint64_t state_a = ia->key >> 20;
+    uint64_t state_b = ib->key >> 20;
+    if(state_a != state_b)
+    {
+        return (state_a < state_b) ? (-1) : (1);
+    }
+    if(ia->face != ib->face)
+    {
+        return (ia->face < ib->face) ? (-1) : (1);
+    }
+    return (ia->instance < ib->instance) ? (-1) : ((ia->instance > ib->instance) ? (1) : (0));
+}
+
+
+CRenderQueue::CRenderQueue():
+m_items(NULL),
+m_items_count(0),
+m_items_size(0),
+m_instances(NULL),
+m_instances_count(0),
+m_instances_size(0),
+m_animated_meshes(NULL),
+m_animated_meshes_count(0),
+m_animated_meshes_size(0),
+m_stream(NULL),
+m_stream_size(0)
+{
+}
+
+CRenderQueue::~CRenderQueue()
+{
+    free(m_items);
+    free(m_instances);
+    free(m_animated_meshes);
+    free(m_stream);
+    m_items = NULL;
+    m_instances = NULL;
+    m_animated_meshes = NULL;
+    m_stream = NULL;
+}
+
+void CRenderQueue::Reset()
+{
+    m_items_count = 0;
+    m_instances_count = 0;
+    m_animated_meshes_count = 0;
+}
+
+render_item_p CRenderQueue::AllocItem()
+{
+    if(m_items_count >= m_items_size)
+    {
+        m_items_size = (m_items_size) ? (m_items_size * 2) : (RENDER_QUEUE_INITIAL_SIZE);
+        m_items = (render_item_p)realloc(m_items, m_items_size * sizeof(render_item_t));
+    }
+    return m_items + m_items_count++;
+}
+
+uint32_t CRenderQueue::AddInstance(uint16_t shader, const float mvp[16], const float tint[4])
+{
+    render_instance_p inst;
+    if(m_instances_count >= m_instances_size)
+    {
+        m_instances_size = (m_instances_size) ? (m_instances_size * 2) : (RENDER_QUEUE_INITIAL_SIZE);
+        m_instances = (render_instance_p)realloc(m_instances, m_instances_size * sizeof(render_instance_t));
+    }
+    inst = m_instances + m_instances_count;
+    memcpy(inst->mvp, mvp, sizeof(inst->mvp));
+    vec4_copy(inst->tint, tint);
+    inst->shader = shader;
+
+    return m_instances_count++;
+}
+
+/*
+ * Sort key: shader (4 bits), texture page (20 bits), VBO (20 bits), instance
+ * (20 bits). GL names are small sequential numbers, so masking is safe.
+ */
+void CRenderQueue::AddMesh(struct base_mesh_s *mesh, uint32_t instance)
+{
+    uint64_t key = ((uint64_t)(m_instances[instance].shader & 0x0F) << 60) | (uint64_t)(instance & RENDER_QUEUE_NAME_MASK);
+    uint64_t vbo_key;
+    mesh_face_p face;
+
+    if(mesh->animated_faces_count)
+    {
+        uint32_t i = 0;
+        for(; (i < m_animated_meshes_count) && (m_animated_meshes[i] != mesh); ++i);
+        if(i == m_animated_meshes_count)
+        {
+            if(m_animated_meshes_count >= m_animated_meshes_size)
+            {
+                m_animated_meshes_size = (m_animated_meshes_size) ? (m_animated_meshes_size * 2) : (64);
+                m_animated_meshes = (struct base_mesh_s**)realloc(m_animated_meshes, m_animated_meshes_size * sizeof(struct base_mesh_s*));
+            }
+            m_animated_meshes[m_animated_meshes_count++] = mesh;
+        }
+
+        vbo_key = (uint64_t)(mesh->vbo_animated_vertex_array & RENDER_QUEUE_NAME_MASK) << 20;
+        face = mesh->animated_faces;
+        for(uint32_t i = 0; i < mesh->animated_faces_count; ++i, ++face)
+        {
+            render_item_p item = this->AllocItem();
+            item->key = key | vbo_key | ((uint64_t)(face->texture_index & RENDER_QUEUE_NAME_MASK) << 40);
+            item->mesh = mesh;
+            item->face = face;
+            item->instance = instance;
+            item->is_animated = 1;
+        }
+    }
+
+    if(mesh->vertex_count)
+    {
+        vbo_key = (uint64_t)(mesh->vbo_vertex_array & RENDER_QUEUE_NAME_MASK) << 20;
+        face = mesh->faces;
+        for(uint32_t i = 0; i < mesh->faces_count; ++i, ++face)
+        {
+            render_item_p item = this->AllocItem();
+            item->key = key | vbo_key | ((uint64_t)(face->texture_index & RENDER_QUEUE_NAME_MASK) << 40);
+            item->mesh = mesh;
+            item->face = face;
+            item->instance = instance;
+            item->is_animated = 0;
+        }
+    }
+}
+
+void CRenderQueue::Sort()
+{
+    if(m_items_count > 1)
+    {
+        qsort(m_items, m_items_count, sizeof(render_item_t), RenderQueue_CmpItems);
+    }
+}
+
+/*
+ * Number of items from the first one with the same face (instances of
+ * the face in sorted queue).
+ */
+uint32_t CRenderQueue::GetRunLength(uint32_t first)
+{
+    uint32_t i = first + 1;
+    for(; (i < m_items_count) && (m_items[i].face == m_items[first].face); ++i);
+    return i - first;
+}
+
+/*
+ * Copies instances of the items drawn with the shader into the stream in
+ * items order, so every run of instances is contiguous there.
+ */
+uint32_t CRenderQueue::BuildInstancesStream(uint16_t shader)
+{
+    uint32_t count = 0;
+    if(m_stream_size < m_items_count)
+    {
+        m_stream_size = m_items_size;
+        m_stream = (render_instance_p)realloc(m_stream, m_stream_size * sizeof(render_instance_t));
+    }
+    for(render_item_p item = m_items; item < m_items + m_items_count; ++item)
+    {
+        if(m_instances[item->instance].shader == shader)
+        {
+            m_stream[count++] = m_instances[item->instance];
+        }
+    }
+    return count;
+}
+
+/*
+ * Counts GL state changes and draw calls of the queue submission in the
+ * current items order; used to compare traversal order with the sorted one.
+ * If instanced_shader is a valid shader index, runs of one face drawn with it
+ * are counted as one draw call without uniforms updates.
+ */
+void CRenderQueue::GetStats(render_queue_stats_p stats, uint16_t instanced_shader)
+{
+    uint32_t instance = 0xFFFFFFFF;
+    uint16_t shader = 0xFFFF;
+    GLuint texture = 0;
+    GLuint vbo = 0;
+
+    memset(stats, 0, sizeof(render_queue_stats_t));
+    for(render_item_p item = m_items; item < m_items + m_items_count; ++item)
+    {
+        render_instance_p inst = m_instances + item->instance;
+        GLuint item_vbo = (item->is_animated) ? (item->mesh->vbo_animated_vertex_array) : (item->mesh->vbo_vertex_array);
+        if(inst->shader != shader)
+        {
+            shader = inst->shader;
+            instance = 0xFFFFFFFF;
+            stats->shader_changes++;
+        }
+        if(shader == instanced_shader)
+        {
+            item += this->GetRunLength(item - m_items) - 1;
+        }
+        else if(item->instance != instance)
+        {
+            instance = item->instance;
+            stats->instance_changes++;
+        }
+        if(item_vbo != vbo)
+        {
+            vbo = item_vbo;
+            stats->vbo_changes++;
+        }
+        if(item->face->texture_index != texture)
+        {
+            texture = item->face->texture_index;
+            stats->texture_changes++;
+        }
+        stats->draw_calls++;
+    }
+}
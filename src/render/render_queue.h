@@ -0,0 +1,111 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <stdint.h>
+
+struct base_mesh_s;
+struct mesh_face_s;
+
+/*
+ * Shader indexes of queued instances: static mesh shader or room shader
+ * (| RENDER_QUEUE_SHADER_WATER, | RENDER_QUEUE_SHADER_FLICKER flag bits).
+ */
+#define RENDER_QUEUE_SHADER_STATIC      (0)
+#define RENDER_QUEUE_SHADER_ROOM        (1)
+#define RENDER_QUEUE_SHADER_WATER       (2)
+#define RENDER_QUEUE_SHADER_FLICKER     (4)
+#define RENDER_QUEUE_SHADER_NONE        (0xFFFF)
+
+typedef struct render_queue_stats_s
+{
+    uint32_t                draw_calls;
+    uint32_t                shader_changes;
+    uint32_t                texture_changes;
+    uint32_t                vbo_changes;
+    uint32_t                instance_changes;                                   // matrix and tint uniforms updates
+}render_queue_stats_t, *render_queue_stats_p;
+
+typedef struct render_instance_s
+{
+    float                   mvp[16];
+    float                   tint[4];
+    uint16_t                shader;
+}render_instance_t, *render_instance_p;
+
+typedef struct render_item_s
+{
+    uint64_t                key;                                                // shader | texture | vbo | instance
+    struct base_mesh_s     *mesh;
+    struct mesh_face_s     *face;
+    uint32_t                instance;
+    uint32_t                is_animated;                                        // face from mesh animated faces
+}render_item_t, *render_item_p;
+
+/*
+ * Opaque geometry draw list of a frame: faces of room and static meshes are
+ * collected in traversal order and submitted sorted by shader, texture page
+ * and VBO, so every page is bound once per shader and VBO group.
+ */
+class CRenderQueue
+{
+    render_item_p           m_items;
+    uint32_t                m_items_count;
+    uint32_t                m_items_size;
+
+    render_instance_p       m_instances;
+    uint32_t                m_instances_count;
+    uint32_t                m_instances_size;
+
+    struct base_mesh_s    **m_animated_meshes;                                  // meshes which animated texture coords are updated once per frame
+    uint32_t                m_animated_meshes_count;
+    uint32_t                m_animated_meshes_size;
+
+    render_instance_p       m_stream;                                           // instances of instanced draws
+    uint32_t                m_stream_size;
+
+    render_item_p AllocItem();
+
+public:
+    CRenderQueue();
+   ~CRenderQueue();
+
+    void Reset();
+    uint32_t AddInstance(uint16_t shader, const float mvp[16], const float tint[4]);
+    void AddMesh(struct base_mesh_s *mesh, uint32_t instance);
+    void Sort();
+    void GetStats(render_queue_stats_p stats, uint16_t instanced_shader = RENDER_QUEUE_SHADER_NONE);
+    uint32_t GetRunLength(uint32_t first);
+    uint32_t BuildInstancesStream(uint16_t shader);
+
+    render_instance_p GetInstancesStream()
+    {
+        return m_stream;
+    }
+
+    uint32_t GetItemsCount()
+    {
+        return m_items_count;
+    }
+
+    render_item_p GetItems()
+    {
+        return m_items;
+    }
+
+    render_instance_p GetInstance(uint32_t index)
+    {
+        return m_instances + index;
+    }
+
+    uint32_t GetAnimatedMeshesCount()
+    {
+        return m_animated_meshes_count;
+    }
+
+    struct base_mesh_s *GetAnimatedMesh(uint32_t index)
+    {
+        return m_animated_meshes[index];
+    }
+};
+
+#endif
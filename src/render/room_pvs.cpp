@@ -0,0 +1,231 @@
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../core/system.h"
+#include "../core/vmath.h"
+#include "../core/polygon.h"
+#include "../room.h"
+#include "frustum.h"
+#include "room_pvs.h"
+
+
+#define PVS_MAX_STATES              (8)
+#define PVS_FRUSTUM_VERTICES        (8)                                         // typical clipped portal vertex count
+#define PVS_MAX_FRUSTUM_BUFFER_SIZE (16 * 1024 * 1024)
+
+/*
+ * Is any portal vertex behind the plane of the previous portal in chain
+ * (the side where its destination room is).
+ */
+static bool Portal_IsBehindPortal(portal_p p, portal_p prev)
+{
+    float *v = p->vertex;
+    for(uint16_t i = 0; i < p->vertex_count; i++, v += 3)
+    {
+        if(vec3_plane_dist(prev->norm, v) < -SPLIT_EPSILON)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+CRoomPVS::CRoomPVS():
+m_rooms(NULL),
+m_rooms_count(0),
+m_row_size(0),
+m_states(NULL),
+m_states_count(0)
+{
+}
+
+CRoomPVS::~CRoomPVS()
+{
+    this->ClearStates();
+}
+
+void CRoomPVS::ClearStates()
+{
+    while(m_states)
+    {
+        struct pvs_state_s *next = m_states->next;
+        free(m_states->contents);
+        free(m_states->bits);
+        free(m_states);
+        m_states = next;
+    }
+    m_states_count = 0;
+}
+
+void CRoomPVS::Reset(struct room_s *rooms, uint32_t rooms_count)
+{
+    this->ClearStates();
+    m_rooms = rooms;
+    m_rooms_count = (rooms) ? (rooms_count) : (0);
+    m_row_size = (m_rooms_count + 7) / 8;
+    if(m_rooms_count)
+    {
+        this->Update();
+    }
+}
+
+bool CRoomPVS::IsStateCurrent(struct pvs_state_s *state)
+{
+    for(uint32_t i = 0; i < m_rooms_count; ++i)
+    {
+        if(state->contents[i] != m_rooms[i].content)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Updates sets after flips; returns true if rooms contents arrangement
+ * differs from the previous call.
+ */
+bool CRoomPVS::Update()
+{
+    struct pvs_state_s *prev = NULL, *state = m_states;
+
+    if((m_rooms_count == 0) || (state && this->IsStateCurrent(state)))
+    {
+        return false;
+    }
+
+    for(; state; prev = state, state = state->next)
+    {
+        if(this->IsStateCurrent(state))
+        {
+            prev->next = state->next;
+            state->next = m_states;
+            m_states = state;
+            return true;
+        }
+    }
+
+    state = this->BuildState();
+    state->next = m_states;
+    m_states = state;
+    m_states_count++;
+    if(m_states_count > PVS_MAX_STATES)
+    {
+        for(prev = m_states; prev->next->next; prev = prev->next);
+        free(prev->next->contents);
+        free(prev->next->bits);
+        free(prev->next);
+        prev->next = NULL;
+        m_states_count--;
+    }
+
+    return true;
+}
+
+struct CRoomPVS::pvs_state_s *CRoomPVS::BuildState()
+{
+    struct pvs_state_s *state = (struct pvs_state_s*)malloc(sizeof(struct pvs_state_s));
+    uint32_t *portals_offset = (uint32_t*)malloc((m_rooms_count + 1) * sizeof(uint32_t));
+    const uint32_t frustum_size = sizeof(frustum_t) + (3 * (2 * PVS_FRUSTUM_VERTICES + 1) + 4 * PVS_FRUSTUM_VERTICES) * sizeof(float);
+    uint32_t portals_total = 0;
+    uint32_t max_portals_in_pvs = 0;
+    uint8_t *visited;
+    portal_p *stack;
+
+    state->contents = (struct room_content_s**)malloc(m_rooms_count * sizeof(struct room_content_s*));
+    state->bits = (uint8_t*)calloc(m_rooms_count * m_row_size, sizeof(uint8_t));
+    state->frustum_buffer_size = 0;
+    state->next = NULL;
+    for(uint32_t i = 0; i < m_rooms_count; ++i)
+    {
+        room_p r = m_rooms + i;
+        state->contents[i] = r->content;
+        portals_offset[i] = portals_total;
+        portals_total += (r == r->real_room) ? (r->content->portals_count) : (0);
+    }
+    portals_offset[m_rooms_count] = portals_total;
+
+    visited = (uint8_t*)malloc(portals_total + 1);
+    stack = (portal_p*)malloc((portals_total + 1) * sizeof(portal_p));
+    for(uint32_t i = 0; i < m_rooms_count; ++i)
+    {
+        room_p room = m_rooms + i;
+        uint8_t *row = state->bits + i * m_row_size;
+        uint32_t portals_in_pvs = 0;
+
+        if(room != room->real_room)
+        {
+            continue;                                                           // rows are looked up by real rooms
+        }
+
+        row[i >> 3] |= 1 << (i & 0x07);
+        for(uint32_t p1 = 0; p1 < room->content->portals_count; ++p1)
+        {
+            portal_p first = room->content->portals + p1;
+            uint32_t stack_size = 0;
+            uint32_t dest = first->dest_room->real_room - m_rooms;
+
+            row[dest >> 3] |= 1 << (dest & 0x07);
+            memset(visited, 0, portals_total);
+            stack[stack_size++] = first;
+            while(stack_size > 0)
+            {
+                portal_p prev = stack[--stack_size];
+                room_p dest_room = prev->dest_room->real_room;
+                dest = dest_room - m_rooms;
+                for(uint32_t j = 0; j < dest_room->content->portals_count; ++j)
+                {
+                    portal_p p = dest_room->content->portals + j;
+                    uint32_t k = portals_offset[dest] + j;
+                    if(!visited[k] && Portal_IsBehindPortal(p, prev) && Portal_IsBehindPortal(p, first))
+                    {
+                        uint32_t next_dest = p->dest_room->real_room - m_rooms;
+                        visited[k] = 1;
+                        row[next_dest >> 3] |= 1 << (next_dest & 0x07);
+                        stack[stack_size++] = p;
+                    }
+                }
+            }
+        }
+
+        for(uint32_t j = 0; j < m_rooms_count; ++j)
+        {
+            if(IsInRow(row, j) && (m_rooms[j].real_room == m_rooms + j))
+            {
+                portals_in_pvs += m_rooms[j].content->portals_count;
+            }
+        }
+        max_portals_in_pvs = (portals_in_pvs > max_portals_in_pvs) ? (portals_in_pvs) : (max_portals_in_pvs);
+    }
+    free(stack);
+    free(visited);
+    free(portals_offset);
+
+    state->frustum_buffer_size = max_portals_in_pvs * frustum_size;
+    if(state->frustum_buffer_size > PVS_MAX_FRUSTUM_BUFFER_SIZE)
+    {
+        state->frustum_buffer_size = PVS_MAX_FRUSTUM_BUFFER_SIZE;
+    }
+
+    return state;
+}
+
+const uint8_t *CRoomPVS::GetRoomRow(struct room_s *room)
+{
+    if(m_states && room)
+    {
+        uint32_t index = room->real_room - m_rooms;
+        if(index < m_rooms_count)
+        {
+            return m_states->bits + index * m_row_size;
+        }
+    }
+    return NULL;
+}
+
+uint32_t CRoomPVS::GetFrustumBufferSize()
+{
+    return (m_states) ? (m_states->frustum_buffer_size) : (0);
+}
@@ -0,0 +1,55 @@
+#ifndef ROOM_PVS_H
+#define ROOM_PVS_H
+
+#include <stdint.h>
+
+struct room_s;
+struct room_content_s;
+
+/*
+ * Conservative room to room potentially visible sets. Room B is in the set of
+ * room A if there is a portals chain A -> ... -> B where every next portal
+ * has a vertex behind the first and the previous portal planes (a sight line
+ * crosses every portal plane only once). Rooms outside the set can not be
+ * reached by portal frustums from a camera inside room A.
+ *
+ * Sets depend on the portals, so they are built for the current flip state
+ * (rooms contents arrangement) and kept in a small cache: toggling flipmaps
+ * back and forth does not rebuild them.
+ */
+class CRoomPVS
+{
+    struct pvs_state_s
+    {
+        struct room_content_s **contents;                                       // contents of all rooms at build time
+        uint8_t                *bits;                                           // rooms_count rows of rooms_count bits
+        uint32_t                frustum_buffer_size;                            // estimated frustums arena size
+        struct pvs_state_s     *next;
+    };
+
+    struct room_s       *m_rooms;
+    uint32_t             m_rooms_count;
+    uint32_t             m_row_size;
+    struct pvs_state_s  *m_states;                                              // most recently used state first
+    uint32_t             m_states_count;
+
+    bool IsStateCurrent(struct pvs_state_s *state);
+    struct pvs_state_s *BuildState();
+    void ClearStates();
+
+public:
+    CRoomPVS();
+   ~CRoomPVS();
+
+    void Reset(struct room_s *rooms, uint32_t rooms_count);
+    bool Update();                                                              // returns true if flip state was changed
+    const uint8_t *GetRoomRow(struct room_s *room);
+    uint32_t GetFrustumBufferSize();
+
+    static bool IsInRow(const uint8_t *row, uint32_t room_index)
+    {
+        return (row == NULL) || (row[room_index >> 3] & (1 << (room_index & 0x07)));
+    }
+};
+
+#endif
@@ -33,10 +33,18 @@ shader_description::shader_description(const shader_stage &vertex, const shader_
     program = qglCreateProgramObjectARB();
     qglAttachObjectARB(program, vertex.shader);
     qglAttachObjectARB(program, fragment.shader);
+    qglBindAttribLocationARB(program, ANIM_TEX_FRAME_ATTRIB, "animTexFrame");
     qglLinkProgramARB(program);
     //printInfoLog(program);
 
     sampler = qglGetUniformLocationARB(program, "color_map");
+    GLint anim_tex_table = qglGetUniformLocationARB(program, "animTexTable");
+    if(anim_tex_table >= 0)
+    {
+        qglUseProgramObjectARB(program);
+        qglUniform1iARB(anim_tex_table, ANIM_TEX_TABLE_UNIT);
+        qglUseProgramObjectARB(0);
+    }
 }
 
 shader_description::~shader_description()
@@ -76,3 +84,19 @@ unlit_tinted_shader_description::unlit_tinted_shader_description(const shader_st
     current_tick = qglGetUniformLocationARB(program, "fCurrentTick");
     tint_mult = qglGetUniformLocationARB(program, "tintMult");
 }
+
+instanced_shader_description::instanced_shader_description(const shader_stage &vertex, const shader_stage &fragment)
+: unlit_tinted_shader_description(vertex, fragment)
+{
+    instance_mvp = qglGetAttribLocationARB(program, "instanceMVP");
+    instance_tint = qglGetAttribLocationARB(program, "instanceTint");
+}
+
+skinned_shader_description::skinned_shader_description(const shader_stage &vertex, const shader_stage &fragment)
+: lit_shader_description(vertex, fragment)
+{
+    projection = qglGetUniformLocationARB(program, "projection");
+    bone_matrices = qglGetUniformLocationARB(program, "boneMatrices");
+    bone_index = qglGetAttribLocationARB(program, "boneIndex");
+    bone_weight = qglGetAttribLocationARB(program, "boneWeight");
+}
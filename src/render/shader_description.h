@@ -5,6 +5,12 @@
 #include <SDL2/SDL_opengl.h>
 #include "../core/gl_util.h"
 
+// Vertex attribute of animated texture frame, bound to this location in all
+// programs, so its "not animated" current value is shared by all of them.
+#define ANIM_TEX_FRAME_ATTRIB   (6)
+// Texture unit of animated texture frames table.
+#define ANIM_TEX_TABLE_UNIT     (1)
+
 struct shader_stage
 {
     GLhandleARB shader;
@@ -77,4 +83,31 @@ struct unlit_tinted_shader_description : public unlit_shader_description
     unlit_tinted_shader_description(const shader_stage &vertex, const shader_stage &fragment);
 };
 
+/*!
+ * Unlit tinted shader that takes model view projection matrix and tint from
+ * per instance vertex attributes instead of uniforms.
+ */
+struct instanced_shader_description : public unlit_tinted_shader_description
+{
+    GLint instance_mvp;                 // mat4 attribute, takes 4 locations
+    GLint instance_tint;
+
+    instanced_shader_description(const shader_stage &vertex, const shader_stage &fragment);
+};
+
+/*!
+ * Lit shader that transforms vertices by a palette of bone model view
+ * matrices: every vertex blends two bones, indices and weight of the second
+ * bone come from vertex attributes.
+ */
+struct skinned_shader_description : public lit_shader_description
+{
+    GLint projection;
+    GLint bone_matrices;                // mat4 array of MAX_SKINNED_BONES
+    GLint bone_index;                   // vec2 attribute
+    GLint bone_weight;                  // float attribute
+
+    skinned_shader_description(const shader_stage &vertex, const shader_stage &fragment);
+};
+
 #endif /* defined(__OpenTomb__shader_description__) */
@@ -1,12 +1,60 @@
 #include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <sstream>
 
 #include "shader_manager.h"
+#include "../engine.h"
+
+/*
+ * Reads a shader source that is prepended to other stages instead of being
+ * compiled on its own (see shaders/anim_tex.vsh).
+ */
+static std::string shader_manager_ReadSource(const char *filename)
+{
+    char shader_path[1024];
+    size_t shader_path_base_len = sizeof(shader_path) - 1;
+    strncpy(shader_path, Engine_GetBasePath(), shader_path_base_len);
+    shader_path[shader_path_base_len] = 0;
+    strncat(shader_path, filename, shader_path_base_len - strlen(shader_path));
+
+    std::ifstream file(shader_path, std::ios::in | std::ios::binary);
+    if(!file)
+    {
+        abort();
+    }
+    std::ostringstream source;
+    source << file.rdbuf();
+    return source.str();
+}
 
 shader_manager::shader_manager()
 {
+    GLint vertexTextureUnits = 0;
+    qglGetIntegerv(GL_MAX_VERTEX_TEXTURE_IMAGE_UNITS_ARB, &vertexTextureUnits);
+    anim_tex_table = IsGLExtensionSupported("GL_ARB_texture_float") && (vertexTextureUnits > 0);
+
+    std::ostringstream animDefines;
+    animDefines << "#define ANIM_TEXTURES " << (anim_tex_table ? 1 : 0) << std::endl;
+    animDefines << "#define ANIM_TEX_FRAMES " << MAX_ANIM_TEX_FRAMES << ".0" << std::endl;
+    animDefines << "#define ANIM_TEX_SEQUENCES " << MAX_ANIM_TEX_SEQUENCES << ".0" << std::endl;
+    // animTexCoord() and its inputs, shared by all vertex programs below
+    animDefines << shader_manager_ReadSource("shaders/anim_tex.vsh") << std::endl;
+
     //Color mult prog
-    static_mesh_shader = new unlit_tinted_shader_description(shader_stage(GL_VERTEX_SHADER_ARB, "shaders/static_mesh.vsh"), shader_stage(GL_FRAGMENT_SHADER_ARB, "shaders/static_mesh.fsh"));
+    shader_stage staticMeshFragmentShader(GL_FRAGMENT_SHADER_ARB, "shaders/static_mesh.fsh");
+    static_mesh_shader = new unlit_tinted_shader_description(shader_stage(GL_VERTEX_SHADER_ARB, "shaders/static_mesh.vsh", (animDefines.str() + "#define INSTANCED 0\n").c_str()), staticMeshFragmentShader);
+    static_mesh_instanced_shader = NULL;
+    if(qglDrawElementsInstancedARB && qglVertexAttribDivisorARB)
+    {
+        static_mesh_instanced_shader = new instanced_shader_description(shader_stage(GL_VERTEX_SHADER_ARB, "shaders/static_mesh.vsh", (animDefines.str() + "#define INSTANCED 1\n").c_str()), staticMeshFragmentShader);
+        if((static_mesh_instanced_shader->instance_mvp < 0) || (static_mesh_instanced_shader->instance_tint < 0))
+        {
+            delete static_mesh_instanced_shader;
+            static_mesh_instanced_shader = NULL;
+        }
+    }
 
     //Room prog
     shader_stage roomFragmentShader(GL_FRAGMENT_SHADER_ARB, "shaders/room.fsh");
@@ -15,6 +63,7 @@ shader_manager::shader_manager()
         for (int isFlicker = 0; isFlicker < 2; isFlicker++)
         {
             std::ostringstream stream;
+            stream << animDefines.str();
             stream << "#define IS_WATER " << isWater << std::endl;
             stream << "#define IS_FLICKER " << isFlicker << std::endl;
 
@@ -23,14 +72,34 @@ shader_manager::shader_manager()
     }
 
     // Entity prog
-    shader_stage entityVertexShader(GL_VERTEX_SHADER_ARB, "shaders/entity.vsh");
+    shader_stage entityVertexShader(GL_VERTEX_SHADER_ARB, "shaders/entity.vsh", (animDefines.str() + "#define SKINNED 0\n").c_str());
+    std::ostringstream skinnedDefines;
+    skinnedDefines << animDefines.str();
+    skinnedDefines << "#define SKINNED 1" << std::endl;
+    skinnedDefines << "#define MAX_BONES " << MAX_SKINNED_BONES << std::endl;
+    shader_stage entitySkinnedVertexShader(GL_VERTEX_SHADER_ARB, "shaders/entity.vsh", skinnedDefines.str().c_str());
+    bool skinnedLinked = true;
     for (int i = 0; i <= MAX_NUM_LIGHTS; i++) {
         std::ostringstream stream;
         stream << "#define NUMBER_OF_LIGHTS " << i << std::endl;
 
-        entity_shader[i] = new lit_shader_description(entityVertexShader, shader_stage(GL_FRAGMENT_SHADER_ARB, "shaders/entity.fsh", stream.str().c_str()));
+        shader_stage entityFragmentShader(GL_FRAGMENT_SHADER_ARB, "shaders/entity.fsh", stream.str().c_str());
+        entity_shader[i] = new lit_shader_description(entityVertexShader, entityFragmentShader);
+        entity_skinned_shader[i] = new skinned_shader_description(entitySkinnedVertexShader, entityFragmentShader);
+        skinnedLinked = skinnedLinked && (entity_skinned_shader[i]->bone_matrices >= 0) && (entity_skinned_shader[i]->projection >= 0) &&
+                        (entity_skinned_shader[i]->bone_index >= 0) && (entity_skinned_shader[i]->bone_weight >= 0);
+    }
+    if(!skinnedLinked)
+    {
+        for (int i = 0; i <= MAX_NUM_LIGHTS; i++) {
+            delete entity_skinned_shader[i];
+            entity_skinned_shader[i] = NULL;
+        }
     }
 
+    // Current value of the frame attribute when it is not an array: not animated
+    qglVertexAttrib2fARB(ANIM_TEX_FRAME_ATTRIB, -1.0f, 0.0f);
+
     text = new text_shader_description(shader_stage(GL_VERTEX_SHADER_ARB, "shaders/text.vsh"), shader_stage(GL_FRAGMENT_SHADER_ARB, "shaders/text.fsh"));
 }
 
@@ -45,6 +114,12 @@ const lit_shader_description *shader_manager::getEntityShader(unsigned numberOfL
     return entity_shader[numberOfLights];
 }
 
+const skinned_shader_description *shader_manager::getEntitySkinnedShader(unsigned numberOfLights) const {
+    assert(numberOfLights <= MAX_NUM_LIGHTS);
+
+    return entity_skinned_shader[numberOfLights];
+}
+
 const unlit_tinted_shader_description *shader_manager::getRoomShader(bool isFlickering, bool isWater) const
 {
     return room_shaders[isWater ? 1 : 0][isFlickering ? 1 : 0];
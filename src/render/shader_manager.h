@@ -5,24 +5,42 @@
 
 // Highest number of lights that will show up in the entity shader.
 #define MAX_NUM_LIGHTS 8
+// Highest number of bones of a skeletal model drawn by the skinned entity shader.
+#define MAX_SKINNED_BONES 32
+// Animated texture frames table size: frames of a sequence and sequences.
+#define MAX_ANIM_TEX_FRAMES 64
+#define MAX_ANIM_TEX_SEQUENCES 256
 
 class shader_manager {
     unlit_tinted_shader_description *room_shaders[2][2];
     unlit_tinted_shader_description *static_mesh_shader;
+    instanced_shader_description *static_mesh_instanced_shader;
     lit_shader_description *entity_shader[MAX_NUM_LIGHTS+1];
+    skinned_shader_description *entity_skinned_shader[MAX_NUM_LIGHTS+1];
     text_shader_description *text;
+    bool anim_tex_table;
 
 public:
     shader_manager();
     ~shader_manager();
     
     const lit_shader_description *getEntityShader(unsigned numberOfLights) const;
+
+    // NULL if skinned shader could not be linked (not enough uniforms for bones palette)
+    const skinned_shader_description *getEntitySkinnedShader(unsigned numberOfLights) const;
     
     const unlit_tinted_shader_description *getStaticMeshShader() const { return static_mesh_shader; }
+
+    // NULL if GL context has no instancing support
+    const instanced_shader_description *getStaticMeshInstancedShader() const { return static_mesh_instanced_shader; }
     
     const unlit_tinted_shader_description *getRoomShader(bool isFlickering, bool isWater) const;
     
     const text_shader_description *getTextShader() const { return text; }
+
+    // Vertex shaders look animated texture frames up in the table texture
+    // (needs float textures and vertex texture fetch)
+    bool hasAnimTexTable() const { return anim_tex_table; }
 };
 
 #endif /* defined(__OpenTomb__shader_manager__) */
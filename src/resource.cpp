@@ -96,7 +96,6 @@ __inline void TR_color_to_arr(float v[4], tr5_colour_t *tr_c)
  */
 int32_t  TR_GetNumAnimationsForMoveable(class VT_Level *tr, size_t moveable_ind);
 int      TR_GetNumFramesForAnimation(class VT_Level *tr, size_t animation_ind);
-void     TR_SkeletalModelInterpolateFrames(skeletal_model_p models);
 
 // Main functions which are used to translate legacy TR floor data
 // to native OpenTomb structs.
@@ -1437,99 +1436,12 @@ void TR_GenRoomMesh(struct room_s *room, size_t room_index, struct anim_seq_s *a
 }
 
 
-void TR_SkeletalModelInterpolateFrames(skeletal_model_p model, tr_animation_t *tr_animations)
+static void TR_QuantizeRotation(int16_t qq[4], const float q[4])
 {
-    uint16_t new_frames_count;
-    animation_frame_p anim = model->animations;
-    bone_frame_p bf, new_bone_frames;
-    float lerp, t;
-
-    for(uint16_t i = 0; i < model->animation_count; i++, anim++)
-    {
-        tr_animation_t *tr_anim = tr_animations + i;
-        if(anim->frames_count > 1 && tr_anim->frame_rate > 1)                   // we can't interpolate one frame or rate < 2!
-        {
-            new_frames_count = (uint16_t)tr_anim->frame_rate * (anim->frames_count - 1) + 1;
-            bf = new_bone_frames = (bone_frame_p)malloc(new_frames_count * sizeof(bone_frame_t));
-
-            /*
-             * the first frame does not changes
-             */
-            bf->bone_tags = (bone_tag_p)malloc(model->mesh_count * sizeof(bone_tag_t));
-            bf->bone_tag_count = model->mesh_count;
-            vec3_set_zero(bf->pos);
-            vec3_copy(bf->centre, anim->frames[0].centre);
-            vec3_copy(bf->pos, anim->frames[0].pos);
-            vec3_copy(bf->bb_max, anim->frames[0].bb_max);
-            vec3_copy(bf->bb_min, anim->frames[0].bb_min);
-            for(uint16_t k = 0; k < model->mesh_count; k++)
-            {
-                vec3_copy(bf->bone_tags[k].offset, anim->frames[0].bone_tags[k].offset);
-                vec4_copy(bf->bone_tags[k].qrotate, anim->frames[0].bone_tags[k].qrotate);
-            }
-            bf++;
-
-            for(uint16_t j = 1; j < anim->frames_count; j++)
-            {
-                for(uint16_t lerp_index = 1; lerp_index <= tr_anim->frame_rate; lerp_index++)
-                {
-                    vec3_set_zero(bf->pos);
-                    lerp = ((float)lerp_index) / (float)tr_anim->frame_rate;
-                    t = 1.0f - lerp;
-
-                    bf->bone_tags = (bone_tag_p)malloc(model->mesh_count * sizeof(bone_tag_t));
-                    bf->bone_tag_count = model->mesh_count;
-
-                    bf->centre[0] = t * anim->frames[j-1].centre[0] + lerp * anim->frames[j].centre[0];
-                    bf->centre[1] = t * anim->frames[j-1].centre[1] + lerp * anim->frames[j].centre[1];
-                    bf->centre[2] = t * anim->frames[j-1].centre[2] + lerp * anim->frames[j].centre[2];
-
-                    bf->pos[0] = t * anim->frames[j-1].pos[0] + lerp * anim->frames[j].pos[0];
-                    bf->pos[1] = t * anim->frames[j-1].pos[1] + lerp * anim->frames[j].pos[1];
-                    bf->pos[2] = t * anim->frames[j-1].pos[2] + lerp * anim->frames[j].pos[2];
-
-                    bf->bb_max[0] = t * anim->frames[j-1].bb_max[0] + lerp * anim->frames[j].bb_max[0];
-                    bf->bb_max[1] = t * anim->frames[j-1].bb_max[1] + lerp * anim->frames[j].bb_max[1];
-                    bf->bb_max[2] = t * anim->frames[j-1].bb_max[2] + lerp * anim->frames[j].bb_max[2];
-
-                    bf->bb_min[0] = t * anim->frames[j-1].bb_min[0] + lerp * anim->frames[j].bb_min[0];
-                    bf->bb_min[1] = t * anim->frames[j-1].bb_min[1] + lerp * anim->frames[j].bb_min[1];
-                    bf->bb_min[2] = t * anim->frames[j-1].bb_min[2] + lerp * anim->frames[j].bb_min[2];
-
-                    for(uint16_t k = 0; k < model->mesh_count; k++)
-                    {
-                        bf->bone_tags[k].offset[0] = t * anim->frames[j-1].bone_tags[k].offset[0] + lerp * anim->frames[j].bone_tags[k].offset[0];
-                        bf->bone_tags[k].offset[1] = t * anim->frames[j-1].bone_tags[k].offset[1] + lerp * anim->frames[j].bone_tags[k].offset[1];
-                        bf->bone_tags[k].offset[2] = t * anim->frames[j-1].bone_tags[k].offset[2] + lerp * anim->frames[j].bone_tags[k].offset[2];
-
-                        vec4_slerp(bf->bone_tags[k].qrotate, anim->frames[j-1].bone_tags[k].qrotate, anim->frames[j].bone_tags[k].qrotate, lerp);
-                    }
-                    bf++;
-                }
-            }
-
-            /*
-             * swap old and new animation bone frames
-             * free old bone frames;
-             */
-            for(uint16_t j = 0; j < anim->frames_count; j++)
-            {
-                if(anim->frames[j].bone_tag_count)
-                {
-                    anim->frames[j].bone_tag_count = 0;
-                    free(anim->frames[j].bone_tags);
-                    anim->frames[j].bone_tags = NULL;
-                }
-            }
-            free(anim->frames);
-            anim->frames = new_bone_frames;
-            anim->frames_count = new_frames_count;
-        }
-        if(anim->max_frame > anim->frames_count || anim->max_frame == 0)
-        {
-            anim->max_frame = anim->frames_count;                               // i.e.: unused animations
-        }
-    }
+    qq[0] = (int16_t)lroundf(q[0] * ANIM_QROTATE_SCALE);
+    qq[1] = (int16_t)lroundf(q[1] * ANIM_QROTATE_SCALE);
+    qq[2] = (int16_t)lroundf(q[2] * ANIM_QROTATE_SCALE);
+    qq[3] = (int16_t)lroundf(q[3] * ANIM_QROTATE_SCALE);
 }
 
 
@@ -1538,11 +1450,12 @@ void TR_GenSkeletalModel(struct skeletal_model_s *model, size_t model_id, struct
     tr_moveable_t *tr_moveable = &tr->moveables[model_id];
     tr5_vertex_t *rotations;
     tr5_vertex_t min_max_pos[3];
-    float rot[3];
-    bone_tag_p bone_tag;
-    bone_frame_p bone_frame;
+    float rot[3], q[4];
+    bone_keyframe_p keyframe;
     mesh_tree_tag_p tree_tag;
     animation_frame_p anim;
+    uint32_t keyframes_count;
+    float *bone_offsets;
 
     model->collision_map = (uint16_t*)malloc(model->mesh_count * sizeof(uint16_t));
     model->mesh_tree = (mesh_tree_tag_p)calloc(model->mesh_count, sizeof(mesh_tree_tag_t));
@@ -1577,11 +1490,13 @@ void TR_GenSkeletalModel(struct skeletal_model_s *model, size_t model_id, struct
          * model has no start offset and any animation
          */
         model->animation_count = 1;
-        model->animations = (animation_frame_p)malloc(sizeof(animation_frame_t));
+        model->animations = (animation_frame_p)calloc(1, sizeof(animation_frame_t));
         model->animations->frames_count = 1;
         model->animations->max_frame = 1;
-        model->animations->frames = (bone_frame_p)calloc(model->animations->frames_count , sizeof(bone_frame_t));
-        bone_frame = model->animations->frames;
+        model->animations->bone_offsets = SkeletalModel_AllocKeyframes(model, 1);
+        model->animations->frame_rate = 1;
+        model->animations->keyframes_count = 1;
+        model->animations->keyframes = keyframe = (bone_keyframe_p)model->keyframes_pool;
 
         model->animations->id = 0;
         model->animations->next_anim = model->animations;
@@ -1590,19 +1505,14 @@ void TR_GenSkeletalModel(struct skeletal_model_s *model, size_t model_id, struct
         model->animations->state_change_count = 0;
         model->animations->commands = NULL;
         model->animations->effects = NULL;
-        bone_frame->bone_tag_count = model->mesh_count;
-        bone_frame->bone_tags = (bone_tag_p)malloc(bone_frame->bone_tag_count * sizeof(bone_tag_t));
-        vec3_set_zero(bone_frame->pos);
 
         rot[0] = 0.0f;
         rot[1] = 0.0f;
         rot[2] = 0.0f;
-        for(uint16_t k = 0; k < bone_frame->bone_tag_count; k++)
+        vec4_SetZXYRotations(q, rot);
+        for(uint16_t k = 0; k < model->mesh_count; k++)
         {
-            tree_tag = model->mesh_tree + k;
-            bone_tag = bone_frame->bone_tags + k;
-            vec4_SetZXYRotations(bone_tag->qrotate, rot);
-            vec3_copy(bone_tag->offset, tree_tag->offset);
+            TR_QuantizeRotation(keyframe->qrotate + 4 * k, q);
         }
         return;
     }
@@ -1617,6 +1527,18 @@ void TR_GenSkeletalModel(struct skeletal_model_s *model, size_t model_id, struct
     }
 
     model->animations = (animation_frame_p)calloc(model->animation_count, sizeof(animation_frame_t));
+    keyframes_count = 0;
+    anim = model->animations;
+    for(uint16_t i = 0; i < model->animation_count; i++, anim++)
+    {
+        int frames_count = TR_GetNumFramesForAnimation(tr, tr_moveable->animation_index + i);
+        anim->keyframes_count = (frames_count > 0) ? (frames_count) : (1);      // frame contains base model offset
+        keyframes_count += anim->keyframes_count;
+    }
+    bone_offsets = SkeletalModel_AllocKeyframes(model, keyframes_count);
+    keyframe = (bone_keyframe_p)model->keyframes_pool;
+    rotations = (tr5_vertex_t*)Sys_GetTempMem(model->mesh_count * sizeof(tr5_vertex_t));
+
     anim = model->animations;
     for(uint16_t i = 0; i < model->animation_count; i++, anim++)
     {
@@ -1632,7 +1554,6 @@ void TR_GenSkeletalModel(struct skeletal_model_s *model, size_t model_id, struct
         anim->state_id = tr_animation->state_id;
 
         anim->max_frame = tr_animation->frame_end - tr_animation->frame_start + 1;
-        anim->frames_count = TR_GetNumFramesForAnimation(tr, tr_moveable->animation_index + i);
 
         //Sys_DebugLog(LOG_FILENAME, "Anim[%d], %d", tr_moveable->animation_index, TR_GetNumFramesForAnimation(tr, tr_moveable->animation_index));
 
@@ -1684,59 +1605,51 @@ void TR_GenSkeletalModel(struct skeletal_model_s *model, size_t model_id, struct
             }
         }
 
-        if(anim->frames_count <= 0)
-        {
-            /*
-             * number of animations must be >= 1, because frame contains base model offset
-             */
-            anim->frames_count = 1;
-        }
-        anim->frames = (bone_frame_p)calloc(anim->frames_count, sizeof(bone_frame_t));
-
         /*
-         * let us begin to load animations
+         * let us begin to load animations; frames between keyframes are
+         * sampled at runtime, with 1/30 sec step like in original.
+         * Needed for correct state change works.
          */
-        bone_frame = anim->frames;
-        rotations = (tr5_vertex_t*)Sys_GetTempMem(model->mesh_count * sizeof(tr5_vertex_t));
-        for(uint16_t frame_index = 0; frame_index < anim->frames_count; frame_index++, bone_frame++)
+        anim->frame_rate = (anim->keyframes_count > 1 && tr_animation->frame_rate > 1) ? (tr_animation->frame_rate) : (1);
+        anim->frames_count = anim->frame_rate * (anim->keyframes_count - 1) + 1;
+        if(anim->max_frame > anim->frames_count || anim->max_frame == 0)
+        {
+            anim->max_frame = anim->frames_count;                               // i.e.: unused animations
+        }
+        anim->keyframes = keyframe;
+        anim->bone_offsets = bone_offsets;
+        for(uint16_t frame_index = 0; frame_index < anim->keyframes_count; frame_index++, keyframe++)
         {
-            bone_frame->bone_tag_count = model->mesh_count;
-            bone_frame->bone_tags = (bone_tag_p)malloc(model->mesh_count * sizeof(bone_tag_t));
-            tr->get_anim_frame_data(min_max_pos, rotations, bone_frame->bone_tag_count, tr_animation, frame_index);
+            tr->get_anim_frame_data(min_max_pos, rotations, model->mesh_count, tr_animation, frame_index);
 
-            bone_frame->bb_min[0] = min_max_pos[0].x;
-            bone_frame->bb_min[1] = min_max_pos[0].z;
-            bone_frame->bb_min[2] =-min_max_pos[1].y;
+            keyframe->bb_min[0] = min_max_pos[0].x;
+            keyframe->bb_min[1] = min_max_pos[0].z;
+            keyframe->bb_min[2] =-min_max_pos[1].y;
 
-            bone_frame->bb_max[0] = min_max_pos[1].x;
-            bone_frame->bb_max[1] = min_max_pos[1].z;
-            bone_frame->bb_max[2] =-min_max_pos[0].y;
+            keyframe->bb_max[0] = min_max_pos[1].x;
+            keyframe->bb_max[1] = min_max_pos[1].z;
+            keyframe->bb_max[2] =-min_max_pos[0].y;
 
-            bone_frame->pos[0] = min_max_pos[2].x;
-            bone_frame->pos[1] = min_max_pos[2].z;
-            bone_frame->pos[2] =-min_max_pos[2].y;
+            keyframe->pos[0] = min_max_pos[2].x;
+            keyframe->pos[1] = min_max_pos[2].z;
+            keyframe->pos[2] =-min_max_pos[2].y;
 
-            bone_frame->centre[0] = 0.5f * (bone_frame->bb_min[0] + bone_frame->bb_max[0]);
-            bone_frame->centre[1] = 0.5f * (bone_frame->bb_min[1] + bone_frame->bb_max[1]);
-            bone_frame->centre[2] = 0.5f * (bone_frame->bb_min[2] + bone_frame->bb_max[2]);
+            keyframe->centre[0] = 0.5f * (keyframe->bb_min[0] + keyframe->bb_max[0]);
+            keyframe->centre[1] = 0.5f * (keyframe->bb_min[1] + keyframe->bb_max[1]);
+            keyframe->centre[2] = 0.5f * (keyframe->bb_min[2] + keyframe->bb_max[2]);
 
-            for(uint16_t k = 0; k < bone_frame->bone_tag_count; k++)
+            for(uint16_t k = 0; k < model->mesh_count; k++)
             {
-                tree_tag = model->mesh_tree + k;
-                bone_tag = bone_frame->bone_tags + k;
                 rot[0] = rotations[k].x;
                 rot[1] = rotations[k].z;
                 rot[2] =-rotations[k].y;
-                vec4_SetZXYRotations(bone_tag->qrotate, rot);
-                vec3_copy(bone_tag->offset, tree_tag->offset);
+                vec4_SetZXYRotations(q, rot);
+                TR_QuantizeRotation(keyframe->qrotate + 4 * k, q);
             }
         }
     }
     Sys_ReturnTempMem(model->mesh_count * sizeof(tr5_vertex_t));
-    /*
-     * Animations interpolation to 1/30 sec like in original. Needed for correct state change works.
-     */
-    TR_SkeletalModelInterpolateFrames(model, tr->animations + tr_moveable->animation_index);
+
     /*
      * state change's loading
      */
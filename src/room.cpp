@@ -78,8 +78,7 @@ void Room_Clear(struct room_s *room)
 
         Physics_DeleteObject(content->physics_body);
         content->physics_body = NULL;
-        Physics_DeleteObject(content->physics_alt_tween);
-        content->physics_alt_tween = NULL;
+        content->physics_alt_tween = NULL;                                      // owned by world flip tweens cache
 
         if(content->sprites_count)
         {
@@ -249,7 +249,7 @@ typedef struct room_content_s
     struct static_mesh_s       *static_mesh;
     uint32_t                    sprites_count;
     struct room_sprite_s       *sprites;
-    struct vertex_s            *sprites_vertices;
+    struct vertex_s            *sprites_vertices;                         // sprites colors and tex coords, see CRender::DrawSprites
     uint32_t                    lights_count;
     struct light_s             *lights;
 
@@ -261,7 +261,7 @@ typedef struct room_content_s
     float                       ambient_lighting[3];
     struct base_mesh_s         *mesh;                                           // room's base mesh
     struct physics_object_s    *physics_body;                                   // static physics data
-    struct physics_object_s    *physics_alt_tween;                              // changable (alt room) tween physics data
+    struct physics_object_s    *physics_alt_tween;                              // changable (alt room) tween physics data, see World_UpdateFlipCollisions
 }room_content_t, *room_content_p;
 
 
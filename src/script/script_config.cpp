@@ -16,6 +16,7 @@ extern "C" {
 #include "../render/camera.h"
 #include "../render/render.h"
 #include "../audio/audio.h"
+#include "../physics/physics.h"
 
 /*
  * Game structures parse
@@ -264,6 +265,27 @@ int Script_ParseAudio(lua_State *lua, struct audio_settings_s *as)
     return -1;
 }
 
+int Script_ParsePhysics(lua_State *lua, struct physics_settings_s *ps)
+{
+    if(lua)
+    {
+        int top = lua_gettop(lua);
+
+        lua_getglobal(lua, "physics");
+        if(lua_istable(lua, -1))
+        {
+            lua_getfield(lua, -1, "threads");
+            ps->threads = lua_tointeger(lua, -1);
+            lua_pop(lua, 1);
+        }
+
+        lua_settop(lua, top);
+        return 1;
+    }
+
+    return -1;
+}
+
 int Script_ParseConsole(lua_State *lua, struct console_params_s *cp)
 {
     if(lua)
@@ -370,6 +392,10 @@ void Script_ExportConfig(const char *path)
         fprintf(f, "    show_fps = %d;\n", renderer.settings.show_fps);
         fprintf(f, "}\n\n");
 
+        fprintf(f, "physics =\n{\n");
+        fprintf(f, "    threads = %d;\n", (int)physics_settings.threads);
+        fprintf(f, "}\n\n");
+
         fprintf(f, "controls =\n{\n");
         fprintf(f, "    mouse_sensitivity_x = %.2f;\n", control_settings.mouse_sensitivity_x);
         fprintf(f, "    mouse_sensitivity_y = %.2f;\n\n", control_settings.mouse_sensitivity_y);
@@ -1,18 +1,22 @@
 
 #include <stdlib.h>
+#include <stddef.h>
 #include <memory.h>
 
 #include "core/system.h"
 #include "core/gl_util.h"
 #include "core/vmath.h"
+#include "core/vmath_simd.h"
 #include "core/polygon.h"
 #include "core/obb.h"
+#include "core/profiler.h"
 #include "mesh.h"
 #include "skeletal_model.h"
 
 
 void SSBoneFrame_InitSSAnim(struct ss_animation_s *ss_anim, uint32_t anim_type_id);
 void Anim_Clear(struct animation_frame_s *anim);
+static size_t SkeletalModel_GetKeyframesPoolSize(uint32_t keyframes_count, uint16_t mesh_count);
 
 
 void SkeletalModel_Clear(skeletal_model_p model)
@@ -42,6 +46,10 @@ void SkeletalModel_Clear(skeletal_model_p model)
             free(model->animations);
             model->animations = NULL;
         }
+
+        model->keyframes_count = 0;
+        free(model->keyframes_pool);
+        model->keyframes_pool = NULL;
     }
 }
 
@@ -119,6 +127,15 @@ void SkeletalModel_CopyAnims(skeletal_model_p dst, skeletal_model_p src)
     animation_frame_p new_anims = (animation_frame_p)calloc(src->animation_count, sizeof(animation_frame_t));
     animation_frame_p dst_a = new_anims;
     animation_frame_p src_a = src->animations;
+    size_t pool_size = SkeletalModel_GetKeyframesPoolSize(src->keyframes_count, src->mesh_count);
+    void *new_pool = malloc(pool_size);
+    bone_keyframe_p kf = (bone_keyframe_p)new_pool;
+
+    memcpy(new_pool, src->keyframes_pool, pool_size);
+    for(uint32_t i = 0; i < src->keyframes_count; ++i, ++kf)
+    {
+        kf->qrotate = (int16_t*)((char*)new_pool + ((char*)kf->qrotate - (char*)src->keyframes_pool));
+    }
     
     for(uint16_t i = 0; i < src->animation_count; ++i, ++dst_a, ++src_a)
     {
@@ -141,16 +158,11 @@ void SkeletalModel_CopyAnims(skeletal_model_p dst, skeletal_model_p src)
             last_effect = &((*last_effect)->next);
         }
 
-        dst_a->frames_count = src_a->frames_count;
-        dst_a->frames = (bone_frame_p)calloc(src_a->frames_count, sizeof(bone_frame_t));
-        for(uint16_t i = 0; i < src_a->frames_count; ++i)
-        {
-            size_t sz = src_a->frames[i].bone_tag_count * sizeof(bone_tag_t);
-            dst_a->frames[i] = src_a->frames[i];
-            dst_a->frames[i].bone_tags = (bone_tag_p)malloc(sz);
-            memcpy(dst_a->frames[i].bone_tags, src_a->frames[i].bone_tags, sz);
-        }
-        
+        dst_a->frame_rate = src_a->frame_rate;
+        dst_a->keyframes_count = src_a->keyframes_count;
+        dst_a->keyframes = (bone_keyframe_p)new_pool + (src_a->keyframes - (bone_keyframe_p)src->keyframes_pool);
+        dst_a->bone_offsets = (float*)((char*)new_pool + ((char*)src_a->bone_offsets - (char*)src->keyframes_pool));
+
         dst_a->state_change_count = src_a->state_change_count;
         dst_a->state_change = (state_change_p)calloc(src_a->state_change_count, sizeof(state_change_t));
         for(uint16_t i = 0; i < src_a->state_change_count; ++i)
@@ -183,26 +195,49 @@ void SkeletalModel_CopyAnims(skeletal_model_p dst, skeletal_model_p src)
     free(dst->animations);
     dst->animations = new_anims;
     dst->animation_count = src->animation_count;
+    free(dst->keyframes_pool);
+    dst->keyframes_pool = new_pool;
+    dst->keyframes_count = src->keyframes_count;
 }
 
+/*
+ * Pool layout: keyframes, then bone offsets (3 floats per bone), then
+ * quantized rotations (4 int16 per bone for each keyframe).
+ */
+static size_t SkeletalModel_GetKeyframesPoolSize(uint32_t keyframes_count, uint16_t mesh_count)
+{
+    return keyframes_count * sizeof(bone_keyframe_t) + mesh_count * 3 * sizeof(float) +
+           keyframes_count * mesh_count * 4 * sizeof(int16_t);
+}
 
-void BoneFrame_Copy(bone_frame_p dst, bone_frame_p src)
+/*
+ * Allocates keyframes pool; bone offsets are taken from the mesh tree,
+ * rotations pointers of keyframes are set up, other data is left zero.
+ * Returns bone offsets array for animations setup.
+ */
+float *SkeletalModel_AllocKeyframes(skeletal_model_p model, uint32_t keyframes_count)
 {
-    if(dst->bone_tag_count < src->bone_tag_count)
+    bone_keyframe_p kf;
+    float *offsets;
+    int16_t *qrotate;
+
+    free(model->keyframes_pool);
+    model->keyframes_count = keyframes_count;
+    model->keyframes_pool = calloc(1, SkeletalModel_GetKeyframesPoolSize(keyframes_count, model->mesh_count));
+    kf = (bone_keyframe_p)model->keyframes_pool;
+    offsets = (float*)(kf + keyframes_count);
+    qrotate = (int16_t*)(offsets + 3 * model->mesh_count);
+
+    for(uint16_t i = 0; i < model->mesh_count; i++)
     {
-        dst->bone_tags = (bone_tag_p)realloc(dst->bone_tags, src->bone_tag_count * sizeof(bone_tag_t));
+        vec3_copy(offsets + 3 * i, model->mesh_tree[i].offset);
     }
-    dst->bone_tag_count = src->bone_tag_count;
-    vec3_copy(dst->pos, src->pos);
-    vec3_copy(dst->centre, src->centre);
-    vec3_copy(dst->bb_max, src->bb_max);
-    vec3_copy(dst->bb_min, src->bb_min);
-
-    for(uint16_t i = 0; i < dst->bone_tag_count; i++)
+    for(uint32_t i = 0; i < keyframes_count; i++, kf++)
     {
-        vec4_copy(dst->bone_tags[i].qrotate, src->bone_tags[i].qrotate);
-        vec3_copy(dst->bone_tags[i].offset, src->bone_tags[i].offset);
+        kf->qrotate = qrotate + 4 * model->mesh_count * i;
     }
+
+    return offsets;
 }
 
 
@@ -357,51 +392,313 @@ void SSBoneFrame_Copy(struct ss_bone_frame_s *dst, struct ss_bone_frame_s *src)
 }
 
 
-void SSBoneFrame_Update(struct ss_bone_frame_s *bf, float time)
+/*
+ * Blend between two sampled engine frames. Usually both frames lay between
+ * the same keyframes (or on them), then the blend is a single slerp between
+ * two keyframes and it is stored in kf1, kf2, lerp.
+ */
+typedef struct anim_blend_s
+{
+    bone_keyframe_p     curr_kf1;
+    bone_keyframe_p     curr_kf2;
+    float               curr_lerp;
+    bone_keyframe_p     next_kf1;
+    bone_keyframe_p     next_kf2;
+    float               next_lerp;
+    float               lerp;
+
+    int                 is_merged;
+    bone_keyframe_p     kf1;
+    bone_keyframe_p     kf2;
+    float               merged_lerp;
+}anim_blend_t, *anim_blend_p;
+
+
+static inline void Anim_DequantizeRotation(float q[4], const int16_t qq[4])
+{
+    const float k = 1.0f / ANIM_QROTATE_SCALE;
+    q[0] = k * qq[0];
+    q[1] = k * qq[1];
+    q[2] = k * qq[2];
+    q[3] = k * qq[3];
+}
+
+
+static inline void Anim_SampleRotation(float q[4], bone_keyframe_p kf1, bone_keyframe_p kf2, float lerp, uint16_t bone)
+{
+    float q1[4], q2[4];
+    Anim_DequantizeRotation(q1, kf1->qrotate + 4 * bone);
+    Anim_DequantizeRotation(q2, kf2->qrotate + 4 * bone);
+    vec4_slerp(q, q1, q2, lerp);
+}
+
+
+static void Anim_GetBlend(anim_blend_p blend, struct ss_animation_s *ss_anim)
+{
+    animation_frame_p curr_anim = ss_anim->model->animations + ss_anim->prev_animation;
+    animation_frame_p next_anim = ss_anim->model->animations + ss_anim->current_animation;
+    float l1, l2;
+
+    Anim_GetKeyframes(curr_anim, ss_anim->prev_frame, &blend->curr_kf1, &blend->curr_kf2, &blend->curr_lerp);
+    Anim_GetKeyframes(next_anim, ss_anim->current_frame, &blend->next_kf1, &blend->next_kf2, &blend->next_lerp);
+    blend->lerp = ss_anim->lerp;
+    blend->is_merged = 1;
+    l1 = blend->curr_lerp;
+    l2 = blend->next_lerp;
+
+    if(blend->curr_kf1 == blend->curr_kf2)
+    {
+        if(blend->next_kf1 == blend->next_kf2)
+        {
+            blend->kf1 = blend->curr_kf1;
+            blend->kf2 = blend->next_kf1;
+            l1 = 0.0f;
+            l2 = 1.0f;
+        }
+        else
+        {
+            blend->kf1 = blend->next_kf1;
+            blend->kf2 = blend->next_kf2;
+            blend->is_merged = (blend->curr_kf1 == blend->kf1) || (blend->curr_kf1 == blend->kf2);
+            l1 = (blend->curr_kf1 == blend->kf1) ? (0.0f) : (1.0f);
+        }
+    }
+    else
+    {
+        blend->kf1 = blend->curr_kf1;
+        blend->kf2 = blend->curr_kf2;
+        if(blend->next_kf1 == blend->next_kf2)
+        {
+            blend->is_merged = (blend->next_kf1 == blend->kf1) || (blend->next_kf1 == blend->kf2);
+            l2 = (blend->next_kf1 == blend->kf1) ? (0.0f) : (1.0f);
+        }
+        else
+        {
+            blend->is_merged = (blend->next_kf1 == blend->kf1) && (blend->next_kf2 == blend->kf2);
+        }
+    }
+    blend->merged_lerp = l1 + (l2 - l1) * blend->lerp;
+}
+
+
+static inline void Anim_GetBlendRotation(float q[4], anim_blend_p blend, uint16_t bone)
+{
+    if(blend->is_merged)
+    {
+        Anim_SampleRotation(q, blend->kf1, blend->kf2, blend->merged_lerp, bone);
+    }
+    else
+    {
+        float q1[4], q2[4];
+        Anim_SampleRotation(q1, blend->curr_kf1, blend->curr_kf2, blend->curr_lerp, bone);
+        Anim_SampleRotation(q2, blend->next_kf1, blend->next_kf2, blend->next_lerp, bone);
+        vec4_slerp(q, q1, q2, blend->lerp);
+    }
+}
+
+
+static inline void Anim_GetBlendVector(float v[3], anim_blend_p blend, size_t field_offset)
+{
+    float v1[3], v2[3];
+    const float *c1 = (const float*)((const char*)blend->curr_kf1 + field_offset);
+    const float *c2 = (const float*)((const char*)blend->curr_kf2 + field_offset);
+    const float *n1 = (const float*)((const char*)blend->next_kf1 + field_offset);
+    const float *n2 = (const float*)((const char*)blend->next_kf2 + field_offset);
+    float t = 1.0f - blend->curr_lerp;
+    vec3_interpolate_macro(v1, c1, c2, blend->curr_lerp, t);
+    t = 1.0f - blend->next_lerp;
+    vec3_interpolate_macro(v2, n1, n2, blend->next_lerp, t);
+    t = 1.0f - blend->lerp;
+    vec3_interpolate_macro(v, v1, v2, blend->lerp, t);
+}
+
+
+static inline anim_blend_p SSBoneFrame_GetBoneBlend(ss_bone_tag_p btag, uint16_t k, anim_blend_p blend, anim_blend_p ov_blend, struct ss_animation_s **ov_anim)
+{
+    if((k > 0) && btag->alt_anim && btag->alt_anim->model && btag->alt_anim->enabled && (btag->alt_anim->model->mesh_tree[k].replace_anim != 0))
+    {
+        if(*ov_anim != btag->alt_anim)
+        {
+            *ov_anim = btag->alt_anim;
+            Anim_GetBlend(ov_blend, *ov_anim);
+        }
+        return ov_blend;
+    }
+    return blend;
+}
+
+
+static void SSBoneFrame_UpdateBounds(struct ss_bone_frame_s *bf, anim_blend_p blend)
+{
+    Anim_GetBlend(blend, &bf->animations);
+    Anim_GetBlendVector(bf->bb_max, blend, offsetof(bone_keyframe_t, bb_max));
+    Anim_GetBlendVector(bf->bb_min, blend, offsetof(bone_keyframe_t, bb_min));
+    Anim_GetBlendVector(bf->centre, blend, offsetof(bone_keyframe_t, centre));
+    Anim_GetBlendVector(bf->pos, blend, offsetof(bone_keyframe_t, pos));
+}
+
+
+static inline void SSBoneFrame_UpdateBoneOffset(struct ss_bone_frame_s *bf, uint16_t k)
 {
+    ss_bone_tag_p btag = bf->bone_tags + k;
+    skeletal_model_p model = bf->animations.model;
+    const float *src_offset = model->animations[bf->animations.prev_animation].bone_offsets + 3 * k;
+    const float *next_offset = model->animations[bf->animations.current_animation].bone_offsets + 3 * k;
     float t = 1.0f - bf->animations.lerp;
-    ss_bone_tag_p btag = bf->bone_tags;
-    bone_tag_p src_btag, next_btag;
+
+    vec3_interpolate_macro(btag->offset, src_offset, next_offset, bf->animations.lerp, t);
+    vec3_copy(btag->local_transform + 12, btag->offset);
+    btag->local_transform[15] = 1.0f;
+    if(k == 0)
+    {
+        vec3_add(btag->local_transform + 12, btag->local_transform + 12, bf->pos);
+    }
+}
+
+
+static inline void SSBoneFrame_GatherRotation(float q[4][4], int lane, bone_keyframe_p kf, uint16_t bone)
+{
+    const float k = 1.0f / ANIM_QROTATE_SCALE;
+    const int16_t *qq = kf->qrotate + 4 * bone;
+    q[0][lane] = k * qq[0];
+    q[1][lane] = k * qq[1];
+    q[2][lane] = k * qq[2];
+    q[3][lane] = k * qq[3];
+}
+
+/*
+ * Whole skeleton evaluation: bones go by 4 in structure of arrays layout
+ * through vec4_slerp_soa4() and Mat4_set_qrotation_soa4(), then parents chain
+ * is concatenated with Mat4_Mat4_mul_simd().
+ */
+void SSBoneFrame_Update(struct ss_bone_frame_s *bf, float time)
+{
+    ss_bone_tag_p btag;
     skeletal_model_p model = bf->animations.model;
-    animation_frame_p curr_anim = model->animations + bf->animations.prev_animation;
-    animation_frame_p next_anim = model->animations + bf->animations.current_animation;
-    bone_frame_p curr_bf = curr_anim->frames + bf->animations.prev_frame;
-    bone_frame_p next_bf = next_anim->frames + bf->animations.current_frame;
-    
-    vec3_interpolate_macro(bf->bb_max, curr_bf->bb_max, next_bf->bb_max, bf->animations.lerp, t);
-    vec3_interpolate_macro(bf->bb_min, curr_bf->bb_min, next_bf->bb_min, bf->animations.lerp, t);
-    vec3_interpolate_macro(bf->centre, curr_bf->centre, next_bf->centre, bf->animations.lerp, t);
-    vec3_interpolate_macro(bf->pos, curr_bf->pos, next_bf->pos, bf->animations.lerp, t);
-    
-    next_btag = next_bf->bone_tags;
-    src_btag = curr_bf->bone_tags;
-    for(uint16_t k = 0; k < curr_bf->bone_tag_count; k++, btag++, src_btag++, next_btag++)
+    anim_blend_t blend, ov_blend;
+    struct ss_animation_s *ov_anim = NULL;
+    float scratch[16];
+
+    PROF_ZONE_BEGIN("SSBoneFrame_Update");
+    SSBoneFrame_UpdateBounds(bf, &blend);
+
+    for(uint16_t k = 0; k < model->mesh_count; k += 4)
     {
-        vec3_interpolate_macro(btag->offset, src_btag->offset, next_btag->offset, bf->animations.lerp, t);
-        vec3_copy(btag->local_transform + 12, btag->offset);
-        btag->local_transform[15] = 1.0f;
-        if(k == 0)
+        float q[4][4][4];                                                       // curr kf1, curr kf2, next kf1, next kf2; [component][lane]
+        float lerp[3][4];                                                       // curr, next and blend lerps
+        float *mat[4];
+        int is_merged = 1;
+        v4f_t q1[4], q2[4], ret[4], next[4];
+
+        for(int l = 0; l < 4; l++)
         {
-            vec3_add(btag->local_transform + 12, btag->local_transform + 12, bf->pos);
-            vec4_slerp(btag->qrotate, src_btag->qrotate, next_btag->qrotate, bf->animations.lerp);
+            uint16_t bone = k + l;
+            if(bone < model->mesh_count)
+            {
+                anim_blend_p b;
+                btag = bf->bone_tags + bone;
+                SSBoneFrame_UpdateBoneOffset(bf, bone);
+                b = SSBoneFrame_GetBoneBlend(btag, bone, &blend, &ov_blend, &ov_anim);
+                mat[l] = btag->local_transform;
+                if(b->is_merged)
+                {
+                    SSBoneFrame_GatherRotation(q[0], l, b->kf1, bone);
+                    SSBoneFrame_GatherRotation(q[1], l, b->kf2, bone);
+                    SSBoneFrame_GatherRotation(q[2], l, b->kf1, bone);
+                    SSBoneFrame_GatherRotation(q[3], l, b->kf1, bone);
+                    lerp[0][l] = b->merged_lerp;
+                    lerp[1][l] = 0.0f;
+                    lerp[2][l] = 0.0f;
+                }
+                else
+                {
+                    SSBoneFrame_GatherRotation(q[0], l, b->curr_kf1, bone);
+                    SSBoneFrame_GatherRotation(q[1], l, b->curr_kf2, bone);
+                    SSBoneFrame_GatherRotation(q[2], l, b->next_kf1, bone);
+                    SSBoneFrame_GatherRotation(q[3], l, b->next_kf2, bone);
+                    lerp[0][l] = b->curr_lerp;
+                    lerp[1][l] = b->next_lerp;
+                    lerp[2][l] = b->lerp;
+                    is_merged = 0;
+                }
+            }
+            else
+            {
+                mat[l] = scratch;
+                for(int p = 0; p < 4; p++)
+                {
+                    q[p][0][l] = 0.0f;
+                    q[p][1][l] = 0.0f;
+                    q[p][2][l] = 0.0f;
+                    q[p][3][l] = 1.0f;
+                }
+                lerp[0][l] = 0.0f;
+                lerp[1][l] = 0.0f;
+                lerp[2][l] = 0.0f;
+            }
         }
-        else
+
+        for(int c = 0; c < 4; c++)
         {
-            bone_tag_p ov_src_btag = src_btag;
-            bone_tag_p ov_next_btag = next_btag;
-            float ov_lerp = bf->animations.lerp;
-            if(btag->alt_anim && btag->alt_anim->model && btag->alt_anim->enabled && (btag->alt_anim->model->mesh_tree[k].replace_anim != 0))
+            q1[c] = v4f_load(q[0][c]);
+            q2[c] = v4f_load(q[1][c]);
+        }
+        vec4_slerp_soa4(ret, q1, q2, v4f_load(lerp[0]));
+        if(!is_merged)
+        {
+            for(int c = 0; c < 4; c++)
             {
-                curr_anim = btag->alt_anim->model->animations + btag->alt_anim->prev_animation;
-                next_anim = btag->alt_anim->model->animations + btag->alt_anim->current_animation;
-                bone_frame_p ov_curr_bf = curr_anim->frames + btag->alt_anim->prev_frame;
-                bone_frame_p ov_next_bf = next_anim->frames + btag->alt_anim->current_frame;
-                ov_lerp = btag->alt_anim->lerp;
-                ov_src_btag = ov_curr_bf->bone_tags + k;
-                ov_next_btag = ov_next_bf->bone_tags + k;
+                q1[c] = v4f_load(q[2][c]);
+                q2[c] = v4f_load(q[3][c]);
             }
-            vec4_slerp(btag->qrotate, ov_src_btag->qrotate, ov_next_btag->qrotate, ov_lerp);
+            vec4_slerp_soa4(next, q1, q2, v4f_load(lerp[1]));
+            vec4_slerp_soa4(ret, ret, next, v4f_load(lerp[2]));
+        }
+
+        Mat4_set_qrotation_soa4(mat, ret);
+        for(int c = 0; c < 4; c++)
+        {
+            v4f_store(q[0][c], ret[c]);
         }
+        for(int l = 0; (l < 4) && (k + l < model->mesh_count); l++)
+        {
+            btag = bf->bone_tags + k + l;
+            btag->qrotate[0] = q[0][0][l];
+            btag->qrotate[1] = q[0][1][l];
+            btag->qrotate[2] = q[0][2][l];
+            btag->qrotate[3] = q[0][3][l];
+        }
+    }
+
+    /*
+     * build absolute coordinate matrix system
+     */
+    btag = bf->bone_tags;
+    Mat4_Copy(btag->current_transform, btag->local_transform);
+    btag++;
+    for(uint16_t k = 1; k < model->mesh_count; k++, btag++)
+    {
+        Mat4_Mat4_mul_simd(btag->current_transform, btag->parent->current_transform, btag->local_transform);
+        SSBoneFrame_TargetBoneToSlerp(bf, btag, time);
+    }
+    PROF_ZONE_END();
+}
+
+/*
+ * Per bone scalar implementation, kept as reference for the batched one.
+ */
+void SSBoneFrame_UpdateReference(struct ss_bone_frame_s *bf, float time)
+{
+    ss_bone_tag_p btag = bf->bone_tags;
+    skeletal_model_p model = bf->animations.model;
+    anim_blend_t blend, ov_blend;
+    struct ss_animation_s *ov_anim = NULL;
+
+    SSBoneFrame_UpdateBounds(bf, &blend);
+    for(uint16_t k = 0; k < model->mesh_count; k++, btag++)
+    {
+        SSBoneFrame_UpdateBoneOffset(bf, k);
+        Anim_GetBlendRotation(btag->qrotate, SSBoneFrame_GetBoneBlend(btag, k, &blend, &ov_blend, &ov_anim), k);
         Mat4_set_qrotation(btag->local_transform, btag->qrotate);
     }
 
@@ -411,7 +708,7 @@ void SSBoneFrame_Update(struct ss_bone_frame_s *bf, float time)
     btag = bf->bone_tags;
     Mat4_Copy(btag->current_transform, btag->local_transform);
     btag++;
-    for(uint16_t k = 1; k < curr_bf->bone_tag_count; k++, btag++)
+    for(uint16_t k = 1; k < model->mesh_count; k++, btag++)
     {
         Mat4_Mat4_mul(btag->current_transform, btag->parent->current_transform, btag->local_transform);
         SSBoneFrame_TargetBoneToSlerp(bf, btag, time);
@@ -678,22 +975,11 @@ void Anim_Clear(struct animation_frame_s *anim)
         anim->state_change = NULL;
     }
 
-    if(anim->frames_count)
-    {
-        for(uint16_t j = 0; j < anim->frames_count; j++)
-        {
-            if(anim->frames[j].bone_tag_count)
-            {
-                anim->frames[j].bone_tag_count = 0;
-                free(anim->frames[j].bone_tags);
-                anim->frames[j].bone_tags = NULL;
-            }
-        }
-        anim->frames_count = 0;
-        anim->max_frame = 0;
-        free(anim->frames);
-        anim->frames = NULL;
-    }
+    anim->frames_count = 0;
+    anim->max_frame = 0;
+    anim->keyframes_count = 0;
+    anim->keyframes = NULL;                                                     // keyframes pool is owned by the model
+    anim->bone_offsets = NULL;
 
     while(anim->commands)
     {
@@ -791,6 +1077,36 @@ int Anim_GetAnimDispatchCase(struct ss_animation_s *ss_anim, uint32_t id)
 }
 
 
+/*
+ * Engine frame lays between kf1 and kf2 keyframes at lerp position;
+ * frames on keyframes have kf1 == kf2.
+ */
+void Anim_GetKeyframes(struct animation_frame_s *anim, uint16_t frame, struct bone_keyframe_s **kf1, struct bone_keyframe_s **kf2, float *lerp)
+{
+    uint16_t key = frame / anim->frame_rate;
+    uint16_t sub = frame % anim->frame_rate;
+
+    if(key + 1 >= anim->keyframes_count)
+    {
+        key = anim->keyframes_count - 1;
+        sub = 0;
+    }
+    *kf1 = anim->keyframes + key;
+    *kf2 = (sub) ? (*kf1 + 1) : (*kf1);
+    *lerp = (float)sub / (float)anim->frame_rate;
+}
+
+
+void Anim_GetBoneRotation(struct animation_frame_s *anim, uint16_t frame, uint16_t bone, float q[4])
+{
+    bone_keyframe_p kf1, kf2;
+    float lerp;
+
+    Anim_GetKeyframes(anim, frame, &kf1, &kf2, &lerp);
+    Anim_SampleRotation(q, kf1, kf2, lerp, bone);
+}
+
+
 void Anim_SetAnimation(struct ss_animation_s *ss_anim, int animation, int frame)
 {
     if(ss_anim && ss_anim->model && (animation < ss_anim->model->animation_count))
@@ -127,26 +127,20 @@ typedef struct ss_bone_frame_s
 
 /*
  * ORIGINAL ANIMATIONS
+ * Only original keyframes are stored; engine frames between them (frame_rate
+ * frames per keyframe) are sampled at runtime. Keyframes of all model's
+ * animations are kept in one pool, rotations are quantized to int16.
  */
-typedef struct bone_tag_s
-{
-    float               offset[3];                                              // bone vector
-    float               qrotate[4];                                             // rotation quaternion
-}bone_tag_t, *bone_tag_p;
+#define ANIM_QROTATE_SCALE              (32767.0f)
 
-/*
- * base frame of animated skeletal model
- */
-typedef struct bone_frame_s
+typedef struct bone_keyframe_s
 {
-    uint16_t            bone_tag_count;                                         // number of bones
-    uint16_t            unused;                                                
-    struct bone_tag_s  *bone_tags;                                              // bones data
     float               pos[3];                                                 // position (base offset)
     float               bb_min[3];                                              // bounding box min coordinates
     float               bb_max[3];                                              // bounding box max coordinates
     float               centre[3];                                              // bounding box centre
-}bone_frame_t, *bone_frame_p ;
+    int16_t            *qrotate;                                                // quantized rotation quaternions, 4 per bone
+}bone_keyframe_t, *bone_keyframe_p;
 
 /*
  * mesh tree base element structure
@@ -205,9 +199,12 @@ typedef struct animation_frame_s
     uint32_t                    id;
     uint16_t                    state_id;
     uint16_t                    max_frame;
-    uint16_t                    frames_count;           // Number of frames
+    uint16_t                    frames_count;           // Number of frames (sampled ones included)
     uint16_t                    state_change_count;     // Number of animation statechanges
-    struct bone_frame_s        *frames;                 // Frame data
+    uint16_t                    frame_rate;             // Frames per keyframe
+    uint16_t                    keyframes_count;        // Number of keyframes
+    struct bone_keyframe_s     *keyframes;              // Keyframes data, points to the model's pool
+    float                      *bone_offsets;           // Bone vectors, 3 per bone, points to the model's pool
     struct state_change_s      *state_change;           // Animation statechanges data
     
     struct animation_command_s *commands;
@@ -241,6 +238,9 @@ typedef struct skeletal_model_s
     uint16_t                    mesh_count;                                     // number of model meshes
     struct mesh_tree_tag_s     *mesh_tree;                                      // base mesh tree.
     uint16_t                   *collision_map;
+
+    uint32_t                    keyframes_count;                                // number of keyframes of all animations
+    void                       *keyframes_pool;                                 // keyframes, bone offsets and rotations data
 }skeletal_model_t, *skeletal_model_p;
 
 
@@ -250,12 +250,13 @@ void SkeletalModel_GenParentsIndexes(skeletal_model_p model);
 void SkeletalModel_FillTransparency(skeletal_model_p model);
 void SkeletalModel_CopyMeshes(mesh_tree_tag_p dst, mesh_tree_tag_p src, int tags_count);
 void SkeletalModel_CopyAnims(skeletal_model_p dst, skeletal_model_p src);
-void BoneFrame_Copy(bone_frame_p dst, bone_frame_p src);
+float *SkeletalModel_AllocKeyframes(skeletal_model_p model, uint32_t keyframes_count);
 
 void SSBoneFrame_CreateFromModel(ss_bone_frame_p bf, skeletal_model_p model);
 void SSBoneFrame_Clear(ss_bone_frame_p bf);
 void SSBoneFrame_Copy(struct ss_bone_frame_s *dst, struct ss_bone_frame_s *src);
 void SSBoneFrame_Update(struct ss_bone_frame_s *bf, float time);
+void SSBoneFrame_UpdateReference(struct ss_bone_frame_s *bf, float time);
 void SSBoneFrame_RotateBone(struct ss_bone_frame_s *bf, const float q_rotate[4], int bone);
 int  SSBoneFrame_CheckTargetBoneLimit(struct ss_bone_frame_s *bf, struct ss_bone_tag_s *b_tag, float target[3]);
 void SSBoneFrame_TargetBoneToSlerp(struct ss_bone_frame_s *bf, struct ss_bone_tag_s *b_tag, float time);
@@ -275,6 +276,8 @@ void Anim_AddEffect(struct animation_frame_s *anim, const animation_effect_p eff
 struct state_change_s *Anim_FindStateChangeByAnim(struct animation_frame_s *anim, int state_change_anim);
 struct state_change_s *Anim_FindStateChangeByID(struct animation_frame_s *anim, uint32_t id);
 int  Anim_GetAnimDispatchCase(struct ss_animation_s *ss_anim, uint32_t id);
+void Anim_GetKeyframes(struct animation_frame_s *anim, uint16_t frame, struct bone_keyframe_s **kf1, struct bone_keyframe_s **kf2, float *lerp);
+void Anim_GetBoneRotation(struct animation_frame_s *anim, uint16_t frame, uint16_t bone, float q[4]);
 void Anim_SetAnimation(struct ss_animation_s *ss_anim, int animation, int frame);
 int  Anim_SetNextFrame(struct ss_animation_s *ss_anim, float time);
 int  Anim_IncTime(struct ss_animation_s *ss_anim, float time);
@@ -23,136 +23,114 @@
 #include <string.h>
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_endian.h>
+#include <pthread.h>
+#include <zlib.h>
 
 #include "l_main.h"
 #include "../core/system.h"
 
+/** \brief checks that size bytes can be taken from the current position of src.
+  */
+static inline void check_stream(vt_stream_p const src, size_t size, const char *name)
+{
+    if (src == NULL)
+        Sys_extError("%s: src == NULL", name);
+
+    if ((src->pos > src->size) || (src->size - src->pos < size))
+        Sys_extError("%s: unexpected end of data", name);
+}
+
 /** \brief reads signed 8-bit value.
   *
   * uses current position from src. throws TR_ReadError when not successful.
   */
 
-int8_t TR_Level::read_bit8(SDL_RWops * const src)
+int8_t TR_Level::read_bit8(vt_stream_p const src)
 {
-    int8_t data;
-
-    if (src == NULL)
-        Sys_extError("read_bit8: src == NULL");
-
-    if (SDL_RWread(src, &data, 1, 1) < 1)
-        Sys_extError("read_bit8");
-
-    return data;
+    check_stream(src, 1, "read_bit8");
+    return (int8_t)src->data[src->pos++];
 }
 
 /** \brief reads unsigned 8-bit value.
   *
   * uses current position from src. throws TR_ReadError when not successful.
   */
-uint8_t TR_Level::read_bitu8(SDL_RWops * const src)
+uint8_t TR_Level::read_bitu8(vt_stream_p const src)
 {
-    uint8_t data;
-
-    if (src == NULL)
-        Sys_extError("read_bitu8: src == NULL");
-
-    if (SDL_RWread(src, &data, 1, 1) < 1)
-        Sys_extError("read_bitu8");
-
-    return data;
+    check_stream(src, 1, "read_bitu8");
+    return src->data[src->pos++];
 }
 
 /** \brief reads signed 16-bit value.
   *
   * uses current position from src. does endian correction. throws TR_ReadError when not successful.
   */
-int16_t TR_Level::read_bit16(SDL_RWops * const src)
+int16_t TR_Level::read_bit16(vt_stream_p const src)
 {
     int16_t data;
 
-    if (src == NULL)
-        Sys_extError("read_bit16: src == NULL");
+    check_stream(src, 2, "read_bit16");
+    memcpy(&data, src->data + src->pos, 2);
+    src->pos += 2;
 
-    if (SDL_RWread(src, &data, 2, 1) < 1)
-        Sys_extError("read_bit16");
-
-    data = SDL_SwapLE16(data);
-
-    return data;
+    return SDL_SwapLE16(data);
 }
 
 /** \brief reads unsigned 16-bit value.
   *
   * uses current position from src. does endian correction. throws TR_ReadError when not successful.
   */
-uint16_t TR_Level::read_bitu16(SDL_RWops * const src)
+uint16_t TR_Level::read_bitu16(vt_stream_p const src)
 {
     uint16_t data;
 
-    if (src == NULL)
-        Sys_extError("read_bitu16: src == NULL");
-
-    if (SDL_RWread(src, &data, 2, 1) < 1)
-        Sys_extError("read_bitu16");
+    check_stream(src, 2, "read_bitu16");
+    memcpy(&data, src->data + src->pos, 2);
+    src->pos += 2;
 
-    data = SDL_SwapLE16(data);
-
-    return data;
+    return SDL_SwapLE16(data);
 }
 
 /** \brief reads signed 32-bit value.
   *
   * uses current position from src. does endian correction. throws TR_ReadError when not successful.
   */
-int32_t TR_Level::read_bit32(SDL_RWops * const src)
+int32_t TR_Level::read_bit32(vt_stream_p const src)
 {
     int32_t data;
 
-    if (src == NULL)
-        Sys_extError("read_bit32: src == NULL");
-
-    if (SDL_RWread(src, &data, 4, 1) < 1)
-        Sys_extError("read_bit32");
-
-    data = SDL_SwapLE32(data);
+    check_stream(src, 4, "read_bit32");
+    memcpy(&data, src->data + src->pos, 4);
+    src->pos += 4;
 
-    return data;
+    return SDL_SwapLE32(data);
 }
 
 /** \brief reads unsigned 32-bit value.
   *
   * uses current position from src. does endian correction. throws TR_ReadError when not successful.
   */
-uint32_t TR_Level::read_bitu32(SDL_RWops * const src)
+uint32_t TR_Level::read_bitu32(vt_stream_p const src)
 {
     uint32_t data;
 
-    if (src == NULL)
-        Sys_extError("read_bitu32: src == NULL");
-
-    if (SDL_RWread(src, &data, 4, 1) < 1)
-        Sys_extError("read_bitu32");
-
-    data = SDL_SwapLE32(data);
+    check_stream(src, 4, "read_bitu32");
+    memcpy(&data, src->data + src->pos, 4);
+    src->pos += 4;
 
-    return data;
+    return SDL_SwapLE32(data);
 }
 
 /** \brief reads float value.
   *
   * uses current position from src. does endian correction. throws TR_ReadError when not successful.
   */
-float TR_Level::read_float(SDL_RWops * const src)
+float TR_Level::read_float(vt_stream_p const src)
 {
+    uint32_t bits = read_bitu32(src);
     float data;
 
-    if (src == NULL)
-        Sys_extError("read_float: src == NULL");
-
-    if (SDL_RWread(src, &data, 4, 1) < 1)
-        Sys_extError("read_float");
-
-    data = SDL_SwapLE32(data);
+    memcpy(&data, &bits, 4);
 
     return data;
 }
@@ -161,19 +139,151 @@ float TR_Level::read_float(SDL_RWops * const src)
   *
   * uses current position from src. does endian correction. throws TR_ReadError when not successful.
   */
-float TR_Level::read_mixfloat(SDL_RWops * const src)
+float TR_Level::read_mixfloat(vt_stream_p const src)
 {
-    int16_t base_int;
-    uint16_t sign_int;
+    uint16_t sign_int = read_bitu16(src);
+    int16_t base_int = read_bit16(src);
 
-    if (src == NULL)
-        Sys_extError("read_mixfloat: src == NULL");
+    return ((float)base_int + ((float)sign_int / 65535.0));
+}
+
+/** \brief copies size bytes from src to dst (no endian correction).
+  */
+void TR_Level::read_raw(vt_stream_p const src, void *dst, size_t size)
+{
+    check_stream(src, size, "read_raw");
+    memcpy(dst, src->data + src->pos, size);
+    src->pos += size;
+}
+
+/** \brief returns pointer to the next size bytes of src and skips them.
+  *
+  * The data stays owned by the stream, so the pointer is valid only while
+  * the stream memory (mapped file or decompressed chunk) exists.
+  */
+const uint8_t *TR_Level::read_view(vt_stream_p const src, size_t size)
+{
+    const uint8_t *ret;
 
-    if ((SDL_RWread(src, &sign_int, 2, 1) < 1) || (SDL_RWread(src, &base_int, 2, 1) < 1))
-        Sys_extError("read_mixfloat");
+    check_stream(src, size, "read_view");
+    ret = src->data + src->pos;
+    src->pos += size;
 
-    base_int = SDL_SwapLE32(base_int);
-    sign_int = SDL_SwapLE32(sign_int);
+    return ret;
+}
 
-    return ((float)base_int + ((float)sign_int / 65535.0));
+/** \brief sets absolute position of src.
+  */
+void TR_Level::stream_seek(vt_stream_p const src, size_t pos)
+{
+    if (pos > src->size)
+        Sys_extError("stream_seek: position %d is out of data (%d bytes)", (int)pos, (int)src->size);
+
+    src->pos = pos;
+}
+
+/** \brief skips size bytes of src.
+  */
+void TR_Level::stream_skip(vt_stream_p const src, size_t size)
+{
+    check_stream(src, size, "stream_skip");
+    src->pos += size;
+}
+
+/** \brief makes sub stream over the next size bytes of src and skips them in src.
+  */
+void TR_Level::stream_sub(vt_stream_p const src, size_t size, vt_stream_p const sub)
+{
+    stream_open(sub, read_view(src, size), size);
+}
+
+/** \brief makes stream over size bytes of data; the data is not copied.
+  */
+void TR_Level::stream_open(vt_stream_p const stream, const uint8_t *data, size_t size)
+{
+    stream->data = data;
+    stream->size = size;
+    stream->pos = 0;
+}
+
+static int chunk_threads_running = 0;
+
+static void *inflate_chunk(void *data)
+{
+    vt_chunk_p chunk = (vt_chunk_p)data;
+    uLongf size = chunk->size;
+
+    chunk->result = uncompress(chunk->data, &size, chunk->comp_data, chunk->comp_size);
+    if ((chunk->result == Z_OK) && (size != chunk->size))
+        chunk->result = Z_DATA_ERROR;
+
+    return NULL;
+}
+
+/** \brief takes comp_size bytes of packed data from src and starts to inflate them.
+  *
+  * With async the chunk goes to a worker thread, if one is free; one core is
+  * left to the loader itself. Otherwise the chunk is inflated right here.
+  */
+void TR_Level::read_chunk(vt_stream_p const src, vt_chunk_p chunk, uint32_t uncomp_size, uint32_t comp_size, bool async)
+{
+    int max_threads = SDL_GetCPUCount() - 1;
+
+    if (max_threads > VT_CHUNK_MAX_THREADS)
+        max_threads = VT_CHUNK_MAX_THREADS;
+
+    chunk->comp_data = read_view(src, comp_size);
+    chunk->comp_size = comp_size;
+    chunk->size = uncomp_size;
+    chunk->data = (uint8_t*)malloc(uncomp_size);
+    chunk->result = Z_OK;
+    chunk->is_thread_run = 0;
+    if (chunk->data == NULL)
+        Sys_extError("read_chunk: can not allocate %d bytes", (int)uncomp_size);
+
+    if (async && (chunk_threads_running < max_threads) &&
+        (pthread_create(&chunk->thread, NULL, inflate_chunk, chunk) == 0))
+    {
+        chunk->is_thread_run = 1;
+        chunk_threads_running++;
+        return;
+    }
+
+    inflate_chunk(chunk);
+}
+
+/** \brief waits for the chunk and opens stream over its data.
+  *
+  * Returns false if the chunk was not read (absent in the level file).
+  */
+bool TR_Level::wait_chunk(vt_chunk_p chunk, vt_stream_p const stream, const char *name)
+{
+    if (chunk->data == NULL)
+        return false;
+
+    if (chunk->is_thread_run)
+    {
+        pthread_join(chunk->thread, NULL);
+        chunk->is_thread_run = 0;
+        chunk_threads_running--;
+    }
+
+    if (chunk->result != Z_OK)
+        Sys_extError("%s: uncompress (%d)", name, chunk->result);
+
+    stream_open(stream, chunk->data, chunk->size);
+
+    return true;
+}
+
+void TR_Level::free_chunk(vt_chunk_p chunk)
+{
+    if (chunk->is_thread_run)
+    {
+        pthread_join(chunk->thread, NULL);
+        chunk->is_thread_run = 0;
+        chunk_threads_running--;
+    }
+    free(chunk->data);
+    chunk->data = NULL;
 }
@@ -20,19 +20,27 @@
  */
 
 #include <SDL2/SDL.h>
+#include <SDL2/SDL_endian.h>
 #include <string.h>
 
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 #include "l_main.h"
 #include "../core/system.h"
 
 #define RCSID "$Id: l_main.cpp,v 1.10 2002/09/20 15:59:02 crow Exp $"
 
 /// \brief reads the mesh data.
-void TR_Level::read_mesh_data(SDL_RWops * const src)
+void TR_Level::read_mesh_data(vt_stream_p const src)
 {
-    uint8_t *buffer;
-    SDL_RWops *newsrc = NULL;
-    uint32_t size;
+    vt_stream_t mesh_src;
     uint32_t pos = 0;
     int mesh = 0;
     uint32_t i;
@@ -40,14 +48,8 @@ void TR_Level::read_mesh_data(SDL_RWops * const src)
 
     num_mesh_data = read_bitu32(src);
 
-    size = num_mesh_data * 2;
-    buffer = new uint8_t[size];
-
-    if (SDL_RWread(src, buffer, 1, size) < size)
-        Sys_extError("read_tr_mesh_data: SDL_RWread(buffer)");
-
-    if ((newsrc = SDL_RWFromMem(buffer, size)) == NULL)
-        Sys_extError("read_tr_mesh_data: SDL_RWFromMem");
+    // meshes are parsed in place, right from the level data
+    stream_sub(src, num_mesh_data * 2, &mesh_src);
 
     this->mesh_indices_count = read_bitu32(src);
     this->mesh_indices = (uint32_t*)malloc(this->mesh_indices_count * sizeof(uint32_t));
@@ -65,12 +67,12 @@ void TR_Level::read_mesh_data(SDL_RWops * const src)
             if (this->mesh_indices[j] == pos)
                 this->mesh_indices[j] = mesh;
 
-        SDL_RWseek(newsrc, pos, RW_SEEK_SET);
+        stream_seek(&mesh_src, pos);
 
         if (this->game_version >= TR_IV)
-            read_tr4_mesh(newsrc, this->meshes[mesh]);
+            read_tr4_mesh(&mesh_src, this->meshes[mesh]);
         else
-            read_tr_mesh(newsrc, this->meshes[mesh]);
+            read_tr_mesh(&mesh_src, this->meshes[mesh]);
 
         mesh++;
 
@@ -81,27 +83,22 @@ void TR_Level::read_mesh_data(SDL_RWops * const src)
                 break;
             }
     }
-    SDL_RWclose(newsrc);
-    newsrc = NULL;
-    delete [] buffer;
 }
 
 /// \brief reads frame and moveable data.
-void TR_Level::read_frame_moveable_data(SDL_RWops * const src)
+void TR_Level::read_frame_moveable_data(vt_stream_p const src)
 {
     uint32_t i;
-    SDL_RWops *newsrc = NULL;
     uint32_t pos = 0;
     uint32_t frame = 0;
 
     this->frame_data_size = read_bitu32(src);
     this->frame_data = (uint16_t*)malloc(this->frame_data_size * sizeof(uint16_t));
-
-    if (SDL_RWread(src, this->frame_data, sizeof(uint16_t), this->frame_data_size) < frame_data_size)
-        Sys_extError("read_tr_level: frame_data: SDL_RWread(buffer)");
-
-    if ((newsrc = SDL_RWFromMem(this->frame_data, this->frame_data_size)) == NULL)
-        Sys_extError("read_tr_level: frame_data: SDL_RWFromMem");
+    read_raw(src, this->frame_data, this->frame_data_size * sizeof(uint16_t));
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+    for (i = 0; i < this->frame_data_size; i++)
+        this->frame_data[i] = SDL_SwapLE16(this->frame_data[i]);
+#endif
 
     this->moveables_count = read_bitu32(src);
     this->moveables = (tr_moveable_t*)calloc(this->moveables_count, sizeof(tr_moveable_t));
@@ -124,8 +121,6 @@ void TR_Level::read_frame_moveable_data(SDL_RWops * const src)
                 this->moveables[j].frame_offset = 0;
             }
 
-        SDL_RWseek(newsrc, pos, RW_SEEK_SET);
-
         frame++;
 
         pos = 0;
@@ -136,17 +131,114 @@ void TR_Level::read_frame_moveable_data(SDL_RWops * const src)
                 break;
             }
     }
+}
+
+/** \brief maps whole level file into memory.
+  *
+  * Falls back to one bulk read into a heap buffer, if the file can not be mapped.
+  * Returns NULL if the file can not be opened or is empty.
+  */
+static const uint8_t *map_level_file(const char *filename, size_t *size, int *is_mapped)
+{
+    uint8_t *ret = NULL;
+    SDL_RWops *f;
+    Sint64 file_size;
+
+    *size = 0;
+    *is_mapped = 0;
 
-    SDL_RWclose(newsrc);
-    newsrc = NULL;
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file != INVALID_HANDLE_VALUE)
+    {
+        LARGE_INTEGER li;
+        if (GetFileSizeEx(file, &li) && (li.QuadPart > 0))
+        {
+            HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (mapping)
+            {
+                ret = (uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                CloseHandle(mapping);   // view keeps the mapping alive
+                if (ret)
+                {
+                    *size = (size_t)li.QuadPart;
+                    *is_mapped = 1;
+                }
+            }
+        }
+        CloseHandle(file);
+    }
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd >= 0)
+    {
+        struct stat st;
+        if ((fstat(fd, &st) == 0) && (st.st_size > 0))
+        {
+            void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED)
+            {
+                madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+                ret = (uint8_t*)p;
+                *size = (size_t)st.st_size;
+                *is_mapped = 1;
+            }
+        }
+        close(fd);
+    }
+#endif
+
+    if (ret)
+        return ret;
+
+    f = SDL_RWFromFile(filename, "rb");
+    if (f == NULL)
+        return NULL;
+
+    file_size = SDL_RWsize(f);
+    if (file_size > 0)
+    {
+        ret = (uint8_t*)malloc(file_size);
+        if (SDL_RWread(f, ret, 1, file_size) < (size_t)file_size)
+        {
+            free(ret);
+            ret = NULL;
+        }
+        else
+        {
+            *size = (size_t)file_size;
+        }
+    }
+    SDL_RWclose(f);
+
+    return ret;
+}
+
+static void unmap_level_file(const uint8_t *data, size_t size, int is_mapped)
+{
+    if (is_mapped)
+    {
+#if defined(_WIN32)
+        UnmapViewOfFile(data);
+#else
+        munmap((void*)data, size);
+#endif
+    }
+    else
+    {
+        free((void*)data);
+    }
 }
 
 void TR_Level::read_level(const char *filename, int32_t game_version)
 {
     int len, i, len2;
-    SDL_RWops *src = SDL_RWFromFile(filename, "rb");
+    int is_mapped = 0;
+    vt_stream_t src;
 
-    if(src == NULL)
+    src.pos = 0;
+    src.data = map_level_file(filename, &src.size, &is_mapped);
+    if(src.data == NULL)
     {
         return;
     }
@@ -168,18 +260,18 @@ void TR_Level::read_level(const char *filename, int32_t game_version)
         strncat(this->sfx_path, "MAIN.SFX", 256);
     }
 
-    this->read_level(src, game_version);
-    SDL_RWclose(src);
+    this->read_level(&src, game_version);
+    unmap_level_file(src.data, src.size, is_mapped);
 }
 
 /** \brief reads the level.
   *
-  * Takes a SDL_RWop and the game_version of the file and reads the structures into the members of TR_Level.
+  * Takes a level data stream and the game_version of the file and reads the structures into the members of TR_Level.
   */
-void TR_Level::read_level(SDL_RWops * const src, int32_t game_version)
+void TR_Level::read_level(vt_stream_p const src, int32_t game_version)
 {
     if (!src)
-        Sys_extError("Invalid SDL_RWops");
+        Sys_extError("Invalid level data stream");
 
     this->game_version = game_version;
 
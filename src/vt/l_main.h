@@ -2,6 +2,7 @@
 #define _L_MAIN_H_
 
 #include <SDL2/SDL_rwops.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -29,6 +30,37 @@
 #define TR_AUDIO_DEFAULT_RANGE 8
 #define TR_AUDIO_DEFAULT_PITCH 1.0       // 0.0 - only noise
 
+/** \brief level data stream.
+  *
+  * A read only view over the memory mapped level file, a decompressed chunk or
+  * a part of another stream. Readers take fields straight from memory; no data
+  * is copied until it is stored in TR_Level structures.
+  */
+typedef struct vt_stream_s
+{
+    const uint8_t  *data;
+    size_t          size;
+    size_t          pos;
+} vt_stream_t, *vt_stream_p;
+
+/** \brief zlib packed chunk of TR4 / TR5 level.
+  *
+  * Chunks are independent, so they are inflated by worker threads while the
+  * loader goes on with the rest of the file; wait_chunk() hands out the data.
+  */
+#define VT_CHUNK_MAX_THREADS (3)
+
+typedef struct vt_chunk_s
+{
+    const uint8_t  *comp_data;
+    uint32_t        comp_size;
+    uint8_t        *data;
+    uint32_t        size;
+    int             result;
+    int             is_thread_run;
+    pthread_t       thread;
+} vt_chunk_t, *vt_chunk_p;
+
 /** \brief A complete TR level.
   *
   * This contains all necessary functions to load a TR level.
@@ -543,7 +575,7 @@ class TR_Level
     char     sfx_path[256];
         
     void read_level(const char *filename, int32_t game_version);
-    void read_level(SDL_RWops * const src, int32_t game_version);
+    void read_level(vt_stream_p const src, int32_t game_version);
     tr_mesh_thee_tag_t get_mesh_tree_tag_for_model(tr_moveable_t *model, int index);
     void get_anim_frame_data(tr5_vertex_t min_max_pos[3], tr5_vertex_t *rotations, int meshes_count, tr_animation_t *anim, int frame);
     
@@ -555,90 +587,102 @@ class TR_Level
     uint32_t num_misc_textiles;     ///< \brief number of 256x256 misc textiles (TR4-5).
     bool read_32bit_textiles;       ///< \brief are other 32bit textiles than misc ones read?
 
-    int8_t read_bit8(SDL_RWops * const src);
-    uint8_t read_bitu8(SDL_RWops * const src);
-    int16_t read_bit16(SDL_RWops * const src);
-    uint16_t read_bitu16(SDL_RWops * const src);
-    int32_t read_bit32(SDL_RWops * const src);
-    uint32_t read_bitu32(SDL_RWops * const src);
-    float read_float(SDL_RWops * const src);
-    float read_mixfloat(SDL_RWops * const src);
+    int8_t read_bit8(vt_stream_p const src);
+    uint8_t read_bitu8(vt_stream_p const src);
+    int16_t read_bit16(vt_stream_p const src);
+    uint16_t read_bitu16(vt_stream_p const src);
+    int32_t read_bit32(vt_stream_p const src);
+    uint32_t read_bitu32(vt_stream_p const src);
+    float read_float(vt_stream_p const src);
+    float read_mixfloat(vt_stream_p const src);
+    void read_raw(vt_stream_p const src, void *dst, size_t size);
+    const uint8_t *read_view(vt_stream_p const src, size_t size);
+    void stream_seek(vt_stream_p const src, size_t pos);
+    void stream_skip(vt_stream_p const src, size_t size);
+    void stream_sub(vt_stream_p const src, size_t size, vt_stream_p const sub);
+    void stream_open(vt_stream_p const stream, const uint8_t *data, size_t size);
+    void read_chunk(vt_stream_p const src, vt_chunk_p chunk, uint32_t uncomp_size, uint32_t comp_size, bool async);
+    bool wait_chunk(vt_chunk_p chunk, vt_stream_p const stream, const char *name);
+    void free_chunk(vt_chunk_p chunk);
 
-    void read_mesh_data(SDL_RWops * const src);
-    void read_frame_moveable_data(SDL_RWops * const src);
+    void read_mesh_data(vt_stream_p const src);
+    void read_frame_moveable_data(vt_stream_p const src);
 
-    void read_tr_colour(SDL_RWops * const src, tr2_colour_t & colour);
-    void read_tr_vertex16(SDL_RWops * const src, tr5_vertex_t & vertex);
-    void read_tr_vertex32(SDL_RWops * const src, tr5_vertex_t & vertex);
-    void read_tr_face3(SDL_RWops * const src, tr4_face3_t & face);
-    void read_tr_face4(SDL_RWops * const src, tr4_face4_t & face);
-    void read_tr_textile8(SDL_RWops * const src, tr_textile8_t & textile);
-    void read_tr_lightmap(SDL_RWops * const src, tr_lightmap_t & lightmap);
-    void read_tr_palette(SDL_RWops * const src, tr2_palette_t & palette);
-    void read_tr_box(SDL_RWops * const src, tr_box_t & box);
-    void read_tr_zone(SDL_RWops * const src, tr2_zone_t & zone);
-    void read_tr_room_sprite(SDL_RWops * const src, tr_room_sprite_t & room_sprite);
-    void read_tr_room_portal(SDL_RWops * const src, tr_room_portal_t & portal);
-    void read_tr_room_sector(SDL_RWops * const src, tr_room_sector_t & room_sector);
-    void read_tr_room_light(SDL_RWops * const src, tr5_room_light_t & light);
-    void read_tr_room_vertex(SDL_RWops * const src, tr5_room_vertex_t & room_vertex);
-    void read_tr_room_staticmesh(SDL_RWops * const src, tr2_room_staticmesh_t & room_static_mesh);
-    void read_tr_room(SDL_RWops * const src, tr5_room_t & room);
-    void read_tr_object_texture_vert(SDL_RWops * const src, tr4_object_texture_vert_t & vert);
-    void read_tr_object_texture(SDL_RWops * const src, tr4_object_texture_t & object_texture);
-    void read_tr_sprite_texture(SDL_RWops * const src, tr_sprite_texture_t & sprite_texture);
-    void read_tr_sprite_sequence(SDL_RWops * const src, tr_sprite_sequence_t & sprite_sequence);
-    void read_tr_mesh(SDL_RWops * const src, tr4_mesh_t & mesh);
-    void read_tr_state_changes(SDL_RWops * const src, tr_state_change_t & state_change);
-    void read_tr_anim_dispatches(SDL_RWops * const src, tr_anim_dispatch_t & anim_dispatch);
-    void read_tr_animation(SDL_RWops * const src, tr_animation_t & animation);
-    void read_tr_moveable(SDL_RWops * const src, tr_moveable_t & moveable);
-    void read_tr_item(SDL_RWops * const src, tr2_item_t & item);
-    void read_tr_cinematic_frame(SDL_RWops * const src, tr_cinematic_frame_t & cf);
-    void read_tr_staticmesh(SDL_RWops * const src, tr_staticmesh_t & mesh);
-    void read_tr_level(SDL_RWops * const src, bool demo_or_ub);
+    void read_tr_colour(vt_stream_p const src, tr2_colour_t & colour);
+    void read_tr_vertex16(vt_stream_p const src, tr5_vertex_t & vertex);
+    void read_tr_vertex32(vt_stream_p const src, tr5_vertex_t & vertex);
+    void read_tr_face3(vt_stream_p const src, tr4_face3_t & face);
+    void read_tr_face4(vt_stream_p const src, tr4_face4_t & face);
+    void read_tr_textile8(vt_stream_p const src, tr_textile8_t & textile);
+    void read_tr_lightmap(vt_stream_p const src, tr_lightmap_t & lightmap);
+    void read_tr_palette(vt_stream_p const src, tr2_palette_t & palette);
+    void read_tr_box(vt_stream_p const src, tr_box_t & box);
+    void read_tr_zone(vt_stream_p const src, tr2_zone_t & zone);
+    void read_tr_room_sprite(vt_stream_p const src, tr_room_sprite_t & room_sprite);
+    void read_tr_room_portal(vt_stream_p const src, tr_room_portal_t & portal);
+    void read_tr_room_sector(vt_stream_p const src, tr_room_sector_t & room_sector);
+    void read_tr_room_sectors(vt_stream_p const src, tr_room_sector_t *sectors, uint32_t count);
+    void read_tr_room_light(vt_stream_p const src, tr5_room_light_t & light);
+    void read_tr_room_vertex(vt_stream_p const src, tr5_room_vertex_t & room_vertex);
+    void read_tr_room_staticmesh(vt_stream_p const src, tr2_room_staticmesh_t & room_static_mesh);
+    void read_tr_room(vt_stream_p const src, tr5_room_t & room);
+    void read_tr_object_texture_vert(vt_stream_p const src, tr4_object_texture_vert_t & vert);
+    void read_tr_object_texture(vt_stream_p const src, tr4_object_texture_t & object_texture);
+    void read_tr_sprite_texture(vt_stream_p const src, tr_sprite_texture_t & sprite_texture);
+    void read_tr_sprite_sequence(vt_stream_p const src, tr_sprite_sequence_t & sprite_sequence);
+    void read_tr_mesh(vt_stream_p const src, tr4_mesh_t & mesh);
+    void read_tr_state_changes(vt_stream_p const src, tr_state_change_t & state_change);
+    void read_tr_anim_dispatches(vt_stream_p const src, tr_anim_dispatch_t & anim_dispatch);
+    void read_tr_animation(vt_stream_p const src, tr_animation_t & animation);
+    void read_tr_moveable(vt_stream_p const src, tr_moveable_t & moveable);
+    void read_tr_item(vt_stream_p const src, tr2_item_t & item);
+    void read_tr_cinematic_frame(vt_stream_p const src, tr_cinematic_frame_t & cf);
+    void read_tr_staticmesh(vt_stream_p const src, tr_staticmesh_t & mesh);
+    void read_tr_level(vt_stream_p const src, bool demo_or_ub);
 
-    void read_tr2_colour4(SDL_RWops * const src, tr2_colour_t & colour);
-    void read_tr2_palette16(SDL_RWops * const src, tr2_palette_t & palette16);
-    void read_tr2_textile16(SDL_RWops * const src, tr2_textile16_t & textile);
-    void read_tr2_box(SDL_RWops * const src, tr_box_t & box);
-    void read_tr2_zone(SDL_RWops * const src, tr2_zone_t & zone);
-    void read_tr2_room_light(SDL_RWops * const src, tr5_room_light_t & light);
-    void read_tr2_room_vertex(SDL_RWops * const src, tr5_room_vertex_t & room_vertex);
-    void read_tr2_room_staticmesh(SDL_RWops * const src, tr2_room_staticmesh_t & room_static_mesh);
-    void read_tr2_room(SDL_RWops * const src, tr5_room_t & room);
-    void read_tr2_item(SDL_RWops * const src, tr2_item_t & item);
-    void read_tr2_level(SDL_RWops * const src, bool demo);
+    void read_tr2_colour4(vt_stream_p const src, tr2_colour_t & colour);
+    void read_tr2_palette16(vt_stream_p const src, tr2_palette_t & palette16);
+    void read_tr2_textile16(vt_stream_p const src, tr2_textile16_t & textile);
+    void read_tr2_box(vt_stream_p const src, tr_box_t & box);
+    void read_tr2_zone(vt_stream_p const src, tr2_zone_t & zone);
+    void read_tr2_room_light(vt_stream_p const src, tr5_room_light_t & light);
+    void read_tr2_room_vertex(vt_stream_p const src, tr5_room_vertex_t & room_vertex);
+    void read_tr2_room_staticmesh(vt_stream_p const src, tr2_room_staticmesh_t & room_static_mesh);
+    void read_tr2_room(vt_stream_p const src, tr5_room_t & room);
+    void read_tr2_item(vt_stream_p const src, tr2_item_t & item);
+    void read_tr2_level(vt_stream_p const src, bool demo);
 
-    void read_tr3_room_light(SDL_RWops * const src, tr5_room_light_t & light);
-    void read_tr3_room_vertex(SDL_RWops * const src, tr5_room_vertex_t & room_vertex);
-    void read_tr3_room_staticmesh(SDL_RWops * const src, tr2_room_staticmesh_t & room_static_mesh);
-    void read_tr3_room(SDL_RWops * const src, tr5_room_t & room);
-    void read_tr3_item(SDL_RWops * const src, tr2_item_t & item);
-    void read_tr3_level(SDL_RWops * const src);
+    void read_tr3_room_light(vt_stream_p const src, tr5_room_light_t & light);
+    void read_tr3_room_vertex(vt_stream_p const src, tr5_room_vertex_t & room_vertex);
+    void read_tr3_room_staticmesh(vt_stream_p const src, tr2_room_staticmesh_t & room_static_mesh);
+    void read_tr3_room(vt_stream_p const src, tr5_room_t & room);
+    void read_tr3_item(vt_stream_p const src, tr2_item_t & item);
+    void read_tr3_level(vt_stream_p const src);
 
-    void read_tr4_vertex_float(SDL_RWops * const src, tr5_vertex_t & vertex);
-    void read_tr4_textile32(SDL_RWops * const src, tr4_textile32_t & textile);
-    void read_tr4_face3(SDL_RWops * const src, tr4_face3_t & meshface);
-    void read_tr4_face4(SDL_RWops * const src, tr4_face4_t & meshface);
-    void read_tr4_room_light(SDL_RWops * const src, tr5_room_light_t & light);
-    void read_tr4_room_vertex(SDL_RWops * const src, tr5_room_vertex_t & room_vertex);
-     void read_tr4_room_staticmesh(SDL_RWops * const src, tr2_room_staticmesh_t & room_static_mesh);
-    void read_tr4_room(SDL_RWops * const src, tr5_room_t & room);
-    void read_tr4_item(SDL_RWops * const src, tr2_item_t & item);
-    void read_tr4_object_texture_vert(SDL_RWops * const src, tr4_object_texture_vert_t & vert);
-    void read_tr4_object_texture(SDL_RWops * const src, tr4_object_texture_t & object_texture);
-    void read_tr4_sprite_texture(SDL_RWops * const src, tr_sprite_texture_t & sprite_texture);
-    void read_tr4_mesh(SDL_RWops * const src, tr4_mesh_t & mesh);
-    void read_tr4_animation(SDL_RWops * const src, tr_animation_t & animation);
-    void read_tr4_level(SDL_RWops * const _src);
+    void read_tr4_vertex_float(vt_stream_p const src, tr5_vertex_t & vertex);
+    void read_tr4_textile32(vt_stream_p const src, tr4_textile32_t & textile);
+    void read_tr4_face3(vt_stream_p const src, tr4_face3_t & meshface);
+    void read_tr4_face4(vt_stream_p const src, tr4_face4_t & meshface);
+    void read_tr4_faces3(vt_stream_p const src, tr4_face3_t *faces, int32_t count);
+    void read_tr4_faces4(vt_stream_p const src, tr4_face4_t *faces, int32_t count);
+    void read_tr4_room_light(vt_stream_p const src, tr5_room_light_t & light);
+    void read_tr4_room_vertex(vt_stream_p const src, tr5_room_vertex_t & room_vertex);
+     void read_tr4_room_staticmesh(vt_stream_p const src, tr2_room_staticmesh_t & room_static_mesh);
+    void read_tr4_room(vt_stream_p const src, tr5_room_t & room);
+    void read_tr4_item(vt_stream_p const src, tr2_item_t & item);
+    void read_tr4_object_texture_vert(vt_stream_p const src, tr4_object_texture_vert_t & vert);
+    void read_tr4_object_texture(vt_stream_p const src, tr4_object_texture_t & object_texture);
+    void read_tr4_sprite_texture(vt_stream_p const src, tr_sprite_texture_t & sprite_texture);
+    void read_tr4_mesh(vt_stream_p const src, tr4_mesh_t & mesh);
+    void read_tr4_animation(vt_stream_p const src, tr_animation_t & animation);
+    void read_tr4_level(vt_stream_p const _src);
 
-    void read_tr5_room_light(SDL_RWops * const src, tr5_room_light_t & light);
-    void read_tr5_room_layer(SDL_RWops * const src, tr5_room_layer_t & layer);
-    void read_tr5_room_vertex(SDL_RWops * const src, tr5_room_vertex_t & vert);
-    void read_tr5_room(SDL_RWops * const orgsrc, tr5_room_t & room);
-    void read_tr5_moveable(SDL_RWops * const src, tr_moveable_t & moveable);
-    void read_tr5_level(SDL_RWops * const src);
+    void read_tr5_room_light(vt_stream_p const src, tr5_room_light_t & light);
+    void read_tr5_room_layer(vt_stream_p const src, tr5_room_layer_t & layer);
+    void read_tr5_room_vertex(vt_stream_p const src, tr5_room_vertex_t & vert);
+    void read_tr5_room(vt_stream_p const orgsrc, tr5_room_t & room);
+    void read_tr5_moveable(vt_stream_p const src, tr_moveable_t & moveable);
+    void read_tr5_level(vt_stream_p const src);
 };
 
 #endif // _L_MAIN_H_
@@ -31,7 +31,7 @@
   * Reads three rgb colour components. The read 6-bit values get shifted, so they are 8-bit.
   * The alpha value of tr2_colour_t gets set to 0.
   */
-void TR_Level::read_tr_colour(SDL_RWops * const src, tr2_colour_t & colour)
+void TR_Level::read_tr_colour(vt_stream_p const src, tr2_colour_t & colour)
 {
     // read 6 bit color and change to 8 bit
     colour.r = read_bitu8(src) << 2;
@@ -44,7 +44,7 @@ void TR_Level::read_tr_colour(SDL_RWops * const src, tr2_colour_t & colour)
   *
   * The values get converted from bit16 to float. y and z are negated to fit OpenGLs coordinate system.
   */
-void TR_Level::read_tr_vertex16(SDL_RWops * const src, tr5_vertex_t & vertex)
+void TR_Level::read_tr_vertex16(vt_stream_p const src, tr5_vertex_t & vertex)
 {
     // read vertex and change coordinate system
     vertex.x = (float)read_bit16(src);
@@ -56,7 +56,7 @@ void TR_Level::read_tr_vertex16(SDL_RWops * const src, tr5_vertex_t & vertex)
   *
   * The values get converted from bit32 to float. y and z are negated to fit OpenGLs coordinate system.
   */
-void TR_Level::read_tr_vertex32(SDL_RWops * const src, tr5_vertex_t & vertex)
+void TR_Level::read_tr_vertex32(vt_stream_p const src, tr5_vertex_t & vertex)
 {
     // read vertex and change coordinate system
     vertex.x = (float)read_bit32(src);
@@ -68,7 +68,7 @@ void TR_Level::read_tr_vertex32(SDL_RWops * const src, tr5_vertex_t & vertex)
   *
   * The lighting value is set to 0, as it is only in TR4-5.
   */
-void TR_Level::read_tr_face3(SDL_RWops * const src, tr4_face3_t & meshface)
+void TR_Level::read_tr_face3(vt_stream_p const src, tr4_face3_t & meshface)
 {
     meshface.vertices[0] = read_bitu16(src);
     meshface.vertices[1] = read_bitu16(src);
@@ -82,7 +82,7 @@ void TR_Level::read_tr_face3(SDL_RWops * const src, tr4_face3_t & meshface)
   *
   * The lighting value is set to 0, as it is only in TR4-5.
   */
-void TR_Level::read_tr_face4(SDL_RWops * const src, tr4_face4_t & meshface)
+void TR_Level::read_tr_face4(vt_stream_p const src, tr4_face4_t & meshface)
 {
     meshface.vertices[0] = read_bitu16(src);
     meshface.vertices[1] = read_bitu16(src);
@@ -94,28 +94,26 @@ void TR_Level::read_tr_face4(SDL_RWops * const src, tr4_face4_t & meshface)
 }
 
 /// \brief reads a 8-bit 256x256 textile.
-void TR_Level::read_tr_textile8(SDL_RWops * const src, tr_textile8_t & textile)
+void TR_Level::read_tr_textile8(vt_stream_p const src, tr_textile8_t & textile)
 {
-    for (int i = 0; i < 256; i++)
-        if (SDL_RWread(src, textile.pixels[i], 1, 256) < 256)
-                        Sys_extError("read_tr_textile8");
+    read_raw(src, textile.pixels, sizeof(textile.pixels));
 }
 
 /// \brief reads the lightmap.
-void TR_Level::read_tr_lightmap(SDL_RWops * const src, tr_lightmap_t & lightmap)
+void TR_Level::read_tr_lightmap(vt_stream_p const src, tr_lightmap_t & lightmap)
 {
     for (int i = 0; i < (32 * 256); i++)
         lightmap.map[i] = read_bitu8(src);
 }
 
 /// \brief reads the 256 colour palette values.
-void TR_Level::read_tr_palette(SDL_RWops * const src, tr2_palette_t & palette)
+void TR_Level::read_tr_palette(vt_stream_p const src, tr2_palette_t & palette)
 {
     for (int i = 0; i < 256; i++)
         read_tr_colour(src, palette.colour[i]);
 }
 
-void TR_Level::read_tr_box(SDL_RWops * const src, tr_box_t & box)
+void TR_Level::read_tr_box(vt_stream_p const src, tr_box_t & box)
 {
     box.zmax =-read_bit32(src);
     box.zmin =-read_bit32(src);
@@ -125,7 +123,7 @@ void TR_Level::read_tr_box(SDL_RWops * const src, tr_box_t & box)
     box.overlap_index = read_bitu16(src);
 }
 
-void TR_Level::read_tr_zone(SDL_RWops * const src, tr2_zone_t & zone)
+void TR_Level::read_tr_zone(vt_stream_p const src, tr2_zone_t & zone)
 {
     zone.GroundZone1_Normal = read_bit16(src);
     zone.GroundZone2_Normal = read_bit16(src);
@@ -140,7 +138,7 @@ void TR_Level::read_tr_zone(SDL_RWops * const src, tr2_zone_t & zone)
 }
 
 /// \brief reads a room sprite definition.
-void TR_Level::read_tr_room_sprite(SDL_RWops * const src, tr_room_sprite_t & room_sprite)
+void TR_Level::read_tr_room_sprite(vt_stream_p const src, tr_room_sprite_t & room_sprite)
 {
     room_sprite.vertex = read_bit16(src);
     room_sprite.texture = read_bit16(src);
@@ -150,7 +148,7 @@ void TR_Level::read_tr_room_sprite(SDL_RWops * const src, tr_room_sprite_t & roo
   *
   * A check is preformed to see wether the normal lies on a coordinate axis, if not an exception gets thrown.
   */
-void TR_Level::read_tr_room_portal(SDL_RWops * const src, tr_room_portal_t & portal)
+void TR_Level::read_tr_room_portal(vt_stream_p const src, tr_room_portal_t & portal)
 {
     portal.adjoining_room = read_bitu16(src);
     read_tr_vertex16(src, portal.normal);
@@ -174,7 +172,7 @@ void TR_Level::read_tr_room_portal(SDL_RWops * const src, tr_room_portal_t & por
 }
 
 /// \brief reads a room sector definition.
-void TR_Level::read_tr_room_sector(SDL_RWops * const src, tr_room_sector_t & sector)
+void TR_Level::read_tr_room_sector(vt_stream_p const src, tr_room_sector_t & sector)
 {
     sector.fd_index = read_bitu16(src);
     sector.box_index = read_bitu16(src);
@@ -184,12 +182,24 @@ void TR_Level::read_tr_room_sector(SDL_RWops * const src, tr_room_sector_t & sec
     sector.ceiling = read_bit8(src);
 }
 
+/// \brief reads count room sectors; file layout matches tr_room_sector_t, so it is one copy on little endian hosts.
+void TR_Level::read_tr_room_sectors(vt_stream_p const src, tr_room_sector_t *sectors, uint32_t count)
+{
+    static_assert(sizeof(tr_room_sector_t) == 8, "tr_room_sector_t must match file layout");
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+    read_raw(src, sectors, count * sizeof(tr_room_sector_t));
+#else
+    for (uint32_t i = 0; i < count; i++)
+        read_tr_room_sector(src, sectors[i]);
+#endif
+}
+
 /** \brief reads a room light definition.
   *
   * intensity1 gets converted, so it matches the 0-32768 range introduced in TR3.
   * intensity2 and fade2 are introduced in TR2 and are set to intensity1 and fade1 for TR1.
   */
-void TR_Level::read_tr_room_light(SDL_RWops * const src, tr5_room_light_t & light)
+void TR_Level::read_tr_room_light(vt_stream_p const src, tr5_room_light_t & light)
 {
     read_tr_vertex32(src, light.pos);
     // read and make consistent
@@ -227,7 +237,7 @@ void TR_Level::read_tr_room_light(SDL_RWops * const src, tr5_room_light_t & ligh
   * attributes is introduced in TR2 and is set 0 for TR1.
   * All other values are introduced in TR5 and get set to appropiate values.
   */
-void TR_Level::read_tr_room_vertex(SDL_RWops * const src, tr5_room_vertex_t & room_vertex)
+void TR_Level::read_tr_room_vertex(vt_stream_p const src, tr5_room_vertex_t & room_vertex)
 {
     read_tr_vertex16(src, room_vertex.vertex);
     // read and make consistent
@@ -256,7 +266,7 @@ void TR_Level::read_tr_room_vertex(SDL_RWops * const src, tr5_room_vertex_t & ro
   * intensity1 gets converted, so it matches the 0-32768 range introduced in TR3.
   * intensity2 is introduced in TR2 and is set to intensity1 for TR1.
   */
-void TR_Level::read_tr_room_staticmesh(SDL_RWops * const src, tr2_room_staticmesh_t & room_static_mesh)
+void TR_Level::read_tr_room_staticmesh(vt_stream_p const src, tr2_room_staticmesh_t & room_static_mesh)
 {
     read_tr_vertex32(src, room_static_mesh.pos);
     room_static_mesh.rotation = (float)read_bitu16(src) / 16384.0f * -90;
@@ -279,7 +289,7 @@ void TR_Level::read_tr_room_staticmesh(SDL_RWops * const src, tr2_room_staticmes
   * light_mode is only in TR2 and is set 0 for TR1.
   * light_colour is only in TR3-4 and gets set appropiatly.
   */
-void TR_Level::read_tr_room(SDL_RWops * const src, tr5_room_t & room)
+void TR_Level::read_tr_room(vt_stream_p const src, tr5_room_t & room)
 {
     uint32_t num_data_words;
     uint32_t i;
@@ -294,7 +304,7 @@ void TR_Level::read_tr_room(SDL_RWops * const src, tr5_room_t & room)
 
     num_data_words = read_bitu32(src);
 
-    pos = SDL_RWseek(src, 0, RW_SEEK_CUR);
+    pos = src->pos;
 
     room.num_layers = 0;
 
@@ -319,7 +329,7 @@ void TR_Level::read_tr_room(SDL_RWops * const src, tr5_room_t & room)
         read_tr_room_sprite(src, room.sprites[i]);
 
     // set to the right position in case that there is some unused data
-    SDL_RWseek(src, pos + (num_data_words * 2), RW_SEEK_SET);
+    stream_seek(src, pos + (num_data_words * 2));
 
     room.num_portals = read_bitu16(src);
     room.portals = (tr_room_portal_t*)malloc(room.num_portals * sizeof(tr_room_portal_t));
@@ -329,8 +339,7 @@ void TR_Level::read_tr_room(SDL_RWops * const src, tr5_room_t & room)
     room.num_zsectors = read_bitu16(src);
     room.num_xsectors = read_bitu16(src);
     room.sector_list = (tr_room_sector_t*)malloc(room.num_zsectors * room.num_xsectors * sizeof(tr_room_sector_t));
-    for (i = 0; i < (uint32_t)(room.num_zsectors * room.num_xsectors); i++)
-        read_tr_room_sector(src, room.sector_list[i]);
+    read_tr_room_sectors(src, room.sector_list, (uint32_t)(room.num_zsectors * room.num_xsectors));
 
     // read and make consistent
     float roomIntensity = read_bit16(src);
@@ -368,7 +377,7 @@ void TR_Level::read_tr_room(SDL_RWops * const src, tr5_room_t & room)
 }
 
 /// \brief reads object texture vertex definition.
-void TR_Level::read_tr_object_texture_vert(SDL_RWops * const src, tr4_object_texture_vert_t & vert)
+void TR_Level::read_tr_object_texture_vert(vt_stream_p const src, tr4_object_texture_vert_t & vert)
 {
     vert.xcoordinate = read_bit8(src);
     vert.xpixel = read_bitu8(src);
@@ -381,7 +390,7 @@ void TR_Level::read_tr_object_texture_vert(SDL_RWops * const src, tr4_object_tex
   * some sanity checks get done and if they fail an exception gets thrown.
   * all values introduced in TR4 get set appropiatly.
   */
-void TR_Level::read_tr_object_texture(SDL_RWops * const src, tr4_object_texture_t & object_texture)
+void TR_Level::read_tr_object_texture(vt_stream_p const src, tr4_object_texture_t & object_texture)
 {
     object_texture.transparency_flags = read_bitu16(src);
     object_texture.tile_and_flag = read_bitu16(src);
@@ -408,7 +417,7 @@ void TR_Level::read_tr_object_texture(SDL_RWops * const src, tr4_object_texture_
   *
   * some sanity checks get done and if they fail an exception gets thrown.
   */
-void TR_Level::read_tr_sprite_texture(SDL_RWops * const src, tr_sprite_texture_t & sprite_texture)
+void TR_Level::read_tr_sprite_texture(vt_stream_p const src, tr_sprite_texture_t & sprite_texture)
 {
     int tx, ty, tw, th, tleft, tright, ttop, tbottom;
     float w, h;
@@ -443,7 +452,7 @@ void TR_Level::read_tr_sprite_texture(SDL_RWops * const src, tr_sprite_texture_t
   *
   * length is negative when read and thus gets negated.
   */
-void TR_Level::read_tr_sprite_sequence(SDL_RWops * const src, tr_sprite_sequence_t & sprite_sequence)
+void TR_Level::read_tr_sprite_sequence(vt_stream_p const src, tr_sprite_sequence_t & sprite_sequence)
 {
     sprite_sequence.object_id = read_bit32(src);
     sprite_sequence.length = -read_bit16(src);
@@ -455,7 +464,7 @@ void TR_Level::read_tr_sprite_sequence(SDL_RWops * const src, tr_sprite_sequence
   * The read num_normals value is positive when normals are available and negative when light
   * values are available. The values get set appropiatly.
   */
-void TR_Level::read_tr_mesh(SDL_RWops * const src, tr4_mesh_t & mesh)
+void TR_Level::read_tr_mesh(vt_stream_p const src, tr4_mesh_t & mesh)
 {
     int i;
 
@@ -505,7 +514,7 @@ void TR_Level::read_tr_mesh(SDL_RWops * const src, tr4_mesh_t & mesh)
 }
 
 /// \brief reads an animation state change.
-void TR_Level::read_tr_state_changes(SDL_RWops * const src, tr_state_change_t & state_change)
+void TR_Level::read_tr_state_changes(vt_stream_p const src, tr_state_change_t & state_change)
 {
     state_change.state_id = read_bitu16(src);
     state_change.num_anim_dispatches = read_bitu16(src);
@@ -513,7 +522,7 @@ void TR_Level::read_tr_state_changes(SDL_RWops * const src, tr_state_change_t &
 }
 
 /// \brief reads an animation dispatch.
-void TR_Level::read_tr_anim_dispatches(SDL_RWops * const src, tr_anim_dispatch_t & anim_dispatch)
+void TR_Level::read_tr_anim_dispatches(vt_stream_p const src, tr_anim_dispatch_t & anim_dispatch)
 {
     anim_dispatch.low = read_bit16(src);
     anim_dispatch.high = read_bit16(src);
@@ -522,7 +531,7 @@ void TR_Level::read_tr_anim_dispatches(SDL_RWops * const src, tr_anim_dispatch_t
 }
 
 /// \brief reads an animation definition.
-void TR_Level::read_tr_animation(SDL_RWops * const src, tr_animation_t & animation)
+void TR_Level::read_tr_animation(vt_stream_p const src, tr_animation_t & animation)
 {
     animation.frame_offset = read_bitu32(src);
     animation.frame_rate = read_bitu8(src);
@@ -548,7 +557,7 @@ void TR_Level::read_tr_animation(SDL_RWops * const src, tr_animation_t & animati
   * some sanity checks get done which throw a exception on failure.
   * frame_offset needs to be corrected later in TR_Level::read_tr_level.
   */
-void TR_Level::read_tr_moveable(SDL_RWops * const src, tr_moveable_t & moveable)
+void TR_Level::read_tr_moveable(vt_stream_p const src, tr_moveable_t & moveable)
 {
     moveable.object_id = read_bitu32(src);
     moveable.num_meshes = read_bitu16(src);
@@ -565,7 +574,7 @@ void TR_Level::read_tr_moveable(SDL_RWops * const src, tr_moveable_t & moveable)
 }
 
 /// \brief reads an item definition.
-void TR_Level::read_tr_item(SDL_RWops * const src, tr2_item_t & item)
+void TR_Level::read_tr_item(vt_stream_p const src, tr2_item_t & item)
 {
     item.object_id = read_bit16(src);
     item.room = read_bit16(src);
@@ -580,7 +589,7 @@ void TR_Level::read_tr_item(SDL_RWops * const src, tr2_item_t & item)
 }
 
 /// \brief reads a cinematic frame
-void TR_Level::read_tr_cinematic_frame(SDL_RWops * const src, tr_cinematic_frame_t & cf)
+void TR_Level::read_tr_cinematic_frame(vt_stream_p const src, tr_cinematic_frame_t & cf)
 {
     //Camera look at position
     cf.targetx = read_bit16(src);
@@ -595,7 +604,7 @@ void TR_Level::read_tr_cinematic_frame(SDL_RWops * const src, tr_cinematic_frame
 }
 
 /// \brief reads a static mesh definition.
-void TR_Level::read_tr_staticmesh(SDL_RWops * const src, tr_staticmesh_t & mesh)
+void TR_Level::read_tr_staticmesh(vt_stream_p const src, tr_staticmesh_t & mesh)
 {
     mesh.object_id = read_bitu32(src);
     mesh.mesh = read_bitu16(src);
@@ -617,7 +626,7 @@ void TR_Level::read_tr_staticmesh(SDL_RWops * const src, tr_staticmesh_t & mesh)
     mesh.flags = read_bitu16(src);
 }
 
-void TR_Level::read_tr_level(SDL_RWops * const src, bool demo_or_ub)
+void TR_Level::read_tr_level(vt_stream_p const src, bool demo_or_ub)
 {
     uint32_t i;
 
@@ -26,7 +26,7 @@
 
 #define RCSID "$Id: l_tr2.cpp,v 1.15 2002/09/20 15:59:02 crow Exp $"
 
-void TR_Level::read_tr2_colour4(SDL_RWops * const src, tr2_colour_t & colour)
+void TR_Level::read_tr2_colour4(vt_stream_p const src, tr2_colour_t & colour)
 {
     // read 6 bit color and change to 8 bit
     colour.r = read_bitu8(src) << 2;
@@ -35,24 +35,23 @@ void TR_Level::read_tr2_colour4(SDL_RWops * const src, tr2_colour_t & colour)
     colour.a = read_bitu8(src) << 2;
 }
 
-void TR_Level::read_tr2_palette16(SDL_RWops * const src, tr2_palette_t & palette)
+void TR_Level::read_tr2_palette16(vt_stream_p const src, tr2_palette_t & palette)
 {
     for (int i = 0; i < 256; i++)
         read_tr2_colour4(src, palette.colour[i]);
 }
 
-void TR_Level::read_tr2_textile16(SDL_RWops * const src, tr2_textile16_t & textile)
+void TR_Level::read_tr2_textile16(vt_stream_p const src, tr2_textile16_t & textile)
 {
-    for (int i = 0; i < 256; i++) {
-        if (SDL_RWread(src, textile.pixels[i], 2, 256) < 256)
-            Sys_extError("read_tr2_textile16");
-
+    read_raw(src, textile.pixels, sizeof(textile.pixels));
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+    for (int i = 0; i < 256; i++)
         for (int j = 0; j < 256; j++)
             textile.pixels[i][j] = SDL_SwapLE16(textile.pixels[i][j]);
-    }
+#endif
 }
 
-void TR_Level::read_tr2_box(SDL_RWops * const src, tr_box_t & box)
+void TR_Level::read_tr2_box(vt_stream_p const src, tr_box_t & box)
 {
     box.zmax =-1024 * read_bitu8(src);
     box.zmin =-1024 * read_bitu8(src);
@@ -62,7 +61,7 @@ void TR_Level::read_tr2_box(SDL_RWops * const src, tr_box_t & box)
     box.overlap_index = read_bitu16(src);
 }
 
-void TR_Level::read_tr2_zone(SDL_RWops * const src, tr2_zone_t & zone)
+void TR_Level::read_tr2_zone(vt_stream_p const src, tr2_zone_t & zone)
 {
     zone.GroundZone1_Normal = read_bit16(src);
     zone.GroundZone2_Normal = read_bit16(src);
@@ -76,7 +75,7 @@ void TR_Level::read_tr2_zone(SDL_RWops * const src, tr2_zone_t & zone)
     zone.FlyZone_Alternate = read_bit16(src);
 }
 
-void TR_Level::read_tr2_room_light(SDL_RWops * const src, tr5_room_light_t & light)
+void TR_Level::read_tr2_room_light(vt_stream_p const src, tr5_room_light_t & light)
 {
     read_tr_vertex32(src, light.pos);
     light.intensity1 = read_bitu16(src);
@@ -101,7 +100,7 @@ void TR_Level::read_tr2_room_light(SDL_RWops * const src, tr5_room_light_t & lig
     light.color.b = 0xff;
 }
 
-void TR_Level::read_tr2_room_vertex(SDL_RWops * const src, tr5_room_vertex_t & room_vertex)
+void TR_Level::read_tr2_room_vertex(vt_stream_p const src, tr5_room_vertex_t & room_vertex)
 {
     read_tr_vertex16(src, room_vertex.vertex);
     // read and make consistent
@@ -118,7 +117,7 @@ void TR_Level::read_tr2_room_vertex(SDL_RWops * const src, tr5_room_vertex_t & r
     room_vertex.colour.a = 1.0f;
 }
 
-void TR_Level::read_tr2_room_staticmesh(SDL_RWops * const src, tr2_room_staticmesh_t & room_static_mesh)
+void TR_Level::read_tr2_room_staticmesh(vt_stream_p const src, tr2_room_staticmesh_t & room_static_mesh)
 {
     read_tr_vertex32(src, room_static_mesh.pos);
     room_static_mesh.rotation = (float)read_bitu16(src) / 16384.0f * -90;
@@ -135,7 +134,7 @@ void TR_Level::read_tr2_room_staticmesh(SDL_RWops * const src, tr2_room_staticme
     room_static_mesh.tint.a = 1.0f;
 }
 
-void TR_Level::read_tr2_room(SDL_RWops * const src, tr5_room_t & room)
+void TR_Level::read_tr2_room(vt_stream_p const src, tr5_room_t & room)
 {
     uint32_t num_data_words;
     uint32_t i;
@@ -150,7 +149,7 @@ void TR_Level::read_tr2_room(SDL_RWops * const src, tr5_room_t & room)
 
     num_data_words = read_bitu32(src);
 
-    pos = SDL_RWseek(src, 0, RW_SEEK_CUR);
+    pos = src->pos;
 
     room.num_layers = 0;
 
@@ -175,7 +174,7 @@ void TR_Level::read_tr2_room(SDL_RWops * const src, tr5_room_t & room)
         read_tr_room_sprite(src, room.sprites[i]);
 
     // set to the right position in case that there is some unused data
-    SDL_RWseek(src, pos + (num_data_words * 2), RW_SEEK_SET);
+    stream_seek(src, pos + (num_data_words * 2));
 
     room.num_portals = read_bitu16(src);
     room.portals = (tr_room_portal_t*)malloc(room.num_portals * sizeof(tr_room_portal_t));
@@ -185,8 +184,7 @@ void TR_Level::read_tr2_room(SDL_RWops * const src, tr5_room_t & room)
     room.num_zsectors = read_bitu16(src);
     room.num_xsectors = read_bitu16(src);
     room.sector_list = (tr_room_sector_t*)malloc(room.num_zsectors * room.num_xsectors * sizeof(tr_room_sector_t));
-    for (i = 0; i < (uint32_t)(room.num_zsectors * room.num_xsectors); i++)
-        read_tr_room_sector(src, room.sector_list[i]);
+    read_tr_room_sectors(src, room.sector_list, (uint32_t)(room.num_zsectors * room.num_xsectors));
 
     // read and make consistent
     room.intensity1 = (8191 - read_bit16(src)) << 2;
@@ -223,7 +221,7 @@ void TR_Level::read_tr2_room(SDL_RWops * const src, tr5_room_t & room)
     room.light_colour.a = 1.0f;
 }
 
-void TR_Level::read_tr2_item(SDL_RWops * const src, tr2_item_t & item)
+void TR_Level::read_tr2_item(vt_stream_p const src, tr2_item_t & item)
 {
     item.object_id = read_bit16(src);
     item.room = read_bit16(src);
@@ -239,7 +237,7 @@ void TR_Level::read_tr2_item(SDL_RWops * const src, tr2_item_t & item)
     item.flags = read_bitu16(src);
 }
 
-void TR_Level::read_tr2_level(SDL_RWops * const src, bool demo)
+void TR_Level::read_tr2_level(vt_stream_p const src, bool demo)
 {
     uint32_t i;
 
@@ -449,10 +447,13 @@ void TR_Level::read_tr2_level(SDL_RWops * const src, bool demo)
         this->samples_data_size = SDL_RWsize(newsrc);
         this->samples_count = 0;
         this->samples_data = (uint8_t*)malloc(this->samples_data_size * sizeof(uint8_t));
-        for(i = 0; i < this->samples_data_size; i++)
+        if(SDL_RWread(newsrc, this->samples_data, 1, this->samples_data_size) < this->samples_data_size)
+        {
+            Sys_extError("read_tr_level: samples: SDL_RWread(\"%s\")", this->sfx_path);
+        }
+        for(i = 4; i < this->samples_data_size; i++)
         {
-            this->samples_data[i] = read_bitu8(newsrc);
-            if((i >= 4) && (*((uint32_t*)(this->samples_data+i-4)) == 0x46464952))   /// RIFF
+            if(*((uint32_t*)(this->samples_data+i-4)) == 0x46464952)   /// RIFF
             {
                 this->samples_count++;
             }
@@ -25,7 +25,7 @@
 
 #define RCSID "$Id: l_tr3.cpp,v 1.15 2002/09/20 15:59:02 crow Exp $"
 
-void TR_Level::read_tr3_room_light(SDL_RWops * const src, tr5_room_light_t & light)
+void TR_Level::read_tr3_room_light(vt_stream_p const src, tr5_room_light_t & light)
 {
     read_tr_vertex32(src, light.pos);
     light.color.r = read_bitu8(src);
@@ -49,7 +49,7 @@ void TR_Level::read_tr3_room_light(SDL_RWops * const src, tr5_room_light_t & lig
     light.light_type = 0x01; // Point light
 }
 
-void TR_Level::read_tr3_room_vertex(SDL_RWops *const src, tr5_room_vertex_t & room_vertex)
+void TR_Level::read_tr3_room_vertex(vt_stream_p const src, tr5_room_vertex_t & room_vertex)
 {
     read_tr_vertex16(src, room_vertex.vertex);
     // read and make consistent
@@ -67,7 +67,7 @@ void TR_Level::read_tr3_room_vertex(SDL_RWops *const src, tr5_room_vertex_t & ro
     room_vertex.colour.a = 1.0f;
 }
 
-void TR_Level::read_tr3_room_staticmesh(SDL_RWops *const src, tr2_room_staticmesh_t & room_static_mesh)
+void TR_Level::read_tr3_room_staticmesh(vt_stream_p const src, tr2_room_staticmesh_t & room_static_mesh)
 {
     read_tr_vertex32(src, room_static_mesh.pos);
     room_static_mesh.rotation = (float)read_bitu16(src) / 16384.0f * -90;
@@ -83,7 +83,7 @@ void TR_Level::read_tr3_room_staticmesh(SDL_RWops *const src, tr2_room_staticmes
     room_static_mesh.tint.a = 1.0f;
 }
 
-void TR_Level::read_tr3_room(SDL_RWops * const src, tr5_room_t & room)
+void TR_Level::read_tr3_room(vt_stream_p const src, tr5_room_t & room)
 {
     uint32_t num_data_words;
     uint32_t i;
@@ -98,7 +98,7 @@ void TR_Level::read_tr3_room(SDL_RWops * const src, tr5_room_t & room)
 
     num_data_words = read_bitu32(src);
 
-    pos = SDL_RWseek(src, 0, RW_SEEK_CUR);
+    pos = src->pos;
 
     room.num_layers = 0;
 
@@ -123,7 +123,7 @@ void TR_Level::read_tr3_room(SDL_RWops * const src, tr5_room_t & room)
         read_tr_room_sprite(src, room.sprites[i]);
 
     // set to the right position in case that there is some unused data
-    SDL_RWseek(src, pos + (num_data_words * 2), RW_SEEK_SET);
+    stream_seek(src, pos + (num_data_words * 2));
 
     room.num_portals = read_bitu16(src);
     room.portals = (tr_room_portal_t*)malloc(room.num_portals * sizeof(tr_room_portal_t));
@@ -133,8 +133,7 @@ void TR_Level::read_tr3_room(SDL_RWops * const src, tr5_room_t & room)
     room.num_zsectors = read_bitu16(src);
     room.num_xsectors = read_bitu16(src);
     room.sector_list = (tr_room_sector_t*)malloc(room.num_zsectors * room.num_xsectors * sizeof(tr_room_sector_t));
-    for (i = 0; i < (uint32_t)(room.num_zsectors * room.num_xsectors); i++)
-        read_tr_room_sector(src, room.sector_list[i]);
+    read_tr_room_sectors(src, room.sector_list, (uint32_t)(room.num_zsectors * room.num_xsectors));
 
     room.intensity1 = read_bit16(src);
     room.intensity2 = read_bit16(src);
@@ -168,7 +167,7 @@ void TR_Level::read_tr3_room(SDL_RWops * const src, tr5_room_t & room)
     room.water_scheme = read_bitu8(src);
     room.reverb_info = read_bitu8(src);
 
-    SDL_RWseek(src, 1, SEEK_CUR);   // Alternate_group override?
+    stream_skip(src, 1);            // Alternate_group override?
 
     room.light_colour.r = room.intensity1 / 65534.0f;
     room.light_colour.g = room.intensity1 / 65534.0f;
@@ -176,7 +175,7 @@ void TR_Level::read_tr3_room(SDL_RWops * const src, tr5_room_t & room)
     room.light_colour.a = 1.0f;
 }
 
-void TR_Level::read_tr3_item(SDL_RWops *const src, tr2_item_t & item)
+void TR_Level::read_tr3_item(vt_stream_p const src, tr2_item_t & item)
 {
     item.object_id = read_bit16(src);
     item.room = read_bit16(src);
@@ -188,7 +187,7 @@ void TR_Level::read_tr3_item(SDL_RWops *const src, tr2_item_t & item)
     item.flags = read_bitu16(src);
 }
 
-void TR_Level::read_tr3_level(SDL_RWops *const src)
+void TR_Level::read_tr3_level(vt_stream_p const src)
 {
     uint32_t i;
 
@@ -398,10 +397,13 @@ void TR_Level::read_tr3_level(SDL_RWops *const src)
         this->samples_data_size = SDL_RWsize(newsrc);
         this->samples_count = 0;
         this->samples_data = (uint8_t*)malloc(this->samples_data_size * sizeof(uint8_t));
-        for(i = 0; i < this->samples_data_size; i++)
+        if(SDL_RWread(newsrc, this->samples_data, 1, this->samples_data_size) < this->samples_data_size)
         {
-            this->samples_data[i] = read_bitu8(newsrc);
-            if((i >= 4) && (*((uint32_t*)(this->samples_data+i-4)) == 0x46464952))   /// RIFF
+            Sys_extError("read_tr_level: samples: SDL_RWread(\"%s\")", this->sfx_path);
+        }
+        for(i = 4; i < this->samples_data_size; i++)
+        {
+            if(*((uint32_t*)(this->samples_data+i-4)) == 0x46464952)   /// RIFF
             {
                 this->samples_count++;
             }
@@ -21,32 +21,30 @@
 
 #include <SDL2/SDL_endian.h>
 
-#include <zlib.h>
 #include "l_main.h"
 #include "tr_versions.h"
 #include "../core/system.h"
 
 #define RCSID "$Id: l_tr4.cpp,v 1.14 2002/09/20 15:59:02 crow Exp $"
 
-void TR_Level::read_tr4_vertex_float(SDL_RWops * const src, tr5_vertex_t & vertex)
+void TR_Level::read_tr4_vertex_float(vt_stream_p const src, tr5_vertex_t & vertex)
 {
     vertex.x = read_float(src);
     vertex.y = -read_float(src);
     vertex.z = -read_float(src);
 }
 
-void TR_Level::read_tr4_textile32(SDL_RWops * const src, tr4_textile32_t & textile)
+void TR_Level::read_tr4_textile32(vt_stream_p const src, tr4_textile32_t & textile)
 {
-    for (int i = 0; i < 256; i++) {
-        if (SDL_RWread(src, textile.pixels[i], 4, 256) < 256)
-            Sys_extError("read_tr4_textile32");
+    read_raw(src, textile.pixels, sizeof(textile.pixels));
 
+    for (int i = 0; i < 256; i++) {
         for (int j = 0; j < 256; j++)
             textile.pixels[i][j] = SDL_SwapLE32((textile.pixels[i][j] & 0xff00ff00) | ((textile.pixels[i][j] & 0x00ff0000) >> 16) | ((textile.pixels[i][j] & 0x000000ff) << 16));
     }
 }
 
-void TR_Level::read_tr4_face3(SDL_RWops * const src, tr4_face3_t & meshface)
+void TR_Level::read_tr4_face3(vt_stream_p const src, tr4_face3_t & meshface)
 {
     meshface.vertices[0] = read_bitu16(src);
     meshface.vertices[1] = read_bitu16(src);
@@ -55,7 +53,7 @@ void TR_Level::read_tr4_face3(SDL_RWops * const src, tr4_face3_t & meshface)
     meshface.lighting = read_bitu16(src);
 }
 
-void TR_Level::read_tr4_face4(SDL_RWops * const src, tr4_face4_t & meshface)
+void TR_Level::read_tr4_face4(vt_stream_p const src, tr4_face4_t & meshface)
 {
     meshface.vertices[0] = read_bitu16(src);
     meshface.vertices[1] = read_bitu16(src);
@@ -65,7 +63,35 @@ void TR_Level::read_tr4_face4(SDL_RWops * const src, tr4_face4_t & meshface)
     meshface.lighting = read_bitu16(src);
 }
 
-void TR_Level::read_tr4_room_light(SDL_RWops * const src, tr5_room_light_t & light)
+/// \brief reads count triangles; file layout matches tr4_face3_t, so it is one copy on little endian hosts.
+void TR_Level::read_tr4_faces3(vt_stream_p const src, tr4_face3_t *faces, int32_t count)
+{
+    static_assert(sizeof(tr4_face3_t) == 10, "tr4_face3_t must match file layout");
+    if (count <= 0)
+        return;
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+    read_raw(src, faces, count * sizeof(tr4_face3_t));
+#else
+    for (int32_t i = 0; i < count; i++)
+        read_tr4_face3(src, faces[i]);
+#endif
+}
+
+/// \brief reads count rectangles; file layout matches tr4_face4_t, so it is one copy on little endian hosts.
+void TR_Level::read_tr4_faces4(vt_stream_p const src, tr4_face4_t *faces, int32_t count)
+{
+    static_assert(sizeof(tr4_face4_t) == 12, "tr4_face4_t must match file layout");
+    if (count <= 0)
+        return;
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+    read_raw(src, faces, count * sizeof(tr4_face4_t));
+#else
+    for (int32_t i = 0; i < count; i++)
+        read_tr4_face4(src, faces[i]);
+#endif
+}
+
+void TR_Level::read_tr4_room_light(vt_stream_p const src, tr5_room_light_t & light)
 {
     read_tr_vertex32(src, light.pos);
     read_tr_colour(src, light.color);
@@ -81,7 +107,7 @@ void TR_Level::read_tr4_room_light(SDL_RWops * const src, tr5_room_light_t & lig
     read_tr4_vertex_float(src, light.dir);
 }
 
-void TR_Level::read_tr4_room_vertex(SDL_RWops * const src, tr5_room_vertex_t & room_vertex)
+void TR_Level::read_tr4_room_vertex(vt_stream_p const src, tr5_room_vertex_t & room_vertex)
 {
     read_tr_vertex16(src, room_vertex.vertex);
     // read and make consistent
@@ -99,7 +125,7 @@ void TR_Level::read_tr4_room_vertex(SDL_RWops * const src, tr5_room_vertex_t & r
     room_vertex.colour.a = 1.0f;
 }
 
-void TR_Level::read_tr4_room_staticmesh(SDL_RWops * const src, tr2_room_staticmesh_t & room_static_mesh)
+void TR_Level::read_tr4_room_staticmesh(vt_stream_p const src, tr2_room_staticmesh_t & room_static_mesh)
 {
     read_tr_vertex32(src, room_static_mesh.pos);
     room_static_mesh.rotation = (float)read_bitu16(src) / 16384.0f * -90;
@@ -115,7 +141,7 @@ void TR_Level::read_tr4_room_staticmesh(SDL_RWops * const src, tr2_room_staticme
     room_static_mesh.tint.a = 1.0f;
 }
 
-void TR_Level::read_tr4_room(SDL_RWops * const src, tr5_room_t & room)
+void TR_Level::read_tr4_room(vt_stream_p const src, tr5_room_t & room)
 {
     uint32_t num_data_words;
     uint32_t i;
@@ -130,7 +156,7 @@ void TR_Level::read_tr4_room(SDL_RWops * const src, tr5_room_t & room)
 
     num_data_words = read_bitu32(src);
 
-    pos = SDL_RWseek(src, 0, SEEK_CUR);
+    pos = src->pos;
 
     room.num_layers = 0;
 
@@ -155,7 +181,7 @@ void TR_Level::read_tr4_room(SDL_RWops * const src, tr5_room_t & room)
         read_tr_room_sprite(src, room.sprites[i]);
 
     // set to the right position in case that there is some unused data
-    SDL_RWseek(src, pos + (num_data_words * 2), SEEK_SET);
+    stream_seek(src, pos + (num_data_words * 2));
 
     room.num_portals = read_bitu16(src);
     room.portals = (tr_room_portal_t*)malloc(room.num_portals * sizeof(tr_room_portal_t));
@@ -165,8 +191,7 @@ void TR_Level::read_tr4_room(SDL_RWops * const src, tr5_room_t & room)
     room.num_zsectors = read_bitu16(src);
     room.num_xsectors = read_bitu16(src);
     room.sector_list = (tr_room_sector_t*)malloc(room.num_zsectors * room.num_xsectors * sizeof(tr_room_sector_t));
-    for (i = 0; i < (uint32_t)(room.num_zsectors * room.num_xsectors); i++)
-        read_tr_room_sector(src, room.sector_list[i]);
+    read_tr_room_sectors(src, room.sector_list, (uint32_t)(room.num_zsectors * room.num_xsectors));
 
     room.light_colour.b = read_bitu8(src) / 255.0f;
     room.light_colour.g = read_bitu8(src) / 255.0f;
@@ -199,7 +224,7 @@ void TR_Level::read_tr4_room(SDL_RWops * const src, tr5_room_t & room)
     room.alternate_group = read_bitu8(src);
 }
 
-void TR_Level::read_tr4_item(SDL_RWops * const src, tr2_item_t & item)
+void TR_Level::read_tr4_item(vt_stream_p const src, tr2_item_t & item)
 {
     item.object_id = read_bit16(src);
     item.room = read_bit16(src);
@@ -211,7 +236,7 @@ void TR_Level::read_tr4_item(SDL_RWops * const src, tr2_item_t & item)
     item.flags = read_bitu16(src);
 }
 
-void TR_Level::read_tr4_object_texture_vert(SDL_RWops * const src, tr4_object_texture_vert_t & vert)
+void TR_Level::read_tr4_object_texture_vert(vt_stream_p const src, tr4_object_texture_vert_t & vert)
 {
     vert.xcoordinate = read_bit8(src);
     vert.xpixel = read_bitu8(src);
@@ -223,7 +248,7 @@ void TR_Level::read_tr4_object_texture_vert(SDL_RWops * const src, tr4_object_te
         vert.ycoordinate = 1;
 }
 
-void TR_Level::read_tr4_object_texture(SDL_RWops * const src, tr4_object_texture_t & object_texture)
+void TR_Level::read_tr4_object_texture(vt_stream_p const src, tr4_object_texture_t & object_texture)
 {
     object_texture.transparency_flags = read_bitu16(src);
     object_texture.tile_and_flag = read_bitu16(src);
@@ -244,7 +269,7 @@ void TR_Level::read_tr4_object_texture(SDL_RWops * const src, tr4_object_texture
  /*
   * tr4 + sprite loading
   */
-void TR_Level::read_tr4_sprite_texture(SDL_RWops * const src, tr_sprite_texture_t & sprite_texture)
+void TR_Level::read_tr4_sprite_texture(vt_stream_p const src, tr_sprite_texture_t & sprite_texture)
 {
     int tx, ty, tw, th, tleft, tright, ttop, tbottom;
 
@@ -272,7 +297,7 @@ void TR_Level::read_tr4_sprite_texture(SDL_RWops * const src, tr_sprite_texture_
     sprite_texture.top_side = ty + th / (256);
 }
 
-void TR_Level::read_tr4_mesh(SDL_RWops * const src, tr4_mesh_t & mesh)
+void TR_Level::read_tr4_mesh(vt_stream_p const src, tr4_mesh_t & mesh)
 {
     int i;
 
@@ -305,20 +330,18 @@ void TR_Level::read_tr4_mesh(SDL_RWops * const src, tr4_mesh_t & mesh)
 
     mesh.num_textured_rectangles = read_bit16(src);
     mesh.textured_rectangles = (tr4_face4_t*)malloc(mesh.num_textured_rectangles * sizeof(tr4_face4_t));
-    for (i = 0; i < mesh.num_textured_rectangles; i++)
-        read_tr4_face4(src, mesh.textured_rectangles[i]);
+    read_tr4_faces4(src, mesh.textured_rectangles, mesh.num_textured_rectangles);
 
     mesh.num_textured_triangles = read_bit16(src);
     mesh.textured_triangles = (tr4_face3_t*)malloc(mesh.num_textured_triangles * sizeof(tr4_face3_t));
-    for (i = 0; i < mesh.num_textured_triangles; i++)
-        read_tr4_face3(src, mesh.textured_triangles[i]);
+    read_tr4_faces3(src, mesh.textured_triangles, mesh.num_textured_triangles);
 
     mesh.num_coloured_rectangles = 0;
     mesh.num_coloured_triangles = 0;
 }
 
 /// \brief reads an animation definition.
-void TR_Level::read_tr4_animation(SDL_RWops * const src, tr_animation_t & animation)
+void TR_Level::read_tr4_animation(vt_stream_p const src, tr_animation_t & animation)
 {
     animation.frame_offset = read_bitu32(src);
     animation.frame_rate = read_bitu8(src);
@@ -341,13 +364,16 @@ void TR_Level::read_tr4_animation(SDL_RWops * const src, tr_animation_t & animat
     animation.anim_command = read_bitu16(src);
 }
 
-void TR_Level::read_tr4_level(SDL_RWops * const _src)
+void TR_Level::read_tr4_level(vt_stream_p const _src)
 {
-    SDL_RWops *src = _src;
+    vt_stream_p src = _src;
     uint32_t i;
-    uint8_t *uncomp_buffer = NULL;
-    uint8_t *comp_buffer = NULL;
-    SDL_RWops *newsrc = NULL;
+    vt_chunk_t textiles32_chunk = {};
+    vt_chunk_t textiles16_chunk = {};
+    vt_chunk_t misc_chunk = {};
+    vt_chunk_t geometry_chunk = {};
+    vt_stream_t newstream;
+    vt_stream_p newsrc = &newstream;
 
     // Version
     uint32_t file_version = read_bitu32(src);
@@ -365,7 +391,6 @@ void TR_Level::read_tr4_level(SDL_RWops * const _src)
     {
         uint32_t uncomp_size;
         uint32_t comp_size;
-        unsigned long size;
 
         this->num_room_textiles = read_bitu16(src);
         this->num_obj_textiles = read_bitu16(src);
@@ -380,34 +405,9 @@ void TR_Level::read_tr4_level(SDL_RWops * const _src)
         comp_size = read_bitu32(src);
         if (comp_size > 0)
         {
-            uncomp_buffer = new uint8_t[uncomp_size];
-
             this->textile32_count = this->num_textiles;
             this->textile32 = (tr4_textile32_t*)malloc(this->textile32_count * sizeof(tr4_textile32_t));
-            comp_buffer = new uint8_t[comp_size];
-
-            if (SDL_RWread(src, comp_buffer, 1, comp_size) < comp_size)
-                Sys_extError("read_tr4_level: textiles32");
-
-            size = uncomp_size;
-            if (uncompress(uncomp_buffer, &size, comp_buffer, comp_size) != Z_OK)
-                Sys_extError("read_tr4_level: uncompress");
-
-            if (size != uncomp_size)
-                Sys_extError("read_tr4_level: uncompress size mismatch");
-            delete [] comp_buffer;
-
-            comp_buffer = NULL;
-            if ((newsrc = SDL_RWFromMem(uncomp_buffer, uncomp_size)) == NULL)
-                Sys_extError("read_tr4_level: SDL_RWFromMem");
-
-            for (i = 0; i < (this->num_textiles - this->num_misc_textiles); i++)
-                read_tr4_textile32(newsrc, this->textile32[i]);
-            SDL_RWclose(newsrc);
-            newsrc = NULL;
-            delete [] uncomp_buffer;
-
-            uncomp_buffer = NULL;
+            read_chunk(src, &textiles32_chunk, uncomp_size, comp_size, true);
             this->read_32bit_textiles = true;
         }
 
@@ -420,53 +420,13 @@ void TR_Level::read_tr4_level(SDL_RWops * const _src)
         {
             if (this->textile32_count == 0)
             {
-                uncomp_buffer = new uint8_t[uncomp_size];
-
                 this->textile16_count = this->num_textiles;
                 this->textile16 = (tr2_textile16_t*)malloc(this->textile16_count * sizeof(tr2_textile16_t));
-                comp_buffer = new uint8_t[comp_size];
-
-                if (SDL_RWread(src, comp_buffer, 1, comp_size) < comp_size)
-                {
-                    delete [] comp_buffer;
-                    delete [] uncomp_buffer;
-                    Sys_extError("read_tr4_level: textiles16");
-                }
-
-                size = uncomp_size;
-                if (uncompress(uncomp_buffer, &size, comp_buffer, comp_size) != Z_OK)
-                {
-                    delete [] comp_buffer;
-                    delete [] uncomp_buffer;
-                    Sys_extError("read_tr4_level: uncompress");
-                }
-
-                delete [] comp_buffer;
-                comp_buffer = NULL;
-
-                if (size != uncomp_size)
-                {
-                    delete [] uncomp_buffer;
-                    Sys_extError("read_tr4_level: uncompress size mismatch");
-                }
-
-                if ((newsrc = SDL_RWFromMem(uncomp_buffer, uncomp_size)) == NULL)
-                {
-                    delete [] uncomp_buffer;
-                    Sys_extError("read_tr4_level: SDL_RWFromMem");
-                }
-
-                for (i = 0; i < (this->num_textiles - this->num_misc_textiles); i++)
-                    read_tr2_textile16(newsrc, this->textile16[i]);
-
-                SDL_RWclose(newsrc);
-                newsrc = NULL;
-                delete [] uncomp_buffer;
-                uncomp_buffer = NULL;
+                read_chunk(src, &textiles16_chunk, uncomp_size, comp_size, true);
             }
             else
             {
-                SDL_RWseek(src, comp_size, SEEK_CUR);
+                stream_skip(src, comp_size);
             }
         }
 
@@ -477,8 +437,6 @@ void TR_Level::read_tr4_level(SDL_RWops * const _src)
         comp_size = read_bitu32(src);
         if (comp_size > 0)
         {
-            uncomp_buffer = new uint8_t[uncomp_size];
-
             if ((uncomp_size / (256 * 256 * 4)) > 2)
                 Sys_extWarn("read_tr4_level: num_misc_textiles > 2");
 
@@ -487,44 +445,7 @@ void TR_Level::read_tr4_level(SDL_RWops * const _src)
                 this->textile32_count = this->num_textiles;
                 this->textile32 = (tr4_textile32_t*)malloc(this->textile32_count * sizeof(tr4_textile32_t));
             }
-            comp_buffer = new uint8_t[comp_size];
-
-            if (SDL_RWread(src, comp_buffer, 1, comp_size) < comp_size)
-            {
-                delete [] uncomp_buffer;
-                delete [] comp_buffer;
-                Sys_extError("read_tr4_level: misc_textiles");
-            }
-
-            size = uncomp_size;
-            if (uncompress(uncomp_buffer, &size, comp_buffer, comp_size) != Z_OK)
-            {
-                delete [] uncomp_buffer;
-                delete [] comp_buffer;
-                Sys_extError("read_tr4_level: uncompress");
-            }
-
-            delete [] comp_buffer;
-            comp_buffer = NULL;
-            if (size != uncomp_size)
-            {
-                delete [] uncomp_buffer;
-                Sys_extError("read_tr4_level: uncompress size mismatch");
-            }
-
-            if ((newsrc = SDL_RWFromMem(uncomp_buffer, uncomp_size)) == NULL)
-            {
-                delete [] uncomp_buffer;
-                Sys_extError("read_tr4_level: SDL_RWFromMem");
-            }
-
-            for (i = (this->num_textiles - this->num_misc_textiles); i < this->num_textiles; i++)
-                read_tr4_textile32(newsrc, this->textile32[i]);
-
-            SDL_RWclose(newsrc);
-            newsrc = NULL;
-            delete [] uncomp_buffer;
-            uncomp_buffer = NULL;
+            read_chunk(src, &misc_chunk, uncomp_size, comp_size, true);
         }
 
         uncomp_size = read_bitu32(src);
@@ -536,37 +457,9 @@ void TR_Level::read_tr4_level(SDL_RWops * const _src)
         if (!comp_size)
             Sys_extError("read_tr4_level: packed geometry");
 
-        uncomp_buffer = new uint8_t[uncomp_size];
-        comp_buffer = new uint8_t[comp_size];
-
-        if (SDL_RWread(src, comp_buffer, 1, comp_size) < comp_size)
-        {
-            delete [] uncomp_buffer;
-            delete [] comp_buffer;
-            Sys_extError("read_tr4_level: packed geometry");
-        }
-
-        size = uncomp_size;
-        if (uncompress(uncomp_buffer, &size, comp_buffer, comp_size) != Z_OK)
-        {
-            delete [] uncomp_buffer;
-            delete [] comp_buffer;
-            Sys_extError("read_tr4_level: uncompress");
-        }
-
-        delete [] comp_buffer;
-        comp_buffer = NULL;
-        if (size != uncomp_size)
-        {
-            delete [] uncomp_buffer;
-            Sys_extError("read_tr4_level: uncompress size mismatch");
-        }
-
-        if ((newsrc = SDL_RWFromMem(uncomp_buffer, uncomp_size)) == NULL)
-        {
-            delete [] uncomp_buffer;
-            Sys_extError("read_tr4_level: SDL_RWFromMem");
-        }
+        // geometry is inflated here and parsed while textiles are still inflated by workers
+        read_chunk(src, &geometry_chunk, uncomp_size, comp_size, false);
+        wait_chunk(&geometry_chunk, newsrc, "read_tr4_level: packed geometry");
     }
 
     // Unused
@@ -788,10 +681,29 @@ void TR_Level::read_tr4_level(SDL_RWops * const _src)
         this->sample_indices = NULL;
     }
 
-    SDL_RWclose(newsrc);
+    free_chunk(&geometry_chunk);
+
+    if (wait_chunk(&textiles32_chunk, newsrc, "read_tr4_level: textiles32"))
+    {
+        for (i = 0; i < (this->num_textiles - this->num_misc_textiles); i++)
+            read_tr4_textile32(newsrc, this->textile32[i]);
+    }
+    free_chunk(&textiles32_chunk);
+
+    if (wait_chunk(&textiles16_chunk, newsrc, "read_tr4_level: textiles16"))
+    {
+        for (i = 0; i < (this->num_textiles - this->num_misc_textiles); i++)
+            read_tr2_textile16(newsrc, this->textile16[i]);
+    }
+    free_chunk(&textiles16_chunk);
+
+    if (wait_chunk(&misc_chunk, newsrc, "read_tr4_level: misc_textiles"))
+    {
+        for (i = (this->num_textiles - this->num_misc_textiles); i < this->num_textiles; i++)
+            read_tr4_textile32(newsrc, this->textile32[i]);
+    }
+    free_chunk(&misc_chunk);
     newsrc = NULL;
-    delete [] uncomp_buffer;
-    uncomp_buffer = NULL;
 
     // LOAD SAMPLES
 
@@ -800,7 +712,7 @@ void TR_Level::read_tr4_level(SDL_RWops * const _src)
     {
         // Since sample data is the last part, we simply load whole last
         // block of file as single array.
-        this->samples_data_size = (uint32_t) (SDL_RWsize(src) - SDL_RWtell(src));
+        this->samples_data_size = (uint32_t)(src->size - src->pos);
         this->samples_data = (uint8_t*)malloc(this->samples_data_size * sizeof(uint8_t));
         for(i = 0; i < this->samples_data_size; i++)
             this->samples_data[i] = read_bitu8(src);
@@ -20,13 +20,12 @@
  */
 
 #include <SDL2/SDL.h>
-#include <zlib.h>
 #include "l_main.h"
 #include "../core/system.h"
 
 #define RCSID "$Id: l_tr5.cpp,v 1.14 2002/09/20 15:59:02 crow Exp $"
 
-void TR_Level::read_tr5_room_light(SDL_RWops * const src, tr5_room_light_t & light)
+void TR_Level::read_tr5_room_light(vt_stream_p const src, tr5_room_light_t & light)
 {
     uint32_t temp;
 
@@ -63,7 +62,7 @@ void TR_Level::read_tr5_room_light(SDL_RWops * const src, tr5_room_light_t & lig
         Sys_extWarn("read_tr5_room_light: seperator4 has wrong value");
 }
 
-void TR_Level::read_tr5_room_layer(SDL_RWops * const src, tr5_room_layer_t & layer)
+void TR_Level::read_tr5_room_layer(vt_stream_p const src, tr5_room_layer_t & layer)
 {
     layer.num_vertices = read_bitu16(src);
     layer.unknown_l1 = read_bitu16(src);
@@ -100,7 +99,7 @@ void TR_Level::read_tr5_room_layer(SDL_RWops * const src, tr5_room_layer_t & lay
     layer.unknown_l8b = read_bit16(src);
 }
 
-void TR_Level::read_tr5_room_vertex(SDL_RWops * const src, tr5_room_vertex_t & vert)
+void TR_Level::read_tr5_room_vertex(vt_stream_p const src, tr5_room_vertex_t & vert)
 {
     read_tr4_vertex_float(src, vert.vertex);
     read_tr4_vertex_float(src, vert.normal);
@@ -110,7 +109,7 @@ void TR_Level::read_tr5_room_vertex(SDL_RWops * const src, tr5_room_vertex_t & v
     vert.colour.a = read_bitu8(src) / 255.0f;
 }
 
-void TR_Level::read_tr5_room(SDL_RWops * const src, tr5_room_t & room)
+void TR_Level::read_tr5_room(vt_stream_p const src, tr5_room_t & room)
 {
     uint32_t room_data_size;
     //uint32_t portal_offset;
@@ -123,25 +122,16 @@ void TR_Level::read_tr5_room(SDL_RWops * const src, tr5_room_t & room)
     uint32_t vertices_size;
     //uint32_t light_size;
 
-    SDL_RWops *newsrc = NULL;
+    vt_stream_t room_src;
+    vt_stream_p newsrc = &room_src;
     uint32_t temp;
     uint32_t i;
-    uint8_t *buffer;
 
     if (read_bitu32(src) != 0x414C4558)
         Sys_extError("read_tr5_room: 'XELA' not found");
 
     room_data_size = read_bitu32(src);
-    buffer = new uint8_t[room_data_size];
-
-    if (SDL_RWread(src, buffer, 1, room_data_size) < room_data_size)
-        Sys_extError("read_tr5_room: room_data");
-
-    if ((newsrc = SDL_RWFromMem(buffer, room_data_size)) == NULL)
-    {
-        delete [] buffer;
-        Sys_extError("read_tr5_room: SDL_RWFromMem");
-    }
+    stream_sub(src, room_data_size, newsrc);
 
     room.intensity1 = 32767;
     room.intensity2 = 32767;
@@ -257,8 +247,6 @@ void TR_Level::read_tr5_room(SDL_RWops * const src, tr5_room_t & room)
     /*light_size = */read_bitu32(newsrc);
     if (read_bitu32(newsrc) != room.num_lights)
     {
-        SDL_RWclose(newsrc);
-        delete [] buffer;
         Sys_extError("read_tr5_room: room.num_lights2 != room.num_lights");
     }
 
@@ -288,16 +276,12 @@ void TR_Level::read_tr5_room(SDL_RWops * const src, tr5_room_t & room)
     poly_offset2 = read_bitu32(newsrc);
     if (poly_offset != poly_offset2)
     {
-        SDL_RWclose(newsrc);
-        delete [] buffer;
         Sys_extError("read_tr5_room: poly_offset != poly_offset2");
     }
 
     vertices_size = read_bitu32(newsrc);
     if ((vertices_size % 28) != 0)
     {
-        SDL_RWclose(newsrc);
-        delete [] buffer;
         Sys_extError("read_tr5_room: vertices_size has wrong value");
     }
 
@@ -317,18 +301,17 @@ void TR_Level::read_tr5_room(SDL_RWops * const src, tr5_room_t & room)
     for (i = 0; i < room.num_lights; i++)
         read_tr5_room_light(newsrc, room.lights[i]);
 
-    SDL_RWseek(newsrc, 208 + sector_data_offset, SEEK_SET);
+    stream_seek(newsrc, 208 + sector_data_offset);
 
     room.sector_list = (tr_room_sector_t*)malloc(room.num_zsectors * room.num_xsectors * sizeof(tr_room_sector_t));
-    for (i = 0; i < (uint32_t)(room.num_zsectors * room.num_xsectors); i++)
-        read_tr_room_sector(newsrc, room.sector_list[i]);
+    read_tr_room_sectors(newsrc, room.sector_list, (uint32_t)(room.num_zsectors * room.num_xsectors));
 
     /*
         if (room.portal_offset != 0xFFFFFFFF)
         {
             if (room.portal_offset != (room.sector_data_offset + (room.num_zsectors * room.num_xsectors * 8)))
             throw TR_ReadError("read_tr5_room: portal_offset has wrong value");
-            SDL_RWseek(newsrc, 208 + room.portal_offset, SEEK_SET);
+            stream_seek(newsrc, 208 + room.portal_offset);
         }
      */
 
@@ -337,19 +320,19 @@ void TR_Level::read_tr5_room(SDL_RWops * const src, tr5_room_t & room)
     for (i = 0; i < room.num_portals; i++)
         read_tr_room_portal(newsrc, room.portals[i]);
 
-    SDL_RWseek(newsrc, 208 + static_meshes_offset, SEEK_SET);
+    stream_seek(newsrc, 208 + static_meshes_offset);
 
     room.static_meshes = (tr2_room_staticmesh_t*)malloc(room.num_static_meshes * sizeof(tr2_room_staticmesh_t));
     for (i = 0; i < room.num_static_meshes; i++)
         read_tr4_room_staticmesh(newsrc, room.static_meshes[i]);
 
-    SDL_RWseek(newsrc, 208 + layer_offset, SEEK_SET);
+    stream_seek(newsrc, 208 + layer_offset);
 
     room.layers = (tr5_room_layer_t*)malloc(room.num_layers * sizeof(tr5_room_layer_t));
     for (i = 0; i < room.num_layers; i++)
         read_tr5_room_layer(newsrc, room.layers[i]);
 
-    SDL_RWseek(newsrc, 208 + poly_offset, SEEK_SET);
+    stream_seek(newsrc, 208 + poly_offset);
 
     {
         uint32_t vertex_index = 0;
@@ -380,7 +363,7 @@ void TR_Level::read_tr5_room(SDL_RWops * const src, tr5_room_t & room)
         }
     }
 
-    SDL_RWseek(newsrc, 208 + vertices_offset, SEEK_SET);
+    stream_seek(newsrc, 208 + vertices_offset);
 
     {
         uint32_t vertex_index = 0;
@@ -395,26 +378,22 @@ void TR_Level::read_tr5_room(SDL_RWops * const src, tr5_room_t & room)
         }
     }
 
-    SDL_RWseek(newsrc, room_data_size, SEEK_SET);
-
-    SDL_RWclose(newsrc);
-    newsrc = NULL;
-    delete [] buffer;
 }
 
-void TR_Level::read_tr5_moveable(SDL_RWops * const src, tr_moveable_t & moveable)
+void TR_Level::read_tr5_moveable(vt_stream_p const src, tr_moveable_t & moveable)
 {
     read_tr_moveable(src, moveable);
     if (read_bitu16(src) != 0xFFEF)
         Sys_extWarn("read_tr5_moveable: filler has wrong value");
 }
 
-void TR_Level::read_tr5_level(SDL_RWops * const src)
+void TR_Level::read_tr5_level(vt_stream_p const src)
 {
     uint32_t i;
-    uint8_t *comp_buffer = NULL;
-    uint8_t *uncomp_buffer = NULL;
-    SDL_RWops *newsrc = NULL;
+    vt_chunk_t textiles32_chunk = {};
+    vt_chunk_t textiles16_chunk = {};
+    vt_chunk_t misc_chunk = {};
+    vt_stream_t newstream;
 
     // Version
     uint32_t file_version = read_bitu32(src);
@@ -431,7 +410,6 @@ void TR_Level::read_tr5_level(SDL_RWops * const src)
 
     uint32_t uncomp_size;
     uint32_t comp_size;
-    unsigned long size;
 
     this->num_room_textiles = read_bitu16(src);
     this->num_obj_textiles = read_bitu16(src);
@@ -446,47 +424,9 @@ void TR_Level::read_tr5_level(SDL_RWops * const src)
     comp_size = read_bitu32(src);
     if (comp_size > 0)
     {
-        comp_buffer = new uint8_t[comp_size];
         this->textile32_count = this->num_textiles;
         this->textile32 = (tr4_textile32_t*)malloc(this->textile32_count * sizeof(tr4_textile32_t));
-
-        if (SDL_RWread(src, comp_buffer, 1, comp_size) < comp_size)
-        {
-            delete [] comp_buffer;
-            Sys_extError("read_tr5_level: textiles32");
-        }
-
-        uncomp_buffer = new uint8_t[uncomp_size];
-        size = uncomp_size;
-        if (uncompress(uncomp_buffer, &size, comp_buffer, comp_size) != Z_OK)
-        {
-            delete [] comp_buffer;
-            delete [] uncomp_buffer;
-            Sys_extError("read_tr5_level: uncompress");
-        }
-
-        delete [] comp_buffer;
-        comp_buffer = NULL;
-        if (size != uncomp_size)
-        {
-            delete [] uncomp_buffer;
-            Sys_extError("read_tr5_level: uncompress size mismatch");
-        }
-
-        if ((newsrc = SDL_RWFromMem(uncomp_buffer, uncomp_size)) == NULL)
-        {
-            delete [] uncomp_buffer;
-            Sys_extError("read_tr5_level: SDL_RWFromMem");
-        }
-
-        for (i = 0; i < (this->num_textiles - this->num_misc_textiles); i++)
-            read_tr4_textile32(newsrc, this->textile32[i]);
-
-        SDL_RWclose(newsrc);
-        newsrc = NULL;
-        delete [] uncomp_buffer;
-        uncomp_buffer = NULL;
-
+        read_chunk(src, &textiles32_chunk, uncomp_size, comp_size, true);
         this->read_32bit_textiles = true;
     }
 
@@ -499,50 +439,13 @@ void TR_Level::read_tr5_level(SDL_RWops * const src)
     {
         if (this->textile32_count == 0)
         {
-            comp_buffer = new uint8_t[comp_size];
             this->textile16_count = this->num_textiles;
             this->textile16 = (tr2_textile16_t*)malloc(this->textile16_count * sizeof(tr2_textile16_t));
-
-            if (SDL_RWread(src, comp_buffer, 1, comp_size) < comp_size)
-            {
-                delete [] comp_buffer;
-                Sys_extError("read_tr5_level: textiles16");
-            }
-
-            uncomp_buffer = new uint8_t[uncomp_size];
-            size = uncomp_size;
-            if (uncompress(uncomp_buffer, &size, comp_buffer, comp_size) != Z_OK)
-            {
-                delete [] comp_buffer;
-                delete [] uncomp_buffer;
-                Sys_extError("read_tr5_level: uncompress");
-            }
-            delete [] comp_buffer;
-            comp_buffer = NULL;
-
-            if (size != uncomp_size)
-            {
-                delete [] uncomp_buffer;
-                Sys_extError("read_tr5_level: uncompress size mismatch");
-            }
-
-            if ((newsrc = SDL_RWFromMem(uncomp_buffer, uncomp_size)) == NULL)
-            {
-                delete [] uncomp_buffer;
-                Sys_extError("read_tr5_level: SDL_RWFromMem");
-            }
-
-            for (i = 0; i < (this->num_textiles - this->num_misc_textiles); i++)
-                read_tr2_textile16(newsrc, this->textile16[i]);
-
-            SDL_RWclose(newsrc);
-            newsrc = NULL;
-            delete [] uncomp_buffer;
-            uncomp_buffer = NULL;
+            read_chunk(src, &textiles16_chunk, uncomp_size, comp_size, true);
         }
         else
         {
-            SDL_RWseek(src, comp_size, SEEK_CUR);
+            stream_skip(src, comp_size);
         }
     }
 
@@ -561,44 +464,7 @@ void TR_Level::read_tr5_level(SDL_RWops * const src)
             this->textile32_count = this->num_misc_textiles;
             this->textile32 = (tr4_textile32_t*)malloc(this->textile32_count * sizeof(tr4_textile32_t));
         }
-
-        comp_buffer = new uint8_t[comp_size];
-        if (SDL_RWread(src, comp_buffer, 1, comp_size) < comp_size)
-        {
-            delete [] comp_buffer;
-            Sys_extError("read_tr5_level: misc_textiles");
-        }
-
-        uncomp_buffer = new uint8_t[uncomp_size];
-        size = uncomp_size;
-        if (uncompress(uncomp_buffer, &size, comp_buffer, comp_size) != Z_OK)
-        {
-            delete [] uncomp_buffer;
-            delete [] comp_buffer;
-            Sys_extError("read_tr5_level: uncompress");
-        }
-        delete [] comp_buffer;
-        comp_buffer = NULL;
-
-        if (size != uncomp_size)
-        {
-            delete [] uncomp_buffer;
-            Sys_extError("read_tr5_level: uncompress size mismatch");
-        }
-
-        if ((newsrc = SDL_RWFromMem(uncomp_buffer, uncomp_size)) == NULL)
-        {
-            delete [] uncomp_buffer;
-            Sys_extError("read_tr5_level: SDL_RWFromMem");
-        }
-
-        for (i = (this->num_textiles - this->num_misc_textiles); i < this->num_textiles; i++)
-            read_tr4_textile32(newsrc, this->textile32[i]);
-
-        SDL_RWclose(newsrc);
-        newsrc = NULL;
-        delete [] uncomp_buffer;
-        uncomp_buffer = NULL;
+        read_chunk(src, &misc_chunk, uncomp_size, comp_size, true);
     }
 
     // flags?
@@ -856,7 +722,7 @@ void TR_Level::read_tr5_level(SDL_RWops * const src)
     for(i=0; i < this->sample_indices_count; i++)
         this->sample_indices[i] = read_bitu32(src);
 
-    SDL_RWseek(src, 6, SEEK_CUR);   // In TR5, sample indices are followed by 6 0xCD bytes. - correct - really 0xCDCDCDCDCDCD
+    stream_skip(src, 6);   // In TR5, sample indices are followed by 6 0xCD bytes. - correct - really 0xCDCDCDCDCDCD
 
     // LOAD SAMPLES
     this->samples_count = read_bitu32(src);                                                       // Read num samples
@@ -864,9 +730,31 @@ void TR_Level::read_tr5_level(SDL_RWops * const src)
     {
         // Since sample data is the last part, we simply load whole last
         // block of file as single array.
-        this->samples_data_size = SDL_RWsize(src) - SDL_RWtell(src);
+        this->samples_data_size = src->size - src->pos;
         this->samples_data = (uint8_t*)malloc(this->samples_data_size * sizeof(uint8_t));
         for(i = 0; i < this->samples_data_size; i++)
             this->samples_data[i] = read_bitu8(src);
     }
+
+    // the rest of the level is not packed, so textiles are taken last
+    if (wait_chunk(&textiles32_chunk, &newstream, "read_tr5_level: textiles32"))
+    {
+        for (i = 0; i < (this->num_textiles - this->num_misc_textiles); i++)
+            read_tr4_textile32(&newstream, this->textile32[i]);
+    }
+    free_chunk(&textiles32_chunk);
+
+    if (wait_chunk(&textiles16_chunk, &newstream, "read_tr5_level: textiles16"))
+    {
+        for (i = 0; i < (this->num_textiles - this->num_misc_textiles); i++)
+            read_tr2_textile16(&newstream, this->textile16[i]);
+    }
+    free_chunk(&textiles16_chunk);
+
+    if (wait_chunk(&misc_chunk, &newstream, "read_tr5_level: misc_textiles"))
+    {
+        for (i = (this->num_textiles - this->num_misc_textiles); i < this->num_textiles; i++)
+            read_tr4_textile32(&newstream, this->textile32[i]);
+    }
+    free_chunk(&misc_chunk);
 }
@@ -37,10 +37,36 @@ extern "C" {
 #include "engine.h"
 #include "gameflow.h"
 #include "resource.h"
+#include "level_cache.h"
 #include "inventory.h"
 #include "trigger.h"
 
 
+/*
+ * Dynamic tweens of a real room depend on its content and on the contents of
+ * the rooms behind its sectors portals only, so the generated bodies are kept
+ * with these contents as a key: a flip back just swaps bodies in broadphase
+ * and rooms with unchanged key are not rebuilt.
+ */
+#define WORLD_FLIP_TWEEN_STATES     (4)
+
+typedef struct flip_tween_state_s
+{
+    struct room_content_s     **key;                                            // room content, then portal rooms contents
+    struct physics_object_s    *body;                                           // NULL if there are no dynamic tweens
+    struct flip_tween_state_s  *next;
+}flip_tween_state_t, *flip_tween_state_p;
+
+typedef struct flip_tweens_s
+{
+    uint32_t                    is_ready;
+    uint32_t                    portal_rooms_count;                             // distinct portal rooms of the original content
+    struct room_s             **portal_rooms;
+    uint32_t                    states_count;                                   // states of the real room, most recent first
+    struct flip_tween_state_s  *states;
+}flip_tweens_t, *flip_tweens_p;
+
+
  struct world_s
 {
     char                           *name;
@@ -60,6 +86,7 @@ extern "C" {
     uint8_t                        *flip_map;               // Flipped room activity array.
     uint8_t                        *flip_state;             // Flipped room state array.
     uint16_t                        global_flip_state;
+    struct flip_tweens_s           *flip_tweens;            // Dynamic tweens cache, per room.
 
     bordered_texture_atlas         *tex_atlas;
     uint32_t                        tex_count;              // Number of textures
@@ -125,6 +152,7 @@ void World_GenRoomCollision();
 void World_FixRooms();
 void World_BuildNearRoomsList(struct room_s *room);
 void World_BuildOverlappedRoomsList(struct room_s *room);
+void World_ClearFlipTweens();
 
 extern "C" void AVL_DeleteEntity(void *p) { Entity_Delete((entity_p)p); }
 extern "C" void AVL_DeleteItem(void *p) { BaseItem_Delete((base_item_p)p); }
@@ -145,6 +173,7 @@ void World_Prepare()
     global_world.flip_state = NULL;
     global_world.flip_count = 0;
     global_world.global_flip_state = 0;
+    global_world.flip_tweens = NULL;
     global_world.textures = NULL;
     global_world.type = 0;
     global_world.player = NULL;
@@ -175,93 +204,260 @@ void World_Prepare()
 }
 
 
+/*
+ * Level load stages timing. Load screen progress is taken from the stage
+ * times of the previous load (any level); initial guesses are used for the
+ * first one.
+ */
+static world_load_stage_t world_load_stages[WORLD_LOAD_STAGES_COUNT] =
+{
+    {"read_level"},
+    {"prepare_level"},
+    {"World_Clear"},
+    {"World_ScriptsOpen"},
+    {"World_GenTextures"},
+    {"World_GenAnimTextures"},
+    {"World_GenMeshes"},
+    {"World_GenSprites"},
+    {"World_GenBoxes"},
+    {"World_GenRooms"},
+    {"World_GenCameras"},
+    {"World_GenRoomFlipMap"},
+    {"World_GenSkeletalModels"},
+    {"World_GenEntities"},
+    {"World_GenBaseItems"},
+    {"World_GenSpritesBuffer"},
+    {"Audio_GenSamples"},
+    {"World_GenRoomProperties"},
+    {"World_GenRoomCollision"},
+    {"World_GetSkybox"},
+    {"World_SetEntityFunction"},
+    {"World_AutoexecOpen"},
+    {"World_FixRooms"},
+    {"cleanup"}
+};
+
+static int64_t world_load_expected[WORLD_LOAD_STAGES_COUNT] =
+{
+    60, 40, 1, 1, 100, 20, 80, 20, 20, 40, 20, 20, 80, 50, 30, 20, 50, 50, 50, 10, 50, 50, 10, 30
+};
+
+static int64_t world_load_stage_start = 0;
+
+/*
+ * Heap high-water mark of the current load stage. Without sampling it only
+ * sees the heap at stage bounds; the load benchmark enables a thread that
+ * samples the heap every millisecond to catch peaks inside the stages.
+ */
+static int          world_load_heap_sampling = 0;
+static SDL_Thread  *world_load_heap_sampler = NULL;
+static SDL_mutex   *world_load_heap_mutex = NULL;
+static SDL_atomic_t world_load_heap_sampler_run;
+static size_t       world_load_heap_peak = 0;
+
+
+static void World_LoadHeapSample()
+{
+    size_t heap = Sys_GetHeapUsed();
+    SDL_LockMutex(world_load_heap_mutex);
+    world_load_heap_peak = (heap > world_load_heap_peak) ? (heap) : (world_load_heap_peak);
+    SDL_UnlockMutex(world_load_heap_mutex);
+}
+
+
+static int World_LoadHeapSampler(void *data)
+{
+    while(SDL_AtomicGet(&world_load_heap_sampler_run))
+    {
+        World_LoadHeapSample();
+        SDL_Delay(1);
+    }
+    return 0;
+}
+
+
+static void World_LoadStageBegin()
+{
+    if(!world_load_heap_mutex)
+    {
+        world_load_heap_mutex = SDL_CreateMutex();
+    }
+    world_load_heap_peak = Sys_GetHeapUsed();
+    if(world_load_heap_sampling && !world_load_heap_sampler)
+    {
+        SDL_AtomicSet(&world_load_heap_sampler_run, 1);
+        world_load_heap_sampler = SDL_CreateThread(World_LoadHeapSampler, "heap_sampler", NULL);
+    }
+    world_load_stage_start = Sys_MicroSecTime(0);
+}
+
+
+static void World_LoadStagesFinish()
+{
+    if(world_load_heap_sampler)
+    {
+        SDL_AtomicSet(&world_load_heap_sampler_run, 0);
+        SDL_WaitThread(world_load_heap_sampler, NULL);
+        world_load_heap_sampler = NULL;
+    }
+}
+
+
+static void World_LoadStageEnd(int stage)
+{
+    int64_t now = Sys_MicroSecTime(0);
+    int64_t expected_done = 0;
+    int64_t expected_total = 0;
+
+    world_load_stages[stage].time = now - world_load_stage_start;
+    World_LoadHeapSample();
+    SDL_LockMutex(world_load_heap_mutex);
+    world_load_stages[stage].heap_used = Sys_GetHeapUsed();
+    world_load_stages[stage].heap_peak = world_load_heap_peak;
+    world_load_heap_peak = world_load_stages[stage].heap_used;                  // next stage starts from here
+    SDL_UnlockMutex(world_load_heap_mutex);
+
+    for(int i = 0; i < WORLD_LOAD_STAGES_COUNT; ++i)
+    {
+        expected_total += world_load_expected[i];
+        expected_done += (i <= stage) ? (world_load_expected[i]) : (0);
+    }
+    if(expected_total > 0)
+    {
+        // 0..100 range is used by Engine_LoadMap() before World_Open() call
+        Gui_DrawLoadScreen(100 + (int)(900 * expected_done / expected_total));
+    }
+    world_load_stage_start = Sys_MicroSecTime(0);
+}
+
+
+const struct world_load_stage_s *World_GetLoadStages()
+{
+    return world_load_stages;
+}
+
+
+/**
+ * Enables heap sampling inside the load stages, used by the load benchmark;
+ * otherwise heap_peak only accounts the heap at the stage bounds.
+ */
+void World_SetLoadHeapSampling(int enable)
+{
+    world_load_heap_sampling = enable;
+}
+
+
+void World_PrintLoadStages()
+{
+    int64_t total = 0;
+    size_t peak = 0;
+    Sys_DebugLog(SYS_LOG_FILENAME, "level load stages: %-24s %10s %10s %10s", "stage", "time, ms", "heap, MB", "heap peak");
+    for(int i = 0; i < WORLD_LOAD_STAGES_COUNT; ++i)
+    {
+        world_load_stage_p st = world_load_stages + i;
+        total += st->time;
+        peak = (st->heap_peak > peak) ? (st->heap_peak) : (peak);
+        Sys_DebugLog(SYS_LOG_FILENAME, "level load stages: %-24s %10.2f %10.2f %10.2f", st->name,
+                     st->time / 1000.0f, st->heap_used / 1048576.0f, st->heap_peak / 1048576.0f);
+    }
+    Sys_DebugLog(SYS_LOG_FILENAME, "level load stages: %-24s %10.2f %10s %10.2f   process RSS peak %.2f MB", "total", total / 1000.0f, "",
+                 peak / 1048576.0f, Sys_GetPeakMemUsed() / 1048576.0f);
+}
+
+
 void World_Open(const char *path, int trv)
 {
     VT_Level *tr = new VT_Level();
+
+    World_LoadStageBegin();
     tr->read_level(path, trv);
+    LevelCache_Open(path, tr->game_version, renderer.settings.texture_border);
+    World_LoadStageEnd(WORLD_LOAD_READ_LEVEL);
+
     tr->prepare_level();
+    World_LoadStageEnd(WORLD_LOAD_PREPARE_LEVEL);
     //tr_level->dump_textures();
+
     World_Clear();
+    World_LoadStageEnd(WORLD_LOAD_CLEAR);
 
     global_world.version = tr->game_version;
-    
+
     World_ScriptsOpen(path);            // Open configuration scripts.
-    Gui_DrawLoadScreen(200);
+    World_LoadStageEnd(WORLD_LOAD_SCRIPTS_OPEN);
 
     World_GenTextures(tr);              // Generate OGL textures
-    Gui_DrawLoadScreen(300);
+    World_LoadStageEnd(WORLD_LOAD_GEN_TEXTURES);
 
     World_GenAnimTextures(tr);          // Generate animated textures
-    Gui_DrawLoadScreen(320);
+    World_LoadStageEnd(WORLD_LOAD_GEN_ANIM_TEXTURES);
 
     World_GenMeshes(tr);                // Generate all meshes
-    Gui_DrawLoadScreen(400);
+    World_LoadStageEnd(WORLD_LOAD_GEN_MESHES);
 
     World_GenSprites(tr);               // Generate all sprites
-    Gui_DrawLoadScreen(420);
+    World_LoadStageEnd(WORLD_LOAD_GEN_SPRITES);
 
     World_GenBoxes(tr);                 // Generate boxes.
-    Gui_DrawLoadScreen(440);
+    World_LoadStageEnd(WORLD_LOAD_GEN_BOXES);
 
     World_GenRooms(tr);                 // Build all rooms
-    Gui_DrawLoadScreen(480);
+    World_LoadStageEnd(WORLD_LOAD_GEN_ROOMS);
 
     World_GenCameras(tr);               // Generate cameras & sinks.
     World_GenCinematicCameras(tr);
     World_GenFlyByCameras(tr);
-    Gui_DrawLoadScreen(500);
+    World_LoadStageEnd(WORLD_LOAD_GEN_CAMERAS);
 
     World_GenRoomFlipMap();             // Generate room flipmaps
-    Gui_DrawLoadScreen(520);
+    World_LoadStageEnd(WORLD_LOAD_GEN_ROOM_FLIPMAP);
 
     // Build all skeletal models. Must be generated before TR_Sector_Calculate() function.
     World_GenSkeletalModels(tr);
-    Gui_DrawLoadScreen(600);
+    World_LoadStageEnd(WORLD_LOAD_GEN_SKELETAL_MODELS);
 
     World_GenEntities(tr);              // Build all moveables (entities)
-    Gui_DrawLoadScreen(650);
+    World_LoadStageEnd(WORLD_LOAD_GEN_ENTITIES);
 
     World_GenBaseItems();               // Generate inventory item entries.
-    Gui_DrawLoadScreen(680);
+    World_LoadStageEnd(WORLD_LOAD_GEN_BASE_ITEMS);
 
     // Generate sprite buffers. Only now because entity generation adds new sprites
     World_GenSpritesBuffer();
-    Gui_DrawLoadScreen(700);
+    World_LoadStageEnd(WORLD_LOAD_GEN_SPRITES_BUFFER);
 
     // Initialize audio.
     Audio_GenSamples(tr);
-    Gui_DrawLoadScreen(750);
+    World_LoadStageEnd(WORLD_LOAD_GEN_SAMPLES);
 
     World_GenRoomProperties(tr);
-    Gui_DrawLoadScreen(800);
+    World_LoadStageEnd(WORLD_LOAD_GEN_ROOM_PROPERTIES);
 
     World_GenRoomCollision();
-    Gui_DrawLoadScreen(850);
+    World_LoadStageEnd(WORLD_LOAD_GEN_ROOM_COLLISION);
 
     // Find and set skybox.
     global_world.sky_box = World_GetSkybox();
-    Gui_DrawLoadScreen(860);
+    World_LoadStageEnd(WORLD_LOAD_SKYBOX);
 
     // Generate entity functions.
     for(avl_node_p p = global_world.entity_tree.list; p; p = p->next)
     {
         World_SetEntityFunction((entity_p)p->data);
     }
-    Gui_DrawLoadScreen(910);
+    World_LoadStageEnd(WORLD_LOAD_ENTITY_FUNCTIONS);
 
     // Load entity collision flags and ID overrides from script.
 
-    Gui_DrawLoadScreen(940);
-
     // Process level autoexec loading.
     Audio_Init();
     World_AutoexecOpen();
-    Gui_DrawLoadScreen(960);
+    World_LoadStageEnd(WORLD_LOAD_AUTOEXEC);
 
     // Fix initial room states
     World_FixRooms();
     World_UpdateFlipCollisions();
-    Gui_DrawLoadScreen(970);
+    World_LoadStageEnd(WORLD_LOAD_FIX_ROOMS);
 
     if(global_world.tex_atlas)
     {
@@ -270,6 +466,15 @@ void World_Open(const char *path, int trv)
     }
 
     delete tr;
+    LevelCache_Close();
+    World_LoadStageEnd(WORLD_LOAD_CLEANUP);
+    World_LoadStagesFinish();
+
+    for(int i = 0; i < WORLD_LOAD_STAGES_COUNT; ++i)
+    {
+        world_load_expected[i] = world_load_stages[i].time + 1;
+    }
+    World_PrintLoadStages();
 }
 
 
@@ -294,6 +499,7 @@ void World_Clear()
 
     /* Now we can delete physics misc objects */
     Physics_CleanUpObjects();
+    World_ClearFlipTweens();
 
     for(uint32_t i = 0; i < global_world.rooms_count; i++)
     {
@@ -977,41 +1183,191 @@ void World_BuildOverlappedRoomsList(struct room_s *room)
  * WORLD  TRIGGERING  FUNCTIONS
  */
 
+static flip_tweens_p World_GetContentFlipTweens(struct room_content_s *content)
+{
+    flip_tweens_p ft = global_world.flip_tweens + content->original_room_id;
+    if(!ft->is_ready)
+    {
+        room_p room = global_world.rooms + content->original_room_id;
+        ft->portal_rooms = (room_p*)malloc(room->sectors_count * sizeof(room_p));
+        ft->portal_rooms_count = 0;
+        for(uint32_t i = 0; i < room->sectors_count; ++i)
+        {
+            room_p portal_room = content->sectors[i].portal_to_room;
+            if(portal_room)
+            {
+                uint32_t j = 0;
+                for(; (j < ft->portal_rooms_count) && (ft->portal_rooms[j] != portal_room); ++j);
+                if(j == ft->portal_rooms_count)
+                {
+                    ft->portal_rooms[ft->portal_rooms_count++] = portal_room;
+                }
+            }
+        }
+        ft->is_ready = 1;
+    }
+    return ft;
+}
+
+
+static bool World_IsFlipTweenStateCurrent(flip_tween_state_p state, room_p room, flip_tweens_p ft)
+{
+    if(state->key[0] != room->content)
+    {
+        return false;
+    }
+    for(uint32_t i = 0; i < ft->portal_rooms_count; ++i)
+    {
+        if(state->key[i + 1] != ft->portal_rooms[i]->real_room->content)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+static flip_tween_state_p World_BuildFlipTweenState(room_p room, flip_tweens_p ft)
+{
+    flip_tween_state_p state = (flip_tween_state_p)malloc(sizeof(flip_tween_state_t));
+    int num_tweens = room->sectors_count * 4;
+    size_t buff_size = num_tweens * sizeof(sector_tween_t);
+    sector_tween_p room_tween = (sector_tween_p)Sys_GetTempMem(buff_size);
+
+    state->key = (struct room_content_s**)malloc((ft->portal_rooms_count + 1) * sizeof(struct room_content_s*));
+    state->key[0] = room->content;
+    for(uint32_t i = 0; i < ft->portal_rooms_count; ++i)
+    {
+        state->key[i + 1] = ft->portal_rooms[i]->real_room->content;
+    }
+    state->body = NULL;
+    state->next = NULL;
+
+    // Clear tween array.
+    for(int j = 0; j < num_tweens; j++)
+    {
+        room_tween[j].ceiling_tween_type = TR_SECTOR_TWEEN_TYPE_NONE;
+        room_tween[j].floor_tween_type   = TR_SECTOR_TWEEN_TYPE_NONE;
+    }
+
+    // Most difficult task with converting floordata collision to trimesh collision is
+    // building inbetween polygons which will block out gaps between sector heights.
+    num_tweens = Res_Sector_GenDynamicTweens(room, room_tween);
+    if(num_tweens > 0)
+    {
+        state->body = Physics_GenRoomRigidBody(room, NULL, 0, room_tween, num_tweens);
+    }
+
+    Sys_ReturnTempMem(buff_size);
+
+    return state;
+}
+
+
+static void World_DeleteFlipTweenState(flip_tween_state_p state)
+{
+    if(state->key[0]->physics_alt_tween == state->body)
+    {
+        state->key[0]->physics_alt_tween = NULL;
+    }
+    Physics_DeleteObject(state->body);
+    free(state->key);
+    free(state);
+}
+
+
+void World_ClearFlipTweens()
+{
+    if(global_world.flip_tweens)
+    {
+        for(uint32_t i = 0; i < global_world.rooms_count; ++i)
+        {
+            flip_tweens_p ft = global_world.flip_tweens + i;
+            while(ft->states)
+            {
+                flip_tween_state_p next = ft->states->next;
+                World_DeleteFlipTweenState(ft->states);
+                ft->states = next;
+            }
+            free(ft->portal_rooms);
+        }
+        free(global_world.flip_tweens);
+        global_world.flip_tweens = NULL;
+    }
+}
+
+
+/*
+ * Rooms which tweens can not be changed by flips (no alternate rooms on both
+ * sides of the portals) are skipped; the previous room state is made current
+ * again if it is cached, otherwise tweens are built and the oldest state of
+ * the room is dropped.
+ */
 void World_UpdateFlipCollisions()
 {
     room_p r = global_world.rooms;
+
+    if((global_world.flip_tweens == NULL) && global_world.rooms_count)
+    {
+        global_world.flip_tweens = (flip_tweens_p)calloc(global_world.rooms_count, sizeof(flip_tweens_t));
+    }
+
     for(uint32_t i = 0; i < global_world.rooms_count; ++i, ++r)
     {
         if(r->real_room == r)
         {
-            int num_tweens = r->sectors_count * 4;
-            size_t buff_size = num_tweens * sizeof(sector_tween_t);
-            sector_tween_p room_tween = (sector_tween_p)Sys_GetTempMem(buff_size);
-
-            // Clear previous dynamic tweens
-            Physics_DeleteObject(r->content->physics_alt_tween);
-            r->content->physics_alt_tween = NULL;
+            flip_tweens_p ft = World_GetContentFlipTweens(r->content);
+            flip_tweens_p room_ft = global_world.flip_tweens + i;
+            flip_tween_state_p prev = NULL, state = room_ft->states;
+            bool is_alterable = r->alternate_room_next || r->alternate_room_prev;
 
-            // Clear tween array.
-            for(int j = 0; j < num_tweens; j++)
+            for(uint32_t j = 0; !is_alterable && (j < ft->portal_rooms_count); ++j)
             {
-                room_tween[j].ceiling_tween_type = TR_SECTOR_TWEEN_TYPE_NONE;
-                room_tween[j].floor_tween_type   = TR_SECTOR_TWEEN_TYPE_NONE;
+                is_alterable = ft->portal_rooms[j]->alternate_room_next || ft->portal_rooms[j]->alternate_room_prev;
             }
 
-            // Most difficult task with converting floordata collision to trimesh collision is
-            // building inbetween polygons which will block out gaps between sector heights.
-            num_tweens = Res_Sector_GenDynamicTweens(r, room_tween);
-            if(num_tweens > 0)
+            if(!is_alterable)
             {
-                r->content->physics_alt_tween = Physics_GenRoomRigidBody(r, NULL, 0, room_tween, num_tweens);
                 if(r->content->physics_alt_tween)
                 {
-                    Physics_EnableObject(r->content->physics_alt_tween);
+                    Physics_DisableObject(r->content->physics_alt_tween);
+                    r->content->physics_alt_tween = NULL;
                 }
+                continue;
             }
 
-            Sys_ReturnTempMem(buff_size);
+            for(; state && !World_IsFlipTweenStateCurrent(state, r, ft); prev = state, state = state->next);
+            if(state && prev)
+            {
+                prev->next = state->next;
+                state->next = room_ft->states;
+                room_ft->states = state;
+            }
+            else if(!state)
+            {
+                state = World_BuildFlipTweenState(r, ft);
+                state->next = room_ft->states;
+                room_ft->states = state;
+                room_ft->states_count++;
+                if(room_ft->states_count > WORLD_FLIP_TWEEN_STATES)
+                {
+                    for(prev = room_ft->states; prev->next->next; prev = prev->next);
+                    World_DeleteFlipTweenState(prev->next);
+                    prev->next = NULL;
+                    room_ft->states_count--;
+                }
+            }
+
+            if(r->content->physics_alt_tween && (r->content->physics_alt_tween != state->body))
+            {
+                Physics_DisableObject(r->content->physics_alt_tween);
+            }
+            r->content->physics_alt_tween = state->body;
+            if(state->body)
+            {
+                Physics_SetOwnerObject(state->body, r->self);
+                Physics_EnableObject(state->body);
+            }
         }
     }
 }
@@ -1327,6 +1683,7 @@ void World_GenTextures(class VT_Level *tr)
     qglPixelStorei(GL_UNPACK_ALIGNMENT, 1);
     qglPixelZoom(1, 1);
     global_world.tex_atlas->createTextures(global_world.textures);
+    LevelCache_SetAtlas(global_world.textures, global_world.tex_count, (uint32_t)global_world.tex_atlas->getPageWidth());
 
     qglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);   // Mag filter is always linear.
 
@@ -1481,8 +1838,12 @@ void World_GenMeshes(class VT_Level *tr)
     base_mesh = global_world.meshes = (base_mesh_p)calloc(global_world.meshes_count, sizeof(base_mesh_t));
     for(uint32_t i = 0; i < global_world.meshes_count; i++, base_mesh++)
     {
-        TR_GenMesh(base_mesh, i, global_world.anim_sequences, global_world.anim_sequences_count, global_world.tex_atlas, tr);
-        BaseMesh_GenFaces(base_mesh);
+        if(!LevelCache_LoadMesh(base_mesh, i))
+        {
+            TR_GenMesh(base_mesh, i, global_world.anim_sequences, global_world.anim_sequences_count, global_world.tex_atlas, tr);
+            BaseMesh_GenFaces(base_mesh);
+            LevelCache_SaveMesh(base_mesh);
+        }
     }
 }
 
@@ -1740,10 +2101,14 @@ void World_GenRoom(struct room_s *room, class VT_Level *tr)
     room->content->ambient_lighting[1] = tr->rooms[room->id].light_colour.g * 2;
     room->content->ambient_lighting[2] = tr->rooms[room->id].light_colour.b * 2;
 
-    TR_GenRoomMesh(room, room->id, global_world.anim_sequences, global_world.anim_sequences_count, global_world.tex_atlas, tr);
-    if(room->content->mesh)
+    if(!LevelCache_LoadRoomMesh(&room->content->mesh, room->id))
     {
-        BaseMesh_GenFaces(room->content->mesh);
+        TR_GenRoomMesh(room, room->id, global_world.anim_sequences, global_world.anim_sequences_count, global_world.tex_atlas, tr);
+        if(room->content->mesh)
+        {
+            BaseMesh_GenFaces(room->content->mesh);
+        }
+        LevelCache_SaveRoomMesh(room->content->mesh, room->id);
     }
     /*
      * let us load sectors
@@ -2369,11 +2734,22 @@ void World_GenRoomProperties(class VT_Level *tr)
     for(uint32_t i = 0; i < global_world.rooms_count; i++)
     {
         room_p r = global_world.rooms + i;
-        // Fill heightmap and translate floordata.
+        if(!LevelCache_LoadRoomSectors(global_world.rooms, global_world.rooms_count, i))
+        {
+            // Fill heightmap and translate floordata.
+            for(uint32_t j = 0; j < r->sectors_count; j++)
+            {
+                Res_Sector_TranslateFloorData(global_world.rooms, global_world.rooms_count, r->content->sectors + j, tr);
+            }
+
+            // Basic sector calculations.
+            Res_RoomSectorsCalculate(global_world.rooms, global_world.rooms_count, i, tr);
+            LevelCache_SaveRoomSectors(global_world.rooms, i);
+        }
+
         for(uint32_t j = 0; j < r->sectors_count; j++)
         {
             room_sector_p rs = r->content->sectors + j;
-            Res_Sector_TranslateFloorData(global_world.rooms, global_world.rooms_count, rs, tr);
             for(trigger_command_p cmd = (rs->trigger) ? (rs->trigger->commands) : (NULL); cmd; cmd = cmd->next)
             {
                 if(cmd->function == TR_FD_TRIGFUNC_PLAYTRACK)
@@ -2382,9 +2758,6 @@ void World_GenRoomProperties(class VT_Level *tr)
                 }
             }
         }
-
-        // Basic sector calculations.
-        Res_RoomSectorsCalculate(global_world.rooms, global_world.rooms_count, i, tr);
     }
 
     for(uint32_t i = 0; i < global_world.rooms_count; i++)
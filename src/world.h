@@ -9,11 +9,52 @@
 #define FLIP_STATE_ON       (0x01)
 #define FLIP_STATE_BY_FLAG  (0x03)
 
+// World_Open() stages; each one is timed on every level load.
+enum world_load_stage_e
+{
+    WORLD_LOAD_READ_LEVEL = 0,
+    WORLD_LOAD_PREPARE_LEVEL,
+    WORLD_LOAD_CLEAR,
+    WORLD_LOAD_SCRIPTS_OPEN,
+    WORLD_LOAD_GEN_TEXTURES,
+    WORLD_LOAD_GEN_ANIM_TEXTURES,
+    WORLD_LOAD_GEN_MESHES,
+    WORLD_LOAD_GEN_SPRITES,
+    WORLD_LOAD_GEN_BOXES,
+    WORLD_LOAD_GEN_ROOMS,
+    WORLD_LOAD_GEN_CAMERAS,
+    WORLD_LOAD_GEN_ROOM_FLIPMAP,
+    WORLD_LOAD_GEN_SKELETAL_MODELS,
+    WORLD_LOAD_GEN_ENTITIES,
+    WORLD_LOAD_GEN_BASE_ITEMS,
+    WORLD_LOAD_GEN_SPRITES_BUFFER,
+    WORLD_LOAD_GEN_SAMPLES,
+    WORLD_LOAD_GEN_ROOM_PROPERTIES,
+    WORLD_LOAD_GEN_ROOM_COLLISION,
+    WORLD_LOAD_SKYBOX,
+    WORLD_LOAD_ENTITY_FUNCTIONS,
+    WORLD_LOAD_AUTOEXEC,
+    WORLD_LOAD_FIX_ROOMS,
+    WORLD_LOAD_CLEANUP,
+    WORLD_LOAD_STAGES_COUNT
+};
+
+typedef struct world_load_stage_s
+{
+    const char     *name;
+    int64_t         time;                   // microseconds
+    size_t          heap_used;              // heap in use after the stage, bytes
+    size_t          heap_peak;              // heap high-water mark during the stage, bytes
+}world_load_stage_t, *world_load_stage_p;
+
 
 void World_Prepare();
 void World_Open(const char *path, int trv);
 void World_Clear();
 int32_t World_GetVersion();
+const struct world_load_stage_s *World_GetLoadStages();
+void World_SetLoadHeapSampling(int enable);
+void World_PrintLoadStages();
 
 uint32_t World_SpawnEntity(uint32_t model_id, uint32_t room_id, float pos[3], float ang[3], int32_t id);
 struct entity_s *World_GetEntityByID(uint32_t id);